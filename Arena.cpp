@@ -0,0 +1,45 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+#include "Arena.h"
+
+namespace {
+    uint8_t* AlignPointer(uint8_t* pointer, size_t alignment) {
+        return reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(pointer) + alignment - 1) & ~(alignment - 1));
+    }
+}
+
+void* Arena::Allocate(size_t size, size_t alignment) {
+    assert(0 != alignment && 0 == (alignment & (alignment - 1)));
+
+    if (nullptr != _cursor) {
+        uint8_t* aligned = AlignPointer(_cursor, alignment);
+        if (aligned <= _end && size <= static_cast<size_t>(_end - aligned)) {
+            _cursor = aligned + size;
+            _usedSize += size;
+            return aligned;
+        }
+    }
+
+    // Large requests get a block of their own so the current block keeps its free space
+    const bool dedicated = size + alignment > _blockSize / 4;
+    const size_t blockSize = dedicated ? size + alignment - 1 : _blockSize;
+    _blocks.emplace_back(new uint8_t[blockSize]);
+    _reservedSize += blockSize;
+    _usedSize += size;
+
+    uint8_t* aligned = AlignPointer(_blocks.back().get(), alignment);
+    if (false == dedicated) {
+        _cursor = aligned + size;
+        _end = _blocks.back().get() + blockSize;
+    }
+    return aligned;
+}
+
+void Arena::Reset() {
+    _blocks.clear();
+    _cursor = nullptr;
+    _end = nullptr;
+    _usedSize = 0;
+    _reservedSize = 0;
+}
@@ -0,0 +1,163 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#pragma once
+
+// Contiguous elements allocated from an Arena or an ObjectPool, valid until it is reset or cleared
+template<typename T>
+struct ArenaSpan {
+    T*                                      data = nullptr;
+    uint32_t                                count = 0;
+
+    T*                                      begin() const { return data; }
+    T*                                      end() const { return data + count; }
+    uint32_t                                size() const { return count; }
+    bool                                    empty() const { return 0 == count; }
+    T&                                      operator[](size_t index) const { assert(index < count); return data[index]; }
+};
+
+// Bump allocator over large blocks, every allocation is released at once by Reset or the destructor.
+// Only trivially destructible types are placed in it since nothing runs their destructors.
+class Arena {
+public:
+    explicit                                Arena(size_t blockSize = 64 * 1024) : _blockSize(blockSize) {}
+                                            ~Arena() = default;
+
+                                            Arena(const Arena&) = delete;
+    Arena&                                  operator=(const Arena&) = delete;
+                                            Arena(Arena&&) noexcept = default;
+    Arena&                                  operator=(Arena&&) noexcept = default;
+
+    void*                                   Allocate(size_t size, size_t alignment);
+    void                                    Reset();
+
+    // Bytes handed out and bytes reserved in blocks
+    size_t                                  UsedSize() const { return _usedSize; }
+    size_t                                  ReservedSize() const { return _reservedSize; }
+
+    template<typename T>
+    ArenaSpan<T>                            AllocateArray(size_t count);
+
+    template<typename T, typename... Args>
+    T*                                      New(Args&&... args);
+
+private:
+    std::vector<std::unique_ptr<uint8_t[]>> _blocks;
+    uint8_t*                                _cursor = nullptr;
+    uint8_t*                                _end = nullptr;
+    size_t                                  _blockSize = 0;
+    size_t                                  _usedSize = 0;
+    size_t                                  _reservedSize = 0;
+};
+
+template<typename T>
+ArenaSpan<T> Arena::AllocateArray(size_t count) {
+    static_assert(std::is_trivially_destructible_v<T>, "arena memory is released without running destructors");
+
+    ArenaSpan<T> span;
+    if (0 == count) {
+        return span;
+    }
+    span.data = static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+    span.count = static_cast<uint32_t>(count);
+    for (size_t i = 0; i < count; ++i) {
+        new (span.data + i) T();
+    }
+    return span;
+}
+
+template<typename T, typename... Args>
+T* Arena::New(Args&&... args) {
+    static_assert(std::is_trivially_destructible_v<T>, "arena memory is released without running destructors");
+    return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+}
+
+/*
+    Owns objects of one type in blocks of contiguous storage, so objects created one after another sit next to each other.
+    Addresses stay valid until Clear or the destructor, which run every destructor in reverse creation order at once.
+*/
+template<typename T>
+class ObjectPool {
+public:
+    explicit                                ObjectPool(size_t blockCapacity = 64) : _blockCapacity(blockCapacity) {}
+                                            ~ObjectPool() { Clear(); }
+
+                                            ObjectPool(const ObjectPool&) = delete;
+    ObjectPool&                             operator=(const ObjectPool&) = delete;
+                                            ObjectPool(ObjectPool&& other) noexcept;
+    ObjectPool&                             operator=(ObjectPool&& other) noexcept;
+
+    template<typename... Args>
+    T*                                      New(Args&&... args);
+
+    // The next count objects from New are consecutive
+    void                                    Reserve(size_t count);
+    void                                    Clear();
+
+    size_t                                  Size() const { return _size; }
+
+private:
+    struct Block {
+        T*                                  data = nullptr;
+        size_t                              capacity = 0;
+        size_t                              size = 0;
+    };
+
+    std::vector<Block>                      _blocks;
+    size_t                                  _blockCapacity = 0;
+    size_t                                  _size = 0;
+};
+
+template<typename T>
+ObjectPool<T>::ObjectPool(ObjectPool&& other) noexcept : _blocks(std::move(other._blocks)), _blockCapacity(other._blockCapacity), _size(other._size) {
+    other._blocks.clear();
+    other._size = 0;
+}
+
+template<typename T>
+ObjectPool<T>& ObjectPool<T>::operator=(ObjectPool&& other) noexcept {
+    if (this != &other) {
+        Clear();
+        _blocks = std::move(other._blocks);
+        _blockCapacity = other._blockCapacity;
+        _size = other._size;
+        other._blocks.clear();
+        other._size = 0;
+    }
+    return *this;
+}
+
+template<typename T>
+template<typename... Args>
+T* ObjectPool<T>::New(Args&&... args) {
+    if (_blocks.empty() || _blocks.back().size == _blocks.back().capacity) {
+        Reserve(1);
+    }
+    Block& block = _blocks.back();
+    T* object = new (block.data + block.size) T(std::forward<Args>(args)...);
+    ++block.size;
+    ++_size;
+    return object;
+}
+
+template<typename T>
+void ObjectPool<T>::Reserve(size_t count) {
+    if (false == _blocks.empty() && _blocks.back().capacity - _blocks.back().size >= count) {
+        return;
+    }
+    Block block;
+    block.capacity = std::max(count, _blockCapacity);
+    block.data = std::allocator<T>().allocate(block.capacity);
+    _blocks.push_back(block);
+}
+
+template<typename T>
+void ObjectPool<T>::Clear() {
+    for (auto block = _blocks.rbegin(); block != _blocks.rend(); ++block) {
+        for (size_t i = block->size; i > 0; --i) {
+            block->data[i - 1].~T();
+        }
+        std::allocator<T>().deallocate(block->data, block->capacity);
+    }
+    _blocks.clear();
+    _size = 0;
+}
@@ -0,0 +1,218 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+#include "Base64.h"
+
+#include "CpuFeatures.h"
+#include "ThreadPool.h"
+
+namespace {
+    // Inputs above one chunk are split into chunks of this many 4 character groups, 512KB of text each
+    constexpr size_t parallelChunkQuads = 128 * 1024;
+
+    constexpr uint8_t invalidCharacter = 0xff;
+
+    constexpr std::array<uint8_t, 256> MakeDecodeTable() {
+        std::array<uint8_t, 256> table{};
+        for (size_t i = 0; i < table.size(); ++i) {
+            table[i] = invalidCharacter;
+        }
+        constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (uint8_t i = 0; i < 64; ++i) {
+            table[static_cast<uint8_t>(alphabet[i])] = i;
+        }
+        return table;
+    }
+
+    constexpr std::array<uint8_t, 256> decodeTable = MakeDecodeTable();
+
+    bool DecodeQuadsScalar(const char* src, size_t quadCount, uint8_t* dst) {
+        for (size_t quad = 0; quad < quadCount; ++quad, src += 4, dst += 3) {
+            const uint32_t a = decodeTable[static_cast<uint8_t>(src[0])];
+            const uint32_t b = decodeTable[static_cast<uint8_t>(src[1])];
+            const uint32_t c = decodeTable[static_cast<uint8_t>(src[2])];
+            const uint32_t d = decodeTable[static_cast<uint8_t>(src[3])];
+            if (0 != ((a | b | c | d) & 0x80)) {
+                return false;
+            }
+            const uint32_t value = (a << 18) | (b << 12) | (c << 6) | d;
+            dst[0] = static_cast<uint8_t>(value >> 16);
+            dst[1] = static_cast<uint8_t>(value >> 8);
+            dst[2] = static_cast<uint8_t>(value);
+        }
+        return true;
+    }
+
+    /*
+        Vector kernels, 16 or 32 characters become 12 or 24 bytes. A character is valid when the bit its high nibble selects
+        in lutHigh is clear in the lutLow entry of its low nibble, lutRoll holds the offset from ASCII to the 6 bit value per
+        high nibble ('/' gets its own slot). Both stop at the first block with an invalid character and return the number of
+        4 character groups they decoded, the scalar loop takes over from there.
+    */
+    size_t DecodeQuadsSSE41(const char* src, size_t quadCount, uint8_t* dst) {
+        const __m128i lutLow = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+        const __m128i lutHigh = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m128i nibbleMask = _mm_set1_epi8(0x0f);
+        const __m128i slash = _mm_set1_epi8('/');
+        const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+        size_t quad = 0;
+        for (; quad + 4 <= quadCount; quad += 4) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + quad * 4));
+            const __m128i highNibbles = _mm_and_si128(_mm_srli_epi32(chunk, 4), nibbleMask);
+            const __m128i low = _mm_shuffle_epi8(lutLow, _mm_and_si128(chunk, nibbleMask));
+            const __m128i high = _mm_shuffle_epi8(lutHigh, highNibbles);
+            if (0 == _mm_testz_si128(low, high)) {
+                break;
+            }
+
+            const __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(_mm_cmpeq_epi8(chunk, slash), highNibbles));
+            const __m128i values = _mm_add_epi8(chunk, roll);
+
+            // 4 x 6 bits to one 24 bit value per dword, then big endian bytes
+            const __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+            const __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+            const __m128i bytes = _mm_shuffle_epi8(words, pack);
+
+            uint8_t* out = dst + quad * 3;
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out), bytes);
+            const int32_t tail = _mm_extract_epi32(bytes, 2);
+            memcpy(out + 8, &tail, sizeof(tail));
+        }
+        return quad;
+    }
+
+    size_t DecodeQuadsAVX2(const char* src, size_t quadCount, uint8_t* dst) {
+        const __m256i lutLow = _mm256_setr_epi8(
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+        const __m256i lutHigh = _mm256_setr_epi8(
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m256i lutRoll = _mm256_setr_epi8(
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m256i nibbleMask = _mm256_set1_epi8(0x0f);
+        const __m256i slash = _mm256_set1_epi8('/');
+        const __m256i pack = _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+        // The 12 bytes of each lane next to each other
+        const __m256i joinLanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+
+        size_t quad = 0;
+        for (; quad + 8 <= quadCount; quad += 8) {
+            const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + quad * 4));
+            const __m256i highNibbles = _mm256_and_si256(_mm256_srli_epi32(chunk, 4), nibbleMask);
+            const __m256i low = _mm256_shuffle_epi8(lutLow, _mm256_and_si256(chunk, nibbleMask));
+            const __m256i high = _mm256_shuffle_epi8(lutHigh, highNibbles);
+            if (0 == _mm256_testz_si256(low, high)) {
+                break;
+            }
+
+            const __m256i roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(_mm256_cmpeq_epi8(chunk, slash), highNibbles));
+            const __m256i values = _mm256_add_epi8(chunk, roll);
+
+            const __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+            const __m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+            const __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(words, pack), joinLanes);
+
+            // Exactly 24 bytes are written, so chunks decoded on other threads are never touched
+            uint8_t* out = dst + quad * 3;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(bytes));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 16), _mm256_extracti128_si256(bytes, 1));
+        }
+        return quad;
+    }
+
+    bool DecodeQuads(const char* src, size_t quadCount, uint8_t* dst) {
+        const CpuFeatures& features = CpuFeatures::Get();
+
+        size_t decoded = 0;
+        if (features.avx2) {
+            decoded = DecodeQuadsAVX2(src, quadCount, dst);
+        }
+        if (features.ssse3 && features.sse41) {
+            decoded += DecodeQuadsSSE41(src + decoded * 4, quadCount - decoded, dst + decoded * 3);
+        }
+        return DecodeQuadsScalar(src + decoded * 4, quadCount - decoded, dst + decoded * 3);
+    }
+
+    // Text without the '=' padding of its last group
+    std::string_view StripPadding(std::string_view text) {
+        if (0 == text.size() % 4) {
+            for (uint32_t i = 0; i < 2 && false == text.empty() && '=' == text.back(); ++i) {
+                text.remove_suffix(1);
+            }
+        }
+        return text;
+    }
+}
+
+bool ParseDataUri(std::string_view uri, DataUri& dataUri) {
+    constexpr std::string_view scheme = "data:";
+    constexpr std::string_view base64 = ";base64";
+
+    if (0 != uri.compare(0, scheme.size(), scheme)) {
+        return false;
+    }
+    const size_t comma = uri.find(',');
+    if (std::string_view::npos == comma) {
+        return false;
+    }
+
+    const std::string_view header = uri.substr(scheme.size(), comma - scheme.size());
+    if (header.size() < base64.size() || 0 != header.compare(header.size() - base64.size(), base64.size(), base64)) {
+        return false;
+    }
+    const std::string_view parameters = header.substr(0, header.size() - base64.size());
+    dataUri.mimeType = parameters.substr(0, parameters.find(';'));
+    dataUri.payload = uri.substr(comma + 1);
+    return true;
+}
+
+bool GetBase64DecodedSize(std::string_view text, size_t& size) {
+    const std::string_view stripped = StripPadding(text);
+    const size_t remainder = stripped.size() % 4;
+    if (1 == remainder) {
+        return false;
+    }
+    size = stripped.size() / 4 * 3 + (0 < remainder ? remainder - 1 : 0);
+    return true;
+}
+
+bool DecodeBase64(std::string_view text, uint8_t* dst) {
+    const std::string_view stripped = StripPadding(text);
+    const size_t quadCount = stripped.size() / 4;
+    const size_t remainder = stripped.size() % 4;
+    if (1 == remainder) {
+        return false;
+    }
+
+    // Chunks write disjoint ranges of dst
+    const size_t chunkCount = (quadCount + parallelChunkQuads - 1) / parallelChunkQuads;
+    std::atomic<bool> valid{ true };
+    ThreadPool::Get().ParallelFor(chunkCount, [&](size_t chunk) {
+        const size_t first = chunk * parallelChunkQuads;
+        const size_t count = std::min(parallelChunkQuads, quadCount - first);
+        if (false == DecodeQuads(stripped.data() + first * 4, count, dst + first * 3)) {
+            valid = false;
+        }
+    });
+    if (false == valid) {
+        return false;
+    }
+
+    // Last group without padding, 2 or 3 characters for 1 or 2 bytes
+    if (0 < remainder) {
+        char last[4] = { 'A', 'A', 'A', 'A' };
+        memcpy(last, stripped.data() + quadCount * 4, remainder);
+        uint8_t bytes[3];
+        if (false == DecodeQuadsScalar(last, 1, bytes)) {
+            return false;
+        }
+        memcpy(dst + quadCount * 3, bytes, remainder - 1);
+    }
+    return true;
+}
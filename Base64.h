@@ -0,0 +1,21 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#pragma once
+
+// Parts of a base64 "data:[<mime type>][;parameters];base64,<payload>" URI, views into the URI text
+struct DataUri {
+    std::string_view                        mimeType;
+    std::string_view                        payload;
+};
+
+// False for anything but a base64 data URI
+bool ParseDataUri(std::string_view uri, DataUri& dataUri);
+
+// Decoded size of base64 text with or without '=' padding, false when the length cannot be base64
+bool GetBase64DecodedSize(std::string_view text, size_t& size);
+
+/*
+    Decodes base64 text into dst, which holds GetBase64DecodedSize() bytes. Uses SSE4.1 or AVX2 when available and
+    splits large inputs into chunks decoded on the thread pool. Returns false for characters outside the base64 alphabet.
+*/
+bool DecodeBase64(std::string_view text, uint8_t* dst);
@@ -0,0 +1,37 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+#include "CpuFeatures.h"
+
+namespace {
+    CpuFeatures Detect() {
+        CpuFeatures features;
+
+        int info[4]{};
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+
+        if (1 <= maxLeaf) {
+            __cpuid(info, 1);
+            features.ssse3 = 0 != (info[2] & (1 << 9));
+            features.sse41 = 0 != (info[2] & (1 << 19));
+
+            // AVX also needs the OS to save the YMM registers
+            const bool osxsave = 0 != (info[2] & (1 << 27));
+            const bool avx = 0 != (info[2] & (1 << 28));
+            features.avx = avx && osxsave && 0x6 == (_xgetbv(0) & 0x6);
+        }
+
+        if (7 <= maxLeaf && features.avx) {
+            __cpuidex(info, 7, 0);
+            features.avx2 = 0 != (info[1] & (1 << 5));
+        }
+
+        return features;
+    }
+}
+
+const CpuFeatures& CpuFeatures::Get() {
+    static const CpuFeatures features = Detect();
+    return features;
+}
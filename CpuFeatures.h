@@ -0,0 +1,13 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#pragma once
+
+// Instruction sets available at run time, used to pick SIMD code paths
+struct CpuFeatures {
+    bool                                    ssse3 = false;
+    bool                                    sse41 = false;
+    bool                                    avx = false;
+    bool                                    avx2 = false;
+
+    static const CpuFeatures&               Get();
+};
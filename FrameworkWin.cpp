@@ -249,9 +249,11 @@ namespace Framework::Win {
         _main.Prepare(_win.GetInstance(), _win.GetHandle());
 
         _scene.Initialize(_main, "environments/papermill.ktx"s);
-        _scene.LoadScene(_main, Path::Apply("models/DamagedHelmet/glTF-Embedded/DamagedHelmet.gltf"s));
         _scene.RecordBuffers(_main);
 
+        // The skybox is presented until the model is resident
+        _scene.LoadSceneAsync(_main, Path::Apply("models/DamagedHelmet/glTF-Embedded/DamagedHelmet.gltf"s));
+
         prepared = true;
 
         const float aspect = _main.GetSettings().width / static_cast<float>(_main.GetSettings().height);
@@ -273,6 +275,8 @@ namespace Framework::Win {
         else
             Vk::CheckResult(acquire);
 
+        _scene.OnFrameBoundary(_main, currentBuffer);
+
         UpdateUniformBuffers();
         _scene.OnUniformBufferSets(currentBuffer);
 
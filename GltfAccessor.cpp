@@ -0,0 +1,556 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+#include "GltfAccessor.h"
+
+#pragma warning(disable : 4100)
+#include <tinygltf/tiny_gltf.h>
+#pragma warning(default : 4100)
+
+#include "CpuFeatures.h"
+#include "GltfDocument.h"
+
+namespace Vk {
+    namespace {
+        uint32_t ComponentSize(int32_t componentType) {
+            switch (componentType) {
+            case TINYGLTF_COMPONENT_TYPE_BYTE:
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                return 1;
+            case TINYGLTF_COMPONENT_TYPE_SHORT:
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+                return 2;
+            case TINYGLTF_COMPONENT_TYPE_INT:
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+            case TINYGLTF_COMPONENT_TYPE_FLOAT:
+                return 4;
+            default:
+                return 0;
+            }
+        }
+
+        template<typename T>
+        T Load(const uint8_t* src) {
+            T value;
+            memcpy(&value, src, sizeof(T));
+            return value;
+        }
+
+        // Reference conversion, also used for the tails of the SIMD loops
+        float ReadComponent(const uint8_t* src, int32_t componentType, bool normalized) {
+            switch (componentType) {
+            case TINYGLTF_COMPONENT_TYPE_BYTE: {
+                const float value = Load<int8_t>(src);
+                return normalized ? std::max(value / 127.0f, -1.0f) : value;
+            }
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+                const float value = Load<uint8_t>(src);
+                return normalized ? value / 255.0f : value;
+            }
+            case TINYGLTF_COMPONENT_TYPE_SHORT: {
+                const float value = Load<int16_t>(src);
+                return normalized ? std::max(value / 32767.0f, -1.0f) : value;
+            }
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+                const float value = Load<uint16_t>(src);
+                return normalized ? value / 65535.0f : value;
+            }
+            case TINYGLTF_COMPONENT_TYPE_INT:
+                return static_cast<float>(Load<int32_t>(src));
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+                return static_cast<float>(Load<uint32_t>(src));
+            case TINYGLTF_COMPONENT_TYPE_FLOAT:
+                return Load<float>(src);
+            default:
+                return 0.0f;
+            }
+        }
+
+        uint32_t ReadIndex(const uint8_t* src, int32_t componentType) {
+            switch (componentType) {
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                return Load<uint8_t>(src);
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+                return Load<uint16_t>(src);
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+                return Load<uint32_t>(src);
+            default:
+                return 0;
+            }
+        }
+
+        void ReadElement(const uint8_t* src, const AccessorView& view, uint32_t outComponents, float* dst) {
+            const uint32_t componentSize = ComponentSize(view.componentType);
+            for (uint32_t c = 0; c < outComponents; ++c) {
+                dst[c] = (src && c < view.componentCount) ? ReadComponent(src + c * componentSize, view.componentType, view.normalized) : 0.0f;
+            }
+        }
+
+        /*
+            SSE2 element kernels: one element of N components is widened into the low lanes of an __m128, unused lanes are zero
+        */
+        template<typename T, bool Normalized>
+        __m128 ToFloat4(const T* components) {
+            if constexpr (std::is_same<T, float>::value) {
+                return _mm_loadu_ps(components);
+            }
+            else if constexpr (std::is_same<T, int8_t>::value) {
+                __m128i v = _mm_cvtsi32_si128(Load<int32_t>(reinterpret_cast<const uint8_t*>(components)));
+                v = _mm_unpacklo_epi8(v, v);
+                v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 24);
+                const __m128 f = _mm_cvtepi32_ps(v);
+                return Normalized ? _mm_max_ps(_mm_mul_ps(f, _mm_set1_ps(1.0f / 127.0f)), _mm_set1_ps(-1.0f)) : f;
+            }
+            else if constexpr (std::is_same<T, uint8_t>::value) {
+                __m128i v = _mm_cvtsi32_si128(Load<int32_t>(reinterpret_cast<const uint8_t*>(components)));
+                const __m128i zero = _mm_setzero_si128();
+                v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, zero), zero);
+                const __m128 f = _mm_cvtepi32_ps(v);
+                return Normalized ? _mm_mul_ps(f, _mm_set1_ps(1.0f / 255.0f)) : f;
+            }
+            else if constexpr (std::is_same<T, int16_t>::value) {
+                __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(components));
+                v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+                const __m128 f = _mm_cvtepi32_ps(v);
+                return Normalized ? _mm_max_ps(_mm_mul_ps(f, _mm_set1_ps(1.0f / 32767.0f)), _mm_set1_ps(-1.0f)) : f;
+            }
+            else {
+                static_assert(std::is_same<T, uint16_t>::value, "unsupported component type");
+                const __m128i zero = _mm_setzero_si128();
+                __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(components));
+                v = _mm_unpacklo_epi16(v, zero);
+                const __m128 f = _mm_cvtepi32_ps(v);
+                return Normalized ? _mm_mul_ps(f, _mm_set1_ps(1.0f / 65535.0f)) : f;
+            }
+        }
+
+        void StoreElement(float* dst, __m128 value, uint32_t outComponents) {
+            switch (outComponents) {
+            case 4:
+                _mm_storeu_ps(dst, value);
+                break;
+            case 3:
+                _mm_storel_pi(reinterpret_cast<__m64*>(dst), value);
+                _mm_store_ss(dst + 2, _mm_movehl_ps(value, value));
+                break;
+            case 2:
+                _mm_storel_pi(reinterpret_cast<__m64*>(dst), value);
+                break;
+            case 1:
+                _mm_store_ss(dst, value);
+                break;
+            default:
+                break;
+            }
+        }
+
+        using ElementKernel = void(*)(const uint8_t* src, size_t srcStride, size_t count, uint32_t outComponents, uint8_t* dst, size_t dstStride);
+
+        template<typename T, uint32_t N, bool Normalized>
+        void ConvertElements(const uint8_t* src, size_t srcStride, size_t count, uint32_t outComponents, uint8_t* dst, size_t dstStride) {
+            for (size_t i = 0; i < count; ++i) {
+                // Reads exactly N components, so strided elements never touch bytes past the accessor
+                T components[4]{};
+                memcpy(components, src + i * srcStride, N * sizeof(T));
+                StoreElement(reinterpret_cast<float*>(dst + i * dstStride), ToFloat4<T, Normalized>(components), outComponents);
+            }
+        }
+
+        template<typename T, bool Normalized>
+        ElementKernel SelectElementKernel(uint32_t componentCount) {
+            switch (componentCount) {
+            case 1: return ConvertElements<T, 1, Normalized>;
+            case 2: return ConvertElements<T, 2, Normalized>;
+            case 3: return ConvertElements<T, 3, Normalized>;
+            case 4: return ConvertElements<T, 4, Normalized>;
+            default: return nullptr;
+            }
+        }
+
+        template<typename T>
+        ElementKernel SelectElementKernel(uint32_t componentCount, bool normalized) {
+            return normalized ? SelectElementKernel<T, true>(componentCount) : SelectElementKernel<T, false>(componentCount);
+        }
+
+        ElementKernel SelectElementKernel(const AccessorView& view) {
+            switch (view.componentType) {
+            case TINYGLTF_COMPONENT_TYPE_BYTE: return SelectElementKernel<int8_t>(view.componentCount, view.normalized);
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: return SelectElementKernel<uint8_t>(view.componentCount, view.normalized);
+            case TINYGLTF_COMPONENT_TYPE_SHORT: return SelectElementKernel<int16_t>(view.componentCount, view.normalized);
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: return SelectElementKernel<uint16_t>(view.componentCount, view.normalized);
+            case TINYGLTF_COMPONENT_TYPE_FLOAT: return SelectElementKernel<float, false>(view.componentCount);
+            default: return nullptr;
+            }
+        }
+
+        /*
+            Flat kernels for tightly packed sources converted into tightly packed floats, the components are treated as one long array
+        */
+        template<typename T, bool Normalized>
+        size_t ConvertFlatSSE(const uint8_t* src, size_t valueCount, float* dst) {
+            size_t i = 0;
+            for (; i + 4 <= valueCount; i += 4) {
+                T components[4];
+                memcpy(components, src + i * sizeof(T), sizeof(components));
+                _mm_storeu_ps(dst + i, ToFloat4<T, Normalized>(components));
+            }
+            return i;
+        }
+
+        template<typename T, bool Normalized>
+        size_t ConvertFlatAVX2(const uint8_t* src, size_t valueCount, float* dst) {
+            size_t i = 0;
+            for (; i + 8 <= valueCount; i += 8) {
+                const uint8_t* values = src + i * sizeof(T);
+                __m256 f;
+                float scale = 1.0f;
+                if constexpr (std::is_same<T, int8_t>::value) {
+                    f = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(values))));
+                    scale = 1.0f / 127.0f;
+                }
+                else if constexpr (std::is_same<T, uint8_t>::value) {
+                    f = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(values))));
+                    scale = 1.0f / 255.0f;
+                }
+                else if constexpr (std::is_same<T, int16_t>::value) {
+                    f = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values))));
+                    scale = 1.0f / 32767.0f;
+                }
+                else {
+                    static_assert(std::is_same<T, uint16_t>::value, "unsupported component type");
+                    f = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values))));
+                    scale = 1.0f / 65535.0f;
+                }
+
+                if constexpr (Normalized) {
+                    f = _mm256_mul_ps(f, _mm256_set1_ps(scale));
+                    if constexpr (std::is_signed<T>::value) {
+                        f = _mm256_max_ps(f, _mm256_set1_ps(-1.0f));
+                    }
+                }
+                _mm256_storeu_ps(dst + i, f);
+            }
+            return i;
+        }
+
+        template<typename T, bool Normalized>
+        size_t ConvertFlat(const uint8_t* src, size_t valueCount, float* dst) {
+            return CpuFeatures::Get().avx2 ? ConvertFlatAVX2<T, Normalized>(src, valueCount, dst) : ConvertFlatSSE<T, Normalized>(src, valueCount, dst);
+        }
+
+        template<typename T>
+        size_t ConvertFlat(const uint8_t* src, size_t valueCount, float* dst, bool normalized) {
+            return normalized ? ConvertFlat<T, true>(src, valueCount, dst) : ConvertFlat<T, false>(src, valueCount, dst);
+        }
+
+        // Returns how many values were converted, the caller finishes the rest
+        size_t ConvertFlat(const AccessorView& view, const uint8_t* src, size_t valueCount, float* dst) {
+            switch (view.componentType) {
+            case TINYGLTF_COMPONENT_TYPE_BYTE: return ConvertFlat<int8_t>(src, valueCount, dst, view.normalized);
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: return ConvertFlat<uint8_t>(src, valueCount, dst, view.normalized);
+            case TINYGLTF_COMPONENT_TYPE_SHORT: return ConvertFlat<int16_t>(src, valueCount, dst, view.normalized);
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: return ConvertFlat<uint16_t>(src, valueCount, dst, view.normalized);
+            case TINYGLTF_COMPONENT_TYPE_FLOAT:
+                memcpy(dst, src, valueCount * sizeof(float));
+                return valueCount;
+            default:
+                return 0;
+            }
+        }
+
+        /*
+            Index kernels for tightly packed index buffers
+        */
+        template<typename T>
+        size_t ConvertIndicesSSE(const uint8_t* src, size_t count, uint32_t baseVertex, uint32_t* dst) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i base = _mm_set1_epi32(static_cast<int32_t>(baseVertex));
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                __m128i lo, hi;
+                if constexpr (std::is_same<T, uint8_t>::value) {
+                    const __m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)), zero);
+                    lo = _mm_unpacklo_epi16(v, zero);
+                    hi = _mm_unpackhi_epi16(v, zero);
+                }
+                else if constexpr (std::is_same<T, uint16_t>::value) {
+                    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * sizeof(T)));
+                    lo = _mm_unpacklo_epi16(v, zero);
+                    hi = _mm_unpackhi_epi16(v, zero);
+                }
+                else {
+                    lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * sizeof(T)));
+                    hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * sizeof(T) + 16));
+                }
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi32(lo, base));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_add_epi32(hi, base));
+            }
+            return i;
+        }
+
+        template<typename T>
+        size_t ConvertIndicesAVX2(const uint8_t* src, size_t count, uint32_t baseVertex, uint32_t* dst) {
+            const __m256i base = _mm256_set1_epi32(static_cast<int32_t>(baseVertex));
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                __m256i v;
+                if constexpr (std::is_same<T, uint8_t>::value) {
+                    v = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+                }
+                else if constexpr (std::is_same<T, uint16_t>::value) {
+                    v = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * sizeof(T))));
+                }
+                else {
+                    v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * sizeof(T)));
+                }
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_add_epi32(v, base));
+            }
+            return i;
+        }
+
+        template<typename T>
+        size_t ConvertIndices(const uint8_t* src, size_t count, uint32_t baseVertex, uint32_t* dst) {
+            return CpuFeatures::Get().avx2 ? ConvertIndicesAVX2<T>(src, count, baseVertex, dst) : ConvertIndicesSSE<T>(src, count, baseVertex, dst);
+        }
+
+        // First sparse entry whose target index is at least first, sparse indices are strictly increasing
+        uint32_t FindSparseEntry(const AccessorView& view, size_t first) {
+            const uint32_t indexSize = ComponentSize(view.sparse.indexComponentType);
+            uint32_t lo = 0;
+            uint32_t hi = view.sparse.count;
+            while (lo < hi) {
+                const uint32_t mid = lo + (hi - lo) / 2;
+                if (ReadIndex(view.sparse.indices + mid * indexSize, view.sparse.indexComponentType) < first) {
+                    lo = mid + 1;
+                }
+                else {
+                    hi = mid;
+                }
+            }
+            return lo;
+        }
+
+        const uint8_t* GetBufferViewData(const GltfDocument& document, int32_t bufferViewIndex, size_t byteOffset, size_t byteSize) {
+            if (bufferViewIndex < 0 || bufferViewIndex >= static_cast<int32_t>(document.bufferViews.size())) {
+                return nullptr;
+            }
+            const GltfDocument::BufferView& bufferView = document.bufferViews[bufferViewIndex];
+            const GltfDocument::Buffer& buffer = document.buffers[bufferView.buffer];
+            if (byteOffset > bufferView.byteLength || byteSize > bufferView.byteLength - byteOffset ||
+                bufferView.byteOffset > buffer.size || bufferView.byteLength > buffer.size - bufferView.byteOffset) {
+                return nullptr;
+            }
+            return buffer.data + bufferView.byteOffset + byteOffset;
+        }
+    }
+
+    AccessorView GetAccessorView(const GltfDocument& document, int32_t accessorIndex) {
+        AccessorView view{};
+        if (accessorIndex < 0 || accessorIndex >= static_cast<int32_t>(document.accessors.size())) {
+            return view;
+        }
+
+        const GltfDocument::Accessor& accessor = document.accessors[accessorIndex];
+        const uint32_t componentSize = ComponentSize(accessor.componentType);
+        const int32_t componentCount = tinygltf::GetNumComponentsInType(static_cast<uint32_t>(accessor.type));
+        if (0 == componentSize || componentCount <= 0) {
+            return view;
+        }
+
+        view.count = accessor.count;
+        view.componentType = accessor.componentType;
+        view.componentCount = static_cast<uint32_t>(componentCount);
+        view.normalized = accessor.normalized;
+
+        const size_t elementSize = componentSize * view.componentCount;
+        if (accessor.bufferView > -1) {
+            // Tightly packed unless the buffer view gives a stride, which has to keep components aligned
+            const size_t byteStride = document.bufferViews[accessor.bufferView].byteStride;
+            if (0 < byteStride && (byteStride < 4 || byteStride > 252 || 0 != byteStride % componentSize)) {
+                return view;
+            }
+            view.stride = 0 < byteStride ? byteStride : elementSize;
+
+            const size_t byteSize = view.count > 0 ? (view.count - 1) * view.stride + elementSize : 0;
+            view.data = GetBufferViewData(document, accessor.bufferView, accessor.byteOffset, byteSize);
+            if (nullptr == view.data) {
+                return view;
+            }
+        }
+        else {
+            view.stride = elementSize;
+        }
+
+        if (accessor.sparse.count > 0) {
+            const auto& sparse = accessor.sparse;
+            const uint32_t indexSize = ComponentSize(sparse.indicesComponentType);
+            if (0 == indexSize || TINYGLTF_COMPONENT_TYPE_FLOAT == sparse.indicesComponentType) {
+                return view;
+            }
+            view.sparse.count = static_cast<uint32_t>(sparse.count);
+            view.sparse.indexComponentType = sparse.indicesComponentType;
+            view.sparse.indices = GetBufferViewData(document, sparse.indicesBufferView, sparse.indicesByteOffset, sparse.count * indexSize);
+            view.sparse.values = GetBufferViewData(document, sparse.valuesBufferView, sparse.valuesByteOffset, sparse.count * elementSize);
+            if (nullptr == view.sparse.indices || nullptr == view.sparse.values) {
+                return view;
+            }
+        }
+
+        view.valid = true;
+        return view;
+    }
+
+    void ReadAccessor(const AccessorView& view, size_t first, size_t count, uint32_t outComponents, float* dst, size_t dstStride) {
+        if (false == view.valid || first >= view.count) {
+            return;
+        }
+        count = std::min(count, view.count - first);
+
+        auto* out = reinterpret_cast<uint8_t*>(dst);
+        if (nullptr == view.data) {
+            for (size_t i = 0; i < count; ++i) {
+                memset(out + i * dstStride, 0, outComponents * sizeof(float));
+            }
+        }
+        else {
+            const uint8_t* src = view.data + first * view.stride;
+            const size_t elementSize = ComponentSize(view.componentType) * view.componentCount;
+
+            size_t done = 0;
+            ElementKernel kernel = nullptr;
+            if (outComponents == view.componentCount && view.stride == elementSize && dstStride == outComponents * sizeof(float)) {
+                // Both sides tightly packed, convert the components as one flat array
+                const size_t valueCount = count * view.componentCount;
+                const size_t converted = ConvertFlat(view, src, valueCount, dst);
+                for (size_t v = converted; v < valueCount; ++v) {
+                    dst[v] = ReadComponent(src + v * ComponentSize(view.componentType), view.componentType, view.normalized);
+                }
+                done = count;
+            }
+            else if (outComponents <= 4 && nullptr != (kernel = SelectElementKernel(view))) {
+                kernel(src, view.stride, count, outComponents, out, dstStride);
+                done = count;
+            }
+
+            for (size_t i = done; i < count; ++i) {
+                ReadElement(src + i * view.stride, view, outComponents, reinterpret_cast<float*>(out + i * dstStride));
+            }
+        }
+
+        if (view.sparse.count > 0) {
+            const uint32_t indexSize = ComponentSize(view.sparse.indexComponentType);
+            const size_t elementSize = ComponentSize(view.componentType) * view.componentCount;
+            for (uint32_t s = FindSparseEntry(view, first); s < view.sparse.count; ++s) {
+                const size_t index = ReadIndex(view.sparse.indices + s * indexSize, view.sparse.indexComponentType);
+                if (index >= first + count) {
+                    break;
+                }
+                ReadElement(view.sparse.values + s * elementSize, view, outComponents, reinterpret_cast<float*>(out + (index - first) * dstStride));
+            }
+        }
+    }
+
+    void ReadIndices(const AccessorView& view, size_t first, size_t count, uint32_t baseVertex, uint32_t* dst) {
+        if (false == view.valid || first >= view.count) {
+            return;
+        }
+        count = std::min(count, view.count - first);
+
+        if (nullptr == view.data) {
+            std::fill(dst, dst + count, baseVertex);
+        }
+        else {
+            const uint8_t* src = view.data + first * view.stride;
+            const uint32_t indexSize = ComponentSize(view.componentType);
+
+            size_t done = 0;
+            if (view.stride == indexSize) {
+                switch (view.componentType) {
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                    done = ConvertIndices<uint8_t>(src, count, baseVertex, dst);
+                    break;
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+                    done = ConvertIndices<uint16_t>(src, count, baseVertex, dst);
+                    break;
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+                    done = ConvertIndices<uint32_t>(src, count, baseVertex, dst);
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            for (size_t i = done; i < count; ++i) {
+                dst[i] = ReadIndex(src + i * view.stride, view.componentType) + baseVertex;
+            }
+        }
+
+        if (view.sparse.count > 0) {
+            const uint32_t indexSize = ComponentSize(view.sparse.indexComponentType);
+            const uint32_t valueSize = ComponentSize(view.componentType);
+            for (uint32_t s = FindSparseEntry(view, first); s < view.sparse.count; ++s) {
+                const size_t index = ReadIndex(view.sparse.indices + s * indexSize, view.sparse.indexComponentType);
+                if (index >= first + count) {
+                    break;
+                }
+                dst[index - first] = ReadIndex(view.sparse.values + s * valueSize, view.componentType) + baseVertex;
+            }
+        }
+    }
+
+    void GetPositionBounds(const GltfDocument& document, int32_t accessorIndex, glm::vec3& min, glm::vec3& max) {
+        const GltfDocument::Accessor& accessor = document.accessors[accessorIndex];
+        if (accessor.minValues.size() >= 3 && accessor.maxValues.size() >= 3) {
+            // min and max hold the values stored in the buffer, normalized types still need their scale applied
+            for (glm::length_t c = 0; c < 3; ++c) {
+                float lo = static_cast<float>(accessor.minValues[c]);
+                float hi = static_cast<float>(accessor.maxValues[c]);
+                if (accessor.normalized) {
+                    switch (accessor.componentType) {
+                    case TINYGLTF_COMPONENT_TYPE_BYTE:
+                        lo = std::max(lo / 127.0f, -1.0f);
+                        hi = std::max(hi / 127.0f, -1.0f);
+                        break;
+                    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                        lo /= 255.0f;
+                        hi /= 255.0f;
+                        break;
+                    case TINYGLTF_COMPONENT_TYPE_SHORT:
+                        lo = std::max(lo / 32767.0f, -1.0f);
+                        hi = std::max(hi / 32767.0f, -1.0f);
+                        break;
+                    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+                        lo /= 65535.0f;
+                        hi /= 65535.0f;
+                        break;
+                    default:
+                        break;
+                    }
+                }
+                min[c] = lo;
+                max[c] = hi;
+            }
+            return;
+        }
+
+        // min and max are required for POSITION, but compute them rather than trusting every exporter
+        const AccessorView view = GetAccessorView(document, accessorIndex);
+        min = glm::vec3(0.0f);
+        max = glm::vec3(0.0f);
+        if (false == view.valid || 0 == view.count) {
+            return;
+        }
+
+        min = glm::vec3(FLT_MAX);
+        max = glm::vec3(-FLT_MAX);
+        std::array<glm::vec3, 256> block;
+        for (size_t first = 0; first < view.count; first += block.size()) {
+            const size_t count = std::min(block.size(), view.count - first);
+            ReadAccessor(view, first, count, 3, &block[0].x, sizeof(glm::vec3));
+            for (size_t i = 0; i < count; ++i) {
+                min = glm::min(min, block[i]);
+                max = glm::max(max, block[i]);
+            }
+        }
+    }
+}
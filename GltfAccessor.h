@@ -0,0 +1,49 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#pragma once
+
+namespace Vk {
+    class GltfDocument;
+
+    /*
+        Resolved glTF accessor: where its elements live and how their components are stored
+    */
+    struct AccessorView {
+        const uint8_t* data = nullptr;          // First element, nullptr when the accessor has no buffer view (all zero)
+        size_t count = 0;
+        size_t stride = 0;                      // Bytes between two elements
+        int32_t componentType = 0;              // TINYGLTF_COMPONENT_TYPE_*
+        uint32_t componentCount = 0;
+        bool normalized = false;
+
+        struct Sparse {
+            uint32_t count = 0;
+            const uint8_t* indices = nullptr;
+            int32_t indexComponentType = 0;
+            const uint8_t* values = nullptr;    // Tightly packed elements of the accessor type
+        } sparse;
+
+        bool valid = false;
+    };
+
+    /*
+        Resolves an accessor and checks that every element lies inside its buffer
+    */
+    AccessorView GetAccessorView(const GltfDocument& document, int32_t accessorIndex);
+
+    /*
+        Converts elements [first, first + count) to float, normalized integers become [0, 1] or [-1, 1].
+        Every element writes exactly outComponents floats to dst + i * dstStride bytes, components the accessor lacks are zero.
+    */
+    void ReadAccessor(const AccessorView& view, size_t first, size_t count, uint32_t outComponents, float* dst, size_t dstStride);
+
+    /*
+        Converts index elements [first, first + count) to uint32_t and adds baseVertex
+    */
+    void ReadIndices(const AccessorView& view, size_t first, size_t count, uint32_t baseVertex, uint32_t* dst);
+
+    /*
+        POSITION bounds, taken from the accessor min/max when present (dequantized for normalized types) or computed from the data
+    */
+    void GetPositionBounds(const GltfDocument& document, int32_t accessorIndex, glm::vec3& min, glm::vec3& max);
+}
@@ -0,0 +1,148 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+#include "GltfBuffers.h"
+#include "Base64.h"
+#include "GltfDocument.h"
+
+#pragma warning(disable : 4100)
+#include <tinygltf/tiny_gltf.h>
+#pragma warning(default : 4100)
+
+namespace Vk {
+    namespace {
+        class BufferUsage {
+        public:
+            explicit                                BufferUsage(const GltfDocument& document) : _document(document), _used(document.buffers.size(), 0) {}
+
+            void                                    UseBufferView(int32_t bufferViewIndex) {
+                if (bufferViewIndex < 0 || bufferViewIndex >= static_cast<int32_t>(_document.bufferViews.size())) {
+                    return;
+                }
+                UseBuffer(_document.bufferViews[bufferViewIndex].buffer);
+            }
+
+            void                                    UseAccessor(int32_t accessorIndex) {
+                if (accessorIndex < 0 || accessorIndex >= static_cast<int32_t>(_document.accessors.size())) {
+                    return;
+                }
+                const GltfDocument::Accessor& accessor = _document.accessors[accessorIndex];
+                UseBufferView(accessor.bufferView);
+                if (0 < accessor.sparse.count) {
+                    UseBufferView(accessor.sparse.indicesBufferView);
+                    UseBufferView(accessor.sparse.valuesBufferView);
+                }
+            }
+
+            void                                    UseMesh(int32_t meshIndex) {
+                if (meshIndex < 0 || meshIndex >= static_cast<int32_t>(_document.meshes.size())) {
+                    return;
+                }
+                for (const GltfDocument::Primitive& primitive : _document.meshes[meshIndex].primitives) {
+                    for (const GltfDocument::Attribute& attribute : primitive.attributes) {
+                        UseAccessor(attribute.accessor);
+                    }
+                    UseAccessor(primitive.indices);
+                }
+            }
+
+            // EXT_meshopt_compression fallback buffers are decoded from their compressed source buffers
+            void                                    UseMeshoptSources() {
+                for (const GltfDocument::BufferView& bufferView : _document.bufferViews) {
+                    if (nullptr != bufferView.meshopt && IsUsed(bufferView.buffer)) {
+                        UseBuffer(bufferView.meshopt->buffer);
+                    }
+                }
+            }
+
+            bool                                    IsUsed(int32_t bufferIndex) const {
+                return bufferIndex >= 0 && bufferIndex < static_cast<int32_t>(_used.size()) && 0 != _used[bufferIndex];
+            }
+
+        private:
+            void                                    UseBuffer(int32_t bufferIndex) {
+                if (bufferIndex >= 0 && bufferIndex < static_cast<int32_t>(_used.size())) {
+                    _used[bufferIndex] = 1;
+                }
+            }
+
+            const GltfDocument&                     _document;
+            std::vector<uint8_t>                    _used;
+        };
+
+        bool LoadBuffer(GltfDocument& document, int32_t bufferIndex, const std::string& baseDir, std::string& error) {
+            const GltfDocument::Buffer& buffer = document.buffers[bufferIndex];
+
+            // Data URIs are decoded straight from the JSON text into the buffer storage
+            DataUri dataUri;
+            if (ParseDataUri(buffer.uri, dataUri)) {
+                size_t size = 0;
+                if (false == GetBase64DecodedSize(dataUri.payload, size) || size < buffer.byteLength) {
+                    error = "Data URI of buffer " + std::to_string(bufferIndex) + " is shorter than its byteLength";
+                    return false;
+                }
+                if (false == DecodeBase64(dataUri.payload, document.AllocateBufferData(bufferIndex, size))) {
+                    error = "Failed to decode data URI of buffer " + std::string(buffer.name);
+                    return false;
+                }
+                return true;
+            }
+
+            std::vector<uint8_t> bytes;
+            const std::string filepath = (std::filesystem::path(baseDir) / buffer.uri).string();
+            std::string fileError;
+            if (false == tinygltf::ReadWholeFile(&bytes, &fileError, filepath, nullptr)) {
+                error = "Failed to read buffer " + filepath + ": " + fileError;
+                return false;
+            }
+
+            if (bytes.size() < buffer.byteLength) {
+                error = "Buffer " + std::to_string(bufferIndex) + " is shorter than its byteLength";
+                return false;
+            }
+            document.SetBufferData(bufferIndex, std::move(bytes));
+            return true;
+        }
+    }
+
+    bool LoadSceneBuffers(GltfDocument& document, int32_t sceneIndex, const std::string& baseDir, std::string& error) {
+        BufferUsage usage(document);
+
+        // Meshes of every node below the scene roots, the document guarantees the nodes form trees
+        if (sceneIndex >= 0 && sceneIndex < static_cast<int32_t>(document.scenes.size())) {
+            std::vector<int32_t> stack(document.scenes[sceneIndex].nodes.begin(), document.scenes[sceneIndex].nodes.end());
+            while (false == stack.empty()) {
+                const GltfDocument::Node& node = document.nodes[stack.back()];
+                stack.pop_back();
+                usage.UseMesh(node.mesh);
+                stack.insert(stack.end(), node.children.begin(), node.children.end());
+            }
+        }
+
+        // Skins, animations and textures are loaded for the whole model
+        for (const GltfDocument::Skin& skin : document.skins) {
+            usage.UseAccessor(skin.inverseBindMatrices);
+        }
+        for (const GltfDocument::Animation& animation : document.animations) {
+            for (const GltfDocument::AnimationSampler& sampler : animation.samplers) {
+                usage.UseAccessor(sampler.input);
+                usage.UseAccessor(sampler.output);
+            }
+        }
+        for (const GltfDocument::Texture& texture : document.textures) {
+            usage.UseBufferView(document.images[texture.source].bufferView);
+        }
+        usage.UseMeshoptSources();
+
+        for (uint32_t i = 0; i < document.buffers.size(); ++i) {
+            const GltfDocument::Buffer& buffer = document.buffers[i];
+            if (false == usage.IsUsed(static_cast<int32_t>(i)) || buffer.uri.empty() || 0 < buffer.size) {
+                continue;
+            }
+            if (false == LoadBuffer(document, static_cast<int32_t>(i), baseDir, error)) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
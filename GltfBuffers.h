@@ -0,0 +1,13 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#pragma once
+
+namespace Vk {
+    class GltfDocument;
+
+    /*
+        Loads the uri buffers that the scene or the model wide data (textures, animations) reads.
+        Every other buffer stays empty, buffers of a .glb BIN chunk are already in place.
+    */
+    bool LoadSceneBuffers(GltfDocument& document, int32_t sceneIndex, const std::string& baseDir, std::string& error);
+}
@@ -0,0 +1,1451 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+#include "GltfDocument.h"
+
+#pragma warning(disable : 4100)
+#include <tinygltf/tiny_gltf.h>
+#pragma warning(default : 4100)
+
+namespace Vk {
+    namespace {
+        uint32_t FirstBit(uint32_t mask) {
+            unsigned long index = 0;
+            _BitScanForward(&index, mask);
+            return static_cast<uint32_t>(index);
+        }
+
+        // SSE2 scanners, the scalar loops handle the last bytes so nothing is read past the end
+        const char* FindQuoteOrEscape(const char* p, const char* end) {
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i escape = _mm_set1_epi8('\\');
+            while (end - p >= 16) {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, escape))));
+                if (0 != mask) {
+                    return p + FirstBit(mask);
+                }
+                p += 16;
+            }
+            while (p < end && '"' != *p && '\\' != *p) {
+                ++p;
+            }
+            return p;
+        }
+
+        uint32_t FirstBit64(uint64_t mask) {
+            unsigned long index = 0;
+            _BitScanForward64(&index, mask);
+            return static_cast<uint32_t>(index);
+        }
+
+        uint32_t PopCount(uint64_t mask) {
+            mask = mask - ((mask >> 1) & 0x5555555555555555ull);
+            mask = (mask & 0x3333333333333333ull) + ((mask >> 2) & 0x3333333333333333ull);
+            mask = (mask + (mask >> 4)) & 0x0f0f0f0f0f0f0f0full;
+            return static_cast<uint32_t>((mask * 0x0101010101010101ull) >> 56);
+        }
+
+        // Bit i is set when an odd number of bits at or below i are set, turns quote positions into string interiors
+        uint64_t PrefixXor(uint64_t mask) {
+            mask ^= mask << 1;
+            mask ^= mask << 2;
+            mask ^= mask << 4;
+            mask ^= mask << 8;
+            mask ^= mask << 16;
+            mask ^= mask << 32;
+            return mask;
+        }
+
+        // One bit per byte of a 64 byte block for every character class the container scan looks at
+        struct BlockMasks {
+            uint64_t                            quote = 0;
+            uint64_t                            backslash = 0;
+            uint64_t                            open = 0;       // '[' and '{'
+            uint64_t                            close = 0;      // ']' and '}'
+            uint64_t                            comma = 0;
+        };
+
+        BlockMasks ClassifyBlock(const char* block) {
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i comma = _mm_set1_epi8(',');
+            const __m128i open = _mm_set1_epi8('[');
+            const __m128i close = _mm_set1_epi8(']');
+            // '{' and '}' are '[' and ']' with bit 0x20 set
+            const __m128i caseBit = _mm_set1_epi8(0x20);
+
+            BlockMasks masks;
+            for (uint32_t i = 0; i < 4; ++i) {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16));
+                const __m128i folded = _mm_andnot_si128(caseBit, chunk);
+                const uint32_t shift = i * 16;
+                masks.quote |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote))) << shift;
+                masks.backslash |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, backslash))) << shift;
+                masks.comma |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, comma))) << shift;
+                masks.open |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(folded, open))) << shift;
+                masks.close |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(folded, close))) << shift;
+            }
+            return masks;
+        }
+
+        // Characters escaped by a backslash, escapedCarry tells whether the first byte of the block is escaped and returns the same for the next block
+        uint64_t EscapedCharacters(uint64_t backslash, bool& escapedCarry) {
+            uint64_t escaped = escapedCarry ? 1 : 0;
+            backslash &= ~escaped;
+            escapedCarry = false;
+            // Backslash runs are short and rare, walk them one escape at a time
+            while (0 != backslash) {
+                const uint32_t bit = FirstBit64(backslash);
+                if (63 == bit) {
+                    escapedCarry = true;
+                    break;
+                }
+                escaped |= 2ull << bit;
+                backslash &= ~(3ull << bit);
+            }
+            return escaped;
+        }
+
+        bool IsWhitespace(char c) {
+            return ' ' == c || '\n' == c || '\r' == c || '\t' == c;
+        }
+
+        // Pull parser over JSON text, values are read in document order straight into the caller's tables
+        class JsonReader {
+        public:
+                                                JsonReader(const char* begin, const char* end, Arena& arena) : _begin(begin), _p(begin), _end(end), _arena(arena) {}
+
+            const std::string&                  Error() const { return _error; }
+
+            bool                                Fail(const char* message) {
+                if (_error.empty()) {
+                    _error = std::string(message) + " at byte " + std::to_string(_p - _begin);
+                }
+                return false;
+            }
+
+            void                                SkipWhitespace() {
+                // Minified JSON has next to no whitespace, pretty printed JSON has long indentation runs
+                while (_p < _end && IsWhitespace(*_p)) {
+                    ++_p;
+                    if (_end - _p >= 16) {
+                        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_p));
+                        const __m128i space = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+                        const __m128i tab = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t')));
+                        const uint32_t other = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(space, tab))) & 0xffff;
+                        if (0 != other) {
+                            _p += FirstBit(other);
+                            return;
+                        }
+                        _p += 16;
+                    }
+                }
+            }
+
+            bool                                AtEnd() {
+                SkipWhitespace();
+                return _p == _end;
+            }
+
+            char                                Peek() {
+                SkipWhitespace();
+                return _p < _end ? *_p : '\0';
+            }
+
+            bool                                Consume(char c) {
+                if (c == Peek()) {
+                    ++_p;
+                    return true;
+                }
+                return false;
+            }
+
+            // onMember(key) reads the value of every member
+            template<typename Func>
+            bool                                ParseObject(Func&& onMember) {
+                if (false == Consume('{')) {
+                    return Fail("expected an object");
+                }
+                if (Consume('}')) {
+                    return true;
+                }
+                do {
+                    std::string_view key;
+                    if (false == ReadString(key)) {
+                        return false;
+                    }
+                    if (false == Consume(':')) {
+                        return Fail("expected ':'");
+                    }
+                    if (false == onMember(key)) {
+                        return false;
+                    }
+                } while (Consume(','));
+                return Consume('}') || Fail("expected '}'");
+            }
+
+            // Counts the elements first so the table is a single arena allocation, onElement(element) reads each of them
+            template<typename T, typename Func>
+            bool                                ParseArray(ArenaSpan<T>& table, Func&& onElement) {
+                size_t count = 0;
+                if (false == CountElements('[', count)) {
+                    return false;
+                }
+                table = _arena.AllocateArray<T>(count);
+
+                ++_p;
+                for (size_t i = 0; i < count; ++i) {
+                    if ((0 < i && false == Consume(',')) || false == onElement(table[i])) {
+                        return Fail("malformed array");
+                    }
+                }
+                return Consume(']') || Fail("expected ']'");
+            }
+
+            // Object members become table elements, onMember(key, element) reads each of them
+            template<typename T, typename Func>
+            bool                                ParseObjectAsArray(ArenaSpan<T>& table, Func&& onMember) {
+                size_t count = 0;
+                if (false == CountElements('{', count)) {
+                    return false;
+                }
+                table = _arena.AllocateArray<T>(count);
+
+                size_t i = 0;
+                return ParseObject([&](std::string_view key) {
+                    return i < count ? onMember(key, table[i++]) : Fail("malformed object");
+                });
+            }
+
+            bool                                ReadString(std::string_view& value) {
+                if (false == Consume('"')) {
+                    return Fail("expected a string");
+                }
+                const char* start = _p;
+                const char* p = FindQuoteOrEscape(start, _end);
+                if (p < _end && '"' == *p) {
+                    value = std::string_view(start, static_cast<size_t>(p - start));
+                    _p = p + 1;
+                    return true;
+                }
+                return ReadEscapedString(start, value);
+            }
+
+            bool                                ReadNumber(double& value) {
+                Number number;
+                if (false == ParseNumber(number)) {
+                    return false;
+                }
+                value = number.value;
+                return true;
+            }
+
+            bool                                ReadFloat(float& value) {
+                double number = 0.0;
+                if (false == ReadNumber(number)) {
+                    return false;
+                }
+                value = static_cast<float>(number);
+                return true;
+            }
+
+            bool                                ReadInt(int32_t& value) {
+                Number number;
+                if (false == ParseNumber(number) || false == number.integral || number.value < INT32_MIN || number.value > INT32_MAX) {
+                    return Fail("expected an integer");
+                }
+                value = static_cast<int32_t>(number.value);
+                return true;
+            }
+
+            bool                                ReadSize(size_t& value) {
+                Number number;
+                if (false == ParseNumber(number) || false == number.integral || number.negative) {
+                    return Fail("expected a non negative integer");
+                }
+                value = static_cast<size_t>(number.mantissa);
+                return true;
+            }
+
+            bool                                ReadBool(bool& value) {
+                if (ConsumeLiteral("true")) {
+                    value = true;
+                    return true;
+                }
+                if (ConsumeLiteral("false")) {
+                    value = false;
+                    return true;
+                }
+                return Fail("expected a boolean");
+            }
+
+            // Fixed size number array, like a node translation
+            bool                                ReadFloats(float* values, size_t count) {
+                size_t i = 0;
+                if (false == Consume('[')) {
+                    return Fail("expected an array");
+                }
+                if (false == Consume(']')) {
+                    do {
+                        if (i == count || false == ReadFloat(values[i++])) {
+                            return Fail("wrong number of array elements");
+                        }
+                    } while (Consume(','));
+                    if (false == Consume(']')) {
+                        return Fail("expected ']'");
+                    }
+                }
+                return i == count || Fail("wrong number of array elements");
+            }
+
+            bool                                ReadInts(ArenaSpan<int32_t>& values) {
+                return ParseArray(values, [this](int32_t& value) { return ReadInt(value); });
+            }
+
+            bool                                ReadNumbers(ArenaSpan<double>& values) {
+                return ParseArray(values, [this](double& value) { return ReadNumber(value); });
+            }
+
+            bool                                ReadStrings(ArenaSpan<std::string_view>& values) {
+                return ParseArray(values, [this](std::string_view& value) { return ReadString(value); });
+            }
+
+            // Skips any value without looking inside containers
+            bool                                Skip() {
+                switch (Peek()) {
+                case '"': {
+                    std::string_view value;
+                    return ReadString(value);
+                }
+                case '[':
+                case '{':
+                    return SkipContainer();
+                case 't':
+                case 'f': {
+                    bool value = false;
+                    return ReadBool(value);
+                }
+                case 'n':
+                    return ConsumeLiteral("null") || Fail("unexpected literal");
+                default: {
+                    Number number;
+                    return ParseNumber(number);
+                }
+                }
+            }
+
+        private:
+            struct Number {
+                double                          value = 0.0;
+                uint64_t                        mantissa = 0;
+                bool                            negative = false;
+                bool                            integral = false;
+            };
+
+            bool                                ConsumeLiteral(const char* literal) {
+                const size_t length = strlen(literal);
+                SkipWhitespace();
+                if (static_cast<size_t>(_end - _p) >= length && 0 == memcmp(_p, literal, length)) {
+                    _p += length;
+                    return true;
+                }
+                return false;
+            }
+
+            // Elements of the array or members of the object starting at the cursor, which does not move
+            bool                                CountElements(char open, size_t& count) {
+                if (open != Peek()) {
+                    return Fail('[' == open ? "expected an array" : "expected an object");
+                }
+
+                const char* p = _p + 1;
+                while (p < _end && IsWhitespace(*p)) {
+                    ++p;
+                }
+                if (p < _end && ('[' == open ? ']' : '}') == *p) {
+                    count = 0;
+                    return true;
+                }
+
+                // Short flat arrays like min, max or children end before anything that needs the block scan
+                if ('[' == open) {
+                    size_t separators = 0;
+                    for (const char* end = std::min(p + 64, _end); p < end; ++p) {
+                        if (']' == *p) {
+                            count = separators + 1;
+                            return true;
+                        }
+                        if ('"' == *p || '[' == *p || '{' == *p) {
+                            break;
+                        }
+                        separators += (',' == *p) ? 1 : 0;
+                    }
+                }
+
+                const char* close = nullptr;
+                size_t separators = 0;
+                if (false == ScanContainer(&separators, close)) {
+                    return false;
+                }
+                count = separators + 1;
+                return true;
+            }
+
+            bool                                SkipContainer() {
+                const char* close = nullptr;
+                if (false == ScanContainer(nullptr, close)) {
+                    return false;
+                }
+                _p = close + 1;
+                return true;
+            }
+
+            /*
+                Finds the bracket closing the container at the cursor, 64 bytes at a time. Quotes that are not escaped toggle
+                the string state, brackets and commas inside strings are ignored. Blocks whose closing brackets cannot bring the
+                depth down to the level being counted are skipped without looking at single characters.
+            */
+            bool                                ScanContainer(size_t* separators, const char*& close) {
+                size_t depth = 0;
+                uint64_t inString = 0;
+                bool escapedCarry = false;
+
+                for (const char* block = _p; block < _end; block += 64) {
+                    BlockMasks masks;
+                    if (_end - block >= 64) {
+                        masks = ClassifyBlock(block);
+                    }
+                    else {
+                        char padded[64];
+                        memset(padded, ' ', sizeof(padded));
+                        memcpy(padded, block, static_cast<size_t>(_end - block));
+                        masks = ClassifyBlock(padded);
+                    }
+
+                    const uint64_t quotes = masks.quote & ~EscapedCharacters(masks.backslash, escapedCarry);
+                    const uint64_t inside = PrefixXor(quotes) ^ inString;
+                    inString = 0 - (inside >> 63);
+
+                    const uint64_t opens = masks.open & ~inside;
+                    const uint64_t closes = masks.close & ~inside;
+                    const uint64_t commas = (nullptr != separators) ? (masks.comma & ~inside) : 0;
+
+                    const size_t closeCount = PopCount(closes);
+                    const size_t lowestDepth = (nullptr != separators) ? 1 : 0;
+                    if (depth > closeCount + lowestDepth) {
+                        depth = depth + PopCount(opens) - closeCount;
+                        continue;
+                    }
+                    if (0 == (opens | closes) && 1 == depth && nullptr != separators) {
+                        *separators += PopCount(commas);
+                        continue;
+                    }
+
+                    for (uint64_t bits = opens | closes | commas; 0 != bits; bits &= bits - 1) {
+                        const uint64_t bit = bits & (0 - bits);
+                        if (0 != (opens & bit)) {
+                            ++depth;
+                        }
+                        else if (0 != (closes & bit)) {
+                            if (0 == depth) {
+                                return Fail("unbalanced brackets");
+                            }
+                            if (0 == --depth) {
+                                close = block + FirstBit64(bit);
+                                return true;
+                            }
+                        }
+                        else if (1 == depth) {
+                            ++*separators;
+                        }
+                    }
+                }
+                return Fail("unterminated container");
+            }
+
+            // Returns the position after the closing quote or nullptr
+            const char*                         SkipStringBody(const char* p) const {
+                while (true) {
+                    p = FindQuoteOrEscape(p, _end);
+                    if (p == _end) {
+                        return nullptr;
+                    }
+                    if ('"' == *p) {
+                        return p + 1;
+                    }
+                    p += 2;
+                    if (p > _end) {
+                        return nullptr;
+                    }
+                }
+            }
+
+            bool                                ReadEscapedString(const char* start, std::string_view& value) {
+                const char* stringEnd = SkipStringBody(start);
+                if (nullptr == stringEnd) {
+                    return Fail("unterminated string");
+                }
+
+                // The unescaped string is never longer than the escaped one
+                char* out = static_cast<char*>(_arena.Allocate(static_cast<size_t>(stringEnd - start), 1));
+                char* dst = out;
+                for (const char* p = start; p < stringEnd - 1; ++p) {
+                    if ('\\' != *p) {
+                        *dst++ = *p;
+                        continue;
+                    }
+                    switch (*++p) {
+                    case 'b': *dst++ = '\b'; break;
+                    case 'f': *dst++ = '\f'; break;
+                    case 'n': *dst++ = '\n'; break;
+                    case 'r': *dst++ = '\r'; break;
+                    case 't': *dst++ = '\t'; break;
+                    case 'u': {
+                        uint32_t codePoint = 0;
+                        if (false == ReadHex4(p + 1, stringEnd, codePoint)) {
+                            return Fail("invalid \\u escape");
+                        }
+                        p += 4;
+                        // Surrogate pair
+                        if (0xd800 <= codePoint && codePoint < 0xdc00 && stringEnd - p > 6 && '\\' == p[1] && 'u' == p[2]) {
+                            uint32_t low = 0;
+                            if (ReadHex4(p + 3, stringEnd, low) && 0xdc00 <= low && low < 0xe000) {
+                                codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                                p += 6;
+                            }
+                        }
+                        dst = WriteUtf8(dst, codePoint);
+                        break;
+                    }
+                    default:
+                        // '"', '\\' and '/'
+                        *dst++ = *p;
+                        break;
+                    }
+                }
+
+                value = std::string_view(out, static_cast<size_t>(dst - out));
+                _p = stringEnd;
+                return true;
+            }
+
+            static bool                         ReadHex4(const char* p, const char* end, uint32_t& value) {
+                if (end - p < 4) {
+                    return false;
+                }
+                value = 0;
+                for (int32_t i = 0; i < 4; ++i) {
+                    const char c = p[i];
+                    uint32_t digit = 0;
+                    if ('0' <= c && c <= '9') {
+                        digit = static_cast<uint32_t>(c - '0');
+                    }
+                    else if ('a' <= (c | 0x20) && (c | 0x20) <= 'f') {
+                        digit = static_cast<uint32_t>((c | 0x20) - 'a' + 10);
+                    }
+                    else {
+                        return false;
+                    }
+                    value = value * 16 + digit;
+                }
+                return true;
+            }
+
+            static char*                        WriteUtf8(char* dst, uint32_t codePoint) {
+                if (codePoint < 0x80) {
+                    *dst++ = static_cast<char>(codePoint);
+                }
+                else if (codePoint < 0x800) {
+                    *dst++ = static_cast<char>(0xc0 | (codePoint >> 6));
+                    *dst++ = static_cast<char>(0x80 | (codePoint & 0x3f));
+                }
+                else if (codePoint < 0x10000) {
+                    *dst++ = static_cast<char>(0xe0 | (codePoint >> 12));
+                    *dst++ = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+                    *dst++ = static_cast<char>(0x80 | (codePoint & 0x3f));
+                }
+                else {
+                    *dst++ = static_cast<char>(0xf0 | (codePoint >> 18));
+                    *dst++ = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+                    *dst++ = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+                    *dst++ = static_cast<char>(0x80 | (codePoint & 0x3f));
+                }
+                return dst;
+            }
+
+            // Up to 19 significant digits are accumulated exactly, short mantissas with small exponents convert without rounding error
+            bool                                ParseNumber(Number& number) {
+                SkipWhitespace();
+                const char* start = _p;
+                const char* p = _p;
+
+                number.negative = (p < _end && '-' == *p);
+                p += number.negative ? 1 : 0;
+                if (p == _end || *p < '0' || *p > '9') {
+                    return Fail("expected a number");
+                }
+
+                constexpr uint64_t mantissaLimit = (UINT64_MAX - 9) / 10;
+                uint64_t mantissa = 0;
+                int32_t exponent = 0;
+                bool exact = true;
+                for (; p < _end && '0' <= *p && *p <= '9'; ++p) {
+                    if (mantissa <= mantissaLimit) {
+                        mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                    }
+                    else {
+                        ++exponent;
+                        exact = false;
+                    }
+                }
+
+                bool integral = exact;
+                if (p < _end && '.' == *p) {
+                    integral = false;
+                    for (++p; p < _end && '0' <= *p && *p <= '9'; ++p) {
+                        if (mantissa <= mantissaLimit) {
+                            mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                            --exponent;
+                        }
+                    }
+                }
+                if (p < _end && ('e' == *p || 'E' == *p)) {
+                    integral = false;
+                    ++p;
+                    const bool negativeExponent = (p < _end && '-' == *p);
+                    p += (p < _end && ('-' == *p || '+' == *p)) ? 1 : 0;
+                    if (p == _end || *p < '0' || *p > '9') {
+                        return Fail("malformed number");
+                    }
+                    int32_t value = 0;
+                    for (; p < _end && '0' <= *p && *p <= '9'; ++p) {
+                        value = std::min(value * 10 + (*p - '0'), 100000);
+                    }
+                    exponent += negativeExponent ? -value : value;
+                }
+
+                static const double powersOf10[] = {
+                    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+                };
+                if (mantissa <= (1ull << 53) && -22 <= exponent && exponent <= 22) {
+                    const double value = static_cast<double>(mantissa);
+                    number.value = exponent < 0 ? value / powersOf10[-exponent] : value * powersOf10[exponent];
+                }
+                else {
+                    // Rare long or extreme numbers, converted from the whole token without the sign, which is applied below
+                    const char* digits = start + (number.negative ? 1 : 0);
+                    if (std::errc::result_out_of_range == std::from_chars(digits, p, number.value).ec) {
+                        number.value = exponent > 0 ? std::numeric_limits<double>::infinity() : 0.0;
+                    }
+                }
+                number.value = number.negative ? -number.value : number.value;
+                number.mantissa = mantissa;
+
+                // Integers written with a fraction or exponent, like 1.0 or 1e3, still count as integers
+                number.integral = integral || (std::floor(number.value) == number.value && std::abs(number.value) <= 9007199254740992.0);
+                if (number.integral && false == integral) {
+                    number.mantissa = static_cast<uint64_t>(std::abs(number.value));
+                }
+
+                _p = p;
+                return true;
+            }
+
+            const char*                         _begin = nullptr;
+            const char*                         _p = nullptr;
+            const char*                         _end = nullptr;
+            Arena&                              _arena;
+            std::string                         _error;
+        };
+
+        int32_t ParseAccessorType(std::string_view type) {
+            if ("SCALAR" == type) {
+                return TINYGLTF_TYPE_SCALAR;
+            }
+            if ("VEC2" == type) {
+                return TINYGLTF_TYPE_VEC2;
+            }
+            if ("VEC3" == type) {
+                return TINYGLTF_TYPE_VEC3;
+            }
+            if ("VEC4" == type) {
+                return TINYGLTF_TYPE_VEC4;
+            }
+            if ("MAT2" == type) {
+                return TINYGLTF_TYPE_MAT2;
+            }
+            if ("MAT3" == type) {
+                return TINYGLTF_TYPE_MAT3;
+            }
+            if ("MAT4" == type) {
+                return TINYGLTF_TYPE_MAT4;
+            }
+            return -1;
+        }
+
+        bool ParseTextureInfo(JsonReader& reader, GltfDocument::TextureInfo& info) {
+            return reader.ParseObject([&](std::string_view key) {
+                if ("index" == key) {
+                    return reader.ReadInt(info.index);
+                }
+                if ("texCoord" == key) {
+                    return reader.ReadInt(info.texCoord);
+                }
+                return reader.Skip();
+            });
+        }
+
+        bool ParseBuffer(JsonReader& reader, GltfDocument::Buffer& buffer) {
+            return reader.ParseObject([&](std::string_view key) {
+                if ("uri" == key) {
+                    return reader.ReadString(buffer.uri);
+                }
+                if ("byteLength" == key) {
+                    return reader.ReadSize(buffer.byteLength);
+                }
+                if ("name" == key) {
+                    return reader.ReadString(buffer.name);
+                }
+                if ("extensions" == key) {
+                    return reader.ParseObject([&](std::string_view extension) {
+                        if ("EXT_meshopt_compression" != extension) {
+                            return reader.Skip();
+                        }
+                        return reader.ParseObject([&](std::string_view member) {
+                            return "fallback" == member ? reader.ReadBool(buffer.meshoptFallback) : reader.Skip();
+                        });
+                    });
+                }
+                return reader.Skip();
+            });
+        }
+
+        bool ParseMeshoptCompression(JsonReader& reader, GltfDocument::MeshoptCompression& meshopt) {
+            return reader.ParseObject([&](std::string_view key) {
+                if ("buffer" == key) {
+                    return reader.ReadInt(meshopt.buffer);
+                }
+                if ("byteOffset" == key) {
+                    return reader.ReadSize(meshopt.byteOffset);
+                }
+                if ("byteLength" == key) {
+                    return reader.ReadSize(meshopt.byteLength);
+                }
+                if ("byteStride" == key) {
+                    return reader.ReadSize(meshopt.byteStride);
+                }
+                if ("count" == key) {
+                    return reader.ReadSize(meshopt.count);
+                }
+                if ("mode" == key) {
+                    return reader.ReadString(meshopt.mode);
+                }
+                if ("filter" == key) {
+                    return reader.ReadString(meshopt.filter);
+                }
+                return reader.Skip();
+            });
+        }
+
+        bool ParseBufferView(JsonReader& reader, Arena& arena, GltfDocument::BufferView& bufferView) {
+            return reader.ParseObject([&](std::string_view key) {
+                if ("buffer" == key) {
+                    return reader.ReadInt(bufferView.buffer);
+                }
+                if ("byteOffset" == key) {
+                    return reader.ReadSize(bufferView.byteOffset);
+                }
+                if ("byteLength" == key) {
+                    return reader.ReadSize(bufferView.byteLength);
+                }
+                if ("byteStride" == key) {
+                    return reader.ReadSize(bufferView.byteStride);
+                }
+                if ("extensions" == key) {
+                    return reader.ParseObject([&](std::string_view extension) {
+                        if ("EXT_meshopt_compression" != extension) {
+                            return reader.Skip();
+                        }
+                        auto* meshopt = arena.New<GltfDocument::MeshoptCompression>();
+                        bufferView.meshopt = meshopt;
+                        return ParseMeshoptCompression(reader, *meshopt);
+                    });
+                }
+                return reader.Skip();
+            });
+        }
+
+        bool ParseAccessor(JsonReader& reader, GltfDocument::Accessor& accessor) {
+            return reader.ParseObject([&](std::string_view key) {
+                if ("bufferView" == key) {
+                    return reader.ReadInt(accessor.bufferView);
+                }
+                if ("byteOffset" == key) {
+                    return reader.ReadSize(accessor.byteOffset);
+                }
+                if ("count" == key) {
+                    return reader.ReadSize(accessor.count);
+                }
+                if ("componentType" == key) {
+                    return reader.ReadInt(accessor.componentType);
+                }
+                if ("type" == key) {
+                    std::string_view type;
+                    if (false == reader.ReadString(type)) {
+                        return false;
+                    }
+                    accessor.type = ParseAccessorType(type);
+                    return -1 != accessor.type || reader.Fail("unknown accessor type");
+                }
+                if ("normalized" == key) {
+                    return reader.ReadBool(accessor.normalized);
+                }
+                if ("min" == key) {
+                    return reader.ReadNumbers(accessor.minValues);
+                }
+                if ("max" == key) {
+                    return reader.ReadNumbers(accessor.maxValues);
+                }
+                if ("sparse" == key) {
+                    auto& sparse = accessor.sparse;
+                    return reader.ParseObject([&](std::string_view sparseKey) {
+                        if ("count" == sparseKey) {
+                            return reader.ReadSize(sparse.count);
+                        }
+                        if ("indices" == sparseKey) {
+                            return reader.ParseObject([&](std::string_view member) {
+                                if ("bufferView" == member) {
+                                    return reader.ReadInt(sparse.indicesBufferView);
+                                }
+                                if ("byteOffset" == member) {
+                                    return reader.ReadSize(sparse.indicesByteOffset);
+                                }
+                                if ("componentType" == member) {
+                                    return reader.ReadInt(sparse.indicesComponentType);
+                                }
+                                return reader.Skip();
+                            });
+                        }
+                        if ("values" == sparseKey) {
+                            return reader.ParseObject([&](std::string_view member) {
+                                if ("bufferView" == member) {
+                                    return reader.ReadInt(sparse.valuesBufferView);
+                                }
+                                if ("byteOffset" == member) {
+                                    return reader.ReadSize(sparse.valuesByteOffset);
+                                }
+                                return reader.Skip();
+                            });
+                        }
+                        return reader.Skip();
+                    });
+                }
+                return reader.Skip();
+            });
+        }
+
+        bool ParsePrimitive(JsonReader& reader, GltfDocument::Primitive& primitive) {
+            return reader.ParseObject([&](std::string_view key) {
+                if ("attributes" == key) {
+                    return reader.ParseObjectAsArray(primitive.attributes, [&](std::string_view name, GltfDocument::Attribute& attribute) {
+                        attribute.name = name;
+                        return reader.ReadInt(attribute.accessor);
+                    });
+                }
+                if ("indices" == key) {
+                    return reader.ReadInt(primitive.indices);
+                }
+                if ("material" == key) {
+                    return reader.ReadInt(primitive.material);
+                }
+                if ("mode" == key) {
+                    return reader.ReadInt(primitive.mode);
+                }
+                return reader.Skip();
+            });
+        }
+
+        bool ParseMesh(JsonReader& reader, GltfDocument::Mesh& mesh) {
+            return reader.ParseObject([&](std::string_view key) {
+                if ("primitives" == key) {
+                    return reader.ParseArray(mesh.primitives, [&](GltfDocument::Primitive& primitive) { return ParsePrimitive(reader, primitive); });
+                }
+                if ("name" == key) {
+                    return reader.ReadString(mesh.name);
+                }
+                return reader.Skip();
+            });
+        }
+
+        bool ParseMeshGpuInstancing(JsonReader& reader, GltfDocument::MeshGpuInstancing& instancing) {
+            return reader.ParseObject([&](std::string_view key) {
+                if ("attributes" != key) {
+                    return reader.Skip();
+                }
+                return reader.ParseObject([&](std::string_view attribute) {
+                    if ("TRANSLATION" == attribute) {
+                        return reader.ReadInt(instancing.translation);
+                    }
+                    if ("ROTATION" == attribute) {
+                        return reader.ReadInt(instancing.rotation);
+                    }
+                    if ("SCALE" == attribute) {
+                        return reader.ReadInt(instancing.scale);
+                    }
+                    return reader.Skip();
+                });
+            });
+        }
+
+        bool ParseNode(JsonReader& reader, Arena& arena, GltfDocument::Node& node) {
+            return reader.ParseObject([&](std::string_view key) {
+                if ("children" == key) {
+                    return reader.ReadInts(node.children);
+                }
+                if ("mesh" == key) {
+                    return reader.ReadInt(node.mesh);
+                }
+                if ("skin" == key) {
+                    return reader.ReadInt(node.skin);
+                }
+                if ("translation" == key) {
+                    node.hasTranslation = true;
+                    return reader.ReadFloats(node.translation, 3);
+                }
+                if ("rotation" == key) {
+                    node.hasRotation = true;
+                    return reader.ReadFloats(node.rotation, 4);
+                }
+                if ("scale" == key) {
+                    node.hasScale = true;
+                    return reader.ReadFloats(node.scale, 3);
+                }
+                if ("matrix" == key) {
+                    node.hasMatrix = true;
+                    return reader.ReadFloats(node.matrix, 16);
+                }
+                if ("name" == key) {
+                    return reader.ReadString(node.name);
+                }
+                if ("extensions" == key) {
+                    return reader.ParseObject([&](std::string_view extension) {
+                        if ("EXT_mesh_gpu_instancing" != extension) {
+                            return reader.Skip();
+                        }
+                        auto* instancing = arena.New<GltfDocument::MeshGpuInstancing>();
+                        node.gpuInstancing = instancing;
+                        return ParseMeshGpuInstancing(reader, *instancing);
+                    });
+                }
+                return reader.Skip();
+            });
+        }
+
+        bool ParseScene(JsonReader& reader, GltfDocument::Scene& scene) {
+            return reader.ParseObject([&](std::string_view key) {
+                if ("nodes" == key) {
+                    return reader.ReadInts(scene.nodes);
+                }
+                if ("name" == key) {
+                    return reader.ReadString(scene.name);
+                }
+                return reader.Skip();
+            });
+        }
+
+        bool ParseSkin(JsonReader& reader, GltfDocument::Skin& skin) {
+            return reader.ParseObject([&](std::string_view key) {
+                if ("inverseBindMatrices" == key) {
+                    return reader.ReadInt(skin.inverseBindMatrices);
+                }
+                if ("skeleton" == key) {
+                    return reader.ReadInt(skin.skeleton);
+                }
+                if ("joints" == key) {
+                    return reader.ReadInts(skin.joints);
+                }
+                if ("name" == key) {
+                    return reader.ReadString(skin.name);
+                }
+                return reader.Skip();
+            });
+        }
+
+        bool ParseAnimation(JsonReader& reader, GltfDocument::Animation& animation) {
+            return reader.ParseObject([&](std::string_view key) {
+                if ("samplers" == key) {
+                    return reader.ParseArray(animation.samplers, [&](GltfDocument::AnimationSampler& sampler) {
+                        return reader.ParseObject([&](std::string_view member) {
+                            if ("input" == member) {
+                                return reader.ReadInt(sampler.input);
+                            }
+                            if ("output" == member) {
+                                return reader.ReadInt(sampler.output);
+                            }
+                            if ("interpolation" == member) {
+                                return reader.ReadString(sampler.interpolation);
+                            }
+                            return reader.Skip();
+                        });
+                    });
+                }
+                if ("channels" == key) {
+                    return reader.ParseArray(animation.channels, [&](GltfDocument::AnimationChannel& channel) {
+                        return reader.ParseObject([&](std::string_view member) {
+                            if ("sampler" == member) {
+                                return reader.ReadInt(channel.sampler);
+                            }
+                            if ("target" == member) {
+                                return reader.ParseObject([&](std::string_view target) {
+                                    if ("node" == target) {
+                                        return reader.ReadInt(channel.targetNode);
+                                    }
+                                    if ("path" == target) {
+                                        return reader.ReadString(channel.targetPath);
+                                    }
+                                    return reader.Skip();
+                                });
+                            }
+                            return reader.Skip();
+                        });
+                    });
+                }
+                if ("name" == key) {
+                    return reader.ReadString(animation.name);
+                }
+                return reader.Skip();
+            });
+        }
+
+        bool ParseSpecularGlossiness(JsonReader& reader, GltfDocument::Material::SpecularGlossiness& specularGlossiness) {
+            specularGlossiness.present = true;
+            return reader.ParseObject([&](std::string_view key) {
+                if ("diffuseTexture" == key) {
+                    return ParseTextureInfo(reader, specularGlossiness.diffuseTexture);
+                }
+                if ("specularGlossinessTexture" == key) {
+                    return ParseTextureInfo(reader, specularGlossiness.specularGlossinessTexture);
+                }
+                if ("diffuseFactor" == key) {
+                    specularGlossiness.hasDiffuseFactor = true;
+                    return reader.ReadFloats(specularGlossiness.diffuseFactor, 4);
+                }
+                if ("specularFactor" == key) {
+                    specularGlossiness.hasSpecularFactor = true;
+                    return reader.ReadFloats(specularGlossiness.specularFactor, 3);
+                }
+                return reader.Skip();
+            });
+        }
+
+        bool ParseMaterial(JsonReader& reader, GltfDocument::Material& material) {
+            return reader.ParseObject([&](std::string_view key) {
+                if ("pbrMetallicRoughness" == key) {
+                    return reader.ParseObject([&](std::string_view member) {
+                        if ("baseColorTexture" == member) {
+                            return ParseTextureInfo(reader, material.baseColorTexture);
+                        }
+                        if ("metallicRoughnessTexture" == member) {
+                            return ParseTextureInfo(reader, material.metallicRoughnessTexture);
+                        }
+                        if ("baseColorFactor" == member) {
+                            material.hasBaseColorFactor = true;
+                            return reader.ReadFloats(material.baseColorFactor, 4);
+                        }
+                        if ("metallicFactor" == member) {
+                            material.hasMetallicFactor = true;
+                            return reader.ReadFloat(material.metallicFactor);
+                        }
+                        if ("roughnessFactor" == member) {
+                            material.hasRoughnessFactor = true;
+                            return reader.ReadFloat(material.roughnessFactor);
+                        }
+                        return reader.Skip();
+                    });
+                }
+                if ("normalTexture" == key) {
+                    return ParseTextureInfo(reader, material.normalTexture);
+                }
+                if ("occlusionTexture" == key) {
+                    return ParseTextureInfo(reader, material.occlusionTexture);
+                }
+                if ("emissiveTexture" == key) {
+                    return ParseTextureInfo(reader, material.emissiveTexture);
+                }
+                if ("emissiveFactor" == key) {
+                    material.hasEmissiveFactor = true;
+                    return reader.ReadFloats(material.emissiveFactor, 3);
+                }
+                if ("alphaMode" == key) {
+                    return reader.ReadString(material.alphaMode);
+                }
+                if ("alphaCutoff" == key) {
+                    material.hasAlphaCutoff = true;
+                    return reader.ReadFloat(material.alphaCutoff);
+                }
+                if ("doubleSided" == key) {
+                    return reader.ReadBool(material.doubleSided);
+                }
+                if ("name" == key) {
+                    return reader.ReadString(material.name);
+                }
+                if ("extensions" == key) {
+                    return reader.ParseObject([&](std::string_view extension) {
+                        if ("KHR_materials_pbrSpecularGlossiness" == extension) {
+                            return ParseSpecularGlossiness(reader, material.specularGlossiness);
+                        }
+                        return reader.Skip();
+                    });
+                }
+                return reader.Skip();
+            });
+        }
+
+        bool ParseTexture(JsonReader& reader, GltfDocument::Texture& texture) {
+            return reader.ParseObject([&](std::string_view key) {
+                if ("source" == key) {
+                    return reader.ReadInt(texture.source);
+                }
+                if ("sampler" == key) {
+                    return reader.ReadInt(texture.sampler);
+                }
+                return reader.Skip();
+            });
+        }
+
+        bool ParseSampler(JsonReader& reader, GltfDocument::Sampler& sampler) {
+            return reader.ParseObject([&](std::string_view key) {
+                if ("magFilter" == key) {
+                    return reader.ReadInt(sampler.magFilter);
+                }
+                if ("minFilter" == key) {
+                    return reader.ReadInt(sampler.minFilter);
+                }
+                if ("wrapS" == key) {
+                    return reader.ReadInt(sampler.wrapS);
+                }
+                if ("wrapT" == key) {
+                    return reader.ReadInt(sampler.wrapT);
+                }
+                return reader.Skip();
+            });
+        }
+
+        bool ParseImage(JsonReader& reader, GltfDocument::Image& image) {
+            return reader.ParseObject([&](std::string_view key) {
+                if ("uri" == key) {
+                    return reader.ReadString(image.uri);
+                }
+                if ("mimeType" == key) {
+                    return reader.ReadString(image.mimeType);
+                }
+                if ("bufferView" == key) {
+                    return reader.ReadInt(image.bufferView);
+                }
+                if ("name" == key) {
+                    return reader.ReadString(image.name);
+                }
+                return reader.Skip();
+            });
+        }
+
+        template<typename T>
+        bool InRange(int32_t index, const ArenaSpan<T>& table) {
+            return 0 <= index && static_cast<uint32_t>(index) < table.size();
+        }
+
+        template<typename T>
+        bool InRangeOrNone(int32_t index, const ArenaSpan<T>& table) {
+            return -1 == index || InRange(index, table);
+        }
+    }
+
+    int32_t GltfDocument::Primitive::FindAttribute(std::string_view name) const {
+        for (const Attribute& attribute : attributes) {
+            if (name == attribute.name) {
+                return attribute.accessor;
+            }
+        }
+        return -1;
+    }
+
+    bool GltfDocument::Parse(const char* json, size_t size, std::string& error) {
+        JsonReader reader(json, json + size, _arena);
+
+        bool hasVersion = false;
+        const bool parsed = reader.ParseObject([&](std::string_view key) {
+            if ("asset" == key) {
+                return reader.ParseObject([&](std::string_view member) {
+                    if ("version" != member) {
+                        return reader.Skip();
+                    }
+                    std::string_view version;
+                    if (false == reader.ReadString(version)) {
+                        return false;
+                    }
+                    hasVersion = true;
+                    return (0 == version.compare(0, 2, "2.")) || reader.Fail("unsupported glTF version");
+                });
+            }
+            if ("extensionsUsed" == key) {
+                return reader.ReadStrings(extensionsUsed);
+            }
+            if ("extensionsRequired" == key) {
+                return reader.ReadStrings(extensionsRequired);
+            }
+            if ("scene" == key) {
+                return reader.ReadInt(defaultScene);
+            }
+            if ("buffers" == key) {
+                return reader.ParseArray(buffers, [&](Buffer& buffer) { return ParseBuffer(reader, buffer); });
+            }
+            if ("bufferViews" == key) {
+                return reader.ParseArray(bufferViews, [&](BufferView& bufferView) { return ParseBufferView(reader, _arena, bufferView); });
+            }
+            if ("accessors" == key) {
+                return reader.ParseArray(accessors, [&](Accessor& accessor) { return ParseAccessor(reader, accessor); });
+            }
+            if ("meshes" == key) {
+                return reader.ParseArray(meshes, [&](Mesh& mesh) { return ParseMesh(reader, mesh); });
+            }
+            if ("nodes" == key) {
+                return reader.ParseArray(nodes, [&](Node& node) { return ParseNode(reader, _arena, node); });
+            }
+            if ("scenes" == key) {
+                return reader.ParseArray(scenes, [&](Scene& scene) { return ParseScene(reader, scene); });
+            }
+            if ("skins" == key) {
+                return reader.ParseArray(skins, [&](Skin& skin) { return ParseSkin(reader, skin); });
+            }
+            if ("animations" == key) {
+                return reader.ParseArray(animations, [&](Animation& animation) { return ParseAnimation(reader, animation); });
+            }
+            if ("materials" == key) {
+                return reader.ParseArray(materials, [&](Material& material) { return ParseMaterial(reader, material); });
+            }
+            if ("textures" == key) {
+                return reader.ParseArray(textures, [&](Texture& texture) { return ParseTexture(reader, texture); });
+            }
+            if ("samplers" == key) {
+                return reader.ParseArray(samplers, [&](Sampler& sampler) { return ParseSampler(reader, sampler); });
+            }
+            if ("images" == key) {
+                return reader.ParseArray(images, [&](Image& image) { return ParseImage(reader, image); });
+            }
+            return reader.Skip();
+        });
+
+        if (false == parsed || false == reader.AtEnd()) {
+            reader.Fail("unexpected data after the root object");
+            error = "glTF JSON: " + reader.Error();
+            return false;
+        }
+        if (false == hasVersion) {
+            error = "glTF JSON: asset.version is missing";
+            return false;
+        }
+        return Validate(error);
+    }
+
+    bool GltfDocument::ParseBinary(const uint8_t* data, size_t size, std::string& error) {
+        const auto readUint32 = [data](size_t offset) {
+            uint32_t value = 0;
+            memcpy(&value, data + offset, sizeof(value));
+            return value;
+        };
+
+        // 12 byte header followed by the JSON chunk and an optional BIN chunk, every chunk has an 8 byte header
+        constexpr uint32_t magicGltf = 0x46546c67;
+        constexpr uint32_t chunkJson = 0x4e4f534a;
+        constexpr uint32_t chunkBin = 0x004e4942;
+        if (size < 20 || magicGltf != readUint32(0) || 2 != readUint32(4) || readUint32(8) > size) {
+            error = "Invalid glTF binary header";
+            return false;
+        }
+        size = readUint32(8);
+
+        const size_t jsonLength = readUint32(12);
+        if (chunkJson != readUint32(16) || jsonLength > size - 20) {
+            error = "Invalid glTF binary JSON chunk";
+            return false;
+        }
+        if (false == Parse(reinterpret_cast<const char*>(data + 20), jsonLength, error)) {
+            return false;
+        }
+
+        const size_t binOffset = 20 + ((jsonLength + 3) & ~size_t(3));
+        if (binOffset + 8 <= size && chunkBin == readUint32(binOffset + 4)) {
+            const size_t binLength = readUint32(binOffset);
+            if (binLength > size - binOffset - 8) {
+                error = "Invalid glTF binary BIN chunk";
+                return false;
+            }
+            if (false == buffers.empty() && buffers[0].uri.empty()) {
+                if (buffers[0].byteLength > binLength) {
+                    error = "Buffer 0 is larger than the BIN chunk";
+                    return false;
+                }
+                buffers[0].data = data + binOffset + 8;
+                buffers[0].size = buffers[0].byteLength;
+            }
+        }
+        return true;
+    }
+
+    void GltfDocument::SetBufferData(int32_t bufferIndex, std::vector<uint8_t>&& bytes) {
+        Buffer& buffer = buffers[bufferIndex];
+        _bufferStorage.emplace_back(std::move(bytes));
+        buffer.data = _bufferStorage.back().data();
+        buffer.size = _bufferStorage.back().size();
+    }
+
+    uint8_t* GltfDocument::AllocateBufferData(int32_t bufferIndex, size_t size) {
+        SetBufferData(bufferIndex, std::vector<uint8_t>(size, 0));
+        return _bufferStorage.back().data();
+    }
+
+    const uint8_t* GltfDocument::GetBufferViewData(int32_t bufferViewIndex, size_t& size) const {
+        size = 0;
+        if (false == InRange(bufferViewIndex, bufferViews)) {
+            return nullptr;
+        }
+        const BufferView& bufferView = bufferViews[bufferViewIndex];
+        const Buffer& buffer = buffers[bufferView.buffer];
+        if (bufferView.byteOffset > buffer.size || bufferView.byteLength > buffer.size - bufferView.byteOffset) {
+            return nullptr;
+        }
+        size = bufferView.byteLength;
+        return buffer.data + bufferView.byteOffset;
+    }
+
+    bool GltfDocument::Validate(std::string& error) const {
+        const auto fail = [&error](const char* table, size_t index, const char* what) {
+            error = std::string(table) + "[" + std::to_string(index) + "] " + what + " is out of range";
+            return false;
+        };
+
+        if (false == InRangeOrNone(defaultScene, scenes)) {
+            error = "Default scene is out of range";
+            return false;
+        }
+        for (size_t i = 0; i < bufferViews.size(); ++i) {
+            if (false == InRange(bufferViews[i].buffer, buffers)) {
+                return fail("bufferViews", i, "buffer");
+            }
+        }
+        for (size_t i = 0; i < accessors.size(); ++i) {
+            const Accessor& accessor = accessors[i];
+            if (false == InRangeOrNone(accessor.bufferView, bufferViews)) {
+                return fail("accessors", i, "bufferView");
+            }
+            if (0 < accessor.sparse.count && (false == InRange(accessor.sparse.indicesBufferView, bufferViews) || false == InRange(accessor.sparse.valuesBufferView, bufferViews))) {
+                return fail("accessors", i, "sparse bufferView");
+            }
+        }
+        for (size_t i = 0; i < meshes.size(); ++i) {
+            for (const Primitive& primitive : meshes[i].primitives) {
+                if (false == InRangeOrNone(primitive.indices, accessors) || false == InRangeOrNone(primitive.material, materials)) {
+                    return fail("meshes", i, "primitive indices or material");
+                }
+                for (const Attribute& attribute : primitive.attributes) {
+                    if (false == InRange(attribute.accessor, accessors)) {
+                        return fail("meshes", i, "primitive attribute");
+                    }
+                }
+                if (-1 == primitive.FindAttribute("POSITION")) {
+                    error = "meshes[" + std::to_string(i) + "] has a primitive without POSITION";
+                    return false;
+                }
+            }
+        }
+
+        // Nodes form trees: every node has at most one parent and scene roots have none
+        std::vector<uint8_t> hasParent(nodes.size(), 0);
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            const Node& node = nodes[i];
+            if (false == InRangeOrNone(node.mesh, meshes) || false == InRangeOrNone(node.skin, skins)) {
+                return fail("nodes", i, "mesh or skin");
+            }
+            if (nullptr != node.gpuInstancing) {
+                const MeshGpuInstancing& instancing = *node.gpuInstancing;
+                if (false == InRangeOrNone(instancing.translation, accessors) || false == InRangeOrNone(instancing.rotation, accessors) || false == InRangeOrNone(instancing.scale, accessors)) {
+                    return fail("nodes", i, "instancing attribute");
+                }
+                // All attributes describe the same instances
+                size_t instanceCount = 0;
+                for (int32_t accessor : { instancing.translation, instancing.rotation, instancing.scale }) {
+                    if (-1 == accessor) {
+                        continue;
+                    }
+                    if (0 != instanceCount && accessors[accessor].count != instanceCount) {
+                        error = "nodes[" + std::to_string(i) + "] has instancing attributes of different counts";
+                        return false;
+                    }
+                    instanceCount = accessors[accessor].count;
+                }
+            }
+            for (int32_t child : node.children) {
+                if (false == InRange(child, nodes) || 0 != hasParent[child] || static_cast<size_t>(child) == i) {
+                    return fail("nodes", i, "child");
+                }
+                hasParent[child] = 1;
+            }
+        }
+        for (size_t i = 0; i < scenes.size(); ++i) {
+            for (int32_t root : scenes[i].nodes) {
+                if (false == InRange(root, nodes) || 0 != hasParent[root]) {
+                    return fail("scenes", i, "root node");
+                }
+            }
+        }
+
+        for (size_t i = 0; i < skins.size(); ++i) {
+            if (false == InRangeOrNone(skins[i].inverseBindMatrices, accessors) || false == InRangeOrNone(skins[i].skeleton, nodes)) {
+                return fail("skins", i, "inverseBindMatrices or skeleton");
+            }
+            for (int32_t joint : skins[i].joints) {
+                if (false == InRange(joint, nodes)) {
+                    return fail("skins", i, "joint");
+                }
+            }
+        }
+        for (size_t i = 0; i < animations.size(); ++i) {
+            for (const AnimationSampler& sampler : animations[i].samplers) {
+                if (false == InRange(sampler.input, accessors) || false == InRange(sampler.output, accessors)) {
+                    return fail("animations", i, "sampler accessor");
+                }
+            }
+            for (const AnimationChannel& channel : animations[i].channels) {
+                if (false == InRange(channel.sampler, animations[i].samplers) || false == InRangeOrNone(channel.targetNode, nodes)) {
+                    return fail("animations", i, "channel sampler or node");
+                }
+            }
+        }
+
+        for (size_t i = 0; i < materials.size(); ++i) {
+            const Material& material = materials[i];
+            const TextureInfo* infos[] = {
+                &material.baseColorTexture, &material.metallicRoughnessTexture, &material.normalTexture, &material.occlusionTexture,
+                &material.emissiveTexture, &material.specularGlossiness.diffuseTexture, &material.specularGlossiness.specularGlossinessTexture,
+            };
+            for (const TextureInfo* info : infos) {
+                if (false == InRangeOrNone(info->index, textures)) {
+                    return fail("materials", i, "texture");
+                }
+            }
+        }
+        for (size_t i = 0; i < textures.size(); ++i) {
+            if (false == InRange(textures[i].source, images) || false == InRangeOrNone(textures[i].sampler, samplers)) {
+                return fail("textures", i, "source or sampler");
+            }
+        }
+        for (size_t i = 0; i < images.size(); ++i) {
+            if (false == InRangeOrNone(images[i].bufferView, bufferViews) || (-1 == images[i].bufferView && images[i].uri.empty())) {
+                return fail("images", i, "bufferView");
+            }
+        }
+        return true;
+    }
+}
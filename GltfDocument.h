@@ -0,0 +1,238 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "Arena.h"
+
+namespace Vk {
+    /*
+        glTF JSON front-end. The JSON is scanned once, without building a DOM, into compact tables that live in one arena.
+        Strings are views into the JSON text unless they contain escapes, so the text has to outlive the document.
+        Only the properties the model loader reads are kept, everything else is skipped.
+    */
+    class GltfDocument {
+    public:
+        // Buffer bytes are borrowed from the .glb BIN chunk or owned by the document once loaded
+        struct Buffer {
+            std::string_view                    name;
+            std::string_view                    uri;
+            size_t                              byteLength = 0;
+            bool                                meshoptFallback = false;    // EXT_meshopt_compression fallback without data of its own
+            const uint8_t*                      data = nullptr;
+            size_t                              size = 0;
+        };
+
+        // EXT_meshopt_compression extension object of a buffer view
+        struct MeshoptCompression {
+            int32_t                             buffer = -1;
+            size_t                              byteOffset = 0;
+            size_t                              byteLength = 0;
+            size_t                              byteStride = 0;
+            size_t                              count = 0;
+            std::string_view                    mode;
+            std::string_view                    filter = "NONE";
+        };
+
+        struct BufferView {
+            int32_t                             buffer = -1;
+            size_t                              byteOffset = 0;
+            size_t                              byteLength = 0;
+            size_t                              byteStride = 0;
+            const MeshoptCompression*           meshopt = nullptr;
+        };
+
+        struct Accessor {
+            int32_t                             bufferView = -1;
+            size_t                              byteOffset = 0;
+            size_t                              count = 0;
+            int32_t                             componentType = -1;             // TINYGLTF_COMPONENT_TYPE_*
+            int32_t                             type = -1;                      // TINYGLTF_TYPE_*
+            bool                                normalized = false;
+            ArenaSpan<double>                   minValues;
+            ArenaSpan<double>                   maxValues;
+
+            struct Sparse {
+                size_t                          count = 0;
+                int32_t                         indicesBufferView = -1;
+                size_t                          indicesByteOffset = 0;
+                int32_t                         indicesComponentType = -1;
+                int32_t                         valuesBufferView = -1;
+                size_t                          valuesByteOffset = 0;
+            } sparse;
+        };
+
+        struct Attribute {
+            std::string_view                    name;
+            int32_t                             accessor = -1;
+        };
+
+        struct Primitive {
+            ArenaSpan<Attribute>                attributes;
+            int32_t                             indices = -1;
+            int32_t                             material = -1;
+            int32_t                             mode = 4;                       // TINYGLTF_MODE_TRIANGLES
+
+            // Accessor index of an attribute or -1
+            int32_t                             FindAttribute(std::string_view name) const;
+        };
+
+        struct Mesh {
+            std::string_view                    name;
+            ArenaSpan<Primitive>                primitives;
+        };
+
+        // EXT_mesh_gpu_instancing attributes of a node, one accessor element per instance, -1 when absent
+        struct MeshGpuInstancing {
+            int32_t                             translation = -1;
+            int32_t                             rotation = -1;
+            int32_t                             scale = -1;
+        };
+
+        struct Node {
+            std::string_view                    name;
+            ArenaSpan<int32_t>                  children;
+            int32_t                             mesh = -1;
+            int32_t                             skin = -1;
+            bool                                hasTranslation = false;
+            bool                                hasRotation = false;
+            bool                                hasScale = false;
+            bool                                hasMatrix = false;
+            float                               translation[3] = { 0.0f, 0.0f, 0.0f };
+            float                               rotation[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+            float                               scale[3] = { 1.0f, 1.0f, 1.0f };
+            float                               matrix[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+            const MeshGpuInstancing*            gpuInstancing = nullptr;
+        };
+
+        struct Scene {
+            std::string_view                    name;
+            ArenaSpan<int32_t>                  nodes;
+        };
+
+        struct Skin {
+            std::string_view                    name;
+            int32_t                             inverseBindMatrices = -1;
+            int32_t                             skeleton = -1;
+            ArenaSpan<int32_t>                  joints;
+        };
+
+        struct AnimationSampler {
+            int32_t                             input = -1;
+            int32_t                             output = -1;
+            std::string_view                    interpolation = "LINEAR";
+        };
+
+        struct AnimationChannel {
+            int32_t                             sampler = -1;
+            int32_t                             targetNode = -1;
+            std::string_view                    targetPath;
+        };
+
+        struct Animation {
+            std::string_view                    name;
+            ArenaSpan<AnimationSampler>         samplers;
+            ArenaSpan<AnimationChannel>         channels;
+        };
+
+        struct TextureInfo {
+            int32_t                             index = -1;
+            int32_t                             texCoord = 0;
+        };
+
+        // Factors that are absent from the JSON keep their glTF defaults, the has* flags tell whether they were present
+        struct Material {
+            std::string_view                    name;
+            TextureInfo                         baseColorTexture;
+            TextureInfo                         metallicRoughnessTexture;
+            TextureInfo                         normalTexture;
+            TextureInfo                         occlusionTexture;
+            TextureInfo                         emissiveTexture;
+            float                               baseColorFactor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+            float                               metallicFactor = 1.0f;
+            float                               roughnessFactor = 1.0f;
+            float                               emissiveFactor[3] = { 0.0f, 0.0f, 0.0f };
+            std::string_view                    alphaMode = "OPAQUE";
+            float                               alphaCutoff = 0.5f;
+            bool                                hasBaseColorFactor = false;
+            bool                                hasMetallicFactor = false;
+            bool                                hasRoughnessFactor = false;
+            bool                                hasEmissiveFactor = false;
+            bool                                hasAlphaCutoff = false;
+            bool                                doubleSided = false;
+
+            // KHR_materials_pbrSpecularGlossiness
+            struct SpecularGlossiness {
+                bool                            present = false;
+                TextureInfo                     diffuseTexture;
+                TextureInfo                     specularGlossinessTexture;
+                float                           diffuseFactor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+                float                           specularFactor[3] = { 1.0f, 1.0f, 1.0f };
+                bool                            hasDiffuseFactor = false;
+                bool                            hasSpecularFactor = false;
+            } specularGlossiness;
+        };
+
+        struct Texture {
+            int32_t                             source = -1;
+            int32_t                             sampler = -1;
+        };
+
+        struct Sampler {
+            int32_t                             magFilter = -1;
+            int32_t                             minFilter = -1;
+            int32_t                             wrapS = 10497;                  // TINYGLTF_TEXTURE_WRAP_REPEAT
+            int32_t                             wrapT = 10497;
+        };
+
+        struct Image {
+            std::string_view                    name;
+            std::string_view                    uri;
+            std::string_view                    mimeType;
+            int32_t                             bufferView = -1;
+        };
+
+                                                GltfDocument() = default;
+                                                GltfDocument(const GltfDocument&) = delete;
+        GltfDocument&                           operator=(const GltfDocument&) = delete;
+
+        // Parses glTF JSON text
+        bool                                    Parse(const char* json, size_t size, std::string& error);
+
+        // Parses a .glb container, its BIN chunk becomes the data of the first buffer without uri
+        bool                                    ParseBinary(const uint8_t* data, size_t size, std::string& error);
+
+        // Hands the bytes of a buffer to the document, which keeps them alive
+        void                                    SetBufferData(int32_t bufferIndex, std::vector<uint8_t>&& bytes);
+
+        // Zero filled storage for a buffer that is written in place, like an EXT_meshopt_compression fallback
+        uint8_t*                                AllocateBufferData(int32_t bufferIndex, size_t size);
+
+        // Bytes of an image stored in a buffer view, nullptr when the view is out of its buffer
+        const uint8_t*                          GetBufferViewData(int32_t bufferViewIndex, size_t& size) const;
+
+        size_t                                  ArenaSize() const { return _arena.ReservedSize(); }
+
+        int32_t                                 defaultScene = -1;
+        ArenaSpan<std::string_view>             extensionsUsed;
+        ArenaSpan<std::string_view>             extensionsRequired;
+        ArenaSpan<Buffer>                       buffers;
+        ArenaSpan<BufferView>                   bufferViews;
+        ArenaSpan<Accessor>                     accessors;
+        ArenaSpan<Mesh>                         meshes;
+        ArenaSpan<Node>                         nodes;
+        ArenaSpan<Scene>                        scenes;
+        ArenaSpan<Skin>                         skins;
+        ArenaSpan<Animation>                    animations;
+        ArenaSpan<Material>                     materials;
+        ArenaSpan<Texture>                      textures;
+        ArenaSpan<Sampler>                      samplers;
+        ArenaSpan<Image>                        images;
+
+    private:
+        // Checks every index the loader follows without looking
+        bool                                    Validate(std::string& error) const;
+
+        Arena                                   _arena;
+        std::vector<std::vector<uint8_t>>       _bufferStorage;
+    };
+}
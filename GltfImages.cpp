@@ -0,0 +1,163 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+#include "GltfImages.h"
+
+#pragma warning(disable : 4100)
+#include <tinygltf/tiny_gltf.h>
+#pragma warning(default : 4100)
+
+#include "Base64.h"
+#include "GltfDocument.h"
+#include "ThreadPool.h"
+
+namespace Vk {
+    struct GltfImageDecoder::DecodeState {
+        struct Item {
+            int32_t                             image = -1;
+            const uint8_t*                      data = nullptr;     // Buffer view bytes, uri images are read by the task
+            size_t                              size = 0;
+            std::string_view                    uri;                // View into the document text
+            std::string                         error;
+        };
+
+        std::string                             baseDir;
+        std::vector<Item>                       items;
+        std::vector<tinygltf::Image>            images;
+
+        std::atomic<size_t>                     next{ 0 };
+        std::mutex                              mutex;
+        std::condition_variable                 condition;
+        std::deque<size_t>                      finished;   // Decoded items not handed out yet
+        size_t                                  completed = 0;
+        size_t                                  returned = 0;
+    };
+
+    GltfImageDecoder::~GltfImageDecoder() {
+        if (nullptr == _state) {
+            return;
+        }
+
+        // Nothing new gets claimed, but running decodes still read the document buffers
+        const size_t claimed = std::min(_state->next.exchange(_state->items.size()), _state->items.size());
+        std::unique_lock<std::mutex> lock(_state->mutex);
+        _state->condition.wait(lock, [this, claimed]() { return _state->completed >= claimed; });
+    }
+
+    void GltfImageDecoder::Start(const GltfDocument& document, const std::string& baseDir, std::vector<int32_t>&& imageIndices) {
+        assert(nullptr == _state);
+
+        _state = std::make_shared<DecodeState>();
+        _state->baseDir = baseDir;
+        _state->items.resize(imageIndices.size());
+        _state->images.resize(document.images.size());
+
+        for (size_t i = 0; i < imageIndices.size(); ++i) {
+            DecodeState::Item& item = _state->items[i];
+            item.image = imageIndices[i];
+
+            const GltfDocument::Image& image = document.images[item.image];
+            if (image.bufferView > -1) {
+                item.data = document.GetBufferViewData(image.bufferView, item.size);
+            }
+            else {
+                item.uri = image.uri;
+            }
+        }
+
+        // Helpers that start after every item was claimed return right away, the state outlives them
+        auto state = _state;
+        auto& pool = ThreadPool::Get();
+        const size_t helperCount = std::min(static_cast<size_t>(pool.ThreadCount()), _state->items.size());
+        for (size_t i = 0; i < helperCount; ++i) {
+            pool.Enqueue([state]() {
+                for (size_t item = state->next++; item < state->items.size(); item = state->next++) {
+                    Decode(*state, item);
+                }
+            });
+        }
+    }
+
+    void GltfImageDecoder::Decode(DecodeState& state, size_t item) {
+        DecodeState::Item& entry = state.items[item];
+        tinygltf::Image& image = state.images[entry.image];
+
+        std::vector<unsigned char> encoded;
+        DataUri dataUri;
+        if (ParseDataUri(entry.uri, dataUri)) {
+            size_t size = 0;
+            if (GetBase64DecodedSize(dataUri.payload, size)) {
+                encoded.resize(size);
+            }
+            if (encoded.empty() || false == DecodeBase64(dataUri.payload, encoded.data())) {
+                entry.error = "Failed to decode data URI of image " + std::to_string(entry.image) + "\n";
+            }
+            entry.data = encoded.data();
+            entry.size = encoded.size();
+        }
+        else if (false == entry.uri.empty()) {
+            const std::string filepath = (std::filesystem::path(state.baseDir) / entry.uri).string();
+            std::string fileError;
+            if (false == tinygltf::ReadWholeFile(&encoded, &fileError, filepath, nullptr)) {
+                entry.error = "Failed to read image " + filepath + ": " + fileError + "\n";
+            }
+            entry.data = encoded.data();
+            entry.size = encoded.size();
+        }
+
+        if (entry.error.empty()) {
+            if (nullptr == entry.data || 0 == entry.size || entry.size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+                entry.error = "No encoded data for image " + std::to_string(entry.image) + "\n";
+            }
+            else {
+                std::string warning;
+                tinygltf::LoadImageData(&image, entry.image, &entry.error, &warning, 0, 0, entry.data, static_cast<int>(entry.size), nullptr);
+            }
+        }
+        entry.data = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.finished.push_back(item);
+            ++state.completed;
+        }
+        state.condition.notify_all();
+    }
+
+    const tinygltf::Image& GltfImageDecoder::GetImage(int32_t imageIndex) const {
+        return _state->images[imageIndex];
+    }
+
+    int32_t GltfImageDecoder::WaitNext(std::string& error) {
+        if (nullptr == _state) {
+            return -1;
+        }
+
+        DecodeState& state = *_state;
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                if (false == state.finished.empty()) {
+                    const DecodeState::Item& item = state.items[state.finished.front()];
+                    state.finished.pop_front();
+                    ++state.returned;
+                    error += item.error;
+                    return item.image;
+                }
+                if (state.items.size() == state.returned) {
+                    return -1;
+                }
+            }
+
+            // Decode on this thread rather than wait, which also keeps loads running on pool threads from stalling
+            const size_t item = state.next++;
+            if (item < state.items.size()) {
+                Decode(state, item);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(state.mutex);
+            state.condition.wait(lock, [&state]() { return false == state.finished.empty(); });
+        }
+    }
+}
@@ -0,0 +1,42 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#pragma once
+
+namespace tinygltf {
+    struct Image;
+}
+
+namespace Vk {
+    class GltfDocument;
+
+    /*
+        Decodes glTF images on the thread pool. Start() reads and decodes every requested image on its own task,
+        whether it lives in a buffer view, a data URI or an external file, and WaitNext() hands them out in the order
+        they finish, so uploads overlap with the remaining decodes.
+    */
+    class GltfImageDecoder {
+    public:
+                                                GltfImageDecoder() = default;
+                                                ~GltfImageDecoder();
+
+                                                GltfImageDecoder(const GltfImageDecoder&) = delete;
+        GltfImageDecoder&                       operator=(const GltfImageDecoder&) = delete;
+
+        // Images stored in buffer views are read from their buffers, which have to be loaded by now.
+        // Uris are read from the document text, so the document has to outlive the decoder
+        void                                    Start(const GltfDocument& document, const std::string& baseDir, std::vector<int32_t>&& imageIndices);
+
+        // Index of the next decoded image or -1 once all of them were returned. Failed images stay empty
+        int32_t                                 WaitNext(std::string& error);
+
+        // Pixels of an image returned by WaitNext, 8 bit images are always RGBA
+        const tinygltf::Image&                  GetImage(int32_t imageIndex) const;
+
+    private:
+        struct DecodeState;
+
+        static void                             Decode(DecodeState& state, size_t item);
+
+        std::shared_ptr<DecodeState>            _state;
+    };
+}
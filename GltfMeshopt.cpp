@@ -0,0 +1,782 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+#include "GltfMeshopt.h"
+
+#include "CpuFeatures.h"
+#include "GltfDocument.h"
+#include "ThreadPool.h"
+
+namespace Vk {
+    namespace {
+        constexpr uint8_t VERTEX_HEADER = 0xa0;
+        constexpr uint8_t TRIANGLE_HEADER = 0xe0;
+        constexpr uint8_t SEQUENCE_HEADER = 0xd0;
+
+        constexpr size_t VERTEX_BLOCK_SIZE_BYTES = 8192;
+        constexpr size_t VERTEX_BLOCK_MAX_SIZE = 256;
+        constexpr size_t BYTE_GROUP_SIZE = 16;
+        constexpr size_t BYTE_GROUP_DECODE_LIMIT = 24;  // Largest group: 8 bytes of 4 bit selectors and 16 explicit bytes
+        constexpr size_t TAIL_MAX_SIZE = 32;
+
+        size_t GetVertexBlockSize(size_t stride) {
+            const size_t result = (VERTEX_BLOCK_SIZE_BYTES / stride) & ~(BYTE_GROUP_SIZE - 1);
+            return result < VERTEX_BLOCK_MAX_SIZE ? result : VERTEX_BLOCK_MAX_SIZE;
+        }
+
+        uint8_t Unzigzag8(uint8_t v) {
+            return static_cast<uint8_t>((0 - (v & 1)) ^ (v >> 1));
+        }
+
+        /*
+            Vertex codec: every byte lane of a block is a delta stream, stored as groups of 16 bytes
+            packed to 0, 2, 4 or 8 bits where the largest packed value escapes to an explicit byte
+        */
+        const uint8_t* DecodeBytesGroup(const uint8_t* data, uint8_t* buffer, uint32_t bitsLog2) {
+            switch (bitsLog2) {
+            case 0:
+                memset(buffer, 0, BYTE_GROUP_SIZE);
+                return data;
+            case 1: {
+                const uint8_t* explicitData = data + 4;
+                for (size_t i = 0; i < BYTE_GROUP_SIZE; ++i) {
+                    const uint8_t selector = (data[i / 4] >> (6 - (i % 4) * 2)) & 3;
+                    buffer[i] = (3 == selector) ? *explicitData++ : selector;
+                }
+                return explicitData;
+            }
+            case 2: {
+                const uint8_t* explicitData = data + 8;
+                for (size_t i = 0; i < BYTE_GROUP_SIZE; ++i) {
+                    const uint8_t selector = (data[i / 2] >> (4 - (i % 2) * 4)) & 15;
+                    buffer[i] = (15 == selector) ? *explicitData++ : selector;
+                }
+                return explicitData;
+            }
+            default:
+                memcpy(buffer, data, BYTE_GROUP_SIZE);
+                return data + BYTE_GROUP_SIZE;
+            }
+        }
+
+        // For every 8 bit escape mask: where each escaped byte comes from among the explicit bytes, 0x80 clears the rest
+        struct ShuffleTable {
+            alignas(16) uint8_t shuffle[256][8];
+            uint8_t count[256];
+
+            ShuffleTable() {
+                for (uint32_t mask = 0; mask < 256; ++mask) {
+                    uint8_t next = 0;
+                    for (uint32_t bit = 0; bit < 8; ++bit) {
+                        shuffle[mask][bit] = (mask & (1u << bit)) ? next++ : 0x80;
+                    }
+                    count[mask] = next;
+                }
+            }
+        };
+
+        const ShuffleTable& GetShuffleTable() {
+            static const ShuffleTable table;
+            return table;
+        }
+
+        const uint8_t* DecodeBytesGroupSSSE3(const uint8_t* data, uint8_t* buffer, uint32_t bitsLog2, const ShuffleTable& table) {
+            __m128i selectors;
+            __m128i escapes;
+            const uint8_t* explicitData;
+
+            switch (bitsLog2) {
+            case 0:
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(buffer), _mm_setzero_si128());
+                return data;
+            case 1: {
+                int32_t packed;
+                memcpy(&packed, data, sizeof(packed));
+                const __m128i sel2 = _mm_cvtsi32_si128(packed);
+                const __m128i sel22 = _mm_unpacklo_epi8(_mm_srli_epi16(sel2, 4), sel2);
+                const __m128i sel2222 = _mm_unpacklo_epi8(_mm_srli_epi16(sel22, 2), sel22);
+                selectors = _mm_and_si128(sel2222, _mm_set1_epi8(3));
+                escapes = _mm_cmpeq_epi8(selectors, _mm_set1_epi8(3));
+                explicitData = data + 4;
+                break;
+            }
+            case 2: {
+                const __m128i sel4 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data));
+                const __m128i sel44 = _mm_unpacklo_epi8(_mm_srli_epi16(sel4, 4), sel4);
+                selectors = _mm_and_si128(sel44, _mm_set1_epi8(15));
+                escapes = _mm_cmpeq_epi8(selectors, _mm_set1_epi8(15));
+                explicitData = data + 8;
+                break;
+            }
+            default:
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(buffer), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+                return data + BYTE_GROUP_SIZE;
+            }
+
+            const int32_t mask = _mm_movemask_epi8(escapes);
+            const uint8_t mask0 = static_cast<uint8_t>(mask & 0xff);
+            const uint8_t mask1 = static_cast<uint8_t>(mask >> 8);
+
+            // The second half picks its explicit bytes after the ones taken by the first half
+            const __m128i shuffle0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(table.shuffle[mask0]));
+            const __m128i shuffle1 = _mm_add_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(table.shuffle[mask1])), _mm_set1_epi8(static_cast<char>(table.count[mask0])));
+            const __m128i shuffle = _mm_unpacklo_epi64(shuffle0, shuffle1);
+
+            const __m128i explicitBytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(explicitData));
+            const __m128i result = _mm_or_si128(_mm_shuffle_epi8(explicitBytes, shuffle), _mm_andnot_si128(escapes, selectors));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(buffer), result);
+
+            return explicitData + table.count[mask0] + table.count[mask1];
+        }
+
+        template<bool Simd>
+        const uint8_t* DecodeBytes(const uint8_t* data, const uint8_t* dataEnd, uint8_t* buffer, size_t bufferSize) {
+            assert(0 == bufferSize % BYTE_GROUP_SIZE);
+
+            // Two header bits per group
+            const uint8_t* header = data;
+            const size_t headerSize = (bufferSize / BYTE_GROUP_SIZE + 3) / 4;
+            if (static_cast<size_t>(dataEnd - data) < headerSize) {
+                return nullptr;
+            }
+            data += headerSize;
+
+            for (size_t i = 0; i < bufferSize; i += BYTE_GROUP_SIZE) {
+                // The tail after the last block guarantees that a well formed stream never trips this
+                if (static_cast<size_t>(dataEnd - data) < BYTE_GROUP_DECODE_LIMIT) {
+                    return nullptr;
+                }
+
+                const size_t group = i / BYTE_GROUP_SIZE;
+                const uint32_t bitsLog2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+                if constexpr (Simd) {
+                    data = DecodeBytesGroupSSSE3(data, buffer + i, bitsLog2, GetShuffleTable());
+                }
+                else {
+                    data = DecodeBytesGroup(data, buffer + i, bitsLog2);
+                }
+            }
+            return data;
+        }
+
+        template<bool Simd>
+        const uint8_t* DecodeVertexBlock(const uint8_t* data, const uint8_t* dataEnd, uint8_t* dst, size_t count, size_t stride, uint8_t lastVertex[256]) {
+            assert(0 < count && count <= VERTEX_BLOCK_MAX_SIZE);
+
+            alignas(16) uint8_t buffer[VERTEX_BLOCK_MAX_SIZE];
+            const size_t alignedCount = (count + BYTE_GROUP_SIZE - 1) & ~(BYTE_GROUP_SIZE - 1);
+
+            for (size_t k = 0; k < stride; ++k) {
+                data = DecodeBytes<Simd>(data, dataEnd, buffer, alignedCount);
+                if (nullptr == data) {
+                    return nullptr;
+                }
+
+                uint8_t previous = lastVertex[k];
+                if constexpr (Simd) {
+                    // Unzigzag and prefix sum 16 deltas at a time, only the scatter into the vertices stays scalar
+                    const __m128i one = _mm_set1_epi8(1);
+                    const __m128i low7 = _mm_set1_epi8(0x7f);
+                    for (size_t i = 0; i < alignedCount; i += BYTE_GROUP_SIZE) {
+                        __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(buffer + i));
+                        v = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(v, 1), low7), _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(v, one)));
+                        v = _mm_add_epi8(v, _mm_slli_si128(v, 1));
+                        v = _mm_add_epi8(v, _mm_slli_si128(v, 2));
+                        v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+                        v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+                        v = _mm_add_epi8(v, _mm_set1_epi8(static_cast<char>(previous)));
+                        _mm_store_si128(reinterpret_cast<__m128i*>(buffer + i), v);
+                        previous = buffer[i + BYTE_GROUP_SIZE - 1];
+                    }
+
+                    uint8_t* out = dst + k;
+                    for (size_t i = 0; i < count; ++i, out += stride) {
+                        *out = buffer[i];
+                    }
+                }
+                else {
+                    uint8_t* out = dst + k;
+                    for (size_t i = 0; i < count; ++i, out += stride) {
+                        previous = static_cast<uint8_t>(previous + Unzigzag8(buffer[i]));
+                        *out = previous;
+                    }
+                }
+            }
+
+            memcpy(lastVertex, dst + stride * (count - 1), stride);
+            return data;
+        }
+
+        template<bool Simd>
+        bool DecodeVertexBlocks(uint8_t* dst, size_t count, size_t stride, const uint8_t* data, const uint8_t* dataEnd) {
+            // The tail ends with the vertex the first deltas are relative to
+            uint8_t lastVertex[256];
+            memcpy(lastVertex, dataEnd - stride, stride);
+
+            const size_t blockSize = GetVertexBlockSize(stride);
+            for (size_t offset = 0; offset < count; offset += blockSize) {
+                const size_t blockCount = std::min(blockSize, count - offset);
+                data = DecodeVertexBlock<Simd>(data, dataEnd, dst + offset * stride, blockCount, stride, lastVertex);
+                if (nullptr == data) {
+                    return false;
+                }
+            }
+
+            const size_t tailSize = std::max(stride, TAIL_MAX_SIZE);
+            return static_cast<size_t>(dataEnd - data) == tailSize;
+        }
+
+        /*
+            Index codecs
+        */
+        uint32_t DecodeVByte(const uint8_t*& data) {
+            const uint8_t lead = *data++;
+            if (lead < 128) {
+                return lead;
+            }
+
+            // At most 5 bytes for a 32 bit value
+            uint32_t result = lead & 127;
+            uint32_t shift = 7;
+            for (uint32_t i = 0; i < 4; ++i) {
+                const uint8_t group = *data++;
+                result |= static_cast<uint32_t>(group & 127) << shift;
+                shift += 7;
+                if (group < 128) {
+                    break;
+                }
+            }
+            return result;
+        }
+
+        uint32_t DecodeIndex(const uint8_t*& data, uint32_t last) {
+            const uint32_t v = DecodeVByte(data);
+            const uint32_t delta = (v >> 1) ^ (0u - (v & 1));
+            return last + delta;
+        }
+
+        void WriteIndex(uint8_t* dst, size_t i, size_t indexSize, uint32_t index) {
+            if (2 == indexSize) {
+                const uint16_t value = static_cast<uint16_t>(index);
+                memcpy(dst + i * 2, &value, sizeof(value));
+            }
+            else {
+                memcpy(dst + i * 4, &index, sizeof(index));
+            }
+        }
+
+        void WriteTriangle(uint8_t* dst, size_t i, size_t indexSize, uint32_t a, uint32_t b, uint32_t c) {
+            WriteIndex(dst, i + 0, indexSize, a);
+            WriteIndex(dst, i + 1, indexSize, b);
+            WriteIndex(dst, i + 2, indexSize, c);
+        }
+
+        // Both FIFOs have to be updated exactly like the encoder does, reads wrap around the 16 entries
+        struct TriangleFifos {
+            uint32_t edges[16][2];
+            uint32_t vertices[16];
+            size_t edgeOffset = 0;
+            size_t vertexOffset = 0;
+
+            TriangleFifos() {
+                memset(edges, -1, sizeof(edges));
+                memset(vertices, -1, sizeof(vertices));
+            }
+
+            void PushEdge(uint32_t a, uint32_t b) {
+                edges[edgeOffset][0] = a;
+                edges[edgeOffset][1] = b;
+                edgeOffset = (edgeOffset + 1) & 15;
+            }
+
+            void PushVertex(uint32_t v, bool advance = true) {
+                vertices[vertexOffset] = v;
+                vertexOffset = (vertexOffset + (advance ? 1 : 0)) & 15;
+            }
+        };
+
+        /*
+            EXT_meshopt_compression extension object of a buffer view
+        */
+        enum class MeshoptMode {
+            ATTRIBUTES,
+            TRIANGLES,
+            INDICES,
+        };
+
+        enum class MeshoptFilter {
+            NONE,
+            OCTAHEDRAL,
+            QUATERNION,
+            EXPONENTIAL,
+        };
+
+        struct CompressedView {
+            int32_t bufferView = -1;
+            size_t sourceBuffer = 0;
+            size_t sourceOffset = 0;
+            const uint8_t* src = nullptr;
+            size_t srcSize = 0;
+            uint8_t* dst = nullptr;
+            size_t count = 0;
+            size_t stride = 0;
+            MeshoptMode mode = MeshoptMode::ATTRIBUTES;
+            MeshoptFilter filter = MeshoptFilter::NONE;
+        };
+
+        bool ParseCompressedView(const GltfDocument::MeshoptCompression& extension, CompressedView& view, std::string& error) {
+            if (extension.buffer < 0 || 0 == extension.byteLength || 0 == extension.byteStride || extension.mode.empty()) {
+                error = "missing required properties";
+                return false;
+            }
+            view.sourceBuffer = static_cast<size_t>(extension.buffer);
+            view.sourceOffset = extension.byteOffset;
+            view.srcSize = extension.byteLength;
+            view.stride = extension.byteStride;
+            view.count = extension.count;
+
+            const std::string_view mode = extension.mode;
+            if ("ATTRIBUTES" == mode) {
+                view.mode = MeshoptMode::ATTRIBUTES;
+            }
+            else if ("TRIANGLES" == mode) {
+                view.mode = MeshoptMode::TRIANGLES;
+            }
+            else if ("INDICES" == mode) {
+                view.mode = MeshoptMode::INDICES;
+            }
+            else {
+                error = "unknown mode " + std::string(mode);
+                return false;
+            }
+
+            const std::string_view filter = extension.filter;
+            if ("NONE" == filter) {
+                view.filter = MeshoptFilter::NONE;
+            }
+            else if ("OCTAHEDRAL" == filter) {
+                view.filter = MeshoptFilter::OCTAHEDRAL;
+            }
+            else if ("QUATERNION" == filter) {
+                view.filter = MeshoptFilter::QUATERNION;
+            }
+            else if ("EXPONENTIAL" == filter) {
+                view.filter = MeshoptFilter::EXPONENTIAL;
+            }
+            else {
+                error = "unknown filter " + std::string(filter);
+                return false;
+            }
+
+            switch (view.mode) {
+            case MeshoptMode::ATTRIBUTES: {
+                const bool strideValid = 0 < view.stride && view.stride <= 256 && 0 == view.stride % 4;
+                const bool filterValid = (MeshoptFilter::NONE == view.filter) || (MeshoptFilter::EXPONENTIAL == view.filter) ||
+                                         (MeshoptFilter::OCTAHEDRAL == view.filter && (4 == view.stride || 8 == view.stride)) ||
+                                         (MeshoptFilter::QUATERNION == view.filter && 8 == view.stride);
+                if (false == strideValid || false == filterValid) {
+                    error = "invalid byteStride for ATTRIBUTES";
+                    return false;
+                }
+                break;
+            }
+            case MeshoptMode::TRIANGLES:
+            case MeshoptMode::INDICES:
+                if ((2 != view.stride && 4 != view.stride) || MeshoptFilter::NONE != view.filter ||
+                    (MeshoptMode::TRIANGLES == view.mode && 0 != view.count % 3)) {
+                    error = "invalid index layout";
+                    return false;
+                }
+                break;
+            }
+            return true;
+        }
+
+        bool DecodeCompressedView(const CompressedView& view) {
+            switch (view.mode) {
+            case MeshoptMode::ATTRIBUTES:
+                if (false == DecodeVertexStream(view.dst, view.count, view.stride, view.src, view.srcSize)) {
+                    return false;
+                }
+                break;
+            case MeshoptMode::TRIANGLES:
+                return DecodeTriangleStream(view.dst, view.count, view.stride, view.src, view.srcSize);
+            case MeshoptMode::INDICES:
+                return DecodeIndexSequence(view.dst, view.count, view.stride, view.src, view.srcSize);
+            }
+
+            switch (view.filter) {
+            case MeshoptFilter::OCTAHEDRAL:
+                DecodeOctahedralFilter(view.dst, view.count, view.stride);
+                break;
+            case MeshoptFilter::QUATERNION:
+                DecodeQuaternionFilter(view.dst, view.count, view.stride);
+                break;
+            case MeshoptFilter::EXPONENTIAL:
+                DecodeExponentialFilter(view.dst, view.count, view.stride);
+                break;
+            default:
+                break;
+            }
+            return true;
+        }
+
+        template<typename T>
+        void DecodeOctahedral(uint8_t* data, size_t count) {
+            const float maxValue = static_cast<float>((1 << (sizeof(T) * 8 - 1)) - 1);
+
+            for (size_t i = 0; i < count; ++i) {
+                T v[4];
+                memcpy(v, data + i * sizeof(v), sizeof(v));
+
+                // z holds 1.0 at the same scale as x and y, w passes through untouched
+                float x = static_cast<float>(v[0]);
+                float y = static_cast<float>(v[1]);
+                const float z = static_cast<float>(v[2]) - fabsf(x) - fabsf(y);
+
+                // Unfold the lower hemisphere
+                const float t = std::min(z, 0.0f);
+                x += (x >= 0.0f) ? t : -t;
+                y += (y >= 0.0f) ? t : -t;
+
+                const float scale = maxValue / sqrtf(x * x + y * y + z * z);
+                v[0] = static_cast<T>(static_cast<int32_t>(x * scale + (x >= 0.0f ? 0.5f : -0.5f)));
+                v[1] = static_cast<T>(static_cast<int32_t>(y * scale + (y >= 0.0f ? 0.5f : -0.5f)));
+                v[2] = static_cast<T>(static_cast<int32_t>(z * scale + (z >= 0.0f ? 0.5f : -0.5f)));
+
+                memcpy(data + i * sizeof(v), v, sizeof(v));
+            }
+        }
+    }
+
+    bool DecodeVertexStream(uint8_t* dst, size_t count, size_t stride, const uint8_t* src, size_t srcSize) {
+        if (0 == stride || 256 < stride || 0 != stride % 4) {
+            return false;
+        }
+        if (srcSize < 1 + stride || VERTEX_HEADER != src[0]) {
+            return false;
+        }
+
+        const uint8_t* data = src + 1;
+        const uint8_t* dataEnd = src + srcSize;
+        return CpuFeatures::Get().ssse3 ? DecodeVertexBlocks<true>(dst, count, stride, data, dataEnd) : DecodeVertexBlocks<false>(dst, count, stride, data, dataEnd);
+    }
+
+    bool DecodeTriangleStream(uint8_t* dst, size_t count, size_t indexSize, const uint8_t* src, size_t srcSize) {
+        if (0 != count % 3 || (2 != indexSize && 4 != indexSize)) {
+            return false;
+        }
+
+        // Header, one code byte per triangle and the 16 byte auxiliary code table at the end
+        if (srcSize < 1 + count / 3 + 16 || TRIANGLE_HEADER != (src[0] & 0xf0)) {
+            return false;
+        }
+        const uint32_t version = src[0] & 0x0f;
+        if (1 < version) {
+            return false;
+        }
+
+        TriangleFifos fifos;
+        uint32_t next = 0;
+        uint32_t last = 0;
+        // Version 1 spends vertex FIFO codes 13 and 14 on last - 1 and last + 1
+        const uint32_t fecMax = (1 <= version) ? 13 : 15;
+
+        const uint8_t* code = src + 1;
+        const uint8_t* data = code + count / 3;
+        const uint8_t* dataSafeEnd = src + srcSize - 16;
+        const uint8_t* codeAuxTable = dataSafeEnd;
+
+        for (size_t i = 0; i < count; i += 3) {
+            // A triangle reads at most 16 bytes past data, the auxiliary table doubles as padding
+            if (data > dataSafeEnd) {
+                return false;
+            }
+
+            const uint8_t codeTri = *code++;
+            if (codeTri < 0xf0) {
+                // Edge from the edge FIFO plus a third vertex
+                const uint32_t fe = codeTri >> 4;
+                const uint32_t a = fifos.edges[(fifos.edgeOffset - 1 - fe) & 15][0];
+                const uint32_t b = fifos.edges[(fifos.edgeOffset - 1 - fe) & 15][1];
+
+                const uint32_t fec = codeTri & 15;
+                uint32_t c;
+                if (fec < fecMax) {
+                    const bool isNext = (0 == fec);
+                    c = isNext ? next : fifos.vertices[(fifos.vertexOffset - 1 - fec) & 15];
+                    next += isNext ? 1 : 0;
+                    fifos.PushVertex(c, isNext);
+                }
+                else {
+                    // Free indices are delta encoded against the previous free index
+                    if (15 == fec) {
+                        c = DecodeIndex(data, last);
+                    }
+                    else {
+                        c = (13 == fec) ? last - 1 : last + 1;
+                    }
+                    last = c;
+                    fifos.PushVertex(c);
+                }
+
+                WriteTriangle(dst, i, indexSize, a, b, c);
+                fifos.PushEdge(c, b);
+                fifos.PushEdge(a, c);
+            }
+            else {
+                uint32_t a;
+                uint32_t b;
+                uint32_t c;
+                uint32_t feb;
+                uint32_t fec;
+
+                if (codeTri < 0xfe) {
+                    // Table encoded vertex FIFO codes, a is always the next vertex
+                    const uint8_t codeAux = codeAuxTable[codeTri & 15];
+                    feb = codeAux >> 4;
+                    fec = codeAux & 15;
+
+                    a = next++;
+                    b = (0 == feb) ? next++ : fifos.vertices[(fifos.vertexOffset - feb) & 15];
+                    c = (0 == fec) ? next++ : fifos.vertices[(fifos.vertexOffset - fec) & 15];
+                }
+                else {
+                    // Explicit code byte, 0xfe restarts from vertex 0 when it is zero
+                    const uint8_t codeAux = *data++;
+                    const uint32_t fea = (0xfe == codeTri) ? 0 : 15;
+                    feb = codeAux >> 4;
+                    fec = codeAux & 15;
+
+                    if (0 == codeAux) {
+                        next = 0;
+                    }
+
+                    a = (0 == fea) ? next++ : 0;
+                    b = (0 == feb) ? next++ : fifos.vertices[(fifos.vertexOffset - feb) & 15];
+                    c = (0 == fec) ? next++ : fifos.vertices[(fifos.vertexOffset - fec) & 15];
+
+                    if (15 == fea) {
+                        last = a = DecodeIndex(data, last);
+                    }
+                    if (15 == feb) {
+                        last = b = DecodeIndex(data, last);
+                    }
+                    if (15 == fec) {
+                        last = c = DecodeIndex(data, last);
+                    }
+                }
+
+                WriteTriangle(dst, i, indexSize, a, b, c);
+                fifos.PushVertex(a);
+                fifos.PushVertex(b, 0 == feb || 15 == feb);
+                fifos.PushVertex(c, 0 == fec || 15 == fec);
+                fifos.PushEdge(b, a);
+                fifos.PushEdge(c, b);
+                fifos.PushEdge(a, c);
+            }
+        }
+
+        // Everything up to the auxiliary table has to be consumed
+        return data == dataSafeEnd;
+    }
+
+    bool DecodeIndexSequence(uint8_t* dst, size_t count, size_t indexSize, const uint8_t* src, size_t srcSize) {
+        if (2 != indexSize && 4 != indexSize) {
+            return false;
+        }
+
+        // Header, at least one byte per index and a 4 byte tail
+        if (srcSize < 1 + count + 4 || SEQUENCE_HEADER != (src[0] & 0xf0) || 1 < (src[0] & 0x0f)) {
+            return false;
+        }
+
+        const uint8_t* data = src + 1;
+        const uint8_t* dataSafeEnd = src + srcSize - 4;
+
+        // Deltas alternate between two baselines, the low bit picks one
+        uint32_t last[2] = {};
+        for (size_t i = 0; i < count; ++i) {
+            // An index reads at most 5 bytes, the tail covers the overrun
+            if (data >= dataSafeEnd) {
+                return false;
+            }
+
+            uint32_t v = DecodeVByte(data);
+            const uint32_t baseline = v & 1;
+            v >>= 1;
+
+            const uint32_t delta = (v >> 1) ^ (0u - (v & 1));
+            last[baseline] += delta;
+            WriteIndex(dst, i, indexSize, last[baseline]);
+        }
+
+        return data == dataSafeEnd;
+    }
+
+    void DecodeOctahedralFilter(uint8_t* data, size_t count, size_t stride) {
+        if (4 == stride) {
+            DecodeOctahedral<int8_t>(data, count);
+        }
+        else if (8 == stride) {
+            DecodeOctahedral<int16_t>(data, count);
+        }
+    }
+
+    void DecodeQuaternionFilter(uint8_t* data, size_t count, size_t stride) {
+        if (8 != stride) {
+            return;
+        }
+
+        const float scale = 1.0f / sqrtf(2.0f);
+        for (size_t i = 0; i < count; ++i) {
+            int16_t v[4];
+            memcpy(v, data + i * sizeof(v), sizeof(v));
+
+            // The fourth component stores the range in its high bits and the index of the dropped component in its low 2 bits
+            const float rangeScale = scale / static_cast<float>(v[3] | 3);
+            const float x = v[0] * rangeScale;
+            const float y = v[1] * rangeScale;
+            const float z = v[2] * rangeScale;
+            const float w = sqrtf(std::max(1.0f - x * x - y * y - z * z, 0.0f));
+
+            const int32_t maxComponent = v[3] & 3;
+            v[(maxComponent + 1) & 3] = static_cast<int16_t>(static_cast<int32_t>(x * 32767.0f + (x >= 0.0f ? 0.5f : -0.5f)));
+            v[(maxComponent + 2) & 3] = static_cast<int16_t>(static_cast<int32_t>(y * 32767.0f + (y >= 0.0f ? 0.5f : -0.5f)));
+            v[(maxComponent + 3) & 3] = static_cast<int16_t>(static_cast<int32_t>(z * 32767.0f + (z >= 0.0f ? 0.5f : -0.5f)));
+            v[maxComponent] = static_cast<int16_t>(static_cast<int32_t>(w * 32767.0f + 0.5f));
+
+            memcpy(data + i * sizeof(v), v, sizeof(v));
+        }
+    }
+
+    void DecodeExponentialFilter(uint8_t* data, size_t count, size_t stride) {
+        // Every 32 bit value is a 24 bit signed mantissa with an 8 bit signed exponent
+        const size_t valueCount = count * stride / 4;
+        for (size_t i = 0; i < valueCount; ++i) {
+            uint32_t v;
+            memcpy(&v, data + i * 4, sizeof(v));
+
+            const int32_t mantissa = static_cast<int32_t>(v << 8) >> 8;
+            const int32_t exponent = static_cast<int32_t>(v) >> 24;
+            const float value = ldexpf(static_cast<float>(mantissa), exponent);
+
+            memcpy(data + i * 4, &value, sizeof(value));
+        }
+    }
+
+    bool DecodeMeshoptBufferViews(GltfDocument& document, std::string& error) {
+        std::vector<CompressedView> views;
+        std::vector<size_t> requiredSizes(document.buffers.size(), 0);
+
+        for (size_t i = 0; i < document.bufferViews.size(); ++i) {
+            const GltfDocument::BufferView& bufferView = document.bufferViews[i];
+            if (nullptr == bufferView.meshopt) {
+                continue;
+            }
+
+            CompressedView view;
+            std::string viewError;
+            if (false == ParseCompressedView(*bufferView.meshopt, view, viewError)) {
+                error = "EXT_meshopt_compression buffer view " + std::to_string(i) + ": " + viewError;
+                return false;
+            }
+
+            if (document.buffers.size() > view.sourceBuffer && 0 == document.buffers[view.sourceBuffer].size) {
+                // Deferred source buffer the scene does not read, its fallback stays empty
+                continue;
+            }
+            if (document.buffers.size() <= view.sourceBuffer || document.buffers[view.sourceBuffer].size < view.sourceOffset + view.srcSize ||
+                bufferView.byteLength < view.count * view.stride) {
+                error = "EXT_meshopt_compression buffer view " + std::to_string(i) + " is out of range";
+                return false;
+            }
+
+            view.bufferView = static_cast<int32_t>(i);
+            views.push_back(view);
+
+            size_t& requiredSize = requiredSizes[bufferView.buffer];
+            requiredSize = std::max(requiredSize, bufferView.byteOffset + bufferView.byteLength);
+        }
+
+        // Fallback buffers with data are real uncompressed copies, only the empty ones are filled by decoding
+        std::vector<uint8_t*> fallbackData(document.buffers.size(), nullptr);
+        for (size_t i = 0; i < requiredSizes.size(); ++i) {
+            if (0 < requiredSizes[i] && 0 == document.buffers[i].size) {
+                fallbackData[i] = document.AllocateBufferData(static_cast<int32_t>(i), requiredSizes[i]);
+            }
+        }
+
+        views.erase(std::remove_if(views.begin(), views.end(), [&](const CompressedView& view) {
+            return nullptr == fallbackData[document.bufferViews[view.bufferView].buffer];
+        }), views.end());
+
+        for (auto& view : views) {
+            const GltfDocument::BufferView& bufferView = document.bufferViews[view.bufferView];
+            view.src = document.buffers[view.sourceBuffer].data + view.sourceOffset;
+            view.dst = fallbackData[bufferView.buffer] + bufferView.byteOffset;
+        }
+
+        // Buffer views never overlap in their fallback buffers, every one is decoded on its own
+        std::vector<uint8_t> decoded(views.size(), 0);
+        ThreadPool::Get().ParallelFor(views.size(), [&](size_t i) {
+            decoded[i] = DecodeCompressedView(views[i]) ? 1 : 0;
+        });
+
+        for (size_t i = 0; i < views.size(); ++i) {
+            if (0 == decoded[i]) {
+                error = "EXT_meshopt_compression buffer view " + std::to_string(views[i].bufferView) + " could not be decoded";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool VerifyMeshoptFallbacks(const GltfDocument& document, size_t& verifiedCount, std::string& error) {
+        verifiedCount = 0;
+        for (size_t i = 0; i < document.bufferViews.size(); ++i) {
+            const GltfDocument::BufferView& bufferView = document.bufferViews[i];
+            if (nullptr == bufferView.meshopt) {
+                continue;
+            }
+
+            CompressedView view;
+            std::string viewError;
+            if (false == ParseCompressedView(*bufferView.meshopt, view, viewError)) {
+                error = "EXT_meshopt_compression buffer view " + std::to_string(i) + ": " + viewError;
+                return false;
+            }
+
+            // Only views with a loaded source and a fallback of their own can be compared
+            const GltfDocument::Buffer& fallback = document.buffers[bufferView.buffer];
+            if (document.buffers.size() <= view.sourceBuffer || 0 == document.buffers[view.sourceBuffer].size || 0 == fallback.size) {
+                continue;
+            }
+            const size_t decodedSize = view.count * view.stride;
+            if (document.buffers[view.sourceBuffer].size < view.sourceOffset + view.srcSize || bufferView.byteLength < decodedSize ||
+                fallback.size < bufferView.byteOffset + decodedSize) {
+                error = "EXT_meshopt_compression buffer view " + std::to_string(i) + " is out of range";
+                return false;
+            }
+
+            std::vector<uint8_t> decoded(decodedSize);
+            view.bufferView = static_cast<int32_t>(i);
+            view.src = document.buffers[view.sourceBuffer].data + view.sourceOffset;
+            view.dst = decoded.data();
+            if (false == DecodeCompressedView(view)) {
+                error = "EXT_meshopt_compression buffer view " + std::to_string(i) + " could not be decoded";
+                return false;
+            }
+
+            const uint8_t* expected = fallback.data + bufferView.byteOffset;
+            const auto mismatch = std::mismatch(decoded.begin(), decoded.end(), expected, expected + decodedSize);
+            if (decoded.end() != mismatch.first) {
+                error = "EXT_meshopt_compression buffer view " + std::to_string(i) + " differs from its fallback at byte " +
+                    std::to_string(mismatch.first - decoded.begin());
+                return false;
+            }
+            ++verifiedCount;
+        }
+        return true;
+    }
+}
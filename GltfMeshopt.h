@@ -0,0 +1,36 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#pragma once
+
+namespace Vk {
+    class GltfDocument;
+
+    /*
+        EXT_meshopt_compression bitstream decoders, every one returns false for malformed input.
+        Vertex streams hold count elements of stride bytes (mode ATTRIBUTES),
+        index streams hold count indices of indexSize bytes (mode TRIANGLES or INDICES).
+    */
+    bool DecodeVertexStream(uint8_t* dst, size_t count, size_t stride, const uint8_t* src, size_t srcSize);
+    bool DecodeTriangleStream(uint8_t* dst, size_t count, size_t indexSize, const uint8_t* src, size_t srcSize);
+    bool DecodeIndexSequence(uint8_t* dst, size_t count, size_t indexSize, const uint8_t* src, size_t srcSize);
+
+    /*
+        In place filters applied to decoded vertex streams
+    */
+    void DecodeOctahedralFilter(uint8_t* data, size_t count, size_t stride);
+    void DecodeQuaternionFilter(uint8_t* data, size_t count, size_t stride);
+    void DecodeExponentialFilter(uint8_t* data, size_t count, size_t stride);
+
+    /*
+        Decodes every EXT_meshopt_compression buffer view into its fallback buffer, one buffer view per task.
+        Fallback buffers that already hold data are left alone. Has to run before any accessor is read.
+    */
+    bool DecodeMeshoptBufferViews(GltfDocument& document, std::string& error);
+
+    /*
+        Decodes every EXT_meshopt_compression buffer view whose fallback buffer holds real uncompressed data, as
+        gltfpack -cf writes it, into scratch memory and compares it to that data. Has to run before
+        DecodeMeshoptBufferViews, verifiedCount is the number of views that were compared.
+    */
+    bool VerifyMeshoptFallbacks(const GltfDocument& document, size_t& verifiedCount, std::string& error);
+}
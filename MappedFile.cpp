@@ -0,0 +1,54 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+#include "MappedFile.h"
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+bool MappedFile::Open(const std::string& filename) {
+    Close();
+
+    _file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (INVALID_HANDLE_VALUE == _file) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize{};
+    if (FALSE == GetFileSizeEx(_file, &fileSize) || 0 == fileSize.QuadPart) {
+        Close();
+        return false;
+    }
+
+    _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (nullptr == _mapping) {
+        Close();
+        return false;
+    }
+
+    _data = static_cast<const uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (nullptr == _data) {
+        Close();
+        return false;
+    }
+
+    _size = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::Close() {
+    if (nullptr != _data) {
+        UnmapViewOfFile(_data);
+        _data = nullptr;
+    }
+    if (nullptr != _mapping) {
+        CloseHandle(_mapping);
+        _mapping = nullptr;
+    }
+    if (INVALID_HANDLE_VALUE != _file) {
+        CloseHandle(_file);
+        _file = INVALID_HANDLE_VALUE;
+    }
+    _size = 0;
+}
@@ -0,0 +1,26 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#pragma once
+
+// Read only view of a whole file mapped into memory
+class MappedFile {
+public:
+                                            MappedFile() = default;
+                                            ~MappedFile();
+
+                                            MappedFile(const MappedFile&) = delete;
+    MappedFile&                             operator=(const MappedFile&) = delete;
+
+    bool                                    Open(const std::string& filename);
+    void                                    Close();
+
+    bool                                    IsOpen() const { return nullptr != _data; }
+    const uint8_t*                          Data() const { return _data; }
+    size_t                                  Size() const { return _size; }
+
+private:
+    HANDLE                                  _file = INVALID_HANDLE_VALUE;
+    HANDLE                                  _mapping = nullptr;
+    const uint8_t*                          _data = nullptr;
+    size_t                                  _size = 0;
+};
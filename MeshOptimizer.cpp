@@ -0,0 +1,609 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+#include "MeshOptimizer.h"
+
+namespace Vk {
+    namespace {
+        // A cluster with fewer cache misses per triangle may end at a dead end, splitting it costs one cache refill
+        constexpr float CLUSTER_SPLIT_ACMR = 0.75f;
+
+        glm::vec3 GetPosition(const float* positions, size_t positionStride, uint32_t vertex) {
+            return glm::make_vec3(reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + vertex * positionStride));
+        }
+
+        // Squared distances to a set of planes, each weighted by the area of its triangle
+        struct Quadric {
+            double a2 = 0.0, b2 = 0.0, c2 = 0.0, d2 = 0.0;
+            double ab = 0.0, ac = 0.0, ad = 0.0, bc = 0.0, bd = 0.0, cd = 0.0;
+            double weight = 0.0;
+
+            void AddPlane(const glm::dvec3& normal, double d, double area) {
+                a2 += area * normal.x * normal.x;
+                b2 += area * normal.y * normal.y;
+                c2 += area * normal.z * normal.z;
+                d2 += area * d * d;
+                ab += area * normal.x * normal.y;
+                ac += area * normal.x * normal.z;
+                ad += area * normal.x * d;
+                bc += area * normal.y * normal.z;
+                bd += area * normal.y * d;
+                cd += area * normal.z * d;
+                weight += area;
+            }
+
+            void Add(const Quadric& other) {
+                a2 += other.a2;
+                b2 += other.b2;
+                c2 += other.c2;
+                d2 += other.d2;
+                ab += other.ab;
+                ac += other.ac;
+                ad += other.ad;
+                bc += other.bc;
+                bd += other.bd;
+                cd += other.cd;
+                weight += other.weight;
+            }
+
+            // Mean squared distance of p to the planes
+            double Evaluate(const glm::dvec3& p) const {
+                const double sum = a2 * p.x * p.x + b2 * p.y * p.y + c2 * p.z * p.z + d2
+                    + 2.0 * (ab * p.x * p.y + ac * p.x * p.z + ad * p.x + bc * p.y * p.z + bd * p.y + cd * p.z);
+                return weight > 0.0 ? std::max(sum, 0.0) / weight : 0.0;
+            }
+        };
+    }
+
+    VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount) {
+        VertexCacheStatistics result{};
+        result.triangleCount = static_cast<uint32_t>(indexCount / 3);
+
+        // Miss number that brought each vertex into the cache, 0 for never, the cache holds the last VERTEX_CACHE_SIZE misses
+        std::vector<uint32_t> inserted(vertexCount, 0);
+        for (size_t i = 0; i < result.triangleCount * 3; ++i) {
+            const uint32_t vertex = indices[i];
+            if (0 == inserted[vertex]) {
+                ++result.vertexCount;
+            }
+            else if (result.transformCount - inserted[vertex] < VERTEX_CACHE_SIZE) {
+                continue;
+            }
+            inserted[vertex] = ++result.transformCount;
+        }
+
+        result.acmr = result.triangleCount > 0 ? static_cast<float>(result.transformCount) / result.triangleCount : 0.0f;
+        result.atvr = result.vertexCount > 0 ? static_cast<float>(result.transformCount) / result.vertexCount : 0.0f;
+        return result;
+    }
+
+    size_t OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>* clusters) {
+        const size_t triangleCount = indexCount / 3;
+        if (nullptr != clusters) {
+            clusters->clear();
+        }
+        if (0 == triangleCount) {
+            return 0;
+        }
+
+        // Triangles around every vertex in one table, liveCounts tracks how many of them are not emitted yet
+        std::vector<uint32_t> liveCounts(vertexCount, 0);
+        for (size_t i = 0; i < triangleCount * 3; ++i) {
+            ++liveCounts[indices[i]];
+        }
+        std::vector<uint32_t> offsets(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            offsets[v + 1] = offsets[v] + liveCounts[v];
+        }
+        std::vector<uint32_t> adjacency(triangleCount * 3);
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i) {
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        // A vertex is cached while fewer than VERTEX_CACHE_SIZE misses happened since its own
+        std::vector<uint32_t> timestamps(vertexCount, 0);
+        std::vector<uint8_t> emitted(triangleCount, 0);
+        std::vector<uint32_t> deadEnds;
+        std::vector<uint32_t> candidates;
+        std::vector<uint32_t> result;
+        deadEnds.reserve(triangleCount * 3);
+        result.reserve(triangleCount * 3);
+
+        uint32_t time = VERTEX_CACHE_SIZE + 1;
+        uint32_t cursor = 0;
+        int64_t fanning = indices[0];
+        bool clusterStart = true;
+        uint32_t clusterTime = time;
+        size_t clusterTriangle = 0;
+        size_t clusterCount = 0;
+        while (fanning >= 0) {
+            const auto vertex = static_cast<uint32_t>(fanning);
+            candidates.clear();
+            for (uint32_t a = offsets[vertex]; a < offsets[vertex + 1]; ++a) {
+                const uint32_t triangle = adjacency[a];
+                if (0 != emitted[triangle]) {
+                    continue;
+                }
+                if (clusterStart) {
+                    if (nullptr != clusters) {
+                        clusters->push_back(static_cast<uint32_t>(result.size() / 3));
+                    }
+                    ++clusterCount;
+                    clusterStart = false;
+                    clusterTime = time;
+                    clusterTriangle = result.size() / 3;
+                }
+                for (size_t k = 0; k < 3; ++k) {
+                    const uint32_t corner = indices[triangle * 3 + k];
+                    result.push_back(corner);
+                    deadEnds.push_back(corner);
+                    candidates.push_back(corner);
+                    --liveCounts[corner];
+                    if (time - timestamps[corner] > VERTEX_CACHE_SIZE) {
+                        timestamps[corner] = time++;
+                    }
+                }
+                emitted[triangle] = 1;
+            }
+
+            // Next fan: the oldest candidate that stays in the cache while its remaining triangles are emitted
+            int64_t next = -1;
+            int64_t bestPriority = -1;
+            for (const uint32_t candidate : candidates) {
+                if (0 == liveCounts[candidate]) {
+                    continue;
+                }
+                int64_t priority = 0;
+                if (time - timestamps[candidate] + 2 * liveCounts[candidate] <= VERTEX_CACHE_SIZE) {
+                    priority = time - timestamps[candidate];
+                }
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    next = candidate;
+                }
+            }
+
+            if (next < 0) {
+                // Dead end, resume at the latest vertex with triangles left or else the next one in input order
+                while (false == deadEnds.empty() && next < 0) {
+                    const uint32_t deadEnd = deadEnds.back();
+                    deadEnds.pop_back();
+                    if (liveCounts[deadEnd] > 0) {
+                        next = deadEnd;
+                    }
+                }
+                const size_t triangles = result.size() / 3 - clusterTriangle;
+                const bool cold = next < 0;
+                while (next < 0 && cursor < vertexCount) {
+                    if (liveCounts[cursor] > 0) {
+                        next = cursor;
+                    }
+                    else {
+                        ++cursor;
+                    }
+                }
+                // A cold cache always ends the cluster, a warm one only when the cluster has been cache friendly so far
+                clusterStart = cold || (triangles > 0 && static_cast<float>(time - clusterTime) / triangles <= CLUSTER_SPLIT_ACMR);
+            }
+            fanning = next;
+        }
+
+        // Degenerate input keeps a trailing partial triangle where it was
+        std::copy(result.begin(), result.end(), indices);
+        return clusterCount;
+    }
+
+    void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, const std::vector<uint32_t>& clusters) {
+        const size_t triangleCount = indexCount / 3;
+        if (clusters.size() < 2) {
+            return;
+        }
+
+        struct Cluster {
+            uint32_t firstTriangle = 0;
+            uint32_t triangleCount = 0;
+            glm::vec3 centroid{ 0.0f };     // Area weighted
+            glm::vec3 normal{ 0.0f };       // Sum of triangle normals scaled by twice their area
+            float area = 0.0f;
+            float sortKey = 0.0f;
+        };
+
+        std::vector<Cluster> sorted(clusters.size());
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+        for (size_t c = 0; c < clusters.size(); ++c) {
+            Cluster& cluster = sorted[c];
+            cluster.firstTriangle = clusters[c];
+            cluster.triangleCount = static_cast<uint32_t>((c + 1 < clusters.size() ? clusters[c + 1] : triangleCount) - clusters[c]);
+            for (uint32_t t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.triangleCount; ++t) {
+                const glm::vec3 p0 = GetPosition(positions, positionStride, indices[t * 3 + 0]);
+                const glm::vec3 p1 = GetPosition(positions, positionStride, indices[t * 3 + 1]);
+                const glm::vec3 p2 = GetPosition(positions, positionStride, indices[t * 3 + 2]);
+                const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                const float area = glm::length(normal);
+                cluster.centroid += (p0 + p1 + p2) * (area / 3.0f);
+                cluster.normal += normal;
+                cluster.area += area;
+            }
+            meshCentroid += cluster.centroid;
+            meshArea += cluster.area;
+            if (cluster.area > 0.0f) {
+                cluster.centroid /= cluster.area;
+            }
+        }
+        if (meshArea > 0.0f) {
+            meshCentroid /= meshArea;
+        }
+
+        // Clusters on the outside facing outwards go first
+        for (Cluster& cluster : sorted) {
+            const float length = glm::length(cluster.normal);
+            cluster.sortKey = length > 0.0f ? glm::dot(cluster.centroid - meshCentroid, cluster.normal / length) : 0.0f;
+        }
+        std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+        std::vector<uint32_t> result;
+        result.reserve(indexCount);
+        for (const Cluster& cluster : sorted) {
+            result.insert(result.end(), indices + cluster.firstTriangle * 3, indices + (cluster.firstTriangle + cluster.triangleCount) * 3);
+        }
+        std::copy(result.begin(), result.end(), indices);
+    }
+
+    void BuildVertexFetchRemap(uint32_t* remap, uint32_t* indices, size_t indexCount, size_t vertexCount) {
+        constexpr uint32_t unused = std::numeric_limits<uint32_t>::max();
+        std::fill(remap, remap + vertexCount, unused);
+
+        uint32_t next = 0;
+        for (size_t i = 0; i < indexCount; ++i) {
+            uint32_t& target = remap[indices[i]];
+            if (unused == target) {
+                target = next++;
+            }
+            indices[i] = target;
+        }
+        for (size_t v = 0; v < vertexCount; ++v) {
+            if (unused == remap[v]) {
+                remap[v] = next++;
+            }
+        }
+    }
+
+    size_t SimplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount, size_t targetIndexCount, float* resultError) {
+        std::vector<uint32_t> result(indices, indices + indexCount / 3 * 3);
+        double maxError = 0.0;
+
+        std::vector<glm::vec3> points(vertexCount);
+        for (uint32_t v = 0; v < vertexCount; ++v) {
+            points[v] = GetPosition(positions, positionStride, v);
+        }
+
+        // Vertices at the same position are one vertex of the surface, the first of them stands for all and seams stay locked
+        std::vector<uint32_t> positionIds(vertexCount);
+        std::vector<uint8_t> locked(vertexCount, 0);
+        {
+            std::vector<uint32_t> order(vertexCount);
+            std::iota(order.begin(), order.end(), 0u);
+            const auto less = [&points](uint32_t a, uint32_t b) {
+                return std::tie(points[a].x, points[a].y, points[a].z) < std::tie(points[b].x, points[b].y, points[b].z);
+            };
+            std::sort(order.begin(), order.end(), less);
+            for (size_t first = 0; first < order.size();) {
+                size_t last = first + 1;
+                while (last < order.size() && false == less(order[first], order[last])) {
+                    ++last;
+                }
+                const uint32_t id = *std::min_element(order.begin() + first, order.begin() + last);
+                for (size_t i = first; i < last; ++i) {
+                    positionIds[order[i]] = id;
+                }
+                locked[id] = static_cast<uint8_t>(last - first > 1 ? 1 : 0);
+                first = last;
+            }
+        }
+
+        // Edges of only one triangle are open borders, moving their vertices would shrink the outline
+        {
+            std::unordered_map<uint64_t, uint32_t> edgeUses;
+            edgeUses.reserve(result.size());
+            for (size_t i = 0; i < result.size(); ++i) {
+                const uint32_t a = positionIds[result[i]];
+                const uint32_t b = positionIds[result[i % 3 == 2 ? i - 2 : i + 1]];
+                ++edgeUses[(static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b)];
+            }
+            for (const auto& [edge, uses] : edgeUses) {
+                if (1 == uses) {
+                    locked[static_cast<uint32_t>(edge >> 32)] = 1;
+                    locked[static_cast<uint32_t>(edge)] = 1;
+                }
+            }
+        }
+
+        std::vector<Quadric> quadrics(vertexCount);
+        for (size_t t = 0; t < result.size(); t += 3) {
+            const glm::dvec3 p0 = points[result[t + 0]];
+            const glm::dvec3 p1 = points[result[t + 1]];
+            const glm::dvec3 p2 = points[result[t + 2]];
+            const glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+            const double area = glm::length(normal);
+            if (area > 0.0) {
+                const glm::dvec3 unit = normal / area;
+                for (size_t k = 0; k < 3; ++k) {
+                    quadrics[positionIds[result[t + k]]].AddPlane(unit, -glm::dot(unit, p0), area * 0.5);
+                }
+            }
+        }
+
+        struct Collapse {
+            uint32_t from = 0;
+            uint32_t to = 0;
+            double error = 0.0;
+        };
+        std::vector<Collapse> collapses;
+        std::vector<uint32_t> offsets(vertexCount + 1);
+        std::vector<uint32_t> adjacency;
+        std::vector<uint32_t> remap(vertexCount);
+        std::vector<uint8_t> touched(vertexCount);
+
+        while (result.size() > targetIndexCount) {
+            // Every half edge proposes to move its first vertex onto its second, so each edge is tried both ways
+            collapses.clear();
+            for (size_t i = 0; i < result.size(); ++i) {
+                const uint32_t from = result[i];
+                const uint32_t to = result[i % 3 == 2 ? i - 2 : i + 1];
+                if (0 != locked[positionIds[from]] || positionIds[from] == positionIds[to]) {
+                    continue;
+                }
+                Quadric quadric = quadrics[positionIds[from]];
+                quadric.Add(quadrics[positionIds[to]]);
+                collapses.push_back({ from, to, quadric.Evaluate(points[to]) });
+            }
+            if (collapses.empty()) {
+                break;
+            }
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+            // Triangles around every vertex for the flip test
+            std::fill(offsets.begin(), offsets.end(), 0);
+            for (const uint32_t index : result) {
+                ++offsets[index + 1];
+            }
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+            adjacency.resize(result.size());
+            std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < result.size(); ++i) {
+                adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+
+            // The cheapest quarter decides how far this pass goes, later passes see the merged quadrics
+            const double passLimit = collapses[(collapses.size() - 1) / 4].error;
+            const size_t removable = (result.size() - targetIndexCount + 2) / 3;
+            size_t removed = 0;
+            size_t collapsed = 0;
+            std::iota(remap.begin(), remap.end(), 0u);
+            std::fill(touched.begin(), touched.end(), 0);
+            for (const Collapse& collapse : collapses) {
+                if (removed >= removable || collapse.error > passLimit) {
+                    break;
+                }
+                if (0 != touched[collapse.from] || 0 != touched[collapse.to]) {
+                    continue;
+                }
+
+                // Triangles that keep their area after the collapse must not turn by more than about 75 degrees, small
+                // turns add up over the passes and slivers have unreliable normals
+                bool flips = false;
+                size_t collapsing = 0;
+                for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1] && false == flips; ++a) {
+                    const uint32_t* triangle = &result[adjacency[a] * 3];
+                    glm::vec3 before[3];
+                    glm::vec3 after[3];
+                    bool degenerate = false;
+                    for (size_t k = 0; k < 3; ++k) {
+                        before[k] = points[triangle[k]];
+                        after[k] = triangle[k] == collapse.from ? points[collapse.to] : before[k];
+                        degenerate = degenerate || positionIds[triangle[k]] == positionIds[collapse.to];
+                    }
+                    if (degenerate) {
+                        ++collapsing;
+                        continue;
+                    }
+                    const glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                    const glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                    flips = glm::dot(normalBefore, normalAfter) <= 0.25f * glm::length(normalBefore) * glm::length(normalAfter);
+                }
+                if (flips) {
+                    continue;
+                }
+
+                for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1]; ++a) {
+                    for (size_t k = 0; k < 3; ++k) {
+                        touched[result[adjacency[a] * 3 + k]] = 1;
+                    }
+                }
+                remap[collapse.from] = collapse.to;
+                quadrics[positionIds[collapse.to]].Add(quadrics[positionIds[collapse.from]]);
+                maxError = std::max(maxError, collapse.error);
+                removed += collapsing;
+                ++collapsed;
+            }
+            if (0 == collapsed) {
+                break;
+            }
+
+            // Triangles with two corners at one position are gone
+            size_t write = 0;
+            for (size_t t = 0; t < result.size(); t += 3) {
+                const uint32_t a = remap[result[t + 0]];
+                const uint32_t b = remap[result[t + 1]];
+                const uint32_t c = remap[result[t + 2]];
+                if (positionIds[a] != positionIds[b] && positionIds[b] != positionIds[c] && positionIds[c] != positionIds[a]) {
+                    result[write++] = a;
+                    result[write++] = b;
+                    result[write++] = c;
+                }
+            }
+            result.resize(write);
+        }
+
+        if (nullptr != resultError) {
+            *resultError = static_cast<float>(std::sqrt(maxError));
+        }
+        std::copy(result.begin(), result.end(), destination);
+        return result.size();
+    }
+
+    void GenerateTangents(float* tangents, const uint32_t* indices, size_t indexCount, const float* positions, const float* normals, const float* uvs, size_t vertexStride, size_t vertexCount) {
+        // Sums of the directions of +u and +v around every vertex
+        std::vector<glm::vec3> uDirections(vertexCount, glm::vec3(0.0f));
+        std::vector<glm::vec3> vDirections(vertexCount, glm::vec3(0.0f));
+        const size_t triangleCount = (nullptr != indices ? indexCount : vertexCount) / 3;
+        for (size_t t = 0; t < triangleCount; ++t) {
+            const std::array<uint32_t, 3> corners = nullptr != indices ?
+                std::array<uint32_t, 3>{ indices[t * 3 + 0], indices[t * 3 + 1], indices[t * 3 + 2] } :
+                std::array<uint32_t, 3>{ static_cast<uint32_t>(t * 3 + 0), static_cast<uint32_t>(t * 3 + 1), static_cast<uint32_t>(t * 3 + 2) };
+            if (corners[0] >= vertexCount || corners[1] >= vertexCount || corners[2] >= vertexCount) {
+                continue;
+            }
+
+            std::array<glm::vec3, 3> p;
+            std::array<glm::vec2, 3> st;
+            for (size_t c = 0; c < 3; ++c) {
+                p[c] = GetPosition(positions, vertexStride, corners[c]);
+                st[c] = glm::make_vec2(reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(uvs) + corners[c] * vertexStride));
+            }
+            const glm::vec3 e1 = p[1] - p[0];
+            const glm::vec3 e2 = p[2] - p[0];
+            const glm::vec2 d1 = st[1] - st[0];
+            const glm::vec2 d2 = st[2] - st[0];
+            // Only the directions are used, the sign of the uv area stands in for the division by it
+            const float determinant = d1.x * d2.y - d2.x * d1.y;
+            if (0.0f == determinant) {
+                continue;
+            }
+            const float orientation = determinant < 0.0f ? -1.0f : 1.0f;
+            const glm::vec3 u = (e1 * d2.y - e2 * d1.y) * orientation;
+            const glm::vec3 v = (e2 * d1.x - e1 * d2.x) * orientation;
+            const float uLength = glm::length(u);
+            const float vLength = glm::length(v);
+            if (uLength <= 0.0f || vLength <= 0.0f) {
+                continue;
+            }
+
+            for (size_t c = 0; c < 3; ++c) {
+                const glm::vec3 a = p[(c + 1) % 3] - p[c];
+                const glm::vec3 b = p[(c + 2) % 3] - p[c];
+                const float lengths = glm::length(a) * glm::length(b);
+                const float angle = lengths > 0.0f ? std::acos(glm::clamp(glm::dot(a, b) / lengths, -1.0f, 1.0f)) : 0.0f;
+                uDirections[corners[c]] += u * (angle / uLength);
+                vDirections[corners[c]] += v * (angle / vLength);
+            }
+        }
+
+        for (uint32_t vertex = 0; vertex < vertexCount; ++vertex) {
+            const glm::vec3 normal = GetPosition(normals, vertexStride, vertex);
+            glm::vec3 tangent = uDirections[vertex] - normal * glm::dot(normal, uDirections[vertex]);
+            // Vertices of degenerate triangles only take any direction in their tangent plane
+            if (glm::dot(tangent, tangent) <= FLT_EPSILON) {
+                tangent = std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                tangent -= normal * glm::dot(normal, tangent);
+            }
+            const float sign = glm::dot(glm::cross(normal, tangent), vDirections[vertex]) > 0.0f ? -1.0f : 1.0f;
+            const glm::vec4 result(glm::normalize(tangent), sign);
+            memcpy(reinterpret_cast<uint8_t*>(tangents) + vertex * vertexStride, &result, sizeof(result));
+        }
+    }
+
+    size_t BuildMeshlets(std::vector<MeshletBounds>& meshlets, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount) {
+        const size_t firstMeshlet = meshlets.size();
+        const size_t triangleCount = indexCount / 3;
+
+        // Meshlet that last referenced each vertex, plus one
+        std::vector<uint32_t> lastMeshlet(vertexCount, 0);
+        std::vector<uint32_t> meshletVertices;
+        meshletVertices.reserve(MESHLET_MAX_VERTICES);
+
+        const auto finish = [&](size_t endTriangle) {
+            MeshletBounds& meshlet = meshlets.back();
+            meshlet.indexCount = static_cast<uint32_t>(endTriangle * 3) - meshlet.firstIndex;
+
+            glm::vec3 bbMin(FLT_MAX);
+            glm::vec3 bbMax(-FLT_MAX);
+            for (uint32_t vertex : meshletVertices) {
+                bbMin = glm::min(bbMin, GetPosition(positions, positionStride, vertex));
+                bbMax = glm::max(bbMax, GetPosition(positions, positionStride, vertex));
+            }
+            meshlet.center = (bbMin + bbMax) * 0.5f;
+            for (uint32_t vertex : meshletVertices) {
+                meshlet.radius = std::max(meshlet.radius, glm::distance(meshlet.center, GetPosition(positions, positionStride, vertex)));
+            }
+
+            // The cone is kept only while every triangle faces less than about 84 degrees away from the axis
+            std::vector<glm::vec3> normals;
+            normals.reserve(meshlet.indexCount / 3);
+            glm::vec3 axis(0.0f);
+            for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3) {
+                if (indices[i + 0] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount) {
+                    continue;
+                }
+                const glm::vec3 p0 = GetPosition(positions, positionStride, indices[i + 0]);
+                const glm::vec3 normal = glm::cross(GetPosition(positions, positionStride, indices[i + 1]) - p0, GetPosition(positions, positionStride, indices[i + 2]) - p0);
+                const float area = glm::length(normal);
+                if (area > 0.0f) {
+                    normals.push_back(normal / area);
+                    axis += normal / area;
+                }
+            }
+            const float axisLength = glm::length(axis);
+            if (normals.empty() || axisLength <= 0.0f) {
+                return;
+            }
+            meshlet.coneAxis = axis / axisLength;
+            float minDot = 1.0f;
+            for (const glm::vec3& normal : normals) {
+                minDot = std::min(minDot, glm::dot(normal, meshlet.coneAxis));
+            }
+            meshlet.coneCutoff = minDot <= 0.1f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+        };
+
+        uint32_t meshletTriangles = 0;
+        for (size_t t = 0; t < triangleCount; ++t) {
+            const uint32_t* triangle = indices + t * 3;
+            if (triangle[0] >= vertexCount || triangle[1] >= vertexCount || triangle[2] >= vertexCount) {
+                continue;
+            }
+
+            // Corners a degenerate triangle repeats count once
+            auto id = static_cast<uint32_t>(meshlets.size() - firstMeshlet);
+            size_t newVertices = 0;
+            for (size_t c = 0; c < 3; ++c) {
+                if (lastMeshlet[triangle[c]] != id && (0 == c || triangle[c] != triangle[0]) && (2 != c || triangle[2] != triangle[1])) {
+                    ++newVertices;
+                }
+            }
+            if (meshlets.size() == firstMeshlet || meshletTriangles == MESHLET_MAX_TRIANGLES || meshletVertices.size() + newVertices > MESHLET_MAX_VERTICES) {
+                if (meshlets.size() > firstMeshlet) {
+                    finish(t);
+                }
+                meshlets.emplace_back();
+                meshlets.back().firstIndex = static_cast<uint32_t>(t * 3);
+                meshletVertices.clear();
+                meshletTriangles = 0;
+                id = static_cast<uint32_t>(meshlets.size() - firstMeshlet);
+            }
+
+            for (size_t c = 0; c < 3; ++c) {
+                if (lastMeshlet[triangle[c]] != id) {
+                    lastMeshlet[triangle[c]] = id;
+                    meshletVertices.push_back(triangle[c]);
+                }
+            }
+            ++meshletTriangles;
+        }
+        if (meshlets.size() > firstMeshlet) {
+            finish(triangleCount);
+        }
+        return meshlets.size() - firstMeshlet;
+    }
+}
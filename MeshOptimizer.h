@@ -0,0 +1,98 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#pragma once
+
+namespace Vk {
+    /*
+        Import time processing of indexed triangle lists. Indices are relative to the first vertex of the mesh and
+        below vertexCount, positions are read as 3 floats every positionStride bytes.
+    */
+
+    // Post transform cache of the statistics, a FIFO as found on most GPUs
+    constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+    struct VertexCacheStatistics {
+        uint32_t triangleCount = 0;
+        uint32_t vertexCount = 0;           // Vertices referenced by the indices
+        uint32_t transformCount = 0;        // Cache misses
+        float acmr = 0.0f;                  // Average cache miss ratio, transforms per triangle, 0.5 at best
+        float atvr = 0.0f;                  // Average transform to vertex ratio, 1.0 at best
+    };
+
+    VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+    /*
+        Tipsify (Sander, Nehab, Barczak 2007): fans around the most recently used vertices that are still in the cache and
+        falls back to the last dead end when none is left. Writes the first triangle of every cluster, where the order
+        restarted from a cold cache, to clusters and returns the number of clusters.
+    */
+    size_t OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>* clusters = nullptr);
+
+    /*
+        View independent overdraw reduction: clusters whose surface faces away from the center of the mesh are drawn
+        first, as they are the ones most likely to occlude the rest. Triangle order inside a cluster is kept.
+    */
+    void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, const std::vector<uint32_t>& clusters);
+
+    /*
+        Quadric error metric simplification (Garland, Heckbert 1997). Edges are collapsed onto one of their own vertices
+        in order of the error they add, in passes that leave the neighbourhood of every collapse alone until the next
+        pass. Vertices on open borders and on attribute seams, where several vertices share a position, never move.
+        Collapses that flip or sharply turn a triangle are rejected. Writes at most indexCount indices to destination, stops once
+        targetIndexCount is reached or nothing more can be collapsed, and returns the written count. resultError receives
+        the largest root mean square distance of a collapsed vertex to the planes of its original triangles, in position units.
+    */
+    size_t SimplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount, size_t targetIndexCount, float* resultError = nullptr);
+
+    /*
+        Tangent frames after MikkTSpace: every triangle contributes the directions of +u and +v on its surface to its
+        corners, weighted by the angle at the corner. The sums are orthogonalized against the vertex normal and the
+        direction of +v is kept as the sign in w, so that cross(normal, tangent) * w is the bitangent of glTF, which has v
+        pointing down. Vertices are not split where the frames of their triangles disagree. Writes 4 floats every
+        vertexStride bytes of tangents, positions, normals and uvs are read from the same stride. Without indices every
+        3 vertices are a triangle.
+    */
+    void GenerateTangents(float* tangents, const uint32_t* indices, size_t indexCount, const float* positions, const float* normals, const float* uvs, size_t vertexStride, size_t vertexCount);
+
+    // Meshlet limits, a meshlet is culled as a whole by one thread of meshletcull.comp
+    constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+    constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+    struct MeshletBounds {
+        uint32_t firstIndex = 0;            // Relative to the indices it was built from
+        uint32_t indexCount = 0;
+        glm::vec3 center{ 0.0f };           // Bounding sphere of the referenced vertices
+        float radius = 0.0f;
+        glm::vec3 coneAxis{ 0.0f };         // Average facing of the triangles
+        float coneCutoff = 1.0f;            // Sine of the widest angle between a triangle and the axis, 1 when no view sees only back faces
+    };
+
+    /*
+        Splits the triangles into consecutive runs of at most MESHLET_MAX_VERTICES distinct vertices and
+        MESHLET_MAX_TRIANGLES triangles, so the order of OptimizeVertexCache decides how local the meshlets are.
+        Appends one entry per run to meshlets and returns the number appended. The meshlet is behind its triangles
+        for every view where dot(center - view, coneAxis) >= coneCutoff * distance(center, view) + radius.
+    */
+    size_t BuildMeshlets(std::vector<MeshletBounds>& meshlets, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount);
+
+    /*
+        Renumbers the vertices in the order the indices first reference them, which makes vertex fetch sequential.
+        Unreferenced vertices move behind the referenced ones, vertices is an array of vertexCount elements.
+    */
+    template<typename Vertex>
+    void OptimizeVertexFetch(Vertex* vertices, uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+    // Fills remap with the new position of every vertex and rewrites indices to match, OptimizeVertexFetch then moves the vertices
+    void BuildVertexFetchRemap(uint32_t* remap, uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+    template<typename Vertex>
+    void OptimizeVertexFetch(Vertex* vertices, uint32_t* indices, size_t indexCount, size_t vertexCount) {
+        std::vector<uint32_t> remap(vertexCount);
+        BuildVertexFetchRemap(remap.data(), indices, indexCount, vertexCount);
+
+        const std::vector<Vertex> source(vertices, vertices + vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            vertices[remap[v]] = source[v];
+        }
+    }
+}
@@ -0,0 +1,454 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+#include "SceneGraph.h"
+
+#include "CpuFeatures.h"
+#include "ThreadPool.h"
+
+namespace Vk {
+    namespace {
+        // Levels above this many nodes are split into chunks of this size for the thread pool
+        constexpr size_t parallelChunkNodes = 4096;
+
+        glm::mat4 ComposeLocal(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale, const glm::mat4& matrix) {
+            return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
+        }
+
+        struct TransformArrays {
+            const glm::vec3*                    translations;
+            const glm::quat*                    rotations;
+            const glm::vec3*                    scales;
+            const glm::mat4*                    matrices;
+            const uint8_t*                      hasMatrix;
+            glm::mat4*                          localMatrices;
+        };
+
+        // Translation, rotation and scale of Width nodes, one array per component
+        template<size_t Width>
+        struct TrsLanes {
+            alignas(32) float                   tx[Width], ty[Width], tz[Width];
+            alignas(32) float                   qx[Width], qy[Width], qz[Width], qw[Width];
+            alignas(32) float                   sx[Width], sy[Width], sz[Width];
+
+            void Load(const TransformArrays& arrays, const uint32_t* slots) {
+                for (size_t i = 0; i < Width; ++i) {
+                    const uint32_t slot = slots[i];
+                    tx[i] = arrays.translations[slot].x;
+                    ty[i] = arrays.translations[slot].y;
+                    tz[i] = arrays.translations[slot].z;
+                    qx[i] = arrays.rotations[slot].x;
+                    qy[i] = arrays.rotations[slot].y;
+                    qz[i] = arrays.rotations[slot].z;
+                    qw[i] = arrays.rotations[slot].w;
+                    sx[i] = arrays.scales[slot].x;
+                    sy[i] = arrays.scales[slot].y;
+                    sz[i] = arrays.scales[slot].z;
+                }
+            }
+        };
+
+        // Writes the four columns of one node, given as x y z w rows of 4 nodes each, and applies its glTF matrix
+        void StoreColumns(const TransformArrays& arrays, const uint32_t* slots, __m128 c0[4], __m128 c1[4], __m128 c2[4], __m128 c3[4]) {
+            _MM_TRANSPOSE4_PS(c0[0], c0[1], c0[2], c0[3]);
+            _MM_TRANSPOSE4_PS(c1[0], c1[1], c1[2], c1[3]);
+            _MM_TRANSPOSE4_PS(c2[0], c2[1], c2[2], c2[3]);
+            _MM_TRANSPOSE4_PS(c3[0], c3[1], c3[2], c3[3]);
+            for (size_t i = 0; i < 4; ++i) {
+                glm::mat4& m = arrays.localMatrices[slots[i]];
+                _mm_storeu_ps(&m[0][0], c0[i]);
+                _mm_storeu_ps(&m[1][0], c1[i]);
+                _mm_storeu_ps(&m[2][0], c2[i]);
+                _mm_storeu_ps(&m[3][0], c3[i]);
+                if (0 != arrays.hasMatrix[slots[i]]) {
+                    m = m * arrays.matrices[slots[i]];
+                }
+            }
+        }
+
+        /*
+            T * R * S for 4 nodes per iteration. The columns of the rotation matrix scaled by S come straight from the
+            quaternion, see glm::mat3_cast, and T is the last column.
+        */
+        size_t ComposeLocalSSE(const TransformArrays& arrays, const uint32_t* slots, size_t count) {
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 one = _mm_set1_ps(1.0f);
+
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                TrsLanes<4> lanes;
+                lanes.Load(arrays, slots + i);
+
+                const __m128 qx = _mm_load_ps(lanes.qx), qy = _mm_load_ps(lanes.qy), qz = _mm_load_ps(lanes.qz), qw = _mm_load_ps(lanes.qw);
+                const __m128 x2 = _mm_add_ps(qx, qx), y2 = _mm_add_ps(qy, qy), z2 = _mm_add_ps(qz, qz);
+                const __m128 xx = _mm_mul_ps(qx, x2), yy = _mm_mul_ps(qy, y2), zz = _mm_mul_ps(qz, z2);
+                const __m128 xy = _mm_mul_ps(qx, y2), xz = _mm_mul_ps(qx, z2), yz = _mm_mul_ps(qy, z2);
+                const __m128 wx = _mm_mul_ps(qw, x2), wy = _mm_mul_ps(qw, y2), wz = _mm_mul_ps(qw, z2);
+                const __m128 sx = _mm_load_ps(lanes.sx), sy = _mm_load_ps(lanes.sy), sz = _mm_load_ps(lanes.sz);
+
+                __m128 c0[4] = {
+                    _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx), _mm_mul_ps(_mm_add_ps(xy, wz), sx), _mm_mul_ps(_mm_sub_ps(xz, wy), sx), zero };
+                __m128 c1[4] = {
+                    _mm_mul_ps(_mm_sub_ps(xy, wz), sy), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy), _mm_mul_ps(_mm_add_ps(yz, wx), sy), zero };
+                __m128 c2[4] = {
+                    _mm_mul_ps(_mm_add_ps(xz, wy), sz), _mm_mul_ps(_mm_sub_ps(yz, wx), sz), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz), zero };
+                __m128 c3[4] = { _mm_load_ps(lanes.tx), _mm_load_ps(lanes.ty), _mm_load_ps(lanes.tz), one };
+                StoreColumns(arrays, slots + i, c0, c1, c2, c3);
+            }
+            return i;
+        }
+
+        // Same as ComposeLocalSSE with 8 nodes per iteration, the halves are stored 4 nodes at a time
+        size_t ComposeLocalAVX(const TransformArrays& arrays, const uint32_t* slots, size_t count) {
+            const __m256 one = _mm256_set1_ps(1.0f);
+
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                TrsLanes<8> lanes;
+                lanes.Load(arrays, slots + i);
+
+                const __m256 qx = _mm256_load_ps(lanes.qx), qy = _mm256_load_ps(lanes.qy), qz = _mm256_load_ps(lanes.qz), qw = _mm256_load_ps(lanes.qw);
+                const __m256 x2 = _mm256_add_ps(qx, qx), y2 = _mm256_add_ps(qy, qy), z2 = _mm256_add_ps(qz, qz);
+                const __m256 xx = _mm256_mul_ps(qx, x2), yy = _mm256_mul_ps(qy, y2), zz = _mm256_mul_ps(qz, z2);
+                const __m256 xy = _mm256_mul_ps(qx, y2), xz = _mm256_mul_ps(qx, z2), yz = _mm256_mul_ps(qy, z2);
+                const __m256 wx = _mm256_mul_ps(qw, x2), wy = _mm256_mul_ps(qw, y2), wz = _mm256_mul_ps(qw, z2);
+                const __m256 sx = _mm256_load_ps(lanes.sx), sy = _mm256_load_ps(lanes.sy), sz = _mm256_load_ps(lanes.sz);
+
+                const __m256 rows[12] = {
+                    _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx), _mm256_mul_ps(_mm256_add_ps(xy, wz), sx), _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx),
+                    _mm256_mul_ps(_mm256_sub_ps(xy, wz), sy), _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy), _mm256_mul_ps(_mm256_add_ps(yz, wx), sy),
+                    _mm256_mul_ps(_mm256_add_ps(xz, wy), sz), _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz), _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz),
+                    _mm256_load_ps(lanes.tx), _mm256_load_ps(lanes.ty), _mm256_load_ps(lanes.tz),
+                };
+
+                for (size_t half = 0; half < 2; ++half) {
+                    __m128 part[12];
+                    for (size_t row = 0; row < 12; ++row) {
+                        part[row] = 0 == half ? _mm256_castps256_ps128(rows[row]) : _mm256_extractf128_ps(rows[row], 1);
+                    }
+                    __m128 c0[4] = { part[0], part[1], part[2], _mm_setzero_ps() };
+                    __m128 c1[4] = { part[3], part[4], part[5], _mm_setzero_ps() };
+                    __m128 c2[4] = { part[6], part[7], part[8], _mm_setzero_ps() };
+                    __m128 c3[4] = { part[9], part[10], part[11], _mm_set1_ps(1.0f) };
+                    StoreColumns(arrays, slots + i + half * 4, c0, c1, c2, c3);
+                }
+            }
+            return i;
+        }
+
+        // out = a * b, each column of out is the columns of a weighted by one column of b
+        void MultiplySSE(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+            const __m128 a0 = _mm_loadu_ps(&a[0][0]);
+            const __m128 a1 = _mm_loadu_ps(&a[1][0]);
+            const __m128 a2 = _mm_loadu_ps(&a[2][0]);
+            const __m128 a3 = _mm_loadu_ps(&a[3][0]);
+            for (glm::length_t c = 0; c < 4; ++c) {
+                const __m128 column = _mm_loadu_ps(&b[c][0]);
+                __m128 result = _mm_mul_ps(a0, _mm_shuffle_ps(column, column, _MM_SHUFFLE(0, 0, 0, 0)));
+                result = _mm_add_ps(result, _mm_mul_ps(a1, _mm_shuffle_ps(column, column, _MM_SHUFFLE(1, 1, 1, 1))));
+                result = _mm_add_ps(result, _mm_mul_ps(a2, _mm_shuffle_ps(column, column, _MM_SHUFFLE(2, 2, 2, 2))));
+                result = _mm_add_ps(result, _mm_mul_ps(a3, _mm_shuffle_ps(column, column, _MM_SHUFFLE(3, 3, 3, 3))));
+                _mm_storeu_ps(&out[c][0], result);
+            }
+        }
+
+        // Two columns of out per instruction, the columns of a are repeated in both halves
+        void MultiplyAVX(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+            const __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&a[0][0]));
+            const __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&a[1][0]));
+            const __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&a[2][0]));
+            const __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&a[3][0]));
+            for (glm::length_t c = 0; c < 4; c += 2) {
+                const __m256 columns = _mm256_loadu_ps(&b[c][0]);
+                __m256 result = _mm256_mul_ps(a0, _mm256_permute_ps(columns, _MM_SHUFFLE(0, 0, 0, 0)));
+                result = _mm256_add_ps(result, _mm256_mul_ps(a1, _mm256_permute_ps(columns, _MM_SHUFFLE(1, 1, 1, 1))));
+                result = _mm256_add_ps(result, _mm256_mul_ps(a2, _mm256_permute_ps(columns, _MM_SHUFFLE(2, 2, 2, 2))));
+                result = _mm256_add_ps(result, _mm256_mul_ps(a3, _mm256_permute_ps(columns, _MM_SHUFFLE(3, 3, 3, 3))));
+                _mm256_storeu_ps(&out[c][0], result);
+            }
+        }
+    }
+
+    uint32_t NameTable::Intern(std::string_view name) {
+        const auto found = _ids.find(name);
+        if (_ids.end() != found) {
+            return found->second;
+        }
+
+        // The key has to point at the copy, the caller's text may go away
+        std::string_view stored;
+        if (false == name.empty()) {
+            const ArenaSpan<char> text = _text.AllocateArray<char>(name.size());
+            memcpy(text.data, name.data(), name.size());
+            stored = std::string_view(text.data, text.count);
+        }
+
+        const uint32_t id = static_cast<uint32_t>(_names.size());
+        _names.push_back(stored);
+        _ids.emplace(stored, id);
+        return id;
+    }
+
+    int32_t NameTable::Find(std::string_view name) const {
+        const auto found = _ids.find(name);
+        return _ids.end() != found ? static_cast<int32_t>(found->second) : -1;
+    }
+
+    void NameTable::Clear() {
+        _ids.clear();
+        _names.clear();
+        _text.Reset();
+    }
+
+    void SceneGraph::Reserve(size_t nodeCount) {
+        parents.reserve(nodeCount);
+        sourceIndices.reserve(nodeCount);
+        names.reserve(nodeCount);
+        translations.reserve(nodeCount);
+        rotations.reserve(nodeCount);
+        scales.reserve(nodeCount);
+        matrices.reserve(nodeCount);
+        localMatrices.reserve(nodeCount);
+        worldMatrices.reserve(nodeCount);
+        subtreeEnds.reserve(nodeCount);
+        _dirty.reserve(nodeCount);
+        _dirtyFlags.reserve(nodeCount);
+        _worldUpdates.reserve(nodeCount);
+        _hasMatrix.reserve(nodeCount);
+        _levelSlots.reserve(nodeCount);
+        if (_slots.size() < nodeCount) {
+            _slots.resize(nodeCount, -1);
+        }
+    }
+
+    uint32_t SceneGraph::Add(int32_t parent, uint32_t sourceIndex, std::string_view name) {
+        const uint32_t slot = Size();
+        assert(parent < static_cast<int32_t>(slot));
+
+        parents.push_back(parent);
+        sourceIndices.push_back(sourceIndex);
+        names.push_back(nameTable.Intern(name));
+        translations.emplace_back(0.0f);
+        rotations.emplace_back(1.0f, 0.0f, 0.0f, 0.0f);
+        scales.emplace_back(1.0f);
+        matrices.emplace_back(1.0f);
+        localMatrices.emplace_back(1.0f);
+        worldMatrices.emplace_back(1.0f);
+        subtreeEnds.push_back(slot + 1);
+        _dirtyFlags.push_back(0);
+        _worldUpdates.push_back(0);
+        _hasMatrix.push_back(0);
+        _structureValid = false;
+        MarkDirty(slot);
+
+        if (_slots.size() <= sourceIndex) {
+            _slots.resize(sourceIndex + 1, -1);
+        }
+        if (_slots[sourceIndex] < 0) {
+            _slots[sourceIndex] = static_cast<int32_t>(slot);
+        }
+        if (_firstSlotByName.size() <= names.back()) {
+            _firstSlotByName.resize(names.back() + 1, -1);
+        }
+        if (_firstSlotByName[names.back()] < 0) {
+            _firstSlotByName[names.back()] = static_cast<int32_t>(slot);
+        }
+        return slot;
+    }
+
+    void SceneGraph::Clear() {
+        parents.clear();
+        sourceIndices.clear();
+        names.clear();
+        translations.clear();
+        rotations.clear();
+        scales.clear();
+        matrices.clear();
+        localMatrices.clear();
+        worldMatrices.clear();
+        subtreeEnds.clear();
+        nameTable.Clear();
+        _slots.clear();
+        _firstSlotByName.clear();
+        _dirty.clear();
+        _dirtyFlags.clear();
+        _worldUpdates.clear();
+        _hasMatrix.clear();
+        _runs.clear();
+        _levelSlots.clear();
+        _levelStarts.clear();
+        _levelBatch.clear();
+        _structureValid = true;
+    }
+
+    void SceneGraph::SetMatrix(uint32_t slot, const glm::mat4& matrix) {
+        matrices[slot] = matrix;
+        _hasMatrix[slot] = glm::mat4(1.0f) != matrix ? 1 : 0;
+        MarkDirty(slot);
+    }
+
+    void SceneGraph::MarkDirty(uint32_t slot) {
+        if (0 == _dirtyFlags[slot]) {
+            _dirtyFlags[slot] = 1;
+            _dirty.push_back(slot);
+        }
+    }
+
+    uint32_t SceneGraph::UpdateWorldMatrices() {
+        // Stamps of 0 are never current
+        if (0 == ++_updateCount) {
+            std::fill(_worldUpdates.begin(), _worldUpdates.end(), 0);
+            _updateCount = 1;
+        }
+        if (_dirty.empty()) {
+            return 0;
+        }
+        if (false == _structureValid) {
+            UpdateStructure();
+        }
+
+        // Subtrees are runs of slots, so after sorting a dirty slot is either inside the previous run or starts a new one
+        std::sort(_dirty.begin(), _dirty.end());
+        _runs.clear();
+        uint32_t written = 0;
+        uint32_t end = 0;
+        for (const uint32_t first : _dirty) {
+            if (first >= end) {
+                end = subtreeEnds[first];
+                _runs.push_back(first);
+                written += end - first;
+            }
+        }
+
+        if (written < batchMinNodes) {
+            UpdateRuns();
+        }
+        else {
+            UpdateLevels();
+        }
+        _dirty.clear();
+        return written;
+    }
+
+    void SceneGraph::UpdateRuns() {
+        // The parent of a run start is outside of it and was refreshed by an earlier run or is still valid
+        for (const uint32_t first : _runs) {
+            const uint32_t end = subtreeEnds[first];
+            for (uint32_t slot = first; slot < end; ++slot) {
+                if (0 != _dirtyFlags[slot]) {
+                    localMatrices[slot] = ComputeLocalMatrix(slot);
+                    _dirtyFlags[slot] = 0;
+                }
+                const int32_t parent = parents[slot];
+                worldMatrices[slot] = parent > -1 ? worldMatrices[parent] * localMatrices[slot] : localMatrices[slot];
+                _worldUpdates[slot] = _updateCount;
+            }
+        }
+    }
+
+    void SceneGraph::UpdateLevels() {
+        // Local matrices do not depend on each other, every dirty slot is composed in one batch
+        const size_t dirtyChunks = (_dirty.size() + parallelChunkNodes - 1) / parallelChunkNodes;
+        ThreadPool::Get().ParallelFor(dirtyChunks, [this](size_t chunk) {
+            const size_t first = chunk * parallelChunkNodes;
+            ComposeLocalMatrices(_dirty.data() + first, std::min(parallelChunkNodes, _dirty.size() - first));
+        });
+        for (const uint32_t slot : _dirty) {
+            _dirtyFlags[slot] = 0;
+        }
+
+        for (const uint32_t first : _runs) {
+            std::fill(_worldUpdates.begin() + first, _worldUpdates.begin() + subtreeEnds[first], _updateCount);
+        }
+
+        // A level only reads world matrices of the level above it
+        for (size_t level = 0; level + 1 < _levelStarts.size(); ++level) {
+            _levelBatch.clear();
+            for (uint32_t i = _levelStarts[level]; i < _levelStarts[level + 1]; ++i) {
+                if (_updateCount == _worldUpdates[_levelSlots[i]]) {
+                    _levelBatch.push_back(_levelSlots[i]);
+                }
+            }
+
+            const size_t chunks = (_levelBatch.size() + parallelChunkNodes - 1) / parallelChunkNodes;
+            ThreadPool::Get().ParallelFor(chunks, [this](size_t chunk) {
+                const size_t first = chunk * parallelChunkNodes;
+                MultiplyWorldMatrices(_levelBatch.data() + first, std::min(parallelChunkNodes, _levelBatch.size() - first));
+            });
+        }
+    }
+
+    void SceneGraph::ComposeLocalMatrices(const uint32_t* slots, size_t count) {
+        const TransformArrays arrays{ translations.data(), rotations.data(), scales.data(), matrices.data(), _hasMatrix.data(), localMatrices.data() };
+
+        size_t composed = 0;
+        if (CpuFeatures::Get().avx) {
+            composed = ComposeLocalAVX(arrays, slots, count);
+        }
+        composed += ComposeLocalSSE(arrays, slots + composed, count - composed);
+        for (size_t i = composed; i < count; ++i) {
+            localMatrices[slots[i]] = ComputeLocalMatrix(slots[i]);
+        }
+    }
+
+    void SceneGraph::MultiplyWorldMatrices(const uint32_t* slots, size_t count) {
+        const bool avx = CpuFeatures::Get().avx;
+        for (size_t i = 0; i < count; ++i) {
+            const uint32_t slot = slots[i];
+            const int32_t parent = parents[slot];
+            if (parent < 0) {
+                worldMatrices[slot] = localMatrices[slot];
+            }
+            else if (avx) {
+                MultiplyAVX(worldMatrices[parent], localMatrices[slot], worldMatrices[slot]);
+            }
+            else {
+                MultiplySSE(worldMatrices[parent], localMatrices[slot], worldMatrices[slot]);
+            }
+        }
+    }
+
+    void SceneGraph::UpdateStructure() {
+        // Children come after their parent, so walking backwards finishes every subtree before its parent is reached
+        for (uint32_t slot = Size(); slot-- > 0;) {
+            subtreeEnds[slot] = std::max(subtreeEnds[slot], slot + 1);
+            const int32_t parent = parents[slot];
+            if (parent > -1) {
+                subtreeEnds[parent] = std::max(subtreeEnds[parent], subtreeEnds[slot]);
+            }
+        }
+
+        // Slots grouped by depth with a counting sort, parents are visited before their children
+        std::vector<uint32_t> depths(Size(), 0);
+        _levelStarts.assign(1, 0);
+        for (uint32_t slot = 0; slot < Size(); ++slot) {
+            depths[slot] = parents[slot] > -1 ? depths[parents[slot]] + 1 : 0;
+            if (_levelStarts.size() <= depths[slot] + 1) {
+                _levelStarts.resize(depths[slot] + 2, 0);
+            }
+            ++_levelStarts[depths[slot] + 1];
+        }
+        for (size_t level = 1; level < _levelStarts.size(); ++level) {
+            _levelStarts[level] += _levelStarts[level - 1];
+        }
+        std::vector<uint32_t> cursors(_levelStarts.begin(), _levelStarts.end() - 1);
+        _levelSlots.resize(Size());
+        for (uint32_t slot = 0; slot < Size(); ++slot) {
+            _levelSlots[cursors[depths[slot]]++] = slot;
+        }
+        _structureValid = true;
+    }
+
+    int32_t SceneGraph::SlotFromIndex(uint32_t sourceIndex) const {
+        return sourceIndex < _slots.size() ? _slots[sourceIndex] : -1;
+    }
+
+    int32_t SceneGraph::FindByName(std::string_view name) const {
+        const int32_t id = nameTable.Find(name);
+        return id > -1 ? _firstSlotByName[id] : -1;
+    }
+
+    glm::mat4 SceneGraph::ComputeLocalMatrix(uint32_t slot) const {
+        return ComposeLocal(translations[slot], rotations[slot], scales[slot], matrices[slot]);
+    }
+}
@@ -0,0 +1,103 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "Arena.h"
+
+namespace Vk {
+    // Interned strings, equal names share one id and one copy of their text
+    class NameTable {
+    public:
+        uint32_t                                Intern(std::string_view name);
+        // -1 when the name was never interned
+        int32_t                                 Find(std::string_view name) const;
+        std::string_view                        Get(uint32_t id) const { return _names[id]; }
+        void                                    Clear();
+
+    private:
+        Arena                                   _text{ 4 * 1024 };
+        std::vector<std::string_view>           _names;
+        std::unordered_map<std::string_view, uint32_t> _ids;
+    };
+
+    /*
+        Node hierarchy of a model as flat arrays indexed by slot. Slots are handed out in depth first order, so a parent
+        always comes before its children, one forward sweep visits every parent first and the subtree of a slot is the run
+        of slots up to its subtree end. Translation, rotation and scale live in arrays of their own, the glTF node index
+        of a slot and the slot of a glTF node are both one lookup away.
+
+        Local and world matrices are cached. Changing a transform through the setters marks its slot dirty, and
+        UpdateWorldMatrices refreshes only the dirty subtrees, so the cost follows the number of changed nodes. Small
+        updates walk the dirty subtrees one node at a time, large ones go level by level with SIMD kernels that compose
+        4 or 8 local matrices at once and split big levels across the thread pool.
+    */
+    struct SceneGraph {
+        std::vector<int32_t>                    parents;            // Parent slot, -1 for scene roots
+        std::vector<uint32_t>                   sourceIndices;      // glTF node index
+        std::vector<uint32_t>                   names;              // Id in nameTable
+        std::vector<glm::vec3>                  translations;
+        std::vector<glm::quat>                  rotations;
+        std::vector<glm::vec3>                  scales;
+        std::vector<glm::mat4>                  matrices;           // glTF node matrix, applied after TRS
+        std::vector<glm::mat4>                  localMatrices;
+        std::vector<glm::mat4>                  worldMatrices;
+        std::vector<uint32_t>                   subtreeEnds;        // One past the last slot below each slot
+        NameTable                               nameTable;
+        // Updates that rewrite fewer world matrices than this walk the dirty subtrees instead of the levels
+        uint32_t                                batchMinNodes = 256;
+
+        // Capacity for nodeCount glTF nodes, a glTF index can be looked up as soon as its node was added
+        void                                    Reserve(size_t nodeCount);
+        // parent has to be an earlier slot or -1, returns the new slot with an identity transform
+        uint32_t                                Add(int32_t parent, uint32_t sourceIndex, std::string_view name);
+        void                                    Clear();
+
+        void                                    SetTranslation(uint32_t slot, const glm::vec3& translation) { translations[slot] = translation; MarkDirty(slot); }
+        void                                    SetRotation(uint32_t slot, const glm::quat& rotation) { rotations[slot] = rotation; MarkDirty(slot); }
+        void                                    SetScale(uint32_t slot, const glm::vec3& scale) { scales[slot] = scale; MarkDirty(slot); }
+        void                                    SetMatrix(uint32_t slot, const glm::mat4& matrix);
+        void                                    MarkDirty(uint32_t slot);
+
+        // Recomputes the matrices of dirty slots and the world matrices below them, returns the number of world matrices written
+        uint32_t                                UpdateWorldMatrices();
+        // True when the last UpdateWorldMatrices wrote the world matrix of slot
+        bool                                    WorldChanged(uint32_t slot) const { return _updateCount == _worldUpdates[slot]; }
+
+        uint32_t                                Size() const { return static_cast<uint32_t>(parents.size()); }
+        // -1 for glTF nodes outside the loaded scene
+        int32_t                                 SlotFromIndex(uint32_t sourceIndex) const;
+        // First slot named name, -1 if there is none
+        int32_t                                 FindByName(std::string_view name) const;
+        std::string_view                        Name(uint32_t slot) const { return nameTable.Get(names[slot]); }
+        // The next slot is a child exactly when the node has children
+        bool                                    IsLeaf(uint32_t slot) const { return slot + 1 >= Size() || parents[slot + 1] != static_cast<int32_t>(slot); }
+
+        // Cached, valid after UpdateWorldMatrices
+        const glm::mat4&                        WorldMatrix(uint32_t slot) const { assert(0 == _dirtyFlags[slot]); return worldMatrices[slot]; }
+
+        // Slots ordered by depth and the first entry of each depth plus the end, valid after UpdateWorldMatrices
+        const std::vector<uint32_t>&            LevelSlots() const { assert(_structureValid); return _levelSlots; }
+        const std::vector<uint32_t>&            LevelStarts() const { assert(_structureValid); return _levelStarts; }
+
+    private:
+        glm::mat4                               ComputeLocalMatrix(uint32_t slot) const;
+        void                                    UpdateStructure();
+        void                                    UpdateRuns();
+        void                                    UpdateLevels();
+        void                                    ComposeLocalMatrices(const uint32_t* slots, size_t count);
+        void                                    MultiplyWorldMatrices(const uint32_t* slots, size_t count);
+
+        std::vector<int32_t>                    _slots;             // Slot of each glTF node index
+        std::vector<int32_t>                    _firstSlotByName;   // First slot of each name id
+        std::vector<uint32_t>                   _dirty;             // Slots marked since the last update, in marking order
+        std::vector<uint8_t>                    _dirtyFlags;
+        std::vector<uint32_t>                   _worldUpdates;      // Update that last wrote the world matrix
+        std::vector<uint8_t>                    _hasMatrix;         // matrices holds something other than identity
+        std::vector<uint32_t>                   _runs;              // First slot of each dirty subtree
+        std::vector<uint32_t>                   _levelSlots;        // Slots ordered by depth
+        std::vector<uint32_t>                   _levelStarts;       // First entry of each depth in _levelSlots, plus the end
+        std::vector<uint32_t>                   _levelBatch;        // Slots of one level whose world matrix is rewritten
+        uint32_t                                _updateCount = 0;
+        bool                                    _structureValid = true;
+    };
+}
@@ -0,0 +1,102 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+    if (0 == threadCount) {
+        const auto numCpu = std::thread::hardware_concurrency();
+        threadCount = (1 < numCpu) ? numCpu - 1 : 1;
+    }
+
+    _workers.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        _workers.emplace_back(&ThreadPool::WorkerMain, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _condition.notify_all();
+
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::Get() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& func) {
+    if (0 == count) {
+        return;
+    }
+    if (1 == count || _workers.empty()) {
+        for (size_t i = 0; i < count; ++i) {
+            func(i);
+        }
+        return;
+    }
+
+    struct State {
+        std::atomic<size_t>     next{ 0 };
+        std::atomic<size_t>     done{ 0 };
+        std::mutex              mutex;
+        std::condition_variable condition;
+    };
+    auto state = std::make_shared<State>();
+
+    // Helpers that start after every index has been taken return without touching func,
+    // so the caller only has to wait for the indices and not for the helpers themselves.
+    // This also keeps nested ParallelFor calls from worker threads deadlock free.
+    auto run = [state, count, &func]() {
+        for (size_t i = state->next++; i < count; i = state->next++) {
+            func(i);
+            if (count == ++state->done) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->condition.notify_all();
+            }
+        }
+    };
+
+    const size_t helperCount = std::min(static_cast<size_t>(_workers.size()), count - 1);
+    for (size_t i = 0; i < helperCount; ++i) {
+        Push(run);
+    }
+
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->condition.wait(lock, [&state, count]() { return count == state->done; });
+}
+
+void ThreadPool::Push(Task&& task) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.emplace(std::move(task));
+    }
+    _condition.notify_one();
+}
+
+void ThreadPool::WorkerMain() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this]() { return _stop || false == _tasks.empty(); });
+            if (_stop && _tasks.empty()) {
+                return;
+            }
+
+            task = std::move(_tasks.front());
+            _tasks.pop();
+        }
+
+        task();
+    }
+}
@@ -0,0 +1,46 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#pragma once
+
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    // threadCount 0 starts one worker per hardware thread, minus the thread that owns the pool
+    explicit                                ThreadPool(uint32_t threadCount = 0);
+                                            ~ThreadPool();
+
+                                            ThreadPool(const ThreadPool&) = delete;
+    ThreadPool&                             operator=(const ThreadPool&) = delete;
+
+    // Shared pool used by the asset loaders
+    static ThreadPool&                      Get();
+
+    uint32_t                                ThreadCount() const { return static_cast<uint32_t>(_workers.size()); }
+
+    template<typename Func>
+    auto                                    Enqueue(Func&& func) -> std::future<decltype(func())>;
+
+    // Runs func(index) for every index in [0, count); the calling thread takes part and returns when all indices are done
+    void                                    ParallelFor(size_t count, const std::function<void(size_t)>& func);
+
+private:
+    void                                    Push(Task&& task);
+    void                                    WorkerMain();
+
+    std::vector<std::thread>                _workers;
+    std::queue<Task>                        _tasks;
+    std::mutex                              _mutex;
+    std::condition_variable                 _condition;
+    bool                                    _stop = false;
+};
+
+template<typename Func>
+auto ThreadPool::Enqueue(Func&& func) -> std::future<decltype(func())> {
+    using Result = decltype(func());
+
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Func>(func));
+    std::future<Result> result = task->get_future();
+    Push([task]() { (*task)(); });
+    return result;
+}
@@ -0,0 +1,201 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#pragma once
+
+#include <glm/gtc/packing.hpp>
+
+namespace Vk {
+    /*
+        Vertex layouts declared once as a list of attributes. A layout names the struct a vertex is stored in and, for
+        every attribute, the loader data it holds, its shader location, its Vulkan format and its offset in the struct.
+        The pipeline input state and the packer that converts loader vertices are both generated from that list, so
+        they cannot disagree. The shaders still declare their inputs by location.
+    */
+
+    // Loader data an attribute is packed from, members of Model::Vertex
+    enum class VertexSemantic : uint32_t {
+        Position,
+        Normal,
+        UV0,
+        UV1,
+        Joints,
+        Weights,
+        Tangent,
+    };
+
+    // Cube that quantized positions are stored relative to, see Primitive::positionOffset
+    struct VertexPackContext {
+        glm::vec3 positionOffset{ 0.0f };
+        float positionScale = 1.0f;
+    };
+
+    constexpr uint32_t VertexFormatSize(VkFormat format) {
+        switch (format) {
+        case VK_FORMAT_R8G8B8A8_UINT:
+        case VK_FORMAT_R8G8B8A8_SNORM:
+        case VK_FORMAT_R16G16_SNORM:
+        case VK_FORMAT_R16G16_SFLOAT:
+            return 4;
+        case VK_FORMAT_R16G16B16A16_UNORM:
+        case VK_FORMAT_R32G32_SFLOAT:
+            return 8;
+        case VK_FORMAT_R32G32B32_SFLOAT:
+            return 12;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            return 16;
+        default:
+            return 0;
+        }
+    }
+
+    // Octahedral mapping of a unit vector onto [-1, 1]^2, the lower hemisphere is folded over the diagonals
+    inline glm::vec2 EncodeOctahedral(const glm::vec3& normal) {
+        const float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        if (length <= 0.0f) {
+            return glm::vec2(0.0f);
+        }
+        glm::vec2 result = glm::vec2(normal) / length;
+        if (normal.z < 0.0f) {
+            const glm::vec2 sign(result.x >= 0.0f ? 1.0f : -1.0f, result.y >= 0.0f ? 1.0f : -1.0f);
+            result = (1.0f - glm::abs(glm::vec2(result.y, result.x))) * sign;
+        }
+        return result;
+    }
+
+    template<VertexSemantic Semantic, typename Source>
+    const auto& VertexSemanticOf(const Source& source) {
+        if constexpr (VertexSemantic::Position == Semantic) {
+            return source.pos;
+        }
+        else if constexpr (VertexSemantic::Normal == Semantic) {
+            return source.normal;
+        }
+        else if constexpr (VertexSemantic::UV0 == Semantic) {
+            return source.uv0;
+        }
+        else if constexpr (VertexSemantic::UV1 == Semantic) {
+            return source.uv1;
+        }
+        else if constexpr (VertexSemantic::Joints == Semantic) {
+            return source.joint0;
+        }
+        else if constexpr (VertexSemantic::Weights == Semantic) {
+            return source.weight0;
+        }
+        else {
+            return source.tangent;
+        }
+    }
+
+    template<VertexSemantic Semantic, VkFormat Format>
+    constexpr bool IsEncodable() {
+        switch (Format) {
+        case VK_FORMAT_R32G32B32_SFLOAT:
+            return VertexSemantic::Position == Semantic || VertexSemantic::Normal == Semantic;
+        case VK_FORMAT_R32G32_SFLOAT:
+        case VK_FORMAT_R16G16_SFLOAT:
+            return VertexSemantic::UV0 == Semantic || VertexSemantic::UV1 == Semantic;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            return VertexSemantic::Joints == Semantic || VertexSemantic::Weights == Semantic || VertexSemantic::Tangent == Semantic;
+        case VK_FORMAT_R16G16_SNORM:
+            return VertexSemantic::Normal == Semantic;
+        case VK_FORMAT_R16G16B16A16_UNORM:
+            return VertexSemantic::Position == Semantic || VertexSemantic::Weights == Semantic;
+        case VK_FORMAT_R8G8B8A8_UINT:
+            return VertexSemantic::Joints == Semantic;
+        case VK_FORMAT_R8G8B8A8_SNORM:
+            return VertexSemantic::Tangent == Semantic;
+        default:
+            return false;
+        }
+    }
+
+    /*
+        Float formats copy the loader data. R16G16_SNORM normals are octahedral, R16G16B16A16_UNORM positions are
+        relative to the cube of the context, R16G16B16A16_UNORM weights are renormalized, R8G8B8A8_UINT joints
+        are clamped to 8 bits and R8G8B8A8_SNORM tangents keep their sign in w. Writes VertexFormatSize(Format) bytes
+        to destination
+    */
+    template<VertexSemantic Semantic, VkFormat Format, typename Source>
+    void EncodeVertexAttribute(const Source& source, [[maybe_unused]] const VertexPackContext& context, uint8_t* destination) {
+        static_assert(IsEncodable<Semantic, Format>(), "No encoding of this semantic to this format");
+
+        const auto& value = VertexSemanticOf<Semantic>(source);
+        if constexpr (VK_FORMAT_R32G32B32_SFLOAT == Format || VK_FORMAT_R32G32_SFLOAT == Format || VK_FORMAT_R32G32B32A32_SFLOAT == Format) {
+            static_assert(sizeof(value) == VertexFormatSize(Format), "Loader data and format differ in size");
+            memcpy(destination, &value, sizeof(value));
+        }
+        else if constexpr (VK_FORMAT_R16G16_SFLOAT == Format) {
+            const uint32_t packed = glm::packHalf2x16(value);
+            memcpy(destination, &packed, sizeof(packed));
+        }
+        else if constexpr (VK_FORMAT_R16G16_SNORM == Format) {
+            const glm::vec2 encoded = glm::round(glm::clamp(EncodeOctahedral(value), -1.0f, 1.0f) * 32767.0f);
+            const int16_t packed[2] = { static_cast<int16_t>(encoded.x), static_cast<int16_t>(encoded.y) };
+            memcpy(destination, packed, sizeof(packed));
+        }
+        else if constexpr (VK_FORMAT_R16G16B16A16_UNORM == Format && VertexSemantic::Position == Semantic) {
+            const glm::vec3 position = glm::round(glm::clamp((value - context.positionOffset) / context.positionScale, 0.0f, 1.0f) * 65535.0f);
+            const uint16_t packed[4] = { static_cast<uint16_t>(position.x), static_cast<uint16_t>(position.y), static_cast<uint16_t>(position.z), 0 };
+            memcpy(destination, packed, sizeof(packed));
+        }
+        else if constexpr (VK_FORMAT_R16G16B16A16_UNORM == Format) {
+            const float weightSum = value.x + value.y + value.z + value.w;
+            const glm::vec4 weights = glm::round(glm::clamp(weightSum > 0.0f ? value / weightSum : value, 0.0f, 1.0f) * 65535.0f);
+            const uint16_t packed[4] = { static_cast<uint16_t>(weights.x), static_cast<uint16_t>(weights.y), static_cast<uint16_t>(weights.z), static_cast<uint16_t>(weights.w) };
+            memcpy(destination, packed, sizeof(packed));
+        }
+        else if constexpr (VK_FORMAT_R8G8B8A8_SNORM == Format) {
+            const glm::vec4 tangent = glm::round(glm::clamp(value, -1.0f, 1.0f) * 127.0f);
+            const int8_t packed[4] = { static_cast<int8_t>(tangent.x), static_cast<int8_t>(tangent.y), static_cast<int8_t>(tangent.z), static_cast<int8_t>(tangent.w) };
+            memcpy(destination, packed, sizeof(packed));
+        }
+        else {
+            const glm::vec4 joints = glm::clamp(value, 0.0f, 255.0f);
+            const uint8_t packed[4] = { static_cast<uint8_t>(joints.x), static_cast<uint8_t>(joints.y), static_cast<uint8_t>(joints.z), static_cast<uint8_t>(joints.w) };
+            memcpy(destination, packed, sizeof(packed));
+        }
+    }
+
+    template<VertexSemantic Semantic, uint32_t Location, VkFormat Format, size_t Offset>
+    struct VertexAttribute {
+        static constexpr VertexSemantic semantic = Semantic;
+        static constexpr uint32_t location = Location;
+        static constexpr VkFormat format = Format;
+        static constexpr uint32_t offset = static_cast<uint32_t>(Offset);
+        static constexpr uint32_t size = VertexFormatSize(Format);
+
+        static constexpr VkVertexInputAttributeDescription Describe(uint32_t binding) {
+            return { Location, binding, Format, offset };
+        }
+
+        template<typename Source>
+        static void Pack(const Source& source, const VertexPackContext& context, uint8_t* vertex) {
+            EncodeVertexAttribute<Semantic, Format>(source, context, vertex + offset);
+        }
+    };
+
+    template<typename VertexType, typename... Attributes>
+    struct VertexLayout {
+        using Vertex = VertexType;
+        static constexpr uint32_t stride = sizeof(Vertex);
+        static constexpr uint32_t attributeCount = sizeof...(Attributes);
+
+        static_assert(std::is_trivially_copyable_v<Vertex>, "Vertices are uploaded as bytes");
+        static_assert(((0 != Attributes::size && Attributes::offset + Attributes::size <= stride) && ...), "Attribute outside of the vertex");
+
+        static constexpr VkVertexInputBindingDescription Binding(uint32_t binding) {
+            return { binding, stride, VK_VERTEX_INPUT_RATE_VERTEX };
+        }
+
+        static constexpr std::array<VkVertexInputAttributeDescription, attributeCount> Describe(uint32_t binding) {
+            return { Attributes::Describe(binding)... };
+        }
+
+        // Writes every attribute of source to the stride bytes at vertex
+        template<typename Source>
+        static void Pack(const Source& source, const VertexPackContext& context, uint8_t* vertex) {
+            (Attributes::Pack(source, context, vertex), ...);
+        }
+    };
+}
@@ -337,16 +337,17 @@ namespace Vk {
         dynamicStateCI.pDynamicStates = dynamicStateEnables.data();
         dynamicStateCI.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnables.size());
 
-        // Vertex input state
-        VkVertexInputBindingDescription vertexInputBinding = { 0, sizeof(Model::Vertex), VK_VERTEX_INPUT_RATE_VERTEX };
-        VkVertexInputAttributeDescription vertexInputAttribute = { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 };
+        // Vertex input state, only the positions of the float vertices of the cube
+        using CubeLayout = VertexLayout<Model::Vertex, VertexAttribute<VertexSemantic::Position, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Model::Vertex, pos)>>;
+        constexpr VkVertexInputBindingDescription vertexInputBinding = CubeLayout::Binding(0);
+        constexpr auto vertexInputAttributes = CubeLayout::Describe(0);
 
         VkPipelineVertexInputStateCreateInfo vertexInputStateCI{};
         vertexInputStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
         vertexInputStateCI.vertexBindingDescriptionCount = 1;
         vertexInputStateCI.pVertexBindingDescriptions = &vertexInputBinding;
-        vertexInputStateCI.vertexAttributeDescriptionCount = 1;
-        vertexInputStateCI.pVertexAttributeDescriptions = &vertexInputAttribute;
+        vertexInputStateCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributes.size());
+        vertexInputStateCI.pVertexAttributeDescriptions = vertexInputAttributes.data();
 
         const auto shaderName = (CubeMapTarget::IRRADIANCE == target) ? "irradiancecube.frag.spv" : "prefilterenvmap.frag.spv";
         const std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{
@@ -68,9 +68,10 @@ namespace Vk {
     }
 
     void Main::RecreateSwapChain() {
-        vkDeviceWaitIdle(_logicalDevice);
+        _device->WaitIdle();
 
         _swapChain->Create(&_settings.width, &_settings.height, _settings.vsync);
+        _imageFences.assign(_swapChain->imageCount, VK_NULL_HANDLE);
 
         _frameBufs.Release(_logicalDevice);
         _frameBufs.Initialize(*_device, *_swapChain, _depthFormat, _renderPass.Get(), _settings);
@@ -80,7 +81,18 @@ namespace Vk {
         CheckResult(vkWaitForFences(_logicalDevice, 1, &_waitFences[frameIndex], VK_TRUE, UINT64_MAX));
         CheckResult(vkResetFences(_logicalDevice, 1, &_waitFences[frameIndex]));
 
-        return _swapChain->AcquireNextImage(_presentCompleteSemaphores[frameIndex], &currentBuffer);
+        const VkResult result = _swapChain->AcquireNextImage(_presentCompleteSemaphores[frameIndex], &currentBuffer);
+
+        // The image may still be rendered by an older frame slot, once that is done its command buffer can be recorded again
+        if (currentBuffer < _imageFences.size()) {
+            VkFence& imageFence = _imageFences[currentBuffer];
+            if (VK_NULL_HANDLE != imageFence && _waitFences[frameIndex] != imageFence) {
+                CheckResult(vkWaitForFences(_logicalDevice, 1, &imageFence, VK_TRUE, UINT64_MAX));
+            }
+            imageFence = _waitFences[frameIndex];
+        }
+
+        return result;
     }
 
     VkResult Main::QueuePresent(uint32_t currentBuffer, uint32_t frameIndex) {
@@ -95,6 +107,8 @@ namespace Vk {
         submitInfo.signalSemaphoreCount = 1;
         submitInfo.pCommandBuffers = &_cmdBufs.GetPtr()[currentBuffer];
         submitInfo.commandBufferCount = 1;
+
+        std::lock_guard<std::mutex> lock(_device->queueMutex);
         CheckResult(vkQueueSubmit(_gpuQueue, 1, &submitInfo, _waitFences[frameIndex]));
 
         return _swapChain->QueuePresent(_gpuQueue, currentBuffer, _renderCompleteSemaphores[frameIndex]);
@@ -130,6 +144,10 @@ namespace Vk {
         VkPhysicalDeviceFeatures enabledFeatures{};
         if (VK_TRUE == _physDevice.GetFeatures().samplerAnisotropy)
             enabledFeatures.samplerAnisotropy = VK_TRUE;
+        if (VK_TRUE == _physDevice.GetFeatures().drawIndirectFirstInstance)
+            enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+        if (VK_TRUE == _physDevice.GetFeatures().multiDrawIndirect)
+            enabledFeatures.multiDrawIndirect = VK_TRUE;
 
         const std::vector<const char*> enabledExtensions{};
         VkResult res = _device->CreateLogicalDevice(enabledFeatures, enabledExtensions);
@@ -169,6 +187,8 @@ namespace Vk {
     }
 
     void Main::CreateFences() {
+        _imageFences.assign(_swapChain->imageCount, VK_NULL_HANDLE);
+
         _waitFences.resize(_settings.renderAhead);
         for (auto &waitFence : _waitFences) {
             VkFenceCreateInfo fenceCI{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, nullptr, VK_FENCE_CREATE_SIGNALED_BIT };
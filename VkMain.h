@@ -22,6 +22,18 @@ namespace Vk {
         uint32_t width = 300;
         uint32_t height = 300;
         uint32_t renderAhead = 2;
+        bool gpuNodeTransforms = false;     // World and joint matrices from a compute pass instead of per mesh uniform buffers
+        bool staticBatching = false;        // Merge static primitives per material when a model is imported
+        bool optimizeMeshes = true;         // Reorder triangles and vertices of imported meshes for the vertex cache
+        bool generateLods = true;           // Simplified index ranges for the meshes of imported models
+        bool lodSelection = true;           // Draw the coarsest level whose error stays below lodPixelError pixels
+        float lodPixelError = 1.0f;
+        bool packedVertices = false;        // Octahedral normals, half float UVs and a separate skin stream, needs the *_packed shaders
+        bool quantizedPositions = false;    // 16 bit positions relative to the bounds of each primitive, implies packedVertices
+        bool splitVertexStreams = false;    // Positions in a vertex buffer of their own
+        bool depthPrepass = false;          // Depth of static opaque meshes ahead of shading, needs the depth shaders
+        bool vertexTangents = false;        // Normal maps use tangents read or generated at import instead of screen space derivatives, needs pbr_khr_tangents.frag
+        bool meshletCulling = false;        // Frustum and normal cone culling of meshlets in a compute pass, needs lodSelection and meshletcull.comp
     };
 
     using VkFences = std::vector<VkFence>;
@@ -88,6 +100,7 @@ namespace Vk {
         FrameBuffer             _frameBufs;
 
         VkFences                _waitFences;
+        VkFences                _imageFences;   // Fence of the last submission that rendered to each swap chain image
         VkSemaphores            _renderCompleteSemaphores;
         VkSemaphores            _presentCompleteSemaphores;
     };
@@ -0,0 +1,228 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+#include "VkMeshletCulling.h"
+
+#include "VkUtils.h"
+#include "VkMain.h"
+#include "VulkanDevice.h"
+#include "VulkanModel.h"
+#include "VulkanSwapChain.h"
+
+namespace Vk {
+    namespace {
+        // Has to match local_size_x of meshletcull.comp
+        constexpr uint32_t groupSize = 64;
+
+        // Bindings of meshletcull.comp, all storage buffers but the scene uniforms
+        constexpr uint32_t storageBindingCount = 6;
+        constexpr uint32_t sceneBinding = 6;
+
+        struct DispatchConstantData {
+            uint32_t count = 0;
+        };
+
+        static_assert(32 == sizeof(Meshlet), "Update the Meshlet struct of meshletcull.comp");
+        static_assert(20 == sizeof(VkDrawIndexedIndirectCommand), "meshletcull.comp reads and writes tightly packed draws");
+
+        void DestroyBuffer(Buffer& buffer) {
+            if (VK_NULL_HANDLE != buffer.buffer) {
+                buffer.Destroy();
+            }
+        }
+    }
+
+    bool MeshletCulling::Initialize(const Main& main) {
+        const auto device = main.GetDevice();
+
+        // A primitive draws all of its meshlets with one vkCmdDrawIndexedIndirect
+        if (VK_TRUE != main.GetVulkanDevice().enabledFeatures.multiDrawIndirect) {
+            return false;
+        }
+
+        if (false == ShaderExists("meshletcull.comp.spv")) {
+            return false;
+        }
+
+        VkPipelineShaderStageCreateInfo shaderStage = LoadShader(device, "meshletcull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+        if (VK_NULL_HANDLE == shaderStage.module) {
+            return false;
+        }
+
+        CreateDescriptorLayout(device);
+
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.size = sizeof(DispatchConstantData);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutCI{};
+        pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutCI.setLayoutCount = 1;
+        pipelineLayoutCI.pSetLayouts = &_descLayout;
+        pipelineLayoutCI.pushConstantRangeCount = 1;
+        pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+        CheckResult(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &_pipelineLayout));
+
+        VkComputePipelineCreateInfo pipelineCI{};
+        pipelineCI.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineCI.layout = _pipelineLayout;
+        pipelineCI.stage = shaderStage;
+        CheckResult(vkCreateComputePipelines(device, main.GetPipelineCache(), 1, &pipelineCI, nullptr, &_pipeline));
+
+        vkDestroyShaderModule(device, shaderStage.module, nullptr);
+
+        CreateDescriptorSets(main);
+        return true;
+    }
+
+    void MeshletCulling::Release(VkDevice device) {
+        for (auto& frame : _frames) {
+            DestroyBuffer(frame.draws);
+            DestroyBuffer(frame.counts);
+        }
+        _frames.clear();
+
+        vkDestroyPipeline(device, _pipeline, nullptr);
+        vkDestroyPipelineLayout(device, _pipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, _descLayout, nullptr);
+        vkDestroyDescriptorPool(device, _descriptorPool, nullptr);
+
+        _pipeline = VK_NULL_HANDLE;
+        _pipelineLayout = VK_NULL_HANDLE;
+        _descLayout = VK_NULL_HANDLE;
+        _descriptorPool = VK_NULL_HANDLE;
+    }
+
+    void MeshletCulling::CreateDescriptorLayout(VkDevice device) {
+        const std::vector<VkDescriptorSetLayoutBinding> bindings = {
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { sceneBinding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        };
+
+        VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI{};
+        descriptorSetLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        descriptorSetLayoutCI.pBindings = bindings.data();
+        descriptorSetLayoutCI.bindingCount = static_cast<uint32_t>(bindings.size());
+        CheckResult(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &_descLayout));
+    }
+
+    void MeshletCulling::CreateDescriptorSets(const Main& main) {
+        const auto device = main.GetDevice();
+        const auto imageCount = main.GetVulkanSwapChain().imageCount;
+
+        const std::vector<VkDescriptorPoolSize> poolSizes = {
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, storageBindingCount * imageCount },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, imageCount }
+        };
+
+        VkDescriptorPoolCreateInfo descriptorPoolCI{};
+        descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        descriptorPoolCI.pPoolSizes = poolSizes.data();
+        descriptorPoolCI.maxSets = imageCount;
+        CheckResult(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &_descriptorPool));
+
+        _frames.resize(imageCount);
+        for (auto& frame : _frames) {
+            VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
+            descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            descriptorSetAllocInfo.descriptorPool = _descriptorPool;
+            descriptorSetAllocInfo.pSetLayouts = &_descLayout;
+            descriptorSetAllocInfo.descriptorSetCount = 1;
+            CheckResult(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &frame.descSet));
+        }
+    }
+
+    void MeshletCulling::Reserve(const Main& main, Frame& frame, uint32_t meshletCount, uint32_t drawCount) {
+        auto* vulkanDevice = &main.GetVulkanDevice();
+        const auto clearedUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+        if (meshletCount > frame.meshletCapacity) {
+            DestroyBuffer(frame.draws);
+
+            frame.meshletCapacity = std::max(meshletCount, frame.meshletCapacity + frame.meshletCapacity / 2);
+            frame.draws.Create(vulkanDevice, clearedUsage | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                frame.meshletCapacity * sizeof(VkDrawIndexedIndirectCommand), false);
+        }
+
+        if (drawCount > frame.drawCapacity) {
+            DestroyBuffer(frame.counts);
+
+            frame.drawCapacity = std::max(drawCount, frame.drawCapacity + frame.drawCapacity / 2);
+            frame.counts.Create(vulkanDevice, clearedUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.drawCapacity * sizeof(uint32_t), false);
+        }
+    }
+
+    void MeshletCulling::Prepare(const Main& main, uint32_t index, const Model& model, const Buffer& levelDraws, const Buffer& sceneUniforms) {
+        Frame& frame = _frames[index];
+        frame.meshletCount = model.meshlets.count;
+        frame.drawCount = model.drawCount;
+        if (0 == frame.meshletCount) {
+            return;
+        }
+        Reserve(main, frame, frame.meshletCount, frame.drawCount);
+
+        // The model buffers change whenever a load replaces the model
+        const std::array<VkDescriptorBufferInfo, storageBindingCount> storageBuffers = {
+            VkDescriptorBufferInfo{ model.meshlets.buffer, 0, VK_WHOLE_SIZE },
+            levelDraws.descriptor,
+            VkDescriptorBufferInfo{ model.instances.buffer, 0, VK_WHOLE_SIZE },
+            VkDescriptorBufferInfo{ model.instanceTransforms.buffer, 0, VK_WHOLE_SIZE },
+            frame.draws.descriptor,
+            frame.counts.descriptor
+        };
+
+        std::array<VkWriteDescriptorSet, storageBindingCount + 1> writeDescriptorSets{};
+        for (uint32_t i = 0; i < storageBindingCount; ++i) {
+            writeDescriptorSets[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSets[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writeDescriptorSets[i].descriptorCount = 1;
+            writeDescriptorSets[i].dstSet = frame.descSet;
+            writeDescriptorSets[i].dstBinding = i;
+            writeDescriptorSets[i].pBufferInfo = &storageBuffers[i];
+        }
+
+        writeDescriptorSets[sceneBinding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSets[sceneBinding].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        writeDescriptorSets[sceneBinding].descriptorCount = 1;
+        writeDescriptorSets[sceneBinding].dstSet = frame.descSet;
+        writeDescriptorSets[sceneBinding].dstBinding = sceneBinding;
+        writeDescriptorSets[sceneBinding].pBufferInfo = &sceneUniforms.descriptor;
+
+        vkUpdateDescriptorSets(main.GetDevice(), static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+    }
+
+    void MeshletCulling::Record(uint32_t index, VkCommandBuffer cmdBuf) const {
+        const Frame& frame = _frames[index];
+        if (0 == frame.meshletCount) {
+            return;
+        }
+
+        // Draws behind the survivors of a primitive stay empty
+        vkCmdFillBuffer(cmdBuf, frame.draws.buffer, 0, frame.meshletCount * sizeof(VkDrawIndexedIndirectCommand), 0);
+        vkCmdFillBuffer(cmdBuf, frame.counts.buffer, 0, frame.drawCount * sizeof(uint32_t), 0);
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+        vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &frame.descSet, 0, nullptr);
+
+        DispatchConstantData dispatch{};
+        dispatch.count = frame.meshletCount;
+        vkCmdPushConstants(cmdBuf, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DispatchConstantData), &dispatch);
+        vkCmdDispatch(cmdBuf, (dispatch.count + groupSize - 1) / groupSize, 1, 1);
+
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+}
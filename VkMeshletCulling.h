@@ -0,0 +1,56 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "VkBuffer.h"
+
+namespace Vk {
+    class Main;
+    struct Model;
+
+    /*
+        Culls the meshlets of a model against the view frustum and their normal cones in a compute pass. Every
+        primitive with meshlets owns one indirect draw per meshlet, starting at Mesh::firstMeshletDraw. The pass
+        zeroes them and writes the surviving meshlets of a primitive to the front of its draws, so one multi draw
+        of all of them only rasterizes the survivors. A primitive whose selected level is not the full resolution
+        range gets that level as its first draw instead, see Model::SelectLods.
+
+        World matrices come from the instance buffer, which is only written on the CPU path of the node transforms.
+        Every swap chain image owns its buffers, which are sized and pointed at the model while the command buffer
+        of that image is recorded.
+    */
+    class MeshletCulling {
+    public:
+        // False when the compute shader is missing or the device cannot draw several indirect commands at once
+        bool                            Initialize(const Main& main);
+        void                            Release(VkDevice device);
+
+        // levelDraws holds the commands of Model::SelectLods, sceneUniforms the UniformData of the scene for this image
+        void                            Prepare(const Main& main, uint32_t index, const Model& model, const Buffer& levelDraws, const Buffer& sceneUniforms);
+        // Clears the draws and dispatches ahead of the render pass, the draws are made visible to the indirect draw stage
+        void                            Record(uint32_t index, VkCommandBuffer cmdBuf) const;
+        VkBuffer                        GetDrawBuffer(uint32_t index) const { return _frames[index].draws.buffer; }
+
+    private:
+        struct Frame {
+            Buffer                      draws;              // One VkDrawIndexedIndirectCommand per meshlet
+            Buffer                      counts;             // Surviving meshlets of every level draw
+            VkDescriptorSet             descSet = VK_NULL_HANDLE;
+            uint32_t                    meshletCount = 0;
+            uint32_t                    drawCount = 0;
+            uint32_t                    meshletCapacity = 0;
+            uint32_t                    drawCapacity = 0;
+        };
+
+        void                            CreateDescriptorLayout(VkDevice device);
+        void                            CreateDescriptorSets(const Main& main);
+        void                            Reserve(const Main& main, Frame& frame, uint32_t meshletCount, uint32_t drawCount);
+
+        std::vector<Frame>              _frames;
+
+        VkDescriptorPool                _descriptorPool = VK_NULL_HANDLE;
+        VkDescriptorSetLayout           _descLayout = VK_NULL_HANDLE;
+        VkPipelineLayout                _pipelineLayout = VK_NULL_HANDLE;
+        VkPipeline                      _pipeline = VK_NULL_HANDLE;
+    };
+}
@@ -0,0 +1,358 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+#include "VkNodeTransforms.h"
+
+#include "VkUtils.h"
+#include "VkMain.h"
+#include "VulkanDevice.h"
+#include "VulkanModel.h"
+#include "VulkanSwapChain.h"
+
+namespace Vk {
+    namespace {
+        // Has to match local_size_x of nodetransforms.comp
+        constexpr uint32_t groupSize = 64;
+
+        // std430 layouts of nodetransforms.comp
+        struct GpuTransform {
+            glm::vec4 translation;
+            glm::vec4 rotation;     // x, y, z, w
+            glm::vec4 scale;
+        };
+
+        struct GpuNode {
+            glm::mat4 matrix;
+            int32_t parent;
+            uint32_t levelSlot;     // Slot at this position of the level order
+            uint32_t padding[2];
+        };
+
+        struct GpuJoint {
+            glm::mat4 inverseBind;
+            uint32_t slot;
+            uint32_t padding[3];
+        };
+
+        enum class NodePass : uint32_t {
+            World = 0,
+            Joints = 1
+        };
+
+        struct DispatchConstantData {
+            uint32_t first = 0;
+            uint32_t count = 0;
+            NodePass pass = NodePass::World;
+        };
+
+        void DestroyBuffer(Buffer& buffer) {
+            if (VK_NULL_HANDLE != buffer.buffer) {
+                buffer.Destroy();
+            }
+        }
+    }
+
+    bool NodeTransforms::Initialize(const Main& main) {
+        const auto device = main.GetDevice();
+
+        if (false == ShaderExists("nodetransforms.comp.spv")) {
+            return false;
+        }
+
+        VkPipelineShaderStageCreateInfo shaderStage = LoadShader(device, "nodetransforms.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+        if (VK_NULL_HANDLE == shaderStage.module) {
+            return false;
+        }
+
+        CreateDescriptorLayouts(device);
+
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.size = sizeof(DispatchConstantData);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutCI{};
+        pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutCI.setLayoutCount = 1;
+        pipelineLayoutCI.pSetLayouts = &_computeDescLayout;
+        pipelineLayoutCI.pushConstantRangeCount = 1;
+        pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+        CheckResult(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &_pipelineLayout));
+
+        VkComputePipelineCreateInfo pipelineCI{};
+        pipelineCI.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineCI.layout = _pipelineLayout;
+        pipelineCI.stage = shaderStage;
+        CheckResult(vkCreateComputePipelines(device, main.GetPipelineCache(), 1, &pipelineCI, nullptr, &_pipeline));
+
+        vkDestroyShaderModule(device, shaderStage.module, nullptr);
+
+        CreateDescriptorSets(main);
+        return true;
+    }
+
+    void NodeTransforms::Release(VkDevice device) {
+        for (auto& frame : _frames) {
+            DestroyBuffer(frame.transforms);
+            DestroyBuffer(frame.nodes);
+            DestroyBuffer(frame.joints);
+            DestroyBuffer(frame.worldMatrices);
+            DestroyBuffer(frame.jointMatrices);
+            DestroyBuffer(frame.instanceSlots);
+        }
+        _frames.clear();
+
+        vkDestroyPipeline(device, _pipeline, nullptr);
+        vkDestroyPipelineLayout(device, _pipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, _nodeDescLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, _computeDescLayout, nullptr);
+        vkDestroyDescriptorPool(device, _descriptorPool, nullptr);
+
+        _pipeline = VK_NULL_HANDLE;
+        _pipelineLayout = VK_NULL_HANDLE;
+        _nodeDescLayout = VK_NULL_HANDLE;
+        _computeDescLayout = VK_NULL_HANDLE;
+        _descriptorPool = VK_NULL_HANDLE;
+    }
+
+    void NodeTransforms::CreateDescriptorLayouts(VkDevice device) {
+        const std::vector<VkDescriptorSetLayoutBinding> computeBindings = {
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        };
+
+        VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI{};
+        descriptorSetLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        descriptorSetLayoutCI.pBindings = computeBindings.data();
+        descriptorSetLayoutCI.bindingCount = static_cast<uint32_t>(computeBindings.size());
+        CheckResult(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &_computeDescLayout));
+
+        const std::vector<VkDescriptorSetLayoutBinding> nodeBindings = {
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr },
+            { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr },
+        };
+
+        descriptorSetLayoutCI.pBindings = nodeBindings.data();
+        descriptorSetLayoutCI.bindingCount = static_cast<uint32_t>(nodeBindings.size());
+        CheckResult(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCI, nullptr, &_nodeDescLayout));
+    }
+
+    void NodeTransforms::CreateDescriptorSets(const Main& main) {
+        const auto device = main.GetDevice();
+        const auto imageCount = main.GetVulkanSwapChain().imageCount;
+
+        const std::vector<VkDescriptorPoolSize> poolSizes = {
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8 * imageCount }
+        };
+
+        VkDescriptorPoolCreateInfo descriptorPoolCI{};
+        descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        descriptorPoolCI.pPoolSizes = poolSizes.data();
+        descriptorPoolCI.maxSets = 2 * imageCount;
+        CheckResult(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &_descriptorPool));
+
+        _frames.resize(imageCount);
+        for (auto& frame : _frames) {
+            const std::array<VkDescriptorSetLayout, 2> layouts = { _computeDescLayout, _nodeDescLayout };
+            std::array<VkDescriptorSet, 2> sets{};
+
+            VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
+            descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            descriptorSetAllocInfo.descriptorPool = _descriptorPool;
+            descriptorSetAllocInfo.pSetLayouts = layouts.data();
+            descriptorSetAllocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+            CheckResult(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, sets.data()));
+
+            frame.computeDescSet = sets[0];
+            frame.nodeDescSet = sets[1];
+
+            // Descriptor sets need buffers to point at before the first model arrives
+            Reserve(main, frame, 1, 1, 1);
+        }
+    }
+
+    void NodeTransforms::Reserve(const Main& main, Frame& frame, uint32_t nodeCount, uint32_t jointCount, uint32_t instanceCount) {
+        if (nodeCount <= frame.nodeCapacity && jointCount <= frame.jointCapacity && instanceCount <= frame.instanceCapacity) {
+            return;
+        }
+
+        auto* vulkanDevice = &main.GetVulkanDevice();
+        const auto storageUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        const auto hostMemory = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+        if (nodeCount > frame.nodeCapacity) {
+            DestroyBuffer(frame.transforms);
+            DestroyBuffer(frame.nodes);
+            DestroyBuffer(frame.worldMatrices);
+
+            frame.nodeCapacity = std::max(nodeCount, frame.nodeCapacity + frame.nodeCapacity / 2);
+            frame.transforms.Create(vulkanDevice, storageUsage, hostMemory, frame.nodeCapacity * sizeof(GpuTransform));
+            frame.nodes.Create(vulkanDevice, storageUsage, hostMemory, frame.nodeCapacity * sizeof(GpuNode));
+            frame.worldMatrices.Create(vulkanDevice, storageUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.nodeCapacity * sizeof(glm::mat4), false);
+        }
+
+        if (jointCount > frame.jointCapacity) {
+            DestroyBuffer(frame.joints);
+            DestroyBuffer(frame.jointMatrices);
+
+            frame.jointCapacity = std::max(jointCount, frame.jointCapacity + frame.jointCapacity / 2);
+            frame.joints.Create(vulkanDevice, storageUsage, hostMemory, frame.jointCapacity * sizeof(GpuJoint));
+            frame.jointMatrices.Create(vulkanDevice, storageUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.jointCapacity * sizeof(glm::mat4), false);
+        }
+
+        if (instanceCount > frame.instanceCapacity) {
+            DestroyBuffer(frame.instanceSlots);
+
+            frame.instanceCapacity = std::max(instanceCount, frame.instanceCapacity + frame.instanceCapacity / 2);
+            frame.instanceSlots.Create(vulkanDevice, storageUsage, hostMemory, frame.instanceCapacity * sizeof(uint32_t));
+        }
+
+        const std::array<const VkDescriptorBufferInfo*, 5> computeBuffers = {
+            &frame.transforms.descriptor,
+            &frame.nodes.descriptor,
+            &frame.joints.descriptor,
+            &frame.worldMatrices.descriptor,
+            &frame.jointMatrices.descriptor
+        };
+
+        std::array<VkWriteDescriptorSet, 8> writeDescriptorSets{};
+        for (uint32_t i = 0; i < computeBuffers.size(); ++i) {
+            writeDescriptorSets[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSets[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writeDescriptorSets[i].descriptorCount = 1;
+            writeDescriptorSets[i].dstSet = frame.computeDescSet;
+            writeDescriptorSets[i].dstBinding = i;
+            writeDescriptorSets[i].pBufferInfo = computeBuffers[i];
+        }
+
+        writeDescriptorSets[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSets[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writeDescriptorSets[5].descriptorCount = 1;
+        writeDescriptorSets[5].dstSet = frame.nodeDescSet;
+        writeDescriptorSets[5].dstBinding = 0;
+        writeDescriptorSets[5].pBufferInfo = &frame.worldMatrices.descriptor;
+
+        writeDescriptorSets[6].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSets[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writeDescriptorSets[6].descriptorCount = 1;
+        writeDescriptorSets[6].dstSet = frame.nodeDescSet;
+        writeDescriptorSets[6].dstBinding = 1;
+        writeDescriptorSets[6].pBufferInfo = &frame.jointMatrices.descriptor;
+
+        writeDescriptorSets[7].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSets[7].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writeDescriptorSets[7].descriptorCount = 1;
+        writeDescriptorSets[7].dstSet = frame.nodeDescSet;
+        writeDescriptorSets[7].dstBinding = 2;
+        writeDescriptorSets[7].pBufferInfo = &frame.instanceSlots.descriptor;
+
+        vkUpdateDescriptorSets(main.GetDevice(), static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+    }
+
+    int32_t NodeTransforms::GetFirstJoint(uint32_t index, int32_t skinIndex) const {
+        const Frame& frame = _frames[index];
+        return skinIndex > -1 && skinIndex < static_cast<int32_t>(frame.firstJoints.size()) ? frame.firstJoints[skinIndex] : -1;
+    }
+
+    void NodeTransforms::Prepare(const Main& main, uint32_t index, const Model& model) {
+        Frame& frame = _frames[index];
+        const SceneGraph& graph = model.graph;
+
+        frame.firstJoints.clear();
+        uint32_t jointCount = 0;
+        for (const Skin* skin : model.skins) {
+            frame.firstJoints.push_back(static_cast<int32_t>(jointCount));
+            jointCount += static_cast<uint32_t>(skin->joints.size());
+        }
+
+        frame.nodeCount = graph.Size();
+        frame.jointCount = jointCount;
+        const auto instanceCount = static_cast<uint32_t>(model.instanceSlots.size());
+        Reserve(main, frame, std::max(frame.nodeCount, 1u), std::max(frame.jointCount, 1u), std::max(instanceCount, 1u));
+
+        frame.levelStarts.clear();
+        if (0 == frame.nodeCount) {
+            return;
+        }
+        frame.levelStarts = graph.LevelStarts();
+
+        // Parents, node matrices and the level order only change with the model
+        auto* nodes = static_cast<GpuNode*>(frame.nodes.mapped);
+        const std::vector<uint32_t>& levelSlots = graph.LevelSlots();
+        for (uint32_t slot = 0; slot < frame.nodeCount; ++slot) {
+            nodes[slot].matrix = graph.matrices[slot];
+            nodes[slot].parent = graph.parents[slot];
+            nodes[slot].levelSlot = levelSlots[slot];
+        }
+
+        auto* joints = static_cast<GpuJoint*>(frame.joints.mapped);
+        for (const Skin* skin : model.skins) {
+            for (size_t i = 0; i < skin->joints.size(); ++i, ++joints) {
+                joints->inverseBind = i < skin->inverseBindMatrices.size() ? skin->inverseBindMatrices[i] : glm::identity<glm::mat4>();
+                joints->slot = skin->joints[i];
+            }
+        }
+
+        memcpy(frame.instanceSlots.mapped, model.instanceSlots.data(), instanceCount * sizeof(uint32_t));
+
+        Upload(index, graph);
+    }
+
+    void NodeTransforms::Record(uint32_t index, VkCommandBuffer cmdBuf) const {
+        const Frame& frame = _frames[index];
+        if (0 == frame.nodeCount) {
+            return;
+        }
+
+        vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+        vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &frame.computeDescSet, 0, nullptr);
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        // A level reads the world matrices of the one before it
+        DispatchConstantData dispatch{};
+        for (size_t level = 0; level + 1 < frame.levelStarts.size(); ++level) {
+            if (level > 0) {
+                vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+            }
+
+            dispatch.first = frame.levelStarts[level];
+            dispatch.count = frame.levelStarts[level + 1] - frame.levelStarts[level];
+            vkCmdPushConstants(cmdBuf, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DispatchConstantData), &dispatch);
+            vkCmdDispatch(cmdBuf, (dispatch.count + groupSize - 1) / groupSize, 1, 1);
+        }
+
+        if (frame.jointCount > 0) {
+            vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+            dispatch.first = 0;
+            dispatch.count = frame.jointCount;
+            dispatch.pass = NodePass::Joints;
+            vkCmdPushConstants(cmdBuf, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DispatchConstantData), &dispatch);
+            vkCmdDispatch(cmdBuf, (dispatch.count + groupSize - 1) / groupSize, 1, 1);
+        }
+
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    void NodeTransforms::Upload(uint32_t index, const SceneGraph& graph) {
+        Frame& frame = _frames[index];
+        assert(graph.Size() == frame.nodeCount);
+
+        // Host coherent, the submission of this image makes the writes visible to the compute pass
+        auto* transforms = static_cast<GpuTransform*>(frame.transforms.mapped);
+        for (uint32_t slot = 0; slot < frame.nodeCount; ++slot) {
+            const glm::quat& rotation = graph.rotations[slot];
+            transforms[slot].translation = glm::vec4(graph.translations[slot], 0.0f);
+            transforms[slot].rotation = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+            transforms[slot].scale = glm::vec4(graph.scales[slot], 0.0f);
+        }
+    }
+}
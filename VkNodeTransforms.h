@@ -0,0 +1,76 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "VkBuffer.h"
+
+namespace Vk {
+    class Main;
+    struct Model;
+    struct SceneGraph;
+
+    // Vertex stage push constants of every primitive, placed after the material block of the fragment stage
+    struct NodeConstantData {
+        int32_t firstJoint = -1;    // -1 for meshes without skin, only read by the node transform path
+        float positionScale = 1.0f; // Dequantization of VertexFormat::Quantized positions
+        glm::vec3 positionOffset{ 0.0f };
+    };
+
+    /*
+        Resolves the world matrices of a scene graph on the GPU. Translation, rotation and scale of every slot are
+        uploaded once per frame, a compute pass walks the graph level by level into one storage buffer of world matrices
+        and then multiplies the joint matrices of all skins. The vertex shader looks up the slot of its instance and reads
+        both buffers, so neither the instance buffer nor the mesh uniform buffers are rewritten when nodes move.
+
+        Every swap chain image owns its buffers. They are sized and filled with the parents, node matrices and skin
+        joints and instance slots of the model while the command buffer of that image is recorded, which is when nothing reads them.
+    */
+    class NodeTransforms {
+    public:
+        // False when the compute shader is missing, the scene keeps the per mesh uniform buffers then
+        bool                            Initialize(const Main& main);
+        void                            Release(VkDevice device);
+
+        // Storage buffers of world matrices, joint matrices and instance slots as seen by the vertex stage
+        VkDescriptorSetLayout           GetNodeDescLayout() const { return _nodeDescLayout; }
+        VkDescriptorSet                 GetNodeDescSet(uint32_t index) const { return _frames[index].nodeDescSet; }
+        int32_t                         GetFirstJoint(uint32_t index, int32_t skinIndex) const;
+
+        void                            Prepare(const Main& main, uint32_t index, const Model& model);
+        // Dispatches recorded ahead of the render pass, the last one is made visible to the vertex stage
+        void                            Record(uint32_t index, VkCommandBuffer cmdBuf) const;
+        // Copies the current transforms of graph, the layout has to match the model the image was prepared with
+        void                            Upload(uint32_t index, const SceneGraph& graph);
+
+    private:
+        struct Frame {
+            Buffer                      transforms;         // Translation, rotation and scale per slot, written every frame
+            Buffer                      nodes;              // Parent, node matrix and level order per slot
+            Buffer                      joints;             // Slot and inverse bind matrix of every skin joint
+            Buffer                      instanceSlots;      // Model::instanceSlots
+            Buffer                      worldMatrices;
+            Buffer                      jointMatrices;
+            VkDescriptorSet             computeDescSet = VK_NULL_HANDLE;
+            VkDescriptorSet             nodeDescSet = VK_NULL_HANDLE;
+            std::vector<uint32_t>       levelStarts;
+            std::vector<int32_t>        firstJoints;        // First joint matrix of each skin
+            uint32_t                    nodeCount = 0;
+            uint32_t                    jointCount = 0;
+            uint32_t                    nodeCapacity = 0;
+            uint32_t                    jointCapacity = 0;
+            uint32_t                    instanceCapacity = 0;
+        };
+
+        void                            CreateDescriptorLayouts(VkDevice device);
+        void                            CreateDescriptorSets(const Main& main);
+        void                            Reserve(const Main& main, Frame& frame, uint32_t nodeCount, uint32_t jointCount, uint32_t instanceCount);
+
+        std::vector<Frame>              _frames;
+
+        VkDescriptorPool                _descriptorPool = VK_NULL_HANDLE;
+        VkDescriptorSetLayout           _computeDescLayout = VK_NULL_HANDLE;
+        VkDescriptorSetLayout           _nodeDescLayout = VK_NULL_HANDLE;
+        VkPipelineLayout                _pipelineLayout = VK_NULL_HANDLE;
+        VkPipeline                      _pipeline = VK_NULL_HANDLE;
+    };
+}
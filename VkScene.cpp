@@ -10,6 +10,7 @@
 
 #include "Timer.h"
 #include "Path.h"
+#include "ThreadPool.h"
 
 namespace Vk {
     enum class PBRWorkflow : uint8_t {
@@ -43,6 +44,11 @@ namespace Vk {
         float alphaMaskCutoff = 0.0f;
     };
 
+    // The vertex shaders declare the node push constants right behind this block, within the guaranteed 128 bytes
+    static_assert(104 == sizeof(MaterialConstantData), "Update the push constant offset of the vertex shaders");
+    static_assert(8 == offsetof(NodeConstantData, positionOffset) && 128 >= sizeof(MaterialConstantData) + sizeof(NodeConstantData), "Update the push constants of the vertex shaders");
+    static_assert(32 == sizeof(InstanceTransform), "Update the instance attributes of pbr.vert and pbr_nodes.vert");
+
     Texture2D empty;
     Texture2D lutBrdf;
 
@@ -71,85 +77,102 @@ namespace Vk {
         std::cout << "Generating BRDF LUT took " << tDiff << " ms" << std::endl;
     }
 
-    void SetNodeDescriptorSet(Node& node, VkDevice device, const VkDescriptorSetAllocateInfo& descSetInfo) {
-        if (node.mesh) {
-            CheckResult(vkAllocateDescriptorSets(device, &descSetInfo, &node.mesh->uniformBuffer.descriptorSet));
+    void SetMeshDescriptorSet(Mesh& mesh, VkDevice device, const VkDescriptorSetAllocateInfo& descSetInfo) {
+        CheckResult(vkAllocateDescriptorSets(device, &descSetInfo, &mesh.uniformBuffer.descriptorSet));
+
+        VkWriteDescriptorSet writeDescriptorSet{};
+        writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        writeDescriptorSet.descriptorCount = 1;
+        writeDescriptorSet.dstSet = mesh.uniformBuffer.descriptorSet;
+        writeDescriptorSet.dstBinding = 0;
+        writeDescriptorSet.pBufferInfo = &mesh.uniformBuffer.descriptor;
 
-            VkWriteDescriptorSet writeDescriptorSet{};
-            writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            writeDescriptorSet.descriptorCount = 1;
-            writeDescriptorSet.dstSet = node.mesh->uniformBuffer.descriptorSet;
-            writeDescriptorSet.dstBinding = 0;
-            writeDescriptorSet.pBufferInfo = &node.mesh->uniformBuffer.descriptor;
+        vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+    }
 
-            vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+    // Every primitive is one instanced draw over all nodes sharing the mesh
+    // nodeTransforms is null when meshes read their matrices from the instance buffer and their own uniform buffer
+    // Indexed primitives read their draw from drawBuffer unless it is null, see Model::SelectLods
+    // Unskinned primitives with meshlets draw the survivors in meshletDrawBuffer instead unless it is null, see MeshletCulling
+    void RenderMesh(const Model& model, const Mesh& mesh, Material::AlphaMode alphaMode, VkCommandBuffer cmdBuf, VkDescriptorSet descSet, VkPipelineLayout pipelineLayout, const NodeTransforms* nodeTransforms, uint32_t index, VkBuffer drawBuffer, VkBuffer meshletDrawBuffer, VkIndexType& boundIndexType) {
+        VkDescriptorSet nodeDescSet = mesh.uniformBuffer.descriptorSet;
+        NodeConstantData pushConstBlockNode{};
+        if (nullptr != nodeTransforms) {
+            nodeDescSet = nodeTransforms->GetNodeDescSet(index);
+            pushConstBlockNode.firstJoint = nodeTransforms->GetFirstJoint(index, mesh.skinIndex);
         }
 
-        for (auto& child : node.children)
-            SetNodeDescriptorSet(*child, device, descSetInfo);
-    }
+        // Render mesh primitives
+        uint32_t meshletDraw = mesh.firstMeshletDraw;
+        for (const Primitive& primitive : mesh.primitives) {
+            const uint32_t firstMeshletDraw = meshletDraw;
+            meshletDraw += primitive.meshletCount;
+            if (alphaMode != primitive.material.alphaMode)
+                continue;
+
+            const uint32_t descSetCount = 3;
+            const std::array<VkDescriptorSet, descSetCount> descriptorsets = {
+                descSet,
+                primitive.material.descriptorSet,
+                nodeDescSet,
+            };
+            vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, descSetCount, descriptorsets.data(), 0, nullptr);
+
+            // Pass material parameters as push constants
+            MaterialConstantData pushConstBlockMaterial{};
+            pushConstBlockMaterial.emissiveFactor = primitive.material.emissiveFactor;
+
+            // To save push constant space, availabilty and texture coordiante set are combined
+            // -1 = texture not used for this material, >= 0 texture used and index of texture coordinate set
+            pushConstBlockMaterial.colorTextureSet = primitive.material.baseColorTexture != nullptr ? primitive.material.texCoordSets.baseColor : -1;
+            pushConstBlockMaterial.normalTextureSet = primitive.material.normalTexture != nullptr ? primitive.material.texCoordSets.normal : -1;
+            pushConstBlockMaterial.occlusionTextureSet = primitive.material.occlusionTexture != nullptr ? primitive.material.texCoordSets.occlusion : -1;
+            pushConstBlockMaterial.emissiveTextureSet = primitive.material.emissiveTexture != nullptr ? primitive.material.texCoordSets.emissive : -1;
+            pushConstBlockMaterial.alphaMask = (primitive.material.alphaMode == Material::ALPHAMODE_MASK ? 1.0f : 0.0f);
+            pushConstBlockMaterial.alphaMaskCutoff = primitive.material.alphaCutoff;
+
+            // TODO: glTF specs states that metallic roughness should be preferred, even if specular glosiness is present
+
+            if (primitive.material.pbrWorkflows.metallicRoughness) {
+                // Metallic roughness workflow
+                pushConstBlockMaterial.workflow = static_cast<float>(PBRWorkflow::MetallicRoughness);
+                pushConstBlockMaterial.baseColorFactor = primitive.material.baseColorFactor;
+                pushConstBlockMaterial.metallicFactor = primitive.material.metallicFactor;
+                pushConstBlockMaterial.roughnessFactor = primitive.material.roughnessFactor;
+                pushConstBlockMaterial.PhysicalDescriptorTextureSet = primitive.material.metallicRoughnessTexture != nullptr ? primitive.material.texCoordSets.metallicRoughness : -1;
+                pushConstBlockMaterial.colorTextureSet = primitive.material.baseColorTexture != nullptr ? primitive.material.texCoordSets.baseColor : -1;
+            }
 
-    void RenderNode(Node* node, Material::AlphaMode alphaMode, VkCommandBuffer cmdBuf, VkDescriptorSet descSet, VkPipelineLayout pipelineLayout) {
-        if (node->mesh) {
-            // Render mesh primitives
-            for (Primitive* primitive : node->mesh->primitives) {
-                if (alphaMode != primitive->material.alphaMode)
-                    continue;
-
-                const uint32_t descSetCount = 3;
-                const std::array<VkDescriptorSet, descSetCount> descriptorsets = {
-                    descSet,
-                    primitive->material.descriptorSet,
-                    node->mesh->uniformBuffer.descriptorSet,
-                };
-                vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, descSetCount, descriptorsets.data(), 0, nullptr);
-
-                // Pass material parameters as push constants
-                MaterialConstantData pushConstBlockMaterial{};
-                pushConstBlockMaterial.emissiveFactor = primitive->material.emissiveFactor;
-
-                // To save push constant space, availabilty and texture coordiante set are combined
-                // -1 = texture not used for this material, >= 0 texture used and index of texture coordinate set
-                pushConstBlockMaterial.colorTextureSet = primitive->material.baseColorTexture != nullptr ? primitive->material.texCoordSets.baseColor : -1;
-                pushConstBlockMaterial.normalTextureSet = primitive->material.normalTexture != nullptr ? primitive->material.texCoordSets.normal : -1;
-                pushConstBlockMaterial.occlusionTextureSet = primitive->material.occlusionTexture != nullptr ? primitive->material.texCoordSets.occlusion : -1;
-                pushConstBlockMaterial.emissiveTextureSet = primitive->material.emissiveTexture != nullptr ? primitive->material.texCoordSets.emissive : -1;
-                pushConstBlockMaterial.alphaMask = (primitive->material.alphaMode == Material::ALPHAMODE_MASK ? 1.0f : 0.0f);
-                pushConstBlockMaterial.alphaMaskCutoff = primitive->material.alphaCutoff;
-
-                // TODO: glTF specs states that metallic roughness should be preferred, even if specular glosiness is present
-
-                if (primitive->material.pbrWorkflows.metallicRoughness) {
-                    // Metallic roughness workflow
-                    pushConstBlockMaterial.workflow = static_cast<float>(PBRWorkflow::MetallicRoughness);
-                    pushConstBlockMaterial.baseColorFactor = primitive->material.baseColorFactor;
-                    pushConstBlockMaterial.metallicFactor = primitive->material.metallicFactor;
-                    pushConstBlockMaterial.roughnessFactor = primitive->material.roughnessFactor;
-                    pushConstBlockMaterial.PhysicalDescriptorTextureSet = primitive->material.metallicRoughnessTexture != nullptr ? primitive->material.texCoordSets.metallicRoughness : -1;
-                    pushConstBlockMaterial.colorTextureSet = primitive->material.baseColorTexture != nullptr ? primitive->material.texCoordSets.baseColor : -1;
-                }
+            if (primitive.material.pbrWorkflows.specularGlossiness) {
+                // Specular glossiness workflow
+                pushConstBlockMaterial.workflow = static_cast<float>(PBRWorkflow::SpecularGlosiness);
+                pushConstBlockMaterial.PhysicalDescriptorTextureSet = primitive.material.extension.specularGlossinessTexture != nullptr ? primitive.material.texCoordSets.specularGlossiness : -1;
+                pushConstBlockMaterial.colorTextureSet = primitive.material.extension.diffuseTexture != nullptr ? primitive.material.texCoordSets.baseColor : -1;
+                pushConstBlockMaterial.diffuseFactor = primitive.material.extension.diffuseFactor;
+                pushConstBlockMaterial.specularFactor = glm::vec4(primitive.material.extension.specularFactor, 1.0f);
+            }
 
-                if (primitive->material.pbrWorkflows.specularGlossiness) {
-                    // Specular glossiness workflow
-                    pushConstBlockMaterial.workflow = static_cast<float>(PBRWorkflow::SpecularGlosiness);
-                    pushConstBlockMaterial.PhysicalDescriptorTextureSet = primitive->material.extension.specularGlossinessTexture != nullptr ? primitive->material.texCoordSets.specularGlossiness : -1;
-                    pushConstBlockMaterial.colorTextureSet = primitive->material.extension.diffuseTexture != nullptr ? primitive->material.texCoordSets.baseColor : -1;
-                    pushConstBlockMaterial.diffuseFactor = primitive->material.extension.diffuseFactor;
-                    pushConstBlockMaterial.specularFactor = glm::vec4(primitive->material.extension.specularFactor, 1.0f);
-                }
+            vkCmdPushConstants(cmdBuf, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(MaterialConstantData), &pushConstBlockMaterial);
 
-                vkCmdPushConstants(cmdBuf, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(MaterialConstantData), &pushConstBlockMaterial);
+            pushConstBlockNode.positionScale = primitive.positionScale;
+            pushConstBlockNode.positionOffset = primitive.positionOffset;
+            vkCmdPushConstants(cmdBuf, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(MaterialConstantData), sizeof(NodeConstantData), &pushConstBlockNode);
 
-                if (primitive->hasIndices)
-                    vkCmdDrawIndexed(cmdBuf, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
-                else
-                    vkCmdDraw(cmdBuf, primitive->vertexCount, 1, 0, 0);
+            if (primitive.hasIndices && primitive.indexType != boundIndexType) {
+                model.BindIndices(cmdBuf, primitive.indexType);
+                boundIndexType = primitive.indexType;
             }
-        };
 
-        for (auto child : node->children) {
-            RenderNode(child, alphaMode, cmdBuf, descSet, pipelineLayout);
+            const uint32_t draw = mesh.firstDraw + static_cast<uint32_t>(&primitive - mesh.primitives.begin());
+            if (primitive.hasIndices && VK_NULL_HANDLE != meshletDrawBuffer && mesh.skinIndex < 0 && primitive.meshletCount > 0)
+                vkCmdDrawIndexedIndirect(cmdBuf, meshletDrawBuffer, firstMeshletDraw * sizeof(VkDrawIndexedIndirectCommand), primitive.meshletCount, sizeof(VkDrawIndexedIndirectCommand));
+            else if (primitive.hasIndices && VK_NULL_HANDLE != drawBuffer)
+                vkCmdDrawIndexedIndirect(cmdBuf, drawBuffer, draw * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+            else if (primitive.hasIndices)
+                vkCmdDrawIndexed(cmdBuf, primitive.indexCount, mesh.instanceCount, primitive.firstIndex, primitive.vertexOffset, mesh.firstInstance);
+            else
+                vkCmdDraw(cmdBuf, primitive.vertexCount, mesh.instanceCount, primitive.firstVertex, mesh.firstInstance);
         }
     }
 
@@ -161,17 +184,13 @@ namespace Vk {
         // Environment samplers (radiance, irradiance, brdf lut)
         imageSamplerCount += 3;
 
-        const std::vector<Model*> modellist = { &_cubeMap.GetSkybox(), &_scene };
+        // Scene models bring their own pool, see CreateModelDescriptorPool
+        const std::vector<Model*> modellist = { &_cubeMap.GetSkybox() };
         for (auto& model : modellist) {
             const auto inModelMaterialCount = static_cast<uint32_t>(model->materials.size());
             imageSamplerCount += inModelMaterialCount * 5;
             materialCount += inModelMaterialCount;
-
-            for (auto node : model->linearNodes) {
-                if (nullptr != node->mesh) {
-                    meshCount++;
-                }
-            }
+            meshCount += static_cast<uint32_t>(model->meshes.size());
         }
 
         const auto imageCount = main.GetVulkanSwapChain().imageCount;
@@ -291,14 +310,35 @@ namespace Vk {
         }
     }
 
-    void Scene::SetupMaterialDescriptorSet(const Main & main) {
+    VkDescriptorPool Scene::CreateModelDescriptorPool(const Main& main, const Model& model) const {
+        const auto materialCount = static_cast<uint32_t>(model.materials.size());
+        const auto meshCount = static_cast<uint32_t>(model.meshes.size());
+
+        // Pool sizes must not be zero
+        const std::vector<VkDescriptorPoolSize> poolSizes = {
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, std::max(meshCount, 1u) },
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, std::max(materialCount * MaterialType::Count, 1u) }
+        };
+
+        VkDescriptorPoolCreateInfo descriptorPoolCI{};
+        descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        descriptorPoolCI.pPoolSizes = poolSizes.data();
+        descriptorPoolCI.maxSets = std::max(materialCount + meshCount, 1u);
+
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        CheckResult(vkCreateDescriptorPool(main.GetDevice(), &descriptorPoolCI, nullptr, &descriptorPool));
+        return descriptorPool;
+    }
+
+    void Scene::SetupMaterialDescriptorSet(const Main & main, Model& model, VkDescriptorPool descriptorPool) const {
         const auto device = main.GetDevice();
 
         // Per-Material descriptor sets
-        for (auto& material : _scene.materials) {
+        for (auto& material : model.materials) {
             VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
             descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-            descriptorSetAllocInfo.descriptorPool = _descriptorPool;
+            descriptorSetAllocInfo.descriptorPool = descriptorPool;
             descriptorSetAllocInfo.pSetLayouts = &_materialDescLayout;
             descriptorSetAllocInfo.descriptorSetCount = 1;
             CheckResult(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &material.descriptorSet));
@@ -342,16 +382,16 @@ namespace Vk {
         }
     }
 
-    void Scene::SetupNodeDescriptorSet(const Main& main) {
-        // Per-Node descriptor set
+    void Scene::SetupNodeDescriptorSet(const Main& main, Model& model, VkDescriptorPool descriptorPool) const {
+        // Per-Mesh descriptor set, shared by all its instances
         VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
         descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        descriptorSetAllocInfo.descriptorPool = _descriptorPool;
+        descriptorSetAllocInfo.descriptorPool = descriptorPool;
         descriptorSetAllocInfo.pSetLayouts = &_nodeDescLayout;
         descriptorSetAllocInfo.descriptorSetCount = 1;
 
-        for (auto& node : _scene.nodes)
-            SetNodeDescriptorSet(*node, main.GetDevice(), descriptorSetAllocInfo);
+        for (auto mesh : model.meshes)
+            SetMeshDescriptorSet(*mesh, main.GetDevice(), descriptorSetAllocInfo);
     }
 
     void Scene::CreatePipelines(const Main& main) {
@@ -411,29 +451,26 @@ namespace Vk {
 
         // Pipeline layout
         const std::vector<VkDescriptorSetLayout> setLayouts = {
-            _sceneDescLayout, _materialDescLayout, _nodeDescLayout
+            _sceneDescLayout, _materialDescLayout, _gpuNodeTransforms ? _nodeTransforms.GetNodeDescLayout() : _nodeDescLayout
         };
         VkPipelineLayoutCreateInfo pipelineLayoutCI{};
         pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         pipelineLayoutCI.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
         pipelineLayoutCI.pSetLayouts = setLayouts.data();
-        VkPushConstantRange pushConstantRange{};
-        pushConstantRange.size = sizeof(MaterialConstantData);
-        pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-        pipelineLayoutCI.pushConstantRangeCount = 1;
-        pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+        std::array<VkPushConstantRange, 2> pushConstantRanges{};
+        pushConstantRanges[0].size = sizeof(MaterialConstantData);
+        pushConstantRanges[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        pushConstantRanges[1].offset = sizeof(MaterialConstantData);
+        pushConstantRanges[1].size = sizeof(NodeConstantData);
+        pushConstantRanges[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        pipelineLayoutCI.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+        pipelineLayoutCI.pPushConstantRanges = pushConstantRanges.data();
         CheckResult(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &_pipelineLayout));
 
-        // Vertex bindings an attributes
-        const VkVertexInputBindingDescription vertexInputBinding = { 0, sizeof(Model::Vertex), VK_VERTEX_INPUT_RATE_VERTEX };
-        const std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = {
-            { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 },
-            { 1, 0, VK_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 3 },
-            { 2, 0, VK_FORMAT_R32G32_SFLOAT, sizeof(float) * 6 },
-            { 3, 0, VK_FORMAT_R32G32_SFLOAT, sizeof(float) * 8 },
-            { 4, 0, VK_FORMAT_R32G32B32A32_SFLOAT, sizeof(float) * 10 },
-            { 5, 0, VK_FORMAT_R32G32B32A32_SFLOAT, sizeof(float) * 14 }
-        };
+        // Vertex bindings an attributes, the skybox cube is a model in the float format
+        using SkyboxLayout = VertexStreams<VertexFormat::Float>::Interleaved;
+        constexpr VkVertexInputBindingDescription vertexInputBinding = SkyboxLayout::Binding(0);
+        constexpr auto vertexInputAttributes = SkyboxLayout::Describe(0);
 
         VkPipelineVertexInputStateCreateInfo vertexInputStateCI{};
         vertexInputStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -459,42 +496,181 @@ namespace Vk {
         // Skybox pipeline (background cube)
         _cubeMap.PrepareSkyboxPipeline(main, pipelineCI);
 
-        // PBR pipeline
-        const std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {
-            LoadShader(device, "pbr.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
-            LoadShader(device, "pbr_khr.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
+        // Scene meshes read the vertex streams of the model format and add the world matrix of each instance, a mat4
+        // takes four attribute locations, and the EXT_mesh_gpu_instancing transform of the instance relative to its node
+        const VkVertexInputBindingDescription instanceMatrixBinding = { 1, sizeof(glm::mat4), VK_VERTEX_INPUT_RATE_INSTANCE };
+        const VkVertexInputBindingDescription instanceTransformBinding = { 2, sizeof(InstanceTransform), VK_VERTEX_INPUT_RATE_INSTANCE };
+        const auto addInstanceAttributes = [](std::vector<VkVertexInputAttributeDescription>& attributes, bool matrices) {
+            for (uint32_t column = 0; matrices && column < 4; ++column) {
+                attributes.push_back({ 6 + column, 1, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(sizeof(glm::vec4) * column) });
+            }
+            attributes.push_back({ 10, 2, VK_FORMAT_R32G32B32_SFLOAT, offsetof(InstanceTransform, translation) });
+            attributes.push_back({ 11, 2, VK_FORMAT_R16G16B16A16_SNORM, offsetof(InstanceTransform, rotation) });
+            attributes.push_back({ 12, 2, VK_FORMAT_R32G32B32_SFLOAT, offsetof(InstanceTransform, scale) });
         };
-        pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
-        pipelineCI.pStages = shaderStages.data();
 
+        const VertexInputDescription vertexInput = DescribeVertexInput(_vertexFormat, _splitStreams);
+        std::vector<VkVertexInputBindingDescription> sceneInputBindings = vertexInput.bindings;
+        sceneInputBindings.push_back(instanceMatrixBinding);
+        sceneInputBindings.push_back(instanceTransformBinding);
+        std::vector<VkVertexInputAttributeDescription> sceneInputAttributes = vertexInput.attributes;
+        addInstanceAttributes(sceneInputAttributes, true);
+        vertexInputStateCI.vertexBindingDescriptionCount = static_cast<uint32_t>(sceneInputBindings.size());
+        vertexInputStateCI.pVertexBindingDescriptions = sceneInputBindings.data();
+        vertexInputStateCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(sceneInputAttributes.size());
+        vertexInputStateCI.pVertexAttributeDescriptions = sceneInputAttributes.data();
+
+        // Opaque and alpha blended PBR pipelines of one vertex shader
+        const auto createPipelines = [&](const char* vertexShader, VkPipeline& opaquePipeline, VkPipeline& alphaBlendPipeline) {
+            const std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {
+                LoadShader(device, vertexShader, VK_SHADER_STAGE_VERTEX_BIT),
+                LoadShader(device, _vertexTangents ? "pbr_khr_tangents.frag.spv" : "pbr_khr.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
+            };
+            // Optional shaders are probed in Initialize, a module that still fails to load leaves both pipelines unset
+            if (VK_NULL_HANDLE == shaderStages[0].module || VK_NULL_HANDLE == shaderStages[1].module) {
+                for (auto shaderStage : shaderStages)
+                    vkDestroyShaderModule(device, shaderStage.module, nullptr);
+                return;
+            }
+            pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+            pipelineCI.pStages = shaderStages.data();
+
+            rasterizationStateCI.cullMode = VK_CULL_MODE_BACK_BIT;
+            blendAttachmentState.blendEnable = VK_FALSE;
+            depthStencilStateCI.depthWriteEnable = VK_TRUE;
+            depthStencilStateCI.depthTestEnable = VK_TRUE;
+            CheckResult(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &opaquePipeline));
+
+            rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
+            blendAttachmentState.blendEnable = VK_TRUE;
+            blendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+            blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            blendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            blendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+            blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+            blendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+            CheckResult(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &alphaBlendPipeline));
+
+            for (auto shaderStage : shaderStages)
+                vkDestroyShaderModule(device, shaderStage.module, nullptr);
+        };
+
+        if (VertexFormat::Float == _vertexFormat) {
+            createPipelines(_gpuNodeTransforms ? "pbr_nodes.vert.spv" : "pbr.vert.spv", _opaquePipeline, _alphaBlendPipeline);
+        }
+        else {
+            createPipelines(_gpuNodeTransforms ? "pbr_nodes_packed.vert.spv" : "pbr_packed.vert.spv", _opaquePipeline, _alphaBlendPipeline);
+
+            // Packed formats leave joints and weights to the skin stream, which only the skinned pipelines declare
+            sceneInputBindings.insert(sceneInputBindings.end(), vertexInput.skinBindings.begin(), vertexInput.skinBindings.end());
+            sceneInputAttributes.insert(sceneInputAttributes.end(), vertexInput.skinAttributes.begin(), vertexInput.skinAttributes.end());
+            vertexInputStateCI.vertexBindingDescriptionCount = static_cast<uint32_t>(sceneInputBindings.size());
+            vertexInputStateCI.pVertexBindingDescriptions = sceneInputBindings.data();
+            vertexInputStateCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(sceneInputAttributes.size());
+            vertexInputStateCI.pVertexAttributeDescriptions = sceneInputAttributes.data();
+            createPipelines(_gpuNodeTransforms ? "pbr_nodes_packed_skinned.vert.spv" : "pbr_packed_skinned.vert.spv", _skinnedOpaquePipeline, _skinnedAlphaBlendPipeline);
+        }
+
+        if (false == main.GetSettings().depthPrepass)
+            return;
+
+        // Without its shader the pre-pass is skipped, RecordBuffer only draws it when the pipeline exists
+        const char* depthShader = _gpuNodeTransforms ? "depth_nodes.vert.spv" : "depth.vert.spv";
+        if (false == ShaderExists(depthShader)) {
+            std::cout << "Depth pre-pass shader unavailable, shading without it" << std::endl;
+            return;
+        }
+
+        // Depth pre-pass of static opaque meshes, only reads positions and the instance streams and has no fragment stage.
+        // The shading passes then only run the fragment shader for visible surfaces
+        std::vector<VkVertexInputBindingDescription> depthInputBindings = { vertexInput.positionBinding, instanceTransformBinding };
+        std::vector<VkVertexInputAttributeDescription> depthInputAttributes = { vertexInput.positionAttribute };
+        if (false == _gpuNodeTransforms) {
+            depthInputBindings.push_back(instanceMatrixBinding);
+        }
+        addInstanceAttributes(depthInputAttributes, false == _gpuNodeTransforms);
+        vertexInputStateCI.vertexBindingDescriptionCount = static_cast<uint32_t>(depthInputBindings.size());
+        vertexInputStateCI.pVertexBindingDescriptions = depthInputBindings.data();
+        vertexInputStateCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(depthInputAttributes.size());
+        vertexInputStateCI.pVertexAttributeDescriptions = depthInputAttributes.data();
+
+        const VkPipelineShaderStageCreateInfo depthStage = LoadShader(device, depthShader, VK_SHADER_STAGE_VERTEX_BIT);
+        if (VK_NULL_HANDLE == depthStage.module)
+            return;
+        pipelineCI.stageCount = 1;
+        pipelineCI.pStages = &depthStage;
+        rasterizationStateCI.cullMode = VK_CULL_MODE_BACK_BIT;
+        blendAttachmentState = {};
         depthStencilStateCI.depthWriteEnable = VK_TRUE;
         depthStencilStateCI.depthTestEnable = VK_TRUE;
-        CheckResult(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &_opaquePipeline));
+        CheckResult(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &_depthPipeline));
+        vkDestroyShaderModule(device, depthStage.module, nullptr);
+    }
 
-        rasterizationStateCI.cullMode = VK_CULL_MODE_NONE;
-        blendAttachmentState.blendEnable = VK_TRUE;
-        blendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-        blendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-        blendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
-        blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-        blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-        blendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
-        CheckResult(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &_alphaBlendPipeline));
-
-        for (auto shaderStage : shaderStages)
-            vkDestroyShaderModule(device, shaderStage.module, nullptr);
+    SceneLoadHandle Scene::LoadSceneAsync(const Main& main, std::string&& filename) {
+        auto loaded = std::make_shared<LoadedModel>();
+
+        // Only the descriptor set layouts of this scene are touched by the task and they outlive it
+        SceneLoadHandle handle = ThreadPool::Get().Enqueue([this, &main, loaded, filename = std::move(filename)]() {
+            return LoadModel(main, filename, *loaded);
+        }).share();
+
+        _pendingLoads.push_back({ loaded, handle });
+        return handle;
     }
 
-    void Scene::LoadScene(const Main& main, std::string&& filename) {
+    bool Scene::LoadModel(const Main& main, const std::string& filename, LoadedModel& loaded) const {
         Timer timer;
+        Model& model = *loaded.model;
+
+        ModelImportOptions options;
+        options.staticBatching = main.GetSettings().staticBatching;
+        options.optimizeMeshes = main.GetSettings().optimizeMeshes;
+        options.generateLods = main.GetSettings().generateLods;
+        options.generateTangents = _vertexTangents;
+        model.vertexFormat = _vertexFormat;
+        model.splitStreams = _splitStreams;
+        model.buildMeshlets = _cullMeshlets;
+
+        // The cooked file is rebuilt whenever its source files or the import options change
+        const auto cookedFilename = filename + ".cooked"s;
+        if (model.LoadFromCookedFile(cookedFilename, &main.GetVulkanDevice(), main.GetGPUQueue(), options)) {
+            std::cout << "Loading cooked scene took " << timer.Update() << " ms" << std::endl;
+        }
+        else {
+            model.LoadFromFile(filename, &main.GetVulkanDevice(), main.GetGPUQueue(), 1.0f, cookedFilename, options);
+            std::cout << "Loading scene from took " << timer.Update() << " ms" << std::endl;
+        }
 
-        _scene.LoadFromFile(filename, &main.GetVulkanDevice(), main.GetGPUQueue());
+        if (VK_NULL_HANDLE == model.vertices.buffer) {
+            return false;
+        }
+
+        loaded.descriptorPool = CreateModelDescriptorPool(main, model);
+        SetupMaterialDescriptorSet(main, model, loaded.descriptorPool);
+        if (_gpuNodeTransforms) {
+            model.gpuTransforms = true;
+        }
+        else {
+            SetupNodeDescriptorSet(main, model, loaded.descriptorPool);
+        }
+        return true;
+    }
 
-        std::cout << "Loading scene from took " << timer.Update() << " ms" << std::endl;
+    void Scene::DestroyModel(const Main& main, LoadedModel& loaded) {
+        loaded.model->Destroy(main.GetDevice());
+        if (VK_NULL_HANDLE != loaded.descriptorPool) {
+            vkDestroyDescriptorPool(main.GetDevice(), loaded.descriptorPool, nullptr);
+            loaded.descriptorPool = VK_NULL_HANDLE;
+        }
+    }
 
-        SetupMaterialDescriptorSet(main);
-        SetupNodeDescriptorSet(main);
+    void Scene::DestroyRetiredModels(const Main& main) {
+        for (auto& retired : _retiredModels) {
+            DestroyModel(main, *retired);
+        }
+        _retiredModels.clear();
     }
 
     void Scene::InitializeUniformBuffers(const Main& main) {
@@ -526,6 +702,48 @@ namespace Vk {
         CreateNodeDescriptorLayout(main);
         _cubeMap.CreateAndSetupSkyboxDescriptorSet(main, _sceneShaderValueUniBufs, _descriptorPool, _sceneDescLayout);
 
+        if (main.GetSettings().quantizedPositions)
+            _vertexFormat = VertexFormat::Quantized;
+        else if (main.GetSettings().packedVertices)
+            _vertexFormat = VertexFormat::Packed;
+        // Packed formats need their own vertex shaders, the float format is always available
+        if (VertexFormat::Float != _vertexFormat && (false == ShaderExists("pbr_packed.vert.spv") || false == ShaderExists("pbr_packed_skinned.vert.spv"))) {
+            std::cout << "Packed vertex shaders unavailable, using the float vertex format" << std::endl;
+            _vertexFormat = VertexFormat::Float;
+        }
+        _splitStreams = main.GetSettings().splitVertexStreams;
+        _vertexTangents = main.GetSettings().vertexTangents;
+        if (_vertexTangents && false == ShaderExists("pbr_khr_tangents.frag.spv")) {
+            std::cout << "Tangent fragment shader unavailable, deriving tangents from screen space derivatives" << std::endl;
+            _vertexTangents = false;
+        }
+
+        // Indirect draws carry the first instance of their mesh, without that feature every primitive is drawn at full resolution
+        _lodSelection = main.GetSettings().lodSelection && VK_TRUE == main.GetVulkanDevice().enabledFeatures.drawIndirectFirstInstance;
+        _lodPixelError = main.GetSettings().lodPixelError;
+        _drawCommandBufs.resize(main.GetVulkanSwapChain().imageCount);
+
+        // The compute pass is only of use with the vertex shaders that read its matrices
+        if (main.GetSettings().gpuNodeTransforms) {
+            const bool nodeShaders = VertexFormat::Float == _vertexFormat
+                ? ShaderExists("pbr_nodes.vert.spv")
+                : ShaderExists("pbr_nodes_packed.vert.spv") && ShaderExists("pbr_nodes_packed_skinned.vert.spv");
+            _gpuNodeTransforms = nodeShaders && _nodeTransforms.Initialize(main);
+            if (false == _gpuNodeTransforms) {
+                std::cout << "Node transform shaders unavailable, using per mesh uniform buffers" << std::endl;
+            }
+        }
+
+        // Meshlets are culled per level draw and read the world matrices of the instance buffer
+        if (main.GetSettings().meshletCulling) {
+            if (_lodSelection && false == _gpuNodeTransforms) {
+                _cullMeshlets = _meshletCulling.Initialize(main);
+            }
+            if (false == _cullMeshlets) {
+                std::cout << "Meshlet culling needs LOD selection, CPU node transforms, multiDrawIndirect and its compute shader, drawing whole primitives" << std::endl;
+            }
+        }
+
         CreatePipelines(main);
 
         _sceneShaderValue.prefilteredCubeMipLevels = _cubeMap.GetPrefilteredCubeMipLevels();
@@ -538,13 +756,34 @@ namespace Vk {
     void Scene::Release(const Main& main) {
         const auto device = main.GetDevice();
 
-        vkDeviceWaitIdle(device);
+        // Loads still in flight submit to the GPU queue, let them finish before idling
+        for (auto& pending : _pendingLoads) {
+            pending.handle.wait();
+        }
+
+        main.GetVulkanDevice().WaitIdle();
+
+        for (auto& pending : _pendingLoads) {
+            DestroyModel(main, *pending.loaded);
+        }
+        _pendingLoads.clear();
+        DestroyRetiredModels(main);
 
         vkDestroyPipeline(device, _alphaBlendPipeline, nullptr);
         vkDestroyPipeline(device, _opaquePipeline, nullptr);
+        vkDestroyPipeline(device, _skinnedAlphaBlendPipeline, nullptr);
+        vkDestroyPipeline(device, _skinnedOpaquePipeline, nullptr);
+        vkDestroyPipeline(device, _depthPipeline, nullptr);
 
         vkDestroyPipelineLayout(device, _pipelineLayout, nullptr);
 
+        if (_gpuNodeTransforms) {
+            _nodeTransforms.Release(device);
+        }
+        if (_cullMeshlets) {
+            _meshletCulling.Release(device);
+        }
+
         vkDestroyDescriptorSetLayout(device, _nodeDescLayout, nullptr);
         vkDestroyDescriptorSetLayout(device, _materialDescLayout, nullptr);
         vkDestroyDescriptorSetLayout(device, _sceneDescLayout, nullptr);
@@ -562,7 +801,16 @@ namespace Vk {
         for (auto& buffer : _sceneUniBufs) {
             buffer.Destroy();
         }
+        for (auto& buffer : _drawCommandBufs) {
+            if (VK_NULL_HANDLE != buffer.buffer) {
+                buffer.Destroy();
+            }
+        }
         _scene.Destroy(device);
+        if (VK_NULL_HANDLE != _sceneDescriptorPool) {
+            vkDestroyDescriptorPool(device, _sceneDescriptorPool, nullptr);
+            _sceneDescriptorPool = VK_NULL_HANDLE;
+        }
 
         lutBrdf.Destroy();
         empty.Destroy();
@@ -585,6 +833,8 @@ namespace Vk {
         _sceneUniData.model = glm::translate(_sceneUniData.model, translate);
 
         _sceneUniData.camPos = cameraPos;
+        _lodView = view * _sceneUniData.model;
+        _lodPixelsPerUnit = std::abs(perspective[1][1]) * 0.5f;
 
         _sceneShaderValue.lightDir = lightDir;
 
@@ -593,6 +843,20 @@ namespace Vk {
     }
 
     void Scene::RecordBuffers(const Main& main) {
+        const CommandBuffer& cmdBuffers = main.GetCommandBuffer();
+
+        for (decltype(cmdBuffers.Count()) i = 0; i < cmdBuffers.Count(); ++i) {
+            RecordBuffer(main, i);
+        }
+        _staleCommandBuffers.assign(cmdBuffers.Count(), false);
+
+        main.GetVulkanDevice().WaitIdle();
+
+        // Nothing in flight refers to replaced models anymore
+        DestroyRetiredModels(main);
+    }
+
+    void Scene::RecordBuffer(const Main& main, uint32_t index) {
         const Settings& settings = main.GetSettings();
         const CommandBuffer& cmdBuffers = main.GetCommandBuffer();
         const FrameBuffer& frameBuffers = main.GetFrameBuffer();
@@ -621,61 +885,150 @@ namespace Vk {
         renderPassBeginInfo.clearValueCount = settings.multiSampling ? 3 : 2;
         renderPassBeginInfo.pClearValues = clearValues;
 
-        for (decltype(cmdBuffers.Count()) i = 0; i < cmdBuffers.Count(); ++i) {
-            renderPassBeginInfo.framebuffer = frameBuffers.Get(i);
+        renderPassBeginInfo.framebuffer = frameBuffers.Get(index);
 
-            VkCommandBuffer currentCB = cmdBuffers.Get(i);
+        VkCommandBuffer currentCB = cmdBuffers.Get(index);
 
-            CheckResult(vkBeginCommandBuffer(currentCB, &cmdBufferBeginInfo));
-            vkCmdBeginRenderPass(currentCB, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        CheckResult(vkBeginCommandBuffer(currentCB, &cmdBufferBeginInfo));
 
-            VkViewport viewport{};
-            viewport.width = (float)settings.width;
-            viewport.height = (float)settings.height;
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
-            vkCmdSetViewport(currentCB, 0, 1, &viewport);
+        Model& model = _scene;
 
-            VkRect2D scissor{};
-            scissor.extent = { settings.width, settings.height };
-            vkCmdSetScissor(currentCB, 0, 1, &scissor);
+        // World matrices are resolved before the render pass starts reading them
+        const NodeTransforms* nodeTransforms = nullptr;
+        if (_gpuNodeTransforms) {
+            _nodeTransforms.Prepare(main, index, model);
+            _nodeTransforms.Record(index, currentCB);
+            nodeTransforms = &_nodeTransforms;
+        }
 
-            _cubeMap.RenderSkybox(i, currentCB, _pipelineLayout);
+        // Draw commands are rewritten with the selected levels every frame, the buffer only grows with the model
+        VkBuffer drawBuffer = VK_NULL_HANDLE;
+        if (_lodSelection && model.drawCount > 0) {
+            Buffer& drawCommands = _drawCommandBufs[index];
+            if (static_cast<uint32_t>(drawCommands.count) < model.drawCount) {
+                if (VK_NULL_HANDLE != drawCommands.buffer) {
+                    drawCommands.Destroy();
+                }
+                drawCommands.Create(&main.GetVulkanDevice(), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                    model.drawCount * sizeof(VkDrawIndexedIndirectCommand));
+                drawCommands.count = static_cast<int32_t>(model.drawCount);
+            }
+            _viewportHeight = static_cast<float>(settings.height);
+            model.SelectLods(_lodView, _lodPixelsPerUnit * _viewportHeight, _lodPixelError, static_cast<VkDrawIndexedIndirectCommand*>(drawCommands.mapped));
+            drawBuffer = drawCommands.buffer;
+        }
+
+        // Meshlets are culled against the levels the submission of this image selects, see OnUniformBufferSets
+        VkBuffer meshletDrawBuffer = VK_NULL_HANDLE;
+        if (_cullMeshlets && VK_NULL_HANDLE != drawBuffer && model.meshlets.count > 0) {
+            _meshletCulling.Prepare(main, index, model, _drawCommandBufs[index], _sceneUniBufs[index]);
+            _meshletCulling.Record(index, currentCB);
+            meshletDrawBuffer = _meshletCulling.GetDrawBuffer(index);
+        }
 
-            vkCmdBindPipeline(currentCB, VK_PIPELINE_BIND_POINT_GRAPHICS, _opaquePipeline);
+        vkCmdBeginRenderPass(currentCB, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        VkViewport viewport{};
+        viewport.width = (float)settings.width;
+        viewport.height = (float)settings.height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(currentCB, 0, 1, &viewport);
+
+        VkRect2D scissor{};
+        scissor.extent = { settings.width, settings.height };
+        vkCmdSetScissor(currentCB, 0, 1, &scissor);
+
+        _cubeMap.RenderSkybox(index, currentCB, _pipelineLayout);
+
+        if(false == model.meshes.empty()) {
+            // The skin stream of the packed formats only exists when the model has skinned meshes
+            const bool skinStream = VK_NULL_HANDLE != model.skinVertices.buffer && VK_NULL_HANDLE != _skinnedOpaquePipeline;
+            const std::array<VkBuffer, 4> vertexBuffers = { model.vertices.buffer, model.instances.buffer, model.instanceTransforms.buffer, model.skinVertices.buffer };
+            const std::array<VkDeviceSize, 4> offsets = { 0, 0, 0, 0 };
+            vkCmdBindVertexBuffers(currentCB, 0, skinStream ? 4u : 3u, vertexBuffers.data(), offsets.data());
+            if (VK_NULL_HANDLE != model.positions.buffer)
+                vkCmdBindVertexBuffers(currentCB, 4, 1, &model.positions.buffer, offsets.data());
+            // RenderMesh binds the index buffer section of each primitive when the index type changes
+            VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+
+            const auto sceneDescSet = _sceneDescSets[index];
+
+            const auto renderMeshes = [&](VkPipeline staticPipeline, VkPipeline skinnedPipeline, std::initializer_list<Material::AlphaMode> alphaModes) {
+                if (VK_NULL_HANDLE == staticPipeline)
+                    return;
+
+                vkCmdBindPipeline(currentCB, VK_PIPELINE_BIND_POINT_GRAPHICS, staticPipeline);
+                for (auto alphaMode : alphaModes) {
+                    for (auto mesh : model.meshes) {
+                        if (false == skinStream || mesh->skinIndex < 0)
+                            RenderMesh(model, *mesh, alphaMode, currentCB, sceneDescSet, _pipelineLayout, nodeTransforms, index, drawBuffer, meshletDrawBuffer, boundIndexType);
+                    }
+                }
+                if (false == skinStream)
+                    return;
+
+                vkCmdBindPipeline(currentCB, VK_PIPELINE_BIND_POINT_GRAPHICS, skinnedPipeline);
+                for (auto alphaMode : alphaModes) {
+                    for (auto mesh : model.meshes) {
+                        if (mesh->skinIndex > -1)
+                            RenderMesh(model, *mesh, alphaMode, currentCB, sceneDescSet, _pipelineLayout, nodeTransforms, index, drawBuffer, meshletDrawBuffer, boundIndexType);
+                    }
+                }
+            };
 
-            Model& model = _scene;
+            // Depth of the static opaque primitives first, skinned ones would need the skin stream as well
+            if (VK_NULL_HANDLE != _depthPipeline) {
+                vkCmdBindPipeline(currentCB, VK_PIPELINE_BIND_POINT_GRAPHICS, _depthPipeline);
+                for (auto mesh : model.meshes) {
+                    if (mesh->skinIndex < 0)
+                        RenderMesh(model, *mesh, Material::ALPHAMODE_OPAQUE, currentCB, sceneDescSet, _pipelineLayout, nodeTransforms, index, drawBuffer, meshletDrawBuffer, boundIndexType);
+                }
+            }
 
-            if(false == model.nodes.empty()) {
-                VkDeviceSize offsets[1] = { 0 };
-                vkCmdBindVertexBuffers(currentCB, 0, 1, &model.vertices.buffer, offsets);
-                if (model.indices.buffer != VK_NULL_HANDLE)
-                    vkCmdBindIndexBuffer(currentCB, model.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+            // Opaque primitives, then alpha masked ones
+            renderMeshes(_opaquePipeline, _skinnedOpaquePipeline, { Material::ALPHAMODE_OPAQUE, Material::ALPHAMODE_MASK });
 
-                const auto sceneDescSet = _sceneDescSets[i];
+            // Transparent primitives
+            // TODO: Correct depth sorting
+            renderMeshes(_alphaBlendPipeline, _skinnedAlphaBlendPipeline, { Material::ALPHAMODE_BLEND });
+        }
 
-                // Opaque primitives first
-                for (auto node : model.nodes)
-                    RenderNode(node, Material::ALPHAMODE_OPAQUE, currentCB, sceneDescSet, _pipelineLayout);
+        vkCmdEndRenderPass(currentCB);
+        CheckResult(vkEndCommandBuffer(currentCB));
+    }
 
-                // Alpha masked primitives
-                for (auto node : model.nodes)
-                    RenderNode(node, Material::ALPHAMODE_MASK, currentCB, sceneDescSet, _pipelineLayout);
+    void Scene::OnFrameBoundary(const Main& main, uint32_t currentBuffer) {
+        // Finished loads replace the scene in the order they were requested
+        while (false == _pendingLoads.empty() && std::future_status::ready == _pendingLoads.front().handle.wait_for(std::chrono::seconds(0))) {
+            PendingLoad pending = std::move(_pendingLoads.front());
+            _pendingLoads.pop_front();
 
-                // Transparent primitives
-                // TODO: Correct depth sorting
-                vkCmdBindPipeline(currentCB, VK_PIPELINE_BIND_POINT_GRAPHICS, _alphaBlendPipeline);
-                for (auto node : model.nodes)
-                    RenderNode(node, Material::ALPHAMODE_BLEND, currentCB, sceneDescSet, _pipelineLayout);
+            if (false == pending.handle.get()) {
+                // Its own uploads have completed and nothing was recorded with it
+                DestroyModel(main, *pending.loaded);
+                continue;
             }
 
-            vkCmdEndRenderPass(currentCB);
-            CheckResult(vkEndCommandBuffer(currentCB));
+            std::swap(_scene, *pending.loaded->model);
+            std::swap(_sceneDescriptorPool, pending.loaded->descriptorPool);
+            _retiredModels.emplace_back(std::move(pending.loaded));
+            std::fill(_staleCommandBuffers.begin(), _staleCommandBuffers.end(), true);
         }
 
-        vkDeviceWaitIdle(main.GetDevice());
+        // AcquireNextImage waited for the last submission of this image, so its command buffer is free to record
+        if (currentBuffer < _staleCommandBuffers.size() && _staleCommandBuffers[currentBuffer]) {
+            RecordBuffer(main, currentBuffer);
+            _staleCommandBuffers[currentBuffer] = false;
+
+            // Once every image is recorded again no submitted work can reference a replaced model
+            if (std::none_of(_staleCommandBuffers.begin(), _staleCommandBuffers.end(), [](bool stale) { return stale; })) {
+                DestroyRetiredModels(main);
+            }
+        }
     }
 
+
     void Scene::OnUniformBufferSets(uint32_t currentBuffer) {
         if(false == _sceneUniBufs.empty()) {
             constexpr auto uniDataSize = sizeof(UniformData);
@@ -687,6 +1040,17 @@ namespace Vk {
             memcpy_s(_sceneShaderValueUniBufs[currentBuffer].mapped, shaderValueSize, &_sceneShaderValue, shaderValueSize);
         }
 
+        if (_gpuNodeTransforms) {
+            _nodeTransforms.Upload(currentBuffer, _scene.graph);
+        }
+
+        // A stale command buffer still draws a replaced model with the commands it was recorded with
+        // GPU node transforms take precedence over exact levels, the CPU world matrices stay at the pose of the last CPU
+        // update and animated nodes are measured there, camera movement still changes every level
+        if (_lodSelection && _scene.drawCount > 0 && currentBuffer < _staleCommandBuffers.size() && false == _staleCommandBuffers[currentBuffer]) {
+            _scene.SelectLods(_lodView, _lodPixelsPerUnit * _viewportHeight, _lodPixelError, static_cast<VkDrawIndexedIndirectCommand*>(_drawCommandBufs[currentBuffer].mapped));
+        }
+
         _cubeMap.OnSkyboxUniformBuffrSet(currentBuffer);
     }
 }
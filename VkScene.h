@@ -5,6 +5,8 @@
 #include "VulkanModel.h"
 #include "VkCubeMap.h"
 #include "VkBuffer.h"
+#include "VkNodeTransforms.h"
+#include "VkMeshletCulling.h"
 
 namespace Vk {
     class Main;
@@ -30,19 +32,40 @@ namespace Vk {
 
     using VkDescriptorSets = std::vector<VkDescriptorSet>;
 
+    // Becomes ready with the load result once the model is resident, it is shown from the next frame boundary on
+    using SceneLoadHandle = std::shared_future<bool>;
+
     class Scene {
     public:
         bool                        Initialize(const Main& main, std::string&& environmentMapPath);
         void                        Release(const Main& main);
 
-        void                        LoadScene(const Main& main, std::string&& filename);
+        // Parsing, decoding and uploads run on the thread pool, the render loop keeps presenting meanwhile
+        SceneLoadHandle             LoadSceneAsync(const Main& main, std::string&& filename);
 
         void                        UpdateUniformDatas(const glm::mat4& view, const glm::mat4& perspective, const glm::vec3& cameraPos, const glm::vec4& lightDir);
         void                        RecordBuffers(const Main& main);
 
+        // Called after the swap chain image is acquired: swaps in finished loads and re-records a stale command buffer
+        void                        OnFrameBoundary(const Main& main, uint32_t currentBuffer);
         void                        OnUniformBufferSets(uint32_t currentBuffer);
 
     private:
+        struct LoadedModel {
+            std::unique_ptr<Model>  model = std::make_unique<Model>();
+            VkDescriptorPool        descriptorPool = VK_NULL_HANDLE;
+        };
+
+        struct PendingLoad {
+            std::shared_ptr<LoadedModel> loaded;
+            SceneLoadHandle         handle;
+        };
+
+        bool                        LoadModel(const Main& main, const std::string& filename, LoadedModel& loaded) const;
+        void                        DestroyModel(const Main& main, LoadedModel& loaded);
+        void                        DestroyRetiredModels(const Main& main);
+        void                        RecordBuffer(const Main& main, uint32_t index);
+
         void                        InitializeUniformBuffers(const Main& main);
         void                        CreateDescriptorPool(const Main& main);
         void                        CreateSceneDescriptorLayout(const Main& main);
@@ -51,11 +74,35 @@ namespace Vk {
         void                        CreatePipelines(const Main& main);
 
         void                        SetupSceneDescriptorSet(const Main& main);
-        void                        SetupMaterialDescriptorSet(const Main& main);
-        void                        SetupNodeDescriptorSet(const Main& main);
+        VkDescriptorPool            CreateModelDescriptorPool(const Main& main, const Model& model) const;
+        void                        SetupMaterialDescriptorSet(const Main& main, Model& model, VkDescriptorPool descriptorPool) const;
+        void                        SetupNodeDescriptorSet(const Main& main, Model& model, VkDescriptorPool descriptorPool) const;
 
         CubeMap                     _cubeMap;
         Model                       _scene;
+        VkDescriptorPool            _sceneDescriptorPool = VK_NULL_HANDLE;
+
+        std::deque<PendingLoad>     _pendingLoads;
+        std::vector<std::shared_ptr<LoadedModel>> _retiredModels;   // Replaced models, still referenced by stale command buffers
+        std::vector<bool>           _staleCommandBuffers;
+
+        NodeTransforms              _nodeTransforms;
+        bool                        _gpuNodeTransforms = false;
+
+        // Indirect draw commands of every image, rewritten with the selected LOD of each primitive every frame
+        Buffers                     _drawCommandBufs;
+        bool                        _lodSelection = false;
+        float                       _lodPixelError = 1.0f;
+        glm::mat4                   _lodView{ glm::identity<glm::mat4>() };     // View times the model matrix of the scene
+        float                       _lodPixelsPerUnit = 0.0f;       // Per viewport height at distance one
+        float                       _viewportHeight = 0.0f;
+
+        MeshletCulling              _meshletCulling;
+        bool                        _cullMeshlets = false;
+
+        VertexFormat                _vertexFormat = VertexFormat::Float;
+        bool                        _splitStreams = false;
+        bool                        _vertexTangents = false;
 
         ShaderValues                _sceneShaderValue;
         UniformData                 _sceneUniData;
@@ -71,5 +118,8 @@ namespace Vk {
         VkPipelineLayout            _pipelineLayout = VK_NULL_HANDLE;
         VkPipeline                  _opaquePipeline = VK_NULL_HANDLE;
         VkPipeline                  _alphaBlendPipeline = VK_NULL_HANDLE;
+        VkPipeline                  _skinnedOpaquePipeline = VK_NULL_HANDLE;    // Packed vertex formats read the skin stream for skinned meshes only
+        VkPipeline                  _skinnedAlphaBlendPipeline = VK_NULL_HANDLE;
+        VkPipeline                  _depthPipeline = VK_NULL_HANDLE;            // Settings::depthPrepass
     };
 }
@@ -6,13 +6,17 @@
 #include "VulkanDevice.h"
 
 namespace Vk {
+    namespace {
+        const std::string ShaderDirectory = "./../data/shaders/";
+    }
+
     VkPipelineShaderStageCreateInfo LoadShader(VkDevice device, const std::string& filename, VkShaderStageFlagBits stage) {
         VkPipelineShaderStageCreateInfo shaderStage{};
         shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         shaderStage.stage = stage;
         shaderStage.pName = "main";
 
-        std::ifstream is("./../data/shaders/" + filename, std::ios::binary | std::ios::in | std::ios::ate);
+        std::ifstream is(ShaderDirectory + filename, std::ios::binary | std::ios::in | std::ios::ate);
 
         if (is.is_open()) {
             size_t size = is.tellg();
@@ -37,6 +41,10 @@ namespace Vk {
         return shaderStage;
     }
 
+    bool ShaderExists(const std::string& filename) {
+        return std::ifstream(ShaderDirectory + filename, std::ios::binary | std::ios::in).is_open();
+    }
+
     void ReadDirectory(const std::string& directory, const std::string& pattern, std::map<std::string, std::string>& filelist, bool recursive) {
         std::string searchpattern(directory + "/" + pattern);
         WIN32_FIND_DATAA data;
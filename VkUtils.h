@@ -16,6 +16,8 @@ namespace Vk
     }
 
     VkPipelineShaderStageCreateInfo LoadShader(VkDevice device, const std::string& filename, VkShaderStageFlagBits stage);
+    // Optional shaders are probed before loading, LoadShader asserts on a missing file
+    bool ShaderExists(const std::string& filename);
 
     void ReadDirectory(const std::string& directory, const std::string& pattern, std::map<std::string, std::string>& filelist, bool recursive);
 
@@ -26,6 +26,9 @@ namespace Vk {
     }
 
     VulkanDevice::~VulkanDevice() {
+        for (auto& threadCommandPool : threadCommandPools) {
+            vkDestroyCommandPool(logicalDevice, threadCommandPool.second, nullptr);
+        }
         if (commandPool) {
             vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
         }
@@ -140,6 +143,7 @@ namespace Vk {
 
         if (result == VK_SUCCESS) {
             commandPool = CreateCommandPool(queueFamilyIndices.graphics);
+            commandPoolThread = std::this_thread::get_id();
         }
 
         this->enabledFeatures = inEnabledFeatures;
@@ -147,7 +151,7 @@ namespace Vk {
         return result;
     }
 
-    VkResult VulkanDevice::CreateBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer* buffer, VkDeviceMemory* memory, void* data) {
+    VkResult VulkanDevice::CreateBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer* buffer, VkDeviceMemory* memory, const void* data) {
         // Create the buffer handle
         VkBufferCreateInfo bufferCreateInfo{};
         bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -202,7 +206,7 @@ namespace Vk {
     VkCommandBuffer VulkanDevice::CreateCommandBuffer(VkCommandBufferLevel level, bool begin) {
         VkCommandBufferAllocateInfo cmdBufAllocateInfo{};
         cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        cmdBufAllocateInfo.commandPool = commandPool;
+        cmdBufAllocateInfo.commandPool = GetThreadCommandPool();
         cmdBufAllocateInfo.level = level;
         cmdBufAllocateInfo.commandBufferCount = 1;
 
@@ -240,14 +244,36 @@ namespace Vk {
         CheckResult(vkCreateFence(logicalDevice, &fenceInfo, nullptr, &fence));
 
         // Submit to the queue
-        CheckResult(vkQueueSubmit(queue, 1, &submitInfo, fence));
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            CheckResult(vkQueueSubmit(queue, 1, &submitInfo, fence));
+        }
         // Wait for the fence to signal that command buffer has finished executing
         CheckResult(vkWaitForFences(logicalDevice, 1, &fence, VK_TRUE, 100000000000));
 
         vkDestroyFence(logicalDevice, fence, nullptr);
 
         if (free) {
-            vkFreeCommandBuffers(logicalDevice, commandPool, 1, &commandBuffer);
+            vkFreeCommandBuffers(logicalDevice, GetThreadCommandPool(), 1, &commandBuffer);
+        }
+    }
+
+    VkCommandPool VulkanDevice::GetThreadCommandPool() {
+        const auto thread = std::this_thread::get_id();
+        if (thread == commandPoolThread) {
+            return commandPool;
         }
+
+        std::lock_guard<std::mutex> lock(threadCommandPoolMutex);
+        auto& threadCommandPool = threadCommandPools[thread];
+        if (VK_NULL_HANDLE == threadCommandPool) {
+            threadCommandPool = CreateCommandPool(queueFamilyIndices.graphics);
+        }
+        return threadCommandPool;
+    }
+
+    void VulkanDevice::WaitIdle() {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        vkDeviceWaitIdle(logicalDevice);
     }
 }
@@ -13,6 +13,14 @@ namespace Vk {
         std::vector<VkQueueFamilyProperties> queueFamilyProperties;
         VkCommandPool commandPool = VK_NULL_HANDLE;
 
+        // Queues are shared by the render thread and loader threads, every submit, present and wait idle goes through this lock
+        std::mutex queueMutex;
+
+        // commandPool belongs to the thread that created the device, other threads record from pools of their own
+        std::thread::id commandPoolThread;
+        std::mutex threadCommandPoolMutex;
+        std::unordered_map<std::thread::id, VkCommandPool> threadCommandPools;
+
         struct {
             uint32_t graphics = 0;
             uint32_t compute = 0;
@@ -81,7 +89,7 @@ namespace Vk {
         *
         * @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
         */
-        VkResult CreateBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer* buffer, VkDeviceMemory* memory, void* data = nullptr);
+        VkResult CreateBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer* buffer, VkDeviceMemory* memory, const void* data = nullptr);
 
         /**
         * Create a command pool for allocation command buffers from
@@ -96,7 +104,16 @@ namespace Vk {
         VkCommandPool CreateCommandPool(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags createFlags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
         /**
-        * Allocate a command buffer from the command pool
+        * Get the command pool of the calling thread
+        *
+        * @note Threads other than the one that created the device get a pool of their own on first use, it lives as long as the device
+        *
+        * @return commandPool on the creating thread, the thread's own pool otherwise
+        */
+        VkCommandPool GetThreadCommandPool();
+
+        /**
+        * Allocate a command buffer from the command pool of the calling thread
         *
         * @param level Level of the new command buffer (primary or secondary)
         * @param (Optional) begin If true, recording on the new command buffer will be started (vkBeginCommandBuffer) (Defaults to false)
@@ -118,5 +135,10 @@ namespace Vk {
         * @note Uses a fence to ensure command buffer has finished executing
         */
         void FlushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free = true);
+
+        /**
+        * vkDeviceWaitIdle under the queue lock
+        */
+        void WaitIdle();
     };
 }
@@ -7,6 +7,8 @@
 #define TINYGLTF_IMPLEMENTATION
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 #define STB_IMAGE_IMPLEMENTATION
+// Images are decoded on several threads, the failure string is a global without synchronization
+#define STBI_NO_FAILURE_STRINGS
 #define STBI_MSC_SECURE_CRT
 #include <tinygltf/tiny_gltf.h>
 #pragma warning(default : 4100)
@@ -18,9 +20,152 @@
 #endif
 
 #include "VkUtils.h"
+#include "GltfAccessor.h"
+#include "GltfBuffers.h"
+#include "GltfDocument.h"
+#include "GltfImages.h"
+#include "GltfMeshopt.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "ThreadPool.h"
 #include "VulkanDevice.h"
 
 namespace Vk {
+    namespace {
+        // Smaller primitives are cheaper to draw whole than to store levels for
+        constexpr uint32_t LOD_MIN_INDEX_COUNT = 256 * 3;
+
+        // Vertex buffers of one model in the layouts of its format, see VertexStreams
+        struct PackedStreams {
+            std::vector<uint8_t> vertices;
+            std::vector<uint8_t> positions;
+            std::vector<uint8_t> skin;
+        };
+
+        /*
+            Packs vertex v into element remap[v] of a stream of Layout, quantized within the cube of contexts[v].
+            Vertices remapped to streamCount or beyond have no element in this stream
+        */
+        template<typename Layout>
+        std::vector<uint8_t> PackStream(const Model::Vertex* vertices, size_t vertexCount, const uint32_t* remap, const VertexPackContext* contexts, size_t streamCount) {
+            std::vector<uint8_t> stream(streamCount * Layout::stride);
+            for (size_t v = 0; v < vertexCount; ++v) {
+                if (remap[v] < streamCount) {
+                    Layout::Pack(vertices[v], contexts[v], stream.data() + remap[v] * static_cast<size_t>(Layout::stride));
+                }
+            }
+            return stream;
+        }
+
+        template<VertexFormat Format>
+        PackedStreams PackVertexStreams(const Model::Vertex* vertices, size_t vertexCount, const uint32_t* remap, const VertexPackContext* contexts, size_t skinnedCount, bool splitStreams) {
+            using Streams = VertexStreams<Format>;
+            PackedStreams result;
+            if (splitStreams) {
+                result.positions = PackStream<typename Streams::Position>(vertices, vertexCount, remap, contexts, vertexCount);
+                result.vertices = PackStream<typename Streams::Attributes>(vertices, vertexCount, remap, contexts, vertexCount);
+            }
+            else {
+                result.vertices = PackStream<typename Streams::Interleaved>(vertices, vertexCount, remap, contexts, vertexCount);
+            }
+            if constexpr (Streams::skinStream) {
+                result.skin = PackStream<typename Streams::Skin>(vertices, vertexCount, remap, contexts, skinnedCount);
+            }
+            return result;
+        }
+
+        template<VertexFormat Format>
+        VertexInputDescription DescribeStreams(bool splitStreams) {
+            using Streams = VertexStreams<Format>;
+            constexpr auto interleaved = Streams::Interleaved::Describe(0);
+            constexpr auto positions = Streams::Position::Describe(4);
+            constexpr auto attributes = Streams::Attributes::Describe(0);
+            static_assert(0 == interleaved[0].location && 1 == positions.size(), "Position passes expect the position first");
+            static_assert(interleaved.size() == positions.size() + attributes.size(), "Split streams have to hold the same attributes");
+
+            VertexInputDescription result;
+            if (splitStreams) {
+                result.bindings = { Streams::Attributes::Binding(0), Streams::Position::Binding(4) };
+                result.attributes.assign(positions.begin(), positions.end());
+                result.attributes.insert(result.attributes.end(), attributes.begin(), attributes.end());
+                result.positionBinding = result.bindings[1];
+                result.positionAttribute = positions[0];
+            }
+            else {
+                result.bindings = { Streams::Interleaved::Binding(0) };
+                result.attributes.assign(interleaved.begin(), interleaved.end());
+                result.positionBinding = result.bindings[0];
+                result.positionAttribute = interleaved[0];
+            }
+            if constexpr (Streams::skinStream) {
+                constexpr auto skin = Streams::Skin::Describe(3);
+                result.skinBindings = { Streams::Skin::Binding(3) };
+                result.skinAttributes.assign(skin.begin(), skin.end());
+            }
+            return result;
+        }
+
+        // Rounds the axis to snorm8 and widens the cone by the angle that costs, the cutoff rounds up so culling stays conservative
+        void EncodeMeshletCone(const MeshletBounds& bounds, int8_t* cone) {
+            if (bounds.coneCutoff >= 1.0f) {
+                return;
+            }
+            const glm::vec3 axis = glm::round(glm::clamp(bounds.coneAxis, -1.0f, 1.0f) * 127.0f);
+            const float axisError = std::acos(glm::clamp(glm::dot(glm::normalize(axis), bounds.coneAxis), -1.0f, 1.0f));
+            const float spread = std::asin(bounds.coneCutoff) + axisError;
+            if (spread >= glm::half_pi<float>()) {
+                return;
+            }
+            cone[0] = static_cast<int8_t>(axis.x);
+            cone[1] = static_cast<int8_t>(axis.y);
+            cone[2] = static_cast<int8_t>(axis.z);
+            cone[3] = static_cast<int8_t>(std::min(std::ceil(std::sin(spread) * 127.0f), 127.0f));
+        }
+
+        struct BufferUpload {
+            const void* data = nullptr;
+            VkDeviceSize size = 0;
+            VkBufferUsageFlags usage = 0;
+            VkBuffer* buffer = nullptr;
+            VkDeviceMemory* memory = nullptr;
+        };
+
+        // Creates a device local buffer for every upload and fills them through staging buffers in one submission.
+        // The buffers can be copied from as well, which lets the console tests read them back
+        void UploadDeviceLocal(VulkanDevice& device, const std::vector<BufferUpload>& uploads, VkQueue transferQueue) {
+            std::vector<std::pair<VkBuffer, VkDeviceMemory>> staging(uploads.size());
+            for (size_t i = 0; i < uploads.size(); ++i) {
+                const BufferUpload& upload = uploads[i];
+                CheckResult(device.CreateBuffer(
+                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                    upload.size,
+                    &staging[i].first,
+                    &staging[i].second,
+                    upload.data));
+                CheckResult(device.CreateBuffer(
+                    upload.usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    upload.size,
+                    upload.buffer,
+                    upload.memory));
+            }
+
+            VkCommandBuffer copyCmd = device.CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+            for (size_t i = 0; i < uploads.size(); ++i) {
+                VkBufferCopy copyRegion = {};
+                copyRegion.size = uploads[i].size;
+                vkCmdCopyBuffer(copyCmd, staging[i].first, *uploads[i].buffer, 1, &copyRegion);
+            }
+            device.FlushCommandBuffer(copyCmd, transferQueue, true);
+
+            for (const auto& [buffer, memory] : staging) {
+                vkDestroyBuffer(device.logicalDevice, buffer, nullptr);
+                vkFreeMemory(device.logicalDevice, memory, nullptr);
+            }
+        }
+    }
+
     // BoundingBox
     BoundingBox BoundingBox::GetAABB(glm::mat4 m) {
         glm::vec3 min = glm::vec3(m[3]);
@@ -62,19 +207,14 @@ namespace Vk {
         vkDestroySampler(device->logicalDevice, sampler, nullptr);
     }
 
-    void ModelTexture::FromgltfImage(tinygltf::Image& gltfimage, TextureSampler textureSampler, Vk::VulkanDevice* inDevice, VkQueue copyQueue) {
-        this->device = inDevice;
-
-        unsigned char* buffer = nullptr;
-        VkDeviceSize bufferSize = 0;
-        bool deleteBuffer = false;
+    const unsigned char* ModelTexture::GetPixels(const tinygltf::Image& gltfimage, std::vector<unsigned char>& converted, VkDeviceSize& bufferSize) {
         if (gltfimage.component == 3) {
             // Most devices don't support RGB only on Vulkan so convert if necessary
             // TODO: Check actual format support and transform only if required
             bufferSize = gltfimage.width * gltfimage.height * 4;
-            buffer = new unsigned char[bufferSize];
-            unsigned char* rgba = buffer;
-            unsigned char* rgb = &gltfimage.image[0];
+            converted.assign(static_cast<size_t>(bufferSize), 0xff);
+            unsigned char* rgba = converted.data();
+            const unsigned char* rgb = &gltfimage.image[0];
             for (int32_t i = 0; i < gltfimage.width * gltfimage.height; ++i) {
                 for (int32_t j = 0; j < 3; ++j) {
                     rgba[j] = rgb[j];
@@ -82,19 +222,30 @@ namespace Vk {
                 rgba += 4;
                 rgb += 3;
             }
-            deleteBuffer = true;
-        }
-        else {
-            buffer = &gltfimage.image[0];
-            bufferSize = gltfimage.image.size();
+            return converted.data();
         }
 
+        bufferSize = gltfimage.image.size();
+        return &gltfimage.image[0];
+    }
+
+    void ModelTexture::FromgltfImage(const tinygltf::Image& gltfimage, TextureSampler textureSampler, Vk::VulkanDevice* inDevice, VkQueue copyQueue) {
+        std::vector<unsigned char> converted;
+        VkDeviceSize bufferSize = 0;
+        const unsigned char* buffer = GetPixels(gltfimage, converted, bufferSize);
+
+        FromPixels(buffer, bufferSize, static_cast<uint32_t>(gltfimage.width), static_cast<uint32_t>(gltfimage.height), textureSampler, inDevice, copyQueue);
+    }
+
+    void ModelTexture::FromPixels(const unsigned char* buffer, VkDeviceSize bufferSize, uint32_t imageWidth, uint32_t imageHeight, TextureSampler textureSampler, Vk::VulkanDevice* inDevice, VkQueue copyQueue) {
+        this->device = inDevice;
+
         VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
 
         VkFormatProperties formatProperties;
 
-        width = gltfimage.width;
-        height = gltfimage.height;
+        width = imageWidth;
+        height = imageHeight;
         mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
 
         vkGetPhysicalDeviceFormatProperties(inDevice->physicalDevice, format, &formatProperties);
@@ -292,16 +443,12 @@ namespace Vk {
         descriptor.sampler = sampler;
         descriptor.imageView = view;
         descriptor.imageLayout = imageLayout;
-
-        if (deleteBuffer)
-            delete[] buffer;
-
     }
 
     // Mesh
-    Mesh::Mesh(Vk::VulkanDevice* device, glm::mat4 matrix) {
+    Mesh::Mesh(Vk::VulkanDevice* device, int32_t skinIndex) {
         this->device = device;
-        this->uniformBlock.matrix = matrix;
+        this->skinIndex = skinIndex;
         CheckResult(device->CreateBuffer(
             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
@@ -316,61 +463,24 @@ namespace Vk {
     Mesh::~Mesh() {
         vkDestroyBuffer(device->logicalDevice, uniformBuffer.buffer, nullptr);
         vkFreeMemory(device->logicalDevice, uniformBuffer.memory, nullptr);
-        for (Primitive* p : primitives)
-            delete p;
-    }
-
-    // Node
-    glm::mat4 Node::LocalMatrix() {
-        return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
-    }
-
-    glm::mat4 Node::GetMatrix() {
-        glm::mat4 m = LocalMatrix();
-        Node* p = parent;
-        while (p) {
-            m = p->LocalMatrix() * m;
-            p = p->parent;
-        }
-        return m;
     }
 
-    void Node::Update() {
-        if (mesh) {
-            glm::mat4 m = GetMatrix();
-            if (skin) {
-                mesh->uniformBlock.matrix = m;
-                // Update join matrices
-                glm::mat4 inverseTransform = glm::inverse(m);
-                size_t numJoints = std::min((uint32_t)skin->joints.size(), MAX_NUM_JOINTS);
-                for (size_t i = 0; i < numJoints; i++) {
-                    Node* jointNode = skin->joints[i];
-                    glm::mat4 jointMat = jointNode->GetMatrix() * skin->inverseBindMatrices[i];
-                    jointMat = inverseTransform * jointMat;
-                    mesh->uniformBlock.jointMatrix[i] = jointMat;
-                }
-                mesh->uniformBlock.jointcount = (float)numJoints;
-                memcpy(mesh->uniformBuffer.mapped, &mesh->uniformBlock, sizeof(mesh->uniformBlock));
-            }
-            else {
-                memcpy(mesh->uniformBuffer.mapped, &m, sizeof(glm::mat4));
-            }
-        }
-
-        for (auto& child : children) {
-            child->Update();
+    // InstanceTransform
+    InstanceTransform::InstanceTransform(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale) : translation(translation), scale(scale) {
+        const glm::quat unit = glm::normalize(rotation);
+        const float components[4] = { unit.x, unit.y, unit.z, unit.w };
+        for (size_t i = 0; i < 4; ++i) {
+            this->rotation[i] = static_cast<int16_t>(std::round(glm::clamp(components[i], -1.0f, 1.0f) * 32767.0f));
         }
     }
 
-    Node::~Node() {
-        if (mesh) {
-            delete mesh;
-            mesh = nullptr;
-        }
-
-        for (auto& child : children) {
-            delete child;
+    glm::mat4 InstanceTransform::GetMatrix() const {
+        // Decoded like VK_FORMAT_R16G16B16A16_SNORM
+        float components[4];
+        for (size_t i = 0; i < 4; ++i) {
+            components[i] = std::max(rotation[i] / 32767.0f, -1.0f);
         }
+        return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(glm::make_quat(components)) * glm::scale(glm::mat4(1.0f), scale);
     }
 
     // Model
@@ -383,243 +493,461 @@ namespace Vk {
             vkDestroyBuffer(inDevice, indices.buffer, nullptr);
             vkFreeMemory(inDevice, indices.memory, nullptr);
         }
+        if (instances.buffer != VK_NULL_HANDLE) {
+            vkUnmapMemory(inDevice, instances.memory);
+            vkDestroyBuffer(inDevice, instances.buffer, nullptr);
+            vkFreeMemory(inDevice, instances.memory, nullptr);
+            instances = {};
+        }
+        if (positions.buffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(inDevice, positions.buffer, nullptr);
+            vkFreeMemory(inDevice, positions.memory, nullptr);
+            positions = {};
+        }
+        if (skinVertices.buffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(inDevice, skinVertices.buffer, nullptr);
+            vkFreeMemory(inDevice, skinVertices.memory, nullptr);
+            skinVertices = {};
+        }
+        if (instanceTransforms.buffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(inDevice, instanceTransforms.buffer, nullptr);
+            vkFreeMemory(inDevice, instanceTransforms.memory, nullptr);
+            instanceTransforms = {};
+        }
+        if (meshlets.buffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(inDevice, meshlets.buffer, nullptr);
+            vkFreeMemory(inDevice, meshlets.memory, nullptr);
+        }
+        meshlets = {};
         for (auto texture : textures) {
             texture.Destroy();
         }
         textures.resize(0);
         textureSamplers.resize(0);
-        for (auto node : nodes) {
-            delete node;
-        }
+        nodePool.Clear();
+        meshPool.Clear();
+        primitivePool.Clear();
+        skinPool.Clear();
         materials.resize(0);
         animations.resize(0);
-        nodes.resize(0);
+        graph.Clear();
         linearNodes.resize(0);
+        meshes.resize(0);
+        instanceSlots.resize(0);
+        nodeInstances.resize(0);
+        instanceLocals.resize(0);
+        drawCount = 0;
         extensions.resize(0);
         skins.resize(0);
     };
 
-    void Model::LoadNode(Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale) {
-        Node* newNode = new Node{};
-        newNode->index = nodeIndex;
-        newNode->parent = parent;
-        newNode->name = node.name;
+    void Model::LoadNode(int32_t parent, const GltfDocument::Node& node, uint32_t nodeIndex, const GltfDocument& document, LoaderInfo& loaderInfo, float globalscale) {
+        // The slot is taken before the children are loaded, which keeps parents ahead of their children
+        const uint32_t slot = graph.Add(parent, nodeIndex, node.name);
+        Node* newNode = nodePool.New();
+        newNode->slot = slot;
         newNode->skinIndex = node.skin;
-        newNode->matrix = glm::mat4(1.0f);
+        linearNodes.push_back(newNode);
 
         // Generate local node matrix
-        glm::vec3 translation = glm::vec3(0.0f);
-        if (node.translation.size() == 3) {
-            translation = glm::make_vec3(node.translation.data());
-            newNode->translation = translation;
-        }
-        if (node.rotation.size() == 4) {
-            glm::quat q = glm::make_quat(node.rotation.data());
-            newNode->rotation = glm::mat4(q);
-        }
-        glm::vec3 scale = glm::vec3(1.0f);
-        if (node.scale.size() == 3) {
-            scale = glm::make_vec3(node.scale.data());
-            newNode->scale = scale;
-        }
-        if (node.matrix.size() == 16) {
-            newNode->matrix = glm::make_mat4x4(node.matrix.data());
+        if (node.hasTranslation) {
+            graph.SetTranslation(slot, glm::make_vec3(node.translation));
+        }
+        if (node.hasRotation) {
+            graph.SetRotation(slot, glm::make_quat(node.rotation));
+        }
+        if (node.hasScale) {
+            graph.SetScale(slot, glm::make_vec3(node.scale));
+        }
+        if (node.hasMatrix) {
+            graph.SetMatrix(slot, glm::make_mat4x4(node.matrix));
         };
+        if (nullptr != node.gpuInstancing && node.mesh > -1) {
+            LoadNodeInstances(document, *node.gpuInstancing, *newNode);
+        }
 
         // Node with children
         if (!node.children.empty()) {
             for (int i : node.children) {
-                LoadNode(newNode, model.nodes[i], i, model, indexBuffer, vertexBuffer, globalscale);
+                LoadNode(static_cast<int32_t>(slot), document.nodes[i], i, document, loaderInfo, globalscale);
             }
         }
 
         // Node contains mesh data
+        // Only ranges are reserved here, vertex and index data is converted afterwards by LoadPrimitives
         if (node.mesh > -1) {
-            const tinygltf::Mesh mesh = model.meshes[node.mesh];
-            Mesh* newMesh = new Mesh(device, newNode->matrix);
+            // Nodes drawing the same mesh with the same skin become instances of one Mesh
+            const uint64_t meshKey = (static_cast<uint64_t>(node.mesh) << 32) | static_cast<uint32_t>(node.skin + 1);
+            Mesh*& sharedMesh = loaderInfo.sharedMeshes[meshKey];
+            if (nullptr != sharedMesh) {
+                newNode->mesh = sharedMesh;
+                return;
+            }
+
+            Mesh* newMesh = meshPool.New(device, node.skin);
+            sharedMesh = newMesh;
+            newNode->mesh = newMesh;
+
+            // Another skin of an already loaded mesh draws the same vertices
+            if (loaderInfo.meshes.size() <= static_cast<size_t>(node.mesh)) {
+                loaderInfo.meshes.resize(node.mesh + 1, nullptr);
+            }
+            if (nullptr != loaderInfo.meshes[node.mesh]) {
+                newMesh->primitives = loaderInfo.meshes[node.mesh]->primitives;
+                newMesh->bb = loaderInfo.meshes[node.mesh]->bb;
+                return;
+            }
+            loaderInfo.meshes[node.mesh] = newMesh;
+
+            const GltfDocument::Mesh& mesh = document.meshes[node.mesh];
+            primitivePool.Reserve(mesh.primitives.size());
             for (const auto& primitive : mesh.primitives) {
-                auto indexStart = static_cast<uint32_t>(indexBuffer.size());
-                auto vertexStart = static_cast<uint32_t>(vertexBuffer.size());
-                uint32_t indexCount = 0;
-                uint32_t vertexCount = 0;
+                PrimitiveLoad load{};
+                load.source = &primitive;
+                load.firstVertex = loaderInfo.vertexCount;
+                load.firstIndex = loaderInfo.indexCount;
+
+                // Position attribute is required, the document has checked it is there
+                const int32_t posAccessor = primitive.FindAttribute("POSITION");
+                assert(posAccessor > -1);
+
                 glm::vec3 posMin{};
                 glm::vec3 posMax{};
-                bool hasSkin = false;
-                bool hasIndices = primitive.indices > -1;
-                // Vertices
-                {
-                    const float* bufferPos = nullptr;
-                    const float* bufferNormals = nullptr;
-                    const float* bufferTexCoordSet0 = nullptr;
-                    const float* bufferTexCoordSet1 = nullptr;
-                    const uint16_t* bufferJoints = nullptr;
-                    const float* bufferWeights = nullptr;
-
-                    // Position attribute is required
-                    assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
-
-                    const tinygltf::Accessor& posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
-                    const tinygltf::BufferView& posView = model.bufferViews[posAccessor.bufferView];
-                    bufferPos = reinterpret_cast<const float*>(&(model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]));
-                    posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
-                    posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
-                    vertexCount = static_cast<uint32_t>(posAccessor.count);
-
-                    if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
-                        const tinygltf::Accessor& normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
-                        const tinygltf::BufferView& normView = model.bufferViews[normAccessor.bufferView];
-                        bufferNormals = reinterpret_cast<const float*>(&(model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
-                    }
+                if (GetAccessorView(document, posAccessor).valid) {
+                    GetPositionBounds(document, posAccessor, posMin, posMax);
+                    load.vertexCount = static_cast<uint32_t>(document.accessors[posAccessor].count);
+                }
+                else {
+                    std::cerr << "Position accessor " << posAccessor << " is out of bounds!" << std::endl;
+                }
 
-                    if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
-                        const tinygltf::Accessor& uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-                        const tinygltf::BufferView& uvView = model.bufferViews[uvAccessor.bufferView];
-                        bufferTexCoordSet0 = reinterpret_cast<const float*>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-                    }
-                    if (primitive.attributes.find("TEXCOORD_1") != primitive.attributes.end()) {
-                        const tinygltf::Accessor& uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_1")->second];
-                        const tinygltf::BufferView& uvView = model.bufferViews[uvAccessor.bufferView];
-                        bufferTexCoordSet1 = reinterpret_cast<const float*>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
+                if (primitive.indices > -1 && load.vertexCount > 0) {
+                    const GltfDocument::Accessor& accessor = document.accessors[primitive.indices];
+                    switch (accessor.componentType) {
+                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
+                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
+                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
+                        if (GetAccessorView(document, primitive.indices).valid) {
+                            load.indexCount = static_cast<uint32_t>(accessor.count);
+                        }
+                        else {
+                            std::cerr << "Index accessor " << primitive.indices << " is out of bounds!" << std::endl;
+                        }
+                        break;
+                    default:
+                        std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
+                        break;
                     }
+                }
 
-                    // Skinning
-                    // Joints
-                    if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end()) {
-                        const tinygltf::Accessor& jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
-                        const tinygltf::BufferView& jointView = model.bufferViews[jointAccessor.bufferView];
-                        bufferJoints = reinterpret_cast<const uint16_t*>(&(model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]));
-                    }
+                loaderInfo.vertexCount += load.vertexCount;
+                loaderInfo.indexCount += load.indexCount;
+                loaderInfo.primitives.push_back(load);
 
-                    if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end()) {
-                        const tinygltf::Accessor& uvAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
-                        const tinygltf::BufferView& uvView = model.bufferViews[uvAccessor.bufferView];
-                        bufferWeights = reinterpret_cast<const float*>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-                    }
+                Primitive* newPrimitive = primitivePool.New(load.firstIndex, load.indexCount, load.vertexCount, primitive.material > -1 ? materials[primitive.material] : materials.back());
+                newPrimitive->firstVertex = load.firstVertex;
+                newPrimitive->SetBoundingBox(posMin, posMax);
+                loaderInfo.primitives.back().primitive = newPrimitive;
+                newMesh->primitives.data = newMesh->primitives.empty() ? newPrimitive : newMesh->primitives.data;
+                ++newMesh->primitives.count;
+            }
+            // Mesh BB from BBs of primitives
+            for (const Primitive& p : newMesh->primitives) {
+                if (p.bb.valid && !newMesh->bb.valid) {
+                    newMesh->bb = p.bb;
+                    newMesh->bb.valid = true;
+                }
+                newMesh->bb._min = glm::min(newMesh->bb._min, p.bb._min);
+                newMesh->bb._max = glm::max(newMesh->bb._max, p.bb._max);
+            }
+        }
+    }
 
-                    hasSkin = (bufferJoints && bufferWeights);
+    void Model::LoadPrimitives(const GltfDocument& document, const LoaderInfo& loaderInfo, const ModelImportOptions& options, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer) {
+        vertexBuffer.resize(loaderInfo.vertexCount);
+        indexBuffer.resize(loaderInfo.indexCount);
 
-                    for (size_t v = 0; v < posAccessor.count; v++) {
-                        Vertex vert{};
-                        vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * 3]), 1.0f);
-                        vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * 3]) : glm::vec3(0.0f)));
-                        vert.uv0 = bufferTexCoordSet0 ? glm::make_vec2(&bufferTexCoordSet0[v * 2]) : glm::vec3(0.0f);
-                        vert.uv1 = bufferTexCoordSet1 ? glm::make_vec2(&bufferTexCoordSet1[v * 2]) : glm::vec3(0.0f);
+        // Vertex cache statistics of every optimized primitive before and after
+        std::vector<std::array<VertexCacheStatistics, 2>> statistics(options.optimizeMeshes ? loaderInfo.primitives.size() : 0);
 
-                        vert.joint0 = hasSkin ? glm::vec4(glm::make_vec4(&bufferJoints[v * 4])) : glm::vec4(0.0f);
-                        vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * 4]) : glm::vec4(0.0f);
-                        vertexBuffer.push_back(vert);
-                    }
-                }
-                // Indices
-                if (hasIndices) {
-                    const tinygltf::Accessor& accessor = model.accessors[primitive.indices > -1 ? primitive.indices : 0];
-                    const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
-                    const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
+        // Simplified levels of every primitive, relative to its first vertex and its first level until they are appended behind all primitives
+        struct LodChain {
+            std::vector<uint32_t> indices;
+            std::array<PrimitiveLod, MAX_PRIMITIVE_LODS> lods{};
+            uint32_t lodCount = 0;
+        };
+        std::vector<LodChain> lodChains(options.generateLods ? loaderInfo.primitives.size() : 0);
 
-                    indexCount = static_cast<uint32_t>(accessor.count);
-                    const void* dataPtr = &(buffer.data[accessor.byteOffset + bufferView.byteOffset]);
+        // Every primitive owns a disjoint range of both buffers, so they can be converted in any order
+        ThreadPool::Get().ParallelFor(loaderInfo.primitives.size(), [&](size_t primitiveIndex) {
+            const PrimitiveLoad& load = loaderInfo.primitives[primitiveIndex];
+            const GltfDocument::Primitive& primitive = *load.source;
 
-                    switch (accessor.componentType) {
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-                        const auto* buf = static_cast<const uint32_t*>(dataPtr);
-                        for (size_t index = 0; index < accessor.count; index++) {
-                            indexBuffer.push_back(buf[index] + vertexStart);
-                        }
-                        break;
+            const auto attributeView = [&document, &primitive](const char* name) -> AccessorView {
+                const int32_t accessor = primitive.FindAttribute(name);
+                return accessor > -1 ? GetAccessorView(document, accessor) : AccessorView{};
+            };
+
+            // Vertices
+            {
+                const AccessorView posView = attributeView("POSITION");
+                const AccessorView normalView = attributeView("NORMAL");
+                const AccessorView uv0View = attributeView("TEXCOORD_0");
+                const AccessorView uv1View = attributeView("TEXCOORD_1");
+                const AccessorView tangentView = attributeView("TANGENT");
+                // Skinning
+                const AccessorView jointView = attributeView("JOINTS_0");
+                const AccessorView weightView = attributeView("WEIGHTS_0");
+
+                const bool hasSkin = (jointView.valid && weightView.valid);
+
+                // Attributes are converted in blocks so each block of vertices stays in cache while it is filled
+                constexpr size_t blockSize = 1024;
+                Vertex* dst = vertexBuffer.data() + load.firstVertex;
+                for (size_t first = 0; first < load.vertexCount; first += blockSize) {
+                    const size_t count = std::min(blockSize, load.vertexCount - first);
+                    Vertex* block = dst + first;
+
+                    ReadAccessor(posView, first, count, 3, &block->pos.x, sizeof(Vertex));
+                    ReadAccessor(normalView, first, count, 3, &block->normal.x, sizeof(Vertex));
+                    ReadAccessor(uv0View, first, count, 2, &block->uv0.x, sizeof(Vertex));
+                    ReadAccessor(uv1View, first, count, 2, &block->uv1.x, sizeof(Vertex));
+                    ReadAccessor(tangentView, first, count, 4, &block->tangent.x, sizeof(Vertex));
+                    if (hasSkin) {
+                        ReadAccessor(jointView, first, count, 4, &block->joint0.x, sizeof(Vertex));
+                        ReadAccessor(weightView, first, count, 4, &block->weight0.x, sizeof(Vertex));
                     }
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-                        const auto* buf = static_cast<const uint16_t*>(dataPtr);
-                        for (size_t index = 0; index < accessor.count; index++) {
-                            indexBuffer.push_back(buf[index] + vertexStart);
+
+                    // Quantized normals and tangents are not unit length
+                    if (normalView.valid) {
+                        for (size_t v = 0; v < count; v++) {
+                            block[v].normal = glm::normalize(block[v].normal);
                         }
-                        break;
                     }
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-                        const auto* buf = static_cast<const uint8_t*>(dataPtr);
-                        for (size_t index = 0; index < accessor.count; index++) {
-                            indexBuffer.push_back(buf[index] + vertexStart);
+                    if (tangentView.valid) {
+                        for (size_t v = 0; v < count; v++) {
+                            block[v].tangent = glm::vec4(glm::normalize(glm::vec3(block[v].tangent)), block[v].tangent.w < 0.0f ? -1.0f : 1.0f);
                         }
-                        break;
                     }
-                    default:
-                        std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
-                        return;
+                }
+            }
+            // Tangents of the normal map are generated from its texture coordinates, the primitive has no other use for them
+            const Material& material = load.primitive->material;
+            const bool generateTangents = options.generateTangents && nullptr != material.normalTexture && TINYGLTF_MODE_TRIANGLES == primitive.mode &&
+                primitive.FindAttribute("TANGENT") < 0 && primitive.FindAttribute("NORMAL") > -1 && primitive.FindAttribute(0 == material.texCoordSets.normal ? "TEXCOORD_0" : "TEXCOORD_1") > -1;
+            const auto tangentUVs = [&material](Vertex* vertices) { return 0 == material.texCoordSets.normal ? &vertices->uv0.x : &vertices->uv1.x; };
+            // Indices
+            if (load.indexCount > 0) {
+                uint32_t* indices = indexBuffer.data() + load.firstIndex;
+                if ((false == options.optimizeMeshes && false == options.generateLods && false == generateTangents) || TINYGLTF_MODE_TRIANGLES != primitive.mode) {
+                    ReadIndices(GetAccessorView(document, primitive.indices), 0, load.indexCount, load.firstVertex, indices);
+                    return;
+                }
+
+                // Triangle lists are processed with indices relative to the primitive, the first vertex is added afterwards
+                ReadIndices(GetAccessorView(document, primitive.indices), 0, load.indexCount, 0, indices);
+                if (std::all_of(indices, indices + load.indexCount, [&load](uint32_t index) { return index < load.vertexCount; })) {
+                    Vertex* vertices = vertexBuffer.data() + load.firstVertex;
+                    if (generateTangents) {
+                        GenerateTangents(&vertices->tangent.x, indices, load.indexCount, &vertices->pos.x, &vertices->normal.x, tangentUVs(vertices), sizeof(Vertex), load.vertexCount);
+                    }
+                    if (options.optimizeMeshes) {
+                        std::vector<uint32_t> clusters;
+                        statistics[primitiveIndex][0] = AnalyzeVertexCache(indices, load.indexCount, load.vertexCount);
+                        OptimizeVertexCache(indices, load.indexCount, load.vertexCount, &clusters);
+                        OptimizeOverdraw(indices, load.indexCount, &vertices->pos.x, sizeof(Vertex), clusters);
+                        OptimizeVertexFetch(vertices, indices, load.indexCount, load.vertexCount);
+                        statistics[primitiveIndex][1] = AnalyzeVertexCache(indices, load.indexCount, load.vertexCount);
+                    }
+
+                    // The simplifier ignores joint weights, skinned primitives keep their full resolution
+                    // Every level halves the triangles of the previous one and is simplified from the full range, which keeps its error absolute
+                    if (options.generateLods && load.indexCount >= LOD_MIN_INDEX_COUNT && primitive.FindAttribute("JOINTS_0") < 0) {
+                        LodChain& chain = lodChains[primitiveIndex];
+                        std::vector<uint32_t> lod(load.indexCount);
+                        size_t previousCount = load.indexCount;
+                        float previousError = 0.0f;
+                        while (chain.lodCount < MAX_PRIMITIVE_LODS) {
+                            float error = 0.0f;
+                            const size_t count = SimplifyMesh(lod.data(), indices, load.indexCount, &vertices->pos.x, sizeof(Vertex), load.vertexCount, previousCount / 6 * 3, &error);
+                            // A level that barely shrinks is not worth its indices, locked borders and seams keep the next ones from shrinking too
+                            if (0 == count || count > previousCount * 3 / 4) {
+                                break;
+                            }
+                            OptimizeVertexCache(lod.data(), count, load.vertexCount);
+
+                            PrimitiveLod& primitiveLod = chain.lods[chain.lodCount++];
+                            primitiveLod.firstIndex = static_cast<uint32_t>(chain.indices.size());
+                            primitiveLod.indexCount = static_cast<uint32_t>(count);
+                            primitiveLod.error = std::max(error, previousError);
+                            chain.indices.insert(chain.indices.end(), lod.begin(), lod.begin() + count);
+                            previousCount = count;
+                            previousError = primitiveLod.error;
+                        }
                     }
                 }
-                auto newPrimitive = new Primitive(indexStart, indexCount, vertexCount, primitive.material > -1 ? materials[primitive.material] : materials.back());
-                newPrimitive->SetBoundingBox(posMin, posMax);
-                newMesh->primitives.push_back(newPrimitive);
+                for (uint32_t i = 0; i < load.indexCount; ++i) {
+                    indices[i] += load.firstVertex;
+                }
             }
-            // Mesh BB from BBs of primitives
-            for (auto p : newMesh->primitives) {
-                if (p->bb.valid && !newMesh->bb.valid) {
-                    newMesh->bb = p->bb;
-                    newMesh->bb.valid = true;
+            else if (generateTangents) {
+                Vertex* vertices = vertexBuffer.data() + load.firstVertex;
+                GenerateTangents(&vertices->tangent.x, nullptr, 0, &vertices->pos.x, &vertices->normal.x, tangentUVs(vertices), sizeof(Vertex), load.vertexCount);
+            }
+        });
+
+        // Levels go behind all full resolution ranges, static batching relies on every range staying in the vertices of its primitive
+        uint32_t lodPrimitiveCount = 0;
+        uint32_t lodTriangleCount = 0;
+        for (size_t primitiveIndex = 0; primitiveIndex < lodChains.size(); ++primitiveIndex) {
+            const LodChain& chain = lodChains[primitiveIndex];
+            if (0 == chain.lodCount) {
+                continue;
+            }
+            const PrimitiveLoad& load = loaderInfo.primitives[primitiveIndex];
+            const auto firstIndex = static_cast<uint32_t>(indexBuffer.size());
+            for (const uint32_t index : chain.indices) {
+                indexBuffer.push_back(index + load.firstVertex);
+            }
+            for (uint32_t level = 0; level < chain.lodCount; ++level) {
+                load.primitive->lods[level] = chain.lods[level];
+                load.primitive->lods[level].firstIndex += firstIndex;
+            }
+            load.primitive->lodCount = chain.lodCount;
+            ++lodPrimitiveCount;
+            lodTriangleCount += static_cast<uint32_t>(chain.indices.size() / 3);
+        }
+        if (lodPrimitiveCount > 0) {
+            std::cout << "Generated LODs for " << lodPrimitiveCount << " primitives, " << lodTriangleCount << " triangles" << std::endl;
+        }
+
+        if (false == statistics.empty()) {
+            uint32_t triangleCount = 0;
+            uint32_t vertexCount = 0;
+            uint32_t transformsBefore = 0;
+            uint32_t transformsAfter = 0;
+            for (const auto& [before, after] : statistics) {
+                triangleCount += before.triangleCount;
+                vertexCount += before.vertexCount;
+                transformsBefore += before.transformCount;
+                transformsAfter += after.transformCount;
+            }
+            if (triangleCount > 0) {
+                std::cout << "Vertex cache optimization of " << triangleCount << " triangles: ACMR " << static_cast<float>(transformsBefore) / triangleCount << " -> " << static_cast<float>(transformsAfter) / triangleCount
+                          << ", ATVR " << static_cast<float>(transformsBefore) / vertexCount << " -> " << static_cast<float>(transformsAfter) / vertexCount << std::endl;
+            }
+        }
+    }
+
+    void Model::LoadNodeInstances(const GltfDocument& document, const GltfDocument::MeshGpuInstancing& instancing, Node& node) {
+        // The document has checked that all attributes have the same count
+        const int32_t accessors[3] = { instancing.translation, instancing.rotation, instancing.scale };
+        AccessorView views[3];
+        size_t count = 0;
+        for (size_t i = 0; i < 3; ++i) {
+            if (accessors[i] > -1) {
+                views[i] = GetAccessorView(document, accessors[i]);
+                if (false == views[i].valid) {
+                    std::cerr << "Instancing accessor " << accessors[i] << " is out of bounds!" << std::endl;
+                    return;
                 }
-                newMesh->bb._min = glm::min(newMesh->bb._min, p->bb._min);
-                newMesh->bb._max = glm::max(newMesh->bb._max, p->bb._max);
+                count = views[i].count;
             }
-            newNode->mesh = newMesh;
         }
-        if (parent) {
-            parent->children.push_back(newNode);
+        if (0 == count) {
+            return;
         }
-        else {
-            nodes.push_back(newNode);
+
+        // Absent attributes keep the identity transform
+        std::vector<glm::vec3> translations(count, glm::vec3(0.0f));
+        std::vector<glm::vec4> rotations(count, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        std::vector<glm::vec3> scales(count, glm::vec3(1.0f));
+        if (views[0].valid) {
+            ReadAccessor(views[0], 0, count, 3, &translations[0].x, sizeof(glm::vec3));
+        }
+        if (views[1].valid) {
+            ReadAccessor(views[1], 0, count, 4, &rotations[0].x, sizeof(glm::vec4));
+        }
+        if (views[2].valid) {
+            ReadAccessor(views[2], 0, count, 3, &scales[0].x, sizeof(glm::vec3));
+        }
+
+        node.firstInstance = static_cast<uint32_t>(nodeInstances.size());
+        node.instanceCount = static_cast<uint32_t>(count);
+        nodeInstances.reserve(nodeInstances.size() + count);
+        for (size_t i = 0; i < count; ++i) {
+            nodeInstances.emplace_back(translations[i], glm::make_quat(&rotations[i].x), scales[i]);
         }
-        linearNodes.push_back(newNode);
     }
 
-    void Model::LoadSkins(tinygltf::Model& gltfModel) {
-        for (tinygltf::Skin& source : gltfModel.skins) {
-            Skin* newSkin = new Skin{};
-            newSkin->name = source.name;
+    void Model::LoadSkins(const GltfDocument& document) {
+        for (const GltfDocument::Skin& source : document.skins) {
+            Skin* newSkin = skinPool.New();
+            newSkin->name = std::string(source.name);
 
             // Find skeleton root node
             if (source.skeleton > -1) {
-                newSkin->skeletonRoot = NodeFromIndex(source.skeleton);
+                newSkin->skeletonRoot = graph.SlotFromIndex(source.skeleton);
             }
 
             // Find joint nodes
             for (int jointIndex : source.joints) {
-                Node* node = NodeFromIndex(jointIndex);
-                if (node) {
-                    newSkin->joints.push_back(NodeFromIndex(jointIndex));
+                const int32_t slot = graph.SlotFromIndex(jointIndex);
+                if (slot > -1) {
+                    newSkin->joints.push_back(static_cast<uint32_t>(slot));
                 }
             }
 
             // Get inverse bind matrices from buffer
             if (source.inverseBindMatrices > -1) {
-                const tinygltf::Accessor& accessor = gltfModel.accessors[source.inverseBindMatrices];
-                const tinygltf::BufferView& bufferView = gltfModel.bufferViews[accessor.bufferView];
-                const tinygltf::Buffer& buffer = gltfModel.buffers[bufferView.buffer];
-                newSkin->inverseBindMatrices.resize(accessor.count);
-                memcpy(newSkin->inverseBindMatrices.data(), &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::mat4));
+                const AccessorView view = GetAccessorView(document, source.inverseBindMatrices);
+                newSkin->inverseBindMatrices.resize(view.count);
+                ReadAccessor(view, 0, view.count, 16, reinterpret_cast<float*>(newSkin->inverseBindMatrices.data()), sizeof(glm::mat4));
             }
 
             skins.push_back(newSkin);
         }
     }
 
-    void Model::LoadTextures(tinygltf::Model& gltfModel, Vk::VulkanDevice* inDevice, VkQueue transferQueue) {
-        for (tinygltf::Texture& tex : gltfModel.textures) {
-            tinygltf::Image image = gltfModel.images[tex.source];
-            TextureSampler textureSampler;
-            if (tex.sampler == -1) {
-                // No sampler specified, use a default one
-                textureSampler.magFilter = VK_FILTER_LINEAR;
-                textureSampler.minFilter = VK_FILTER_LINEAR;
-                textureSampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-                textureSampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-                textureSampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    bool Model::LoadTextures(const GltfDocument& document, const std::string& baseDir, GltfImageDecoder& imageDecoder, Vk::VulkanDevice* inDevice, VkQueue transferQueue, std::string& error) {
+        // Texture sources were validated by the document
+        std::vector<int32_t> sources;
+        for (const GltfDocument::Texture& tex : document.textures) {
+            sources.push_back(tex.source);
+        }
+        std::sort(sources.begin(), sources.end());
+        sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+
+        // Textures keep their glTF indices and are uploaded in the order their images finish decoding
+        textures.resize(document.textures.size());
+        imageDecoder.Start(document, baseDir, std::move(sources));
+        for (int32_t source = imageDecoder.WaitNext(error); -1 != source; source = imageDecoder.WaitNext(error)) {
+            const tinygltf::Image& image = imageDecoder.GetImage(source);
+            if (image.image.empty()) {
+                return false;
             }
-            else {
-                textureSampler = textureSamplers[tex.sampler];
+            for (size_t i = 0; i < document.textures.size(); ++i) {
+                const GltfDocument::Texture& tex = document.textures[i];
+                if (source == tex.source) {
+                    textures[i].FromgltfImage(image, GetTextureSampler(tex.sampler), inDevice, transferQueue);
+                }
             }
-            ModelTexture texture;
-            texture.FromgltfImage(image, textureSampler, inDevice, transferQueue);
-            textures.push_back(texture);
         }
+        return true;
+    }
+
+    TextureSampler Model::GetTextureSampler(int32_t samplerIndex) const {
+        if (samplerIndex == -1) {
+            // No sampler specified, use a default one
+            TextureSampler textureSampler;
+            textureSampler.magFilter = VK_FILTER_LINEAR;
+            textureSampler.minFilter = VK_FILTER_LINEAR;
+            textureSampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+            textureSampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+            textureSampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+            return textureSampler;
+        }
+        return textureSamplers[samplerIndex];
     }
 
     VkSamplerAddressMode Model::GetVkWrapMode(int32_t wrapMode) {
@@ -654,8 +982,8 @@ namespace Vk {
         }
     }
 
-    void Model::LoadTextureSamplers(tinygltf::Model& gltfModel) {
-        for (const tinygltf::Sampler& smpl : gltfModel.samplers) {
+    void Model::LoadTextureSamplers(const GltfDocument& document) {
+        for (const GltfDocument::Sampler& smpl : document.samplers) {
             TextureSampler sampler{};
             sampler.minFilter = GetVkFilterMode(smpl.minFilter);
             sampler.magFilter = GetVkFilterMode(smpl.magFilter);
@@ -666,84 +994,69 @@ namespace Vk {
         }
     }
 
-    void Model::LoadMaterials(tinygltf::Model& gltfModel) {
-        for (tinygltf::Material& mat : gltfModel.materials) {
+    void Model::LoadMaterials(const GltfDocument& document) {
+        for (const GltfDocument::Material& mat : document.materials) {
             Material material{};
-            if (mat.values.find("baseColorTexture") != mat.values.end()) {
-                material.baseColorTexture = &textures[mat.values["baseColorTexture"].TextureIndex()];
-                material.texCoordSets.baseColor = static_cast<uint8_t>(mat.values["baseColorTexture"].TextureTexCoord());
+            if (mat.baseColorTexture.index > -1) {
+                material.baseColorTexture = &textures[mat.baseColorTexture.index];
+                material.texCoordSets.baseColor = static_cast<uint8_t>(mat.baseColorTexture.texCoord);
             }
-            if (mat.values.find("metallicRoughnessTexture") != mat.values.end()) {
-                material.metallicRoughnessTexture = &textures[mat.values["metallicRoughnessTexture"].TextureIndex()];
-                material.texCoordSets.metallicRoughness = static_cast<uint8_t>(mat.values["metallicRoughnessTexture"].TextureTexCoord());
+            if (mat.metallicRoughnessTexture.index > -1) {
+                material.metallicRoughnessTexture = &textures[mat.metallicRoughnessTexture.index];
+                material.texCoordSets.metallicRoughness = static_cast<uint8_t>(mat.metallicRoughnessTexture.texCoord);
             }
-            if (mat.values.find("roughnessFactor") != mat.values.end()) {
-                material.roughnessFactor = static_cast<float>(mat.values["roughnessFactor"].Factor());
+            if (mat.hasRoughnessFactor) {
+                material.roughnessFactor = mat.roughnessFactor;
             }
-            if (mat.values.find("metallicFactor") != mat.values.end()) {
-                material.metallicFactor = static_cast<float>(mat.values["metallicFactor"].Factor());
+            if (mat.hasMetallicFactor) {
+                material.metallicFactor = mat.metallicFactor;
             }
-            if (mat.values.find("baseColorFactor") != mat.values.end()) {
-                material.baseColorFactor = glm::make_vec4(mat.values["baseColorFactor"].ColorFactor().data());
+            if (mat.hasBaseColorFactor) {
+                material.baseColorFactor = glm::make_vec4(mat.baseColorFactor);
             }
-            if (mat.additionalValues.find("normalTexture") != mat.additionalValues.end()) {
-                material.normalTexture = &textures[mat.additionalValues["normalTexture"].TextureIndex()];
-                material.texCoordSets.normal = static_cast<uint8_t>(mat.additionalValues["normalTexture"].TextureTexCoord());
+            if (mat.normalTexture.index > -1) {
+                material.normalTexture = &textures[mat.normalTexture.index];
+                material.texCoordSets.normal = static_cast<uint8_t>(mat.normalTexture.texCoord);
             }
-            if (mat.additionalValues.find("emissiveTexture") != mat.additionalValues.end()) {
-                material.emissiveTexture = &textures[mat.additionalValues["emissiveTexture"].TextureIndex()];
-                material.texCoordSets.emissive = static_cast<uint8_t>(mat.additionalValues["emissiveTexture"].TextureTexCoord());
+            if (mat.emissiveTexture.index > -1) {
+                material.emissiveTexture = &textures[mat.emissiveTexture.index];
+                material.texCoordSets.emissive = static_cast<uint8_t>(mat.emissiveTexture.texCoord);
             }
-            if (mat.additionalValues.find("occlusionTexture") != mat.additionalValues.end()) {
-                material.occlusionTexture = &textures[mat.additionalValues["occlusionTexture"].TextureIndex()];
-                material.texCoordSets.occlusion = static_cast<uint8_t>(mat.additionalValues["occlusionTexture"].TextureTexCoord());
+            if (mat.occlusionTexture.index > -1) {
+                material.occlusionTexture = &textures[mat.occlusionTexture.index];
+                material.texCoordSets.occlusion = static_cast<uint8_t>(mat.occlusionTexture.texCoord);
             }
-            if (mat.additionalValues.find("alphaMode") != mat.additionalValues.end()) {
-                tinygltf::Parameter param = mat.additionalValues["alphaMode"];
-                if (param.string_value == "BLEND") {
-                    material.alphaMode = Material::ALPHAMODE_BLEND;
-                }
-                if (param.string_value == "MASK") {
-                    material.alphaCutoff = 0.5f;
-                    material.alphaMode = Material::ALPHAMODE_MASK;
-                }
+            if (mat.alphaMode == "BLEND") {
+                material.alphaMode = Material::ALPHAMODE_BLEND;
+            }
+            if (mat.alphaMode == "MASK") {
+                material.alphaCutoff = 0.5f;
+                material.alphaMode = Material::ALPHAMODE_MASK;
             }
-            if (mat.additionalValues.find("alphaCutoff") != mat.additionalValues.end()) {
-                material.alphaCutoff = static_cast<float>(mat.additionalValues["alphaCutoff"].Factor());
+            if (mat.hasAlphaCutoff) {
+                material.alphaCutoff = mat.alphaCutoff;
             }
-            if (mat.additionalValues.find("emissiveFactor") != mat.additionalValues.end()) {
-                material.emissiveFactor = glm::vec4(glm::make_vec3(mat.additionalValues["emissiveFactor"].ColorFactor().data()), 1.0);
+            if (mat.hasEmissiveFactor) {
+                material.emissiveFactor = glm::vec4(glm::make_vec3(mat.emissiveFactor), 1.0);
                 material.emissiveFactor = glm::vec4(0.0f);
             }
 
             // Extensions
-            // @TODO: Find out if there is a nicer way of reading these properties with recent tinygltf headers
-            if (mat.extensions.find("KHR_materials_pbrSpecularGlossiness") != mat.extensions.end()) {
-                auto ext = mat.extensions.find("KHR_materials_pbrSpecularGlossiness");
-                if (ext->second.Has("specularGlossinessTexture")) {
-                    auto index = ext->second.Get("specularGlossinessTexture").Get("index");
-                    material.extension.specularGlossinessTexture = &textures[index.Get<int>()];
-                    auto texCoordSet = ext->second.Get("specularGlossinessTexture").Get("texCoord");
-                    material.texCoordSets.specularGlossiness = static_cast<uint8_t>(texCoordSet.Get<int>());
+            const auto& ext = mat.specularGlossiness;
+            if (ext.present) {
+                if (ext.specularGlossinessTexture.index > -1) {
+                    material.extension.specularGlossinessTexture = &textures[ext.specularGlossinessTexture.index];
+                    material.texCoordSets.specularGlossiness = static_cast<uint8_t>(ext.specularGlossinessTexture.texCoord);
                     material.pbrWorkflows.specularGlossiness = true;
                 }
-                if (ext->second.Has("diffuseTexture")) {
-                    auto index = ext->second.Get("diffuseTexture").Get("index");
-                    material.extension.diffuseTexture = &textures[index.Get<int>()];
+                if (ext.diffuseTexture.index > -1) {
+                    material.extension.diffuseTexture = &textures[ext.diffuseTexture.index];
                 }
-                if (ext->second.Has("diffuseFactor")) {
-                    auto factor = ext->second.Get("diffuseFactor");
-                    for (uint32_t i = 0; i < factor.ArrayLen(); i++) {
-                        auto val = factor.Get(i);
-                        material.extension.diffuseFactor[i] = val.IsNumber() ? (float)val.Get<double>() : (float)val.Get<int>();
-                    }
+                if (ext.hasDiffuseFactor) {
+                    material.extension.diffuseFactor = glm::make_vec4(ext.diffuseFactor);
                 }
-                if (ext->second.Has("specularFactor")) {
-                    auto factor = ext->second.Get("specularFactor");
-                    for (uint32_t i = 0; i < factor.ArrayLen(); i++) {
-                        auto val = factor.Get(i);
-                        material.extension.specularFactor[i] = val.IsNumber() ? (float)val.Get<double>() : (float)val.Get<int>();
-                    }
+                if (ext.hasSpecularFactor) {
+                    material.extension.specularFactor = glm::make_vec3(ext.specularFactor);
                 }
             }
 
@@ -753,16 +1066,16 @@ namespace Vk {
         materials.emplace_back();
     }
 
-    void Model::LoadAnimations(tinygltf::Model& gltfModel) {
-        for (tinygltf::Animation& anim : gltfModel.animations) {
+    void Model::LoadAnimations(const GltfDocument& document) {
+        for (const GltfDocument::Animation& anim : document.animations) {
             Animation animation{};
-            animation.name = anim.name;
+            animation.name = std::string(anim.name);
             if (anim.name.empty()) {
                 animation.name = std::to_string(animations.size());
             }
 
             // Samplers
-            for (auto& samp : anim.samplers) {
+            for (const auto& samp : anim.samplers) {
                 AnimationSampler sampler{};
 
                 if (samp.interpolation == "LINEAR") {
@@ -777,17 +1090,9 @@ namespace Vk {
 
                 // Read sampler input time values
                 {
-                    const tinygltf::Accessor& accessor = gltfModel.accessors[samp.input];
-                    const tinygltf::BufferView& bufferView = gltfModel.bufferViews[accessor.bufferView];
-                    const tinygltf::Buffer& buffer = gltfModel.buffers[bufferView.buffer];
-
-                    assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
-
-                    const void* dataPtr = &buffer.data[accessor.byteOffset + bufferView.byteOffset];
-                    const auto buf = static_cast<const float*>(dataPtr);
-                    for (size_t index = 0; index < accessor.count; index++) {
-                        sampler.inputs.push_back(buf[index]);
-                    }
+                    const AccessorView view = GetAccessorView(document, samp.input);
+                    sampler.inputs.resize(view.count);
+                    ReadAccessor(view, 0, view.count, 1, sampler.inputs.data(), sizeof(float));
 
                     for (auto input : sampler.inputs) {
                         if (input < animation.start) {
@@ -799,29 +1104,16 @@ namespace Vk {
                     }
                 }
 
-                // Read sampler output T/R/S values 
+                // Read sampler output T/R/S values, quantized rotations are normalized shorts or bytes
                 {
-                    const tinygltf::Accessor& accessor = gltfModel.accessors[samp.output];
-                    const tinygltf::BufferView& bufferView = gltfModel.bufferViews[accessor.bufferView];
-                    const tinygltf::Buffer& buffer = gltfModel.buffers[bufferView.buffer];
-
-                    assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
-
-                    const void* dataPtr = &buffer.data[accessor.byteOffset + bufferView.byteOffset];
+                    const AccessorView view = GetAccessorView(document, samp.output);
 
-                    switch (accessor.type) {
-                    case TINYGLTF_TYPE_VEC3: {
-                        const auto buf = static_cast<const glm::vec3*>(dataPtr);
-                        for (size_t index = 0; index < accessor.count; index++) {
-                            sampler.outputsVec4.emplace_back(buf[index], 0.0f);
-                        }
-                        break;
-                    }
+                    switch (document.accessors[samp.output].type) {
+                    case TINYGLTF_TYPE_VEC3:
                     case TINYGLTF_TYPE_VEC4: {
-                        const auto buf = static_cast<const glm::vec4*>(dataPtr);
-                        for (size_t index = 0; index < accessor.count; index++) {
-                            sampler.outputsVec4.push_back(buf[index]);
-                        }
+                        // The missing w of vec3 outputs is written as zero
+                        sampler.outputsVec4.resize(view.count);
+                        ReadAccessor(view, 0, view.count, 4, reinterpret_cast<float*>(sampler.outputsVec4.data()), sizeof(glm::vec4));
                         break;
                     }
                     default: {
@@ -835,27 +1127,28 @@ namespace Vk {
             }
 
             // Channels
-            for (auto& source : anim.channels) {
+            for (const auto& source : anim.channels) {
                 AnimationChannel channel{};
 
-                if (source.target_path == "rotation") {
+                if (source.targetPath == "rotation") {
                     channel.path = AnimationChannel::PathType::ROTATION;
                 }
-                if (source.target_path == "translation") {
+                if (source.targetPath == "translation") {
                     channel.path = AnimationChannel::PathType::TRANSLATION;
                 }
-                if (source.target_path == "scale") {
+                if (source.targetPath == "scale") {
                     channel.path = AnimationChannel::PathType::SCALE;
                 }
-                if (source.target_path == "weights") {
+                if (source.targetPath == "weights") {
                     std::cout << "weights not yet supported, skipping channel" << std::endl;
                     continue;
                 }
                 channel.samplerIndex = source.sampler;
-                channel.node = NodeFromIndex(source.target_node);
-                if (!channel.node) {
+                const int32_t slot = graph.SlotFromIndex(source.targetNode);
+                if (slot < 0) {
                     continue;
                 }
+                channel.node = static_cast<uint32_t>(slot);
 
                 animation.channels.push_back(channel);
             }
@@ -864,11 +1157,8 @@ namespace Vk {
         }
     }
 
-    void Model::LoadFromFile(const std::string& filename, Vk::VulkanDevice* inDevice, VkQueue transferQueue, float scale) {
-        tinygltf::Model gltfModel;
-        tinygltf::TinyGLTF gltfContext;
+    void Model::LoadFromFile(const std::string& filename, Vk::VulkanDevice* inDevice, VkQueue transferQueue, float scale, const std::string& cookedFilename, const ModelImportOptions& options) {
         std::string error;
-        std::string warning;
 
         this->device = inDevice;
 
@@ -878,36 +1168,90 @@ namespace Vk {
             binary = (filename.substr(extpos + 1, filename.length() - extpos) == "glb");
         }
 
-        bool fileLoaded = binary ? gltfContext.LoadBinaryFromFile(&gltfModel, &error, &warning, filename) : gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
+        // The document reads strings and the .glb BIN chunk in place, so the mapping has to outlive the uploads below
+        MappedFile file;
+        GltfDocument document;
+        const std::string baseDir = std::filesystem::path(filename).parent_path().string();
+
+        // Images are decoded in parallel by LoadTextures
+        GltfImageDecoder imageDecoder;
+
+        bool fileLoaded = false;
+        if (false == file.Open(filename)) {
+            error = "Could not map " + filename;
+        }
+        else if (binary) {
+            fileLoaded = document.ParseBinary(file.Data(), file.Size(), error);
+        }
+        else {
+            fileLoaded = document.Parse(reinterpret_cast<const char*>(file.Data()), file.Size(), error);
+        }
+
+        // Buffers with an uri are loaded after parsing, and only when the scene reads them
+        const int32_t sceneIndex = document.defaultScene > -1 ? document.defaultScene : 0;
+        if (fileLoaded) {
+            fileLoaded = LoadSceneBuffers(document, sceneIndex, baseDir, error);
+        }
+
+        // EXT_meshopt_compression buffer views are expanded in place, KHR_mesh_quantization types are read as they are
+        if (fileLoaded) {
+            fileLoaded = DecodeMeshoptBufferViews(document, error);
+        }
 
         std::vector<uint32_t> indexBuffer;
         std::vector<Vertex> vertexBuffer;
 
         if (fileLoaded) {
-            LoadTextureSamplers(gltfModel);
-            LoadTextures(gltfModel, inDevice, transferQueue);
-            LoadMaterials(gltfModel);
+            LoadTextureSamplers(document);
+            fileLoaded = LoadTextures(document, baseDir, imageDecoder, inDevice, transferQueue, error);
+        }
+
+        if (fileLoaded) {
+            LoadMaterials(document);
             // TODO: scene handling with no default scene
-            const tinygltf::Scene& scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
+            const GltfDocument::Scene& scene = document.scenes[sceneIndex];
+
+            // Nodes, meshes, primitives and skins each go into a single block of their pool
+            size_t meshCount = document.meshes.size();
+            size_t primitiveCount = 0;
+            for (const GltfDocument::Mesh& mesh : document.meshes) {
+                primitiveCount += mesh.primitives.size();
+            }
+            for (const GltfDocument::Node& node : document.nodes) {
+                if (node.mesh > -1 && node.skin > -1) {
+                    ++meshCount;
+                }
+            }
+            graph.Reserve(document.nodes.size());
+            linearNodes.reserve(document.nodes.size());
+            nodePool.Reserve(document.nodes.size());
+            meshPool.Reserve(meshCount);
+            primitivePool.Reserve(primitiveCount);
+            skinPool.Reserve(document.skins.size());
+
+            LoaderInfo loaderInfo{};
             for (int i : scene.nodes) {
-                const tinygltf::Node node = gltfModel.nodes[i];
-                LoadNode(nullptr, node, i, gltfModel, indexBuffer, vertexBuffer, scale);
+                const GltfDocument::Node& node = document.nodes[i];
+                LoadNode(-1, node, i, document, loaderInfo, scale);
             }
-            if (!gltfModel.animations.empty()) {
-                LoadAnimations(gltfModel);
+            LoadPrimitives(document, loaderInfo, options, indexBuffer, vertexBuffer);
+            if (!document.animations.empty()) {
+                LoadAnimations(document);
             }
-            LoadSkins(gltfModel);
+            LoadSkins(document);
 
+            // Assign skins
             for (auto node : linearNodes) {
-                // Assign skins
                 if (node->skinIndex > -1) {
                     node->skin = skins[node->skinIndex];
                 }
-                // Initial pose
-                if (node->mesh) {
-                    node->Update();
-                }
             }
+            if (options.staticBatching) {
+                BatchStaticMeshes(static_cast<uint32_t>(document.nodes.size()), indexBuffer, vertexBuffer);
+            }
+            BuildInstances(transferQueue);
+            // Initial pose
+            UpdateMeshes();
         }
         else {
             // TODO: throw
@@ -915,128 +1259,616 @@ namespace Vk {
             return;
         }
 
-        extensions = gltfModel.extensionsUsed;
+        extensions.assign(document.extensionsUsed.begin(), document.extensionsUsed.end());
 
-        size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
-        size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
         indices.count = static_cast<uint32_t>(indexBuffer.size());
 
-        assert(vertexBufferSize > 0);
+        assert(false == vertexBuffer.empty());
 
-        struct StagingBuffer {
-            VkBuffer buffer = VK_NULL_HANDLE;
-            VkDeviceMemory memory = VK_NULL_HANDLE;
-        } vertexStaging, indexStaging;
+        // Cooked files keep the 32 bit index ranges of the import, UploadBuffers rewrites the ranges of the primitives
+        if (false == cookedFilename.empty()) {
+            SaveCookedFile(cookedFilename, filename, document, imageDecoder, vertexBuffer, indexBuffer, options.GetFlags());
+        }
 
-        // Create staging buffers
-        // Vertex data
-        CheckResult(inDevice->CreateBuffer(
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            vertexBufferSize,
-            &vertexStaging.buffer,
-            &vertexStaging.memory,
-            vertexBuffer.data()));
-        // Index data
-        if (indexBufferSize > 0) {
-            CheckResult(inDevice->CreateBuffer(
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                indexBufferSize,
-                &indexStaging.buffer,
-                &indexStaging.memory,
-                indexBuffer.data()));
-        }
-
-        // Create inDevice local buffers
-        // Vertex buffer
-        CheckResult(inDevice->CreateBuffer(
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            vertexBufferSize,
-            &vertices.buffer,
-            &vertices.memory));
-        // Index buffer
-        if (indexBufferSize > 0) {
-            CheckResult(inDevice->CreateBuffer(
-                VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                indexBufferSize,
-                &indices.buffer,
-                &indices.memory));
-        }
-
-        // Copy from staging buffers
-        VkCommandBuffer copyCmd = inDevice->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+        UploadBuffers(vertexBuffer.data(), vertexBuffer.size(), indexBuffer.data(), indexBuffer.size(), transferQueue);
 
-        VkBufferCopy copyRegion = {};
+        GetSceneDimensions();
+    }
 
-        copyRegion.size = vertexBufferSize;
-        vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
+    void Model::UploadBuffers(const Vertex* vertexData, size_t vertexCount, const uint32_t* indexData, size_t indexCount, VkQueue transferQueue) {
+        // Cut from the indices as imported, the packed formats remap them below
+        const std::vector<MeshletBounds> meshletBounds = buildMeshlets ? BuildMeshlets(vertexData, vertexCount, indexData, indexCount) : std::vector<MeshletBounds>{};
+
+        std::vector<BufferUpload> uploads;
+        std::vector<uint8_t> indexBytes;
+        std::vector<Meshlet> meshletData;
+        const auto addIndexUpload = [&]() {
+            indexBytes = PackIndexRanges(indexData, indexCount);
+            if (false == indexBytes.empty()) {
+                uploads.push_back({ indexBytes.data(), indexBytes.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &indices.buffer, &indices.memory });
+            }
+            meshletData = PackMeshlets(meshletBounds);
+            if (false == meshletData.empty()) {
+                uploads.push_back({ meshletData.data(), meshletData.size() * sizeof(Meshlet), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &meshlets.buffer, &meshlets.memory });
+            }
+        };
 
-        if (indexBufferSize > 0) {
-            copyRegion.size = indexBufferSize;
-            vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
+        // Model::Vertex is the interleaved float layout already
+        if (VertexFormat::Float == vertexFormat && false == splitStreams) {
+            uploads.push_back({ vertexData, vertexCount * sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertices.buffer, &vertices.memory });
+            addIndexUpload();
+            UploadDeviceLocal(*device, uploads, transferQueue);
+            return;
         }
 
-        inDevice->FlushCommandBuffer(copyCmd, transferQueue, true);
+        // Every primitive owns one run of vertices, its smallest and largest index bound it. Without indices it is the run the primitive draws
+        const bool skinStream = VertexFormat::Float != vertexFormat;
+        std::vector<uint8_t> skinned(vertexCount, 0);
+        std::vector<VertexPackContext> contexts(vertexCount);
+        for (const Mesh* mesh : meshes) {
+            for (Primitive& primitive : mesh->primitives) {
+                uint32_t begin = primitive.firstVertex;
+                uint32_t end = primitive.firstVertex + primitive.vertexCount;
+                if (primitive.indexCount > 0) {
+                    const uint32_t* first = indexData + primitive.firstIndex;
+                    const auto range = std::minmax_element(first, first + primitive.indexCount);
+                    begin = *range.first;
+                    end = *range.second + 1;
+                }
+                if (begin >= end || end > vertexCount) {
+                    continue;
+                }
 
-        vkDestroyBuffer(inDevice->logicalDevice, vertexStaging.buffer, nullptr);
-        vkFreeMemory(inDevice->logicalDevice, vertexStaging.memory, nullptr);
-        if (indexBufferSize > 0) {
-            vkDestroyBuffer(inDevice->logicalDevice, indexStaging.buffer, nullptr);
-            vkFreeMemory(inDevice->logicalDevice, indexStaging.memory, nullptr);
+                // Positions are quantized within a cube, which keeps the dequantization a single scale
+                if (VertexFormat::Quantized == vertexFormat) {
+                    glm::vec3 bbMin(FLT_MAX);
+                    glm::vec3 bbMax(-FLT_MAX);
+                    for (uint32_t v = begin; v < end; ++v) {
+                        bbMin = glm::min(bbMin, vertexData[v].pos);
+                        bbMax = glm::max(bbMax, vertexData[v].pos);
+                    }
+                    const glm::vec3 extent = bbMax - bbMin;
+                    const float scale = std::max({ extent.x, extent.y, extent.z });
+                    primitive.positionOffset = bbMin;
+                    primitive.positionScale = scale > 0.0f ? scale : 1.0f;
+                }
+                for (uint32_t v = begin; v < end; ++v) {
+                    contexts[v] = { primitive.positionOffset, primitive.positionScale };
+                    if (skinStream && mesh->skinIndex > -1) {
+                        skinned[v] = 1;
+                    }
+                }
+            }
         }
 
-        GetSceneDimensions();
+        // Vertices of skinned meshes come first, so the skin stream only has entries for them
+        std::vector<uint32_t> remap(vertexCount);
+        uint32_t skinnedCount = 0;
+        for (size_t v = 0; v < vertexCount; ++v) {
+            if (0 != skinned[v]) {
+                remap[v] = skinnedCount++;
+            }
+        }
+        uint32_t staticCount = skinnedCount;
+        for (size_t v = 0; v < vertexCount; ++v) {
+            if (0 == skinned[v]) {
+                remap[v] = staticCount++;
+            }
+        }
+        std::vector<uint32_t> remappedIndices;
+        if (skinnedCount > 0 && skinnedCount < vertexCount) {
+            remappedIndices.resize(indexCount);
+            for (size_t i = 0; i < indexCount; ++i) {
+                remappedIndices[i] = indexData[i] < vertexCount ? remap[indexData[i]] : indexData[i];
+            }
+            indexData = remappedIndices.data();
+
+            // A run is skinned or not as a whole and keeps its order, a primitive without indices only moves its first vertex.
+            // Nodes with the same glTF mesh and different skins share one span of primitives
+            std::unordered_set<const Primitive*> remappedSpans;
+            for (const Mesh* mesh : meshes) {
+                if (false == remappedSpans.insert(mesh->primitives.begin()).second) {
+                    continue;
+                }
+                for (Primitive& primitive : mesh->primitives) {
+                    if (0 == primitive.indexCount && primitive.vertexCount > 0 && primitive.firstVertex < vertexCount) {
+                        primitive.firstVertex = remap[primitive.firstVertex];
+                    }
+                }
+            }
+        }
+
+        PackedStreams streams;
+        switch (vertexFormat) {
+        case VertexFormat::Packed:
+            streams = PackVertexStreams<VertexFormat::Packed>(vertexData, vertexCount, remap.data(), contexts.data(), skinnedCount, splitStreams);
+            break;
+        case VertexFormat::Quantized:
+            streams = PackVertexStreams<VertexFormat::Quantized>(vertexData, vertexCount, remap.data(), contexts.data(), skinnedCount, splitStreams);
+            break;
+        default:
+            streams = PackVertexStreams<VertexFormat::Float>(vertexData, vertexCount, remap.data(), contexts.data(), skinnedCount, splitStreams);
+            break;
+        }
+        uploads.push_back({ streams.vertices.data(), streams.vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertices.buffer, &vertices.memory });
+        if (false == streams.positions.empty()) {
+            uploads.push_back({ streams.positions.data(), streams.positions.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &positions.buffer, &positions.memory });
+        }
+        if (false == streams.skin.empty()) {
+            uploads.push_back({ streams.skin.data(), streams.skin.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &skinVertices.buffer, &skinVertices.memory });
+        }
+        addIndexUpload();
+        UploadDeviceLocal(*device, uploads, transferQueue);
+    }
+
+    VertexInputDescription DescribeVertexInput(VertexFormat format, bool splitStreams) {
+        switch (format) {
+        case VertexFormat::Packed:
+            return DescribeStreams<VertexFormat::Packed>(splitStreams);
+        case VertexFormat::Quantized:
+            return DescribeStreams<VertexFormat::Quantized>(splitStreams);
+        default:
+            return DescribeStreams<VertexFormat::Float>(splitStreams);
+        }
+    }
+
+    std::vector<uint8_t> Model::PackIndexRanges(const uint32_t* indexData, size_t indexCount) {
+        std::vector<uint16_t> shortIndices;
+        std::vector<uint32_t> wideIndices;
+
+        // Nodes with the same glTF mesh and different skins share one span of primitives
+        std::unordered_set<const Primitive*> packedSpans;
+        for (const Mesh* mesh : meshes) {
+            if (false == packedSpans.insert(mesh->primitives.begin()).second) {
+                continue;
+            }
+            for (Primitive& primitive : mesh->primitives) {
+                if (0 == primitive.indexCount || primitive.firstIndex + primitive.indexCount > indexCount) {
+                    continue;
+                }
+
+                // The levels are simplified from the same vertices
+                uint32_t minIndex = UINT32_MAX;
+                uint32_t maxIndex = 0;
+                const auto visitRanges = [&](const auto& visit) {
+                    visit(primitive.firstIndex, primitive.indexCount);
+                    for (uint32_t level = 0; level < primitive.lodCount; ++level) {
+                        visit(primitive.lods[level].firstIndex, primitive.lods[level].indexCount);
+                    }
+                };
+                visitRanges([&](uint32_t& firstIndex, uint32_t count) {
+                    const auto [begin, last] = std::minmax_element(indexData + firstIndex, indexData + firstIndex + count);
+                    minIndex = std::min(minIndex, *begin);
+                    maxIndex = std::max(maxIndex, *last);
+                });
+
+                primitive.vertexOffset = static_cast<int32_t>(minIndex);
+                primitive.indexType = maxIndex - minIndex <= UINT16_MAX ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+                visitRanges([&](uint32_t& firstIndex, uint32_t count) {
+                    const uint32_t* source = indexData + firstIndex;
+                    if (VK_INDEX_TYPE_UINT16 == primitive.indexType) {
+                        firstIndex = static_cast<uint32_t>(shortIndices.size());
+                        for (uint32_t i = 0; i < count; ++i) {
+                            shortIndices.push_back(static_cast<uint16_t>(source[i] - minIndex));
+                        }
+                    }
+                    else {
+                        firstIndex = static_cast<uint32_t>(wideIndices.size());
+                        for (uint32_t i = 0; i < count; ++i) {
+                            wideIndices.push_back(source[i] - minIndex);
+                        }
+                    }
+                });
+            }
+        }
+
+        // The 32 bit section starts 4 byte aligned, as vkCmdBindIndexBuffer requires
+        indices.wideOffset = (shortIndices.size() * sizeof(uint16_t) + 3) & ~VkDeviceSize(3);
+        std::vector<uint8_t> result(wideIndices.empty() ? shortIndices.size() * sizeof(uint16_t) : indices.wideOffset + wideIndices.size() * sizeof(uint32_t));
+        if (false == shortIndices.empty()) {
+            memcpy(result.data(), shortIndices.data(), shortIndices.size() * sizeof(uint16_t));
+        }
+        if (false == wideIndices.empty()) {
+            memcpy(result.data() + indices.wideOffset, wideIndices.data(), wideIndices.size() * sizeof(uint32_t));
+        }
+        return result;
     }
 
-    void Model::DrawNode(Node* node, VkCommandBuffer commandBuffer) {
-        if (node->mesh) {
-            for (Primitive* primitive : node->mesh->primitives) {
-                vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+    std::vector<MeshletBounds> Model::BuildMeshlets(const Vertex* vertexData, size_t vertexCount, const uint32_t* indexData, size_t indexCount) {
+        // Skinned vertices leave the bounds of their bind pose, those meshes are drawn whole
+        std::vector<Primitive*> primitives;
+        std::unordered_set<const Primitive*> cutPrimitives;
+        for (const Mesh* mesh : meshes) {
+            if (mesh->skinIndex > -1) {
+                continue;
+            }
+            for (Primitive& primitive : mesh->primitives) {
+                primitive.meshletCount = 0;
+                if (primitive.indexCount > 0 && primitive.firstIndex + primitive.indexCount <= indexCount && cutPrimitives.insert(&primitive).second) {
+                    primitives.push_back(&primitive);
+                }
             }
         }
-        for (auto& child : node->children) {
-            DrawNode(child, commandBuffer);
+
+        std::vector<std::vector<MeshletBounds>> primitiveMeshlets(primitives.size());
+        ThreadPool::Get().ParallelFor(primitives.size(), [&](size_t p) {
+            const Primitive& primitive = *primitives[p];
+            const uint32_t* first = indexData + primitive.firstIndex;
+            const auto [begin, last] = std::minmax_element(first, first + primitive.indexCount);
+            if (*last >= vertexCount) {
+                return;
+            }
+
+            // Relative to the run of vertices of the primitive, which keeps the bookkeeping of BuildMeshlets small
+            std::vector<uint32_t> localIndices(first, first + primitive.indexCount);
+            for (uint32_t& index : localIndices) {
+                index -= *begin;
+            }
+            Vk::BuildMeshlets(primitiveMeshlets[p], localIndices.data(), localIndices.size(), &vertexData[*begin].pos.x, sizeof(Vertex), *last - *begin + 1);
+            // Meshlets are numbered within their draw in 16 bits, which also keeps a draw within maxDrawIndirectCount
+            if (primitiveMeshlets[p].size() > UINT16_MAX) {
+                primitiveMeshlets[p].clear();
+            }
+        });
+
+        std::vector<MeshletBounds> result;
+        for (size_t p = 0; p < primitives.size(); ++p) {
+            primitives[p]->firstMeshlet = static_cast<uint32_t>(result.size());
+            primitives[p]->meshletCount = static_cast<uint32_t>(primitiveMeshlets[p].size());
+            result.insert(result.end(), primitiveMeshlets[p].begin(), primitiveMeshlets[p].end());
         }
+        return result;
     }
 
-    void Model::Draw(VkCommandBuffer commandBuffer) {
-        const VkDeviceSize offsets[1] = { 0 };
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
-        vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-        for (auto& node : nodes) {
-            DrawNode(node, commandBuffer);
+    std::vector<Meshlet> Model::PackMeshlets(const std::vector<MeshletBounds>& bounds) {
+        std::vector<Meshlet> result;
+        for (Mesh* mesh : meshes) {
+            mesh->firstMeshletDraw = static_cast<uint32_t>(result.size());
+            if (mesh->skinIndex > -1) {
+                continue;
+            }
+            uint32_t draw = mesh->firstDraw;
+            for (const Primitive& primitive : mesh->primitives) {
+                for (uint32_t m = 0; m < primitive.meshletCount; ++m) {
+                    const MeshletBounds& source = bounds[primitive.firstMeshlet + m];
+                    Meshlet& meshlet = result.emplace_back();
+                    meshlet.center = source.center;
+                    meshlet.radius = source.radius;
+                    // Blended primitives are drawn without face culling
+                    if (Material::ALPHAMODE_BLEND != primitive.material.alphaMode) {
+                        EncodeMeshletCone(source, meshlet.cone);
+                    }
+                    meshlet.firstIndex = primitive.firstIndex + source.firstIndex;
+                    meshlet.indexCount = static_cast<uint16_t>(source.indexCount);
+                    meshlet.drawOffset = static_cast<uint16_t>(m);
+                    meshlet.draw = draw;
+                }
+                ++draw;
+            }
         }
+        meshlets.count = static_cast<uint32_t>(result.size());
+        return result;
     }
 
-    void Model::CalculateBoundingBox(Node* node, Node* parent) {
-        BoundingBox parentBvh = parent ? parent->bvh : BoundingBox(dimensions.min, dimensions.max);
+    void Model::BindIndices(VkCommandBuffer commandBuffer, VkIndexType indexType) const {
+        vkCmdBindIndexBuffer(commandBuffer, indices.buffer, VK_INDEX_TYPE_UINT16 == indexType ? 0 : indices.wideOffset, indexType);
+    }
 
-        if (node->mesh) {
-            if (node->mesh->bb.valid) {
-                node->aabb = node->mesh->bb.GetAABB(node->GetMatrix());
-                if (node->children.empty()) {
-                    node->bvh._min = node->aabb._min;
-                    node->bvh._max = node->aabb._max;
-                    node->bvh.valid = true;
+    void Model::BatchStaticMeshes(uint32_t batchSourceIndex, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer) {
+        graph.UpdateWorldMatrices();
+
+        // Animated nodes move their whole subtree, parents come first so one sweep spreads the flag
+        std::vector<uint8_t> animated(graph.Size(), 0);
+        for (const Animation& animation : animations) {
+            for (const AnimationChannel& channel : animation.channels) {
+                animated[channel.node] = 1;
+            }
+        }
+        for (uint32_t slot = 0; slot < graph.Size(); ++slot) {
+            if (graph.parents[slot] > -1 && 0 != animated[graph.parents[slot]]) {
+                animated[slot] = 1;
+            }
+        }
+
+        // Static nodes hand their primitives to the group of their material
+        std::vector<std::vector<std::pair<const Node*, const Primitive*>>> groups(materials.size());
+        std::vector<Node*> staticNodes;
+        for (Node* node : linearNodes) {
+            if (nullptr == node->mesh || node->skinIndex > -1 || node->instanceCount > 0 || 0 != animated[node->slot]) {
+                continue;
+            }
+            for (const Primitive& primitive : node->mesh->primitives) {
+                groups[&primitive.material - materials.data()].emplace_back(node, &primitive);
+            }
+            staticNodes.push_back(node);
+        }
+        if (std::all_of(groups.begin(), groups.end(), [](const auto& group) { return group.empty(); })) {
+            return;
+        }
+
+        // Vertices of a primitive are one run, its smallest and largest index bound it. Without indices it is the run the primitive draws
+        const auto vertexRange = [&indexBuffer](const Primitive& primitive) {
+            if (0 == primitive.indexCount) {
+                return std::make_pair(primitive.firstVertex, primitive.firstVertex + primitive.vertexCount);
+            }
+            const auto first = indexBuffer.begin() + primitive.firstIndex;
+            const auto range = std::minmax_element(first, first + primitive.indexCount);
+            return std::make_pair(*range.first, *range.second + 1);
+        };
+
+        // Batches are written behind the loaded data, which is compacted afterwards
+        std::vector<uint32_t> batchIndices;
+        std::vector<Vertex> batchVertices;
+        Mesh* batchMesh = meshPool.New(device, -1);
+        primitivePool.Reserve(groups.size());
+        size_t mergedCount = 0;
+        for (size_t material = 0; material < groups.size(); ++material) {
+            if (groups[material].empty()) {
+                continue;
+            }
+            const auto firstIndex = static_cast<uint32_t>(batchIndices.size());
+            const auto firstVertex = static_cast<uint32_t>(batchVertices.size());
+            glm::vec3 bbMin(FLT_MAX);
+            glm::vec3 bbMax(-FLT_MAX);
+            for (const auto& [node, primitive] : groups[material]) {
+                const glm::mat4& world = graph.WorldMatrix(node->slot);
+                const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+                // A mirroring transform flips the winding, swapping two corners restores it
+                const bool mirrored = glm::determinant(glm::mat3(world)) < 0.0f;
+                const auto [begin, end] = vertexRange(*primitive);
+                const auto base = static_cast<uint32_t>(batchVertices.size());
+                for (uint32_t v = begin; v < end; ++v) {
+                    Vertex vertex = vertexBuffer[v];
+                    vertex.pos = glm::vec3(world * glm::vec4(vertex.pos, 1.0f));
+                    vertex.normal = glm::normalize(normalMatrix * vertex.normal);
+                    // Tangents lie in the surface and follow the world matrix, mirroring flips the bitangent
+                    if (vertex.tangent.w != 0.0f) {
+                        vertex.tangent = glm::vec4(glm::normalize(glm::mat3(world) * glm::vec3(vertex.tangent)), mirrored ? -vertex.tangent.w : vertex.tangent.w);
+                    }
+                    bbMin = glm::min(bbMin, vertex.pos);
+                    bbMax = glm::max(bbMax, vertex.pos);
+                    batchVertices.push_back(vertex);
+                }
+                // A primitive without indices is a list of its vertices
+                const uint32_t* source = indexBuffer.data() + primitive->firstIndex;
+                const uint32_t cornerCount = primitive->indexCount > 0 ? primitive->indexCount : end - begin;
+                for (uint32_t i = 0; i + 2 < cornerCount; i += 3) {
+                    for (const uint32_t corner : { i, mirrored ? i + 2 : i + 1, mirrored ? i + 1 : i + 2 }) {
+                        batchIndices.push_back((primitive->indexCount > 0 ? source[corner] - begin : corner) + base);
+                    }
+                }
+                ++mergedCount;
+            }
+
+            // Batches span many nodes and stay at full resolution, a level of them would be decided by their nearest part
+            Primitive* newPrimitive = primitivePool.New(firstIndex, static_cast<uint32_t>(batchIndices.size()) - firstIndex,
+                static_cast<uint32_t>(batchVertices.size()) - firstVertex, materials[material]);
+            newPrimitive->firstVertex = firstVertex;
+            newPrimitive->SetBoundingBox(bbMin, bbMax);
+            batchMesh->primitives.data = batchMesh->primitives.empty() ? newPrimitive : batchMesh->primitives.data;
+            ++batchMesh->primitives.count;
+            batchMesh->bb._min = batchMesh->bb.valid ? glm::min(batchMesh->bb._min, bbMin) : bbMin;
+            batchMesh->bb._max = batchMesh->bb.valid ? glm::max(batchMesh->bb._max, bbMax) : bbMax;
+            batchMesh->bb.valid = true;
+        }
+
+        for (Node* node : staticNodes) {
+            node->mesh = nullptr;
+        }
+
+        // Primitives still drawn by other nodes move to the front, sources used only by batches are dropped
+        std::vector<uint32_t> indices;
+        std::vector<Vertex> vertices;
+        std::unordered_map<const Primitive*, bool> kept;
+        for (const Node* node : linearNodes) {
+            if (nullptr == node->mesh) {
+                continue;
+            }
+            for (Primitive& primitive : node->mesh->primitives) {
+                if (false == kept.emplace(&primitive, true).second) {
+                    continue;
+                }
+                const auto [begin, end] = vertexRange(primitive);
+                const auto base = static_cast<uint32_t>(vertices.size());
+                vertices.insert(vertices.end(), vertexBuffer.begin() + begin, vertexBuffer.begin() + end);
+                primitive.firstVertex = base;
+                primitive.vertexCount = end - begin;
+                if (0 == primitive.indexCount) {
+                    continue;
+                }
+                const auto firstIndex = static_cast<uint32_t>(indices.size());
+                for (uint32_t i = 0; i < primitive.indexCount; ++i) {
+                    indices.push_back(indexBuffer[primitive.firstIndex + i] - begin + base);
+                }
+                primitive.firstIndex = firstIndex;
+                // Levels reference a subset of the same vertices
+                for (uint32_t level = 0; level < primitive.lodCount; ++level) {
+                    PrimitiveLod& lod = primitive.lods[level];
+                    const auto lodFirstIndex = static_cast<uint32_t>(indices.size());
+                    for (uint32_t i = 0; i < lod.indexCount; ++i) {
+                        indices.push_back(indexBuffer[lod.firstIndex + i] - begin + base);
+                    }
+                    lod.firstIndex = lodFirstIndex;
+                }
+            }
+        }
+        const auto batchFirstIndex = static_cast<uint32_t>(indices.size());
+        const auto batchFirstVertex = static_cast<uint32_t>(vertices.size());
+        for (uint32_t& index : batchIndices) {
+            index += batchFirstVertex;
+        }
+        for (Primitive& primitive : batchMesh->primitives) {
+            primitive.firstIndex += batchFirstIndex;
+            primitive.firstVertex += batchFirstVertex;
+        }
+        indices.insert(indices.end(), batchIndices.begin(), batchIndices.end());
+        vertices.insert(vertices.end(), batchVertices.begin(), batchVertices.end());
+        indexBuffer.swap(indices);
+        vertexBuffer.swap(vertices);
+
+        // The batch is drawn by a root of its own whose world matrix stays identity
+        const uint32_t slot = graph.Add(-1, batchSourceIndex, "StaticBatch");
+        Node* batchNode = nodePool.New();
+        batchNode->slot = slot;
+        batchNode->mesh = batchMesh;
+        linearNodes.push_back(batchNode);
+
+        // Every instance matrix has to be written by the next update
+        for (uint32_t root = 0; root < graph.Size(); ++root) {
+            if (graph.parents[root] < 0) {
+                graph.MarkDirty(root);
+            }
+        }
+
+        std::cout << "Static batching merged " << mergedCount << " primitives of " << staticNodes.size() << " nodes into " << batchMesh->primitives.size() << " draws" << std::endl;
+    }
+
+    void Model::BuildInstances(VkQueue transferQueue) {
+        // Meshes are counted in slot order, then every node takes the next instances of its mesh
+        meshes.clear();
+        for (const Node* node : linearNodes) {
+            if (node->mesh) {
+                if (0 == node->mesh->instanceCount) {
+                    meshes.push_back(node->mesh);
                 }
+                node->mesh->instanceCount += std::max(node->instanceCount, 1u);
             }
         }
 
-        parentBvh._min = glm::min(parentBvh._min, node->bvh._min);
-        parentBvh._max = glm::min(parentBvh._max, node->bvh._max);
+        uint32_t instanceCount = 0;
+        drawCount = 0;
+        for (Mesh* mesh : meshes) {
+            mesh->firstInstance = instanceCount;
+            instanceCount += mesh->instanceCount;
+            mesh->instanceCount = 0;
+            mesh->firstDraw = drawCount;
+            drawCount += static_cast<uint32_t>(mesh->primitives.size());
+        }
 
-        for (auto& child : node->children) {
-            CalculateBoundingBox(child, node);
+        // Instances of one EXT_mesh_gpu_instancing node repeat its slot and differ in their transform
+        instanceSlots.resize(instanceCount);
+        instanceLocals.assign(std::max(instanceCount, 1u), InstanceTransform{});
+        for (const Node* node : linearNodes) {
+            if (node->mesh) {
+                const uint32_t first = node->mesh->firstInstance + node->mesh->instanceCount;
+                const uint32_t count = std::max(node->instanceCount, 1u);
+                std::fill_n(instanceSlots.begin() + first, count, node->slot);
+                if (node->instanceCount > 0) {
+                    std::copy_n(nodeInstances.begin() + node->firstInstance, count, instanceLocals.begin() + first);
+                }
+                node->mesh->instanceCount += count;
+            }
+        }
+
+        const VkDeviceSize bufferSize = std::max(instanceCount, 1u) * sizeof(glm::mat4);
+        CheckResult(device->CreateBuffer(
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            bufferSize,
+            &instances.buffer,
+            &instances.memory));
+        CheckResult(vkMapMemory(device->logicalDevice, instances.memory, 0, bufferSize, 0, reinterpret_cast<void**>(&instances.mapped)));
+
+        // Instance transforms never change, they go to device local memory through a staging buffer
+        const VkDeviceSize transformsSize = instanceLocals.size() * sizeof(InstanceTransform);
+        VkBuffer stagingBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+        CheckResult(device->CreateBuffer(
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            transformsSize,
+            &stagingBuffer,
+            &stagingMemory,
+            instanceLocals.data()));
+        CheckResult(device->CreateBuffer(
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            transformsSize,
+            &instanceTransforms.buffer,
+            &instanceTransforms.memory));
+
+        VkCommandBuffer copyCmd = device->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+        VkBufferCopy copyRegion = {};
+        copyRegion.size = transformsSize;
+        vkCmdCopyBuffer(copyCmd, stagingBuffer, instanceTransforms.buffer, 1, &copyRegion);
+        device->FlushCommandBuffer(copyCmd, transferQueue, true);
+
+        vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
+        vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
+    }
+
+    void Model::DrawMesh(const Mesh& mesh, VkCommandBuffer commandBuffer, VkIndexType& boundIndexType) {
+        for (const Primitive& primitive : mesh.primitives) {
+            if (primitive.indexType != boundIndexType) {
+                BindIndices(commandBuffer, primitive.indexType);
+                boundIndexType = primitive.indexType;
+            }
+            vkCmdDrawIndexed(commandBuffer, primitive.indexCount, mesh.instanceCount, primitive.firstIndex, primitive.vertexOffset, mesh.firstInstance);
+        }
+    }
+
+    void Model::SelectLods(const glm::mat4& view, float pixelsPerUnit, float maxPixelError, VkDrawIndexedIndirectCommand* commands) const {
+        for (const Mesh* mesh : meshes) {
+            // Pixels per mesh unit at the closest point of the bounding sphere over all instances, unbounded once the camera is inside
+            float meshPixels = FLT_MAX;
+            if (mesh->bb.valid) {
+                const glm::vec3 center = (mesh->bb._min + mesh->bb._max) * 0.5f;
+                const float radius = glm::length(mesh->bb._max - mesh->bb._min) * 0.5f;
+                meshPixels = 0.0f;
+                for (uint32_t instance = mesh->firstInstance; instance < mesh->firstInstance + mesh->instanceCount; ++instance) {
+                    const glm::mat4 modelView = view * graph.worldMatrices[instanceSlots[instance]] * instanceLocals[instance].GetMatrix();
+                    const float scale = std::sqrt(std::max({ glm::dot(modelView[0], modelView[0]), glm::dot(modelView[1], modelView[1]), glm::dot(modelView[2], modelView[2]) }));
+                    const float distance = -(modelView * glm::vec4(center, 1.0f)).z - radius * scale;
+                    if (distance <= 0.0f) {
+                        meshPixels = FLT_MAX;
+                        break;
+                    }
+                    meshPixels = std::max(meshPixels, pixelsPerUnit * scale / distance);
+                }
+            }
+
+            uint32_t draw = mesh->firstDraw;
+            for (const Primitive& primitive : mesh->primitives) {
+                VkDrawIndexedIndirectCommand& command = commands[draw++];
+                command.indexCount = primitive.indexCount;
+                command.instanceCount = mesh->instanceCount;
+                command.firstIndex = primitive.firstIndex;
+                command.vertexOffset = primitive.vertexOffset;
+                command.firstInstance = mesh->firstInstance;
+                for (uint32_t level = 0; level < primitive.lodCount && primitive.lods[level].error * meshPixels <= maxPixelError; ++level) {
+                    command.indexCount = primitive.lods[level].indexCount;
+                    command.firstIndex = primitive.lods[level].firstIndex;
+                }
+            }
+        }
+    }
+
+    void Model::Draw(VkCommandBuffer commandBuffer) {
+        const VkDeviceSize offsets[1] = { 0 };
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+        VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+        for (const Mesh* mesh : meshes) {
+            DrawMesh(*mesh, commandBuffer, boundIndexType);
         }
     }
 
     void Model::GetSceneDimensions() {
         // Calculate binary volume hierarchy for all nodes in the scene
         for (auto node : linearNodes) {
-            CalculateBoundingBox(node, nullptr);
+            if (node->mesh && node->mesh->bb.valid) {
+                node->aabb = node->mesh->bb.GetAABB(graph.WorldMatrix(node->slot));
+                // EXT_mesh_gpu_instancing nodes enclose all of their instances
+                for (uint32_t i = 0; i < node->instanceCount; ++i) {
+                    const BoundingBox instanceBox = node->mesh->bb.GetAABB(graph.WorldMatrix(node->slot) * nodeInstances[node->firstInstance + i].GetMatrix());
+                    node->aabb._min = 0 == i ? instanceBox._min : glm::min(node->aabb._min, instanceBox._min);
+                    node->aabb._max = 0 == i ? instanceBox._max : glm::max(node->aabb._max, instanceBox._max);
+                }
+                if (graph.IsLeaf(node->slot)) {
+                    node->bvh._min = node->aabb._min;
+                    node->bvh._max = node->aabb._max;
+                    node->bvh.valid = true;
+                }
+            }
         }
 
         dimensions.min = glm::vec3(FLT_MAX);
@@ -1056,6 +1888,45 @@ namespace Vk {
         aabb[3][2] = dimensions.min[2];
     }
 
+    void Model::UpdateMesh(Mesh& mesh) {
+        // glTF skins ignore the transform of the mesh node, the joints alone place the vertices
+        const Skin* skin = skins[mesh.skinIndex];
+        size_t numJoints = std::min((uint32_t)skin->joints.size(), MAX_NUM_JOINTS);
+        for (size_t i = 0; i < numJoints; i++) {
+            mesh.uniformBlock.jointMatrix[i] = graph.WorldMatrix(skin->joints[i]) * skin->inverseBindMatrices[i];
+        }
+        mesh.uniformBlock.jointcount = (float)numJoints;
+        memcpy(mesh.uniformBuffer.mapped, &mesh.uniformBlock, sizeof(mesh.uniformBlock));
+    }
+
+    void Model::UpdateMeshes() {
+        if (0 == graph.UpdateWorldMatrices()) {
+            return;
+        }
+
+        // Only instances and skins that moved get new matrices
+        for (size_t instance = 0; instance < instanceSlots.size(); ++instance) {
+            const uint32_t slot = instanceSlots[instance];
+            if (graph.WorldChanged(slot)) {
+                instances.mapped[instance] = graph.WorldMatrix(slot);
+            }
+        }
+
+        const auto changed = [this](const Skin& skin) {
+            for (const uint32_t joint : skin.joints) {
+                if (graph.WorldChanged(joint)) {
+                    return true;
+                }
+            }
+            return false;
+        };
+        for (Mesh* mesh : meshes) {
+            if (mesh->skinIndex > -1 && changed(*skins[mesh->skinIndex])) {
+                UpdateMesh(*mesh);
+            }
+        }
+    }
+
     void Model::UpdateAnimation(uint32_t index, float time) {
         if (index > static_cast<uint32_t>(animations.size()) - 1) {
             std::cout << "No animation with index " << index << std::endl;
@@ -1077,12 +1948,12 @@ namespace Vk {
                         switch (channel.path) {
                         case AnimationChannel::PathType::TRANSLATION: {
                             glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-                            channel.node->translation = glm::vec3(trans);
+                            graph.SetTranslation(channel.node, glm::vec3(trans));
                             break;
                         }
                         case AnimationChannel::PathType::SCALE: {
                             glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-                            channel.node->scale = glm::vec3(trans);
+                            graph.SetScale(channel.node, glm::vec3(trans));
                             break;
                         }
                         case AnimationChannel::PathType::ROTATION: {
@@ -1096,7 +1967,7 @@ namespace Vk {
                             q2.y = sampler.outputsVec4[i + 1].y;
                             q2.z = sampler.outputsVec4[i + 1].z;
                             q2.w = sampler.outputsVec4[i + 1].w;
-                            channel.node->rotation = glm::normalize(glm::slerp(q1, q2, u));
+                            graph.SetRotation(channel.node, glm::normalize(glm::slerp(q1, q2, u)));
                             break;
                         }
                         }
@@ -1105,35 +1976,18 @@ namespace Vk {
                 }
             }
         }
-        if (updated) {
-            for (auto& node : nodes) {
-                node->Update();
-            }
+        if (updated && false == gpuTransforms) {
+            UpdateMeshes();
         }
     }
 
-    Node* Model::FindNode(Node* parent, uint32_t index) {
-        Node* nodeFound = nullptr;
-        if (parent->index == index) {
-            return parent;
-        }
-        for (auto& child : parent->children) {
-            nodeFound = FindNode(child, index);
-            if (nodeFound) {
-                break;
-            }
-        }
-        return nodeFound;
+    Node* Model::FindNode(std::string_view name) {
+        const int32_t slot = graph.FindByName(name);
+        return slot > -1 ? linearNodes[slot] : nullptr;
     }
 
     Node* Model::NodeFromIndex(uint32_t index) {
-        Node* nodeFound = nullptr;
-        for (auto& node : nodes) {
-            nodeFound = FindNode(node, index);
-            if (nodeFound) {
-                break;
-            }
-        }
-        return nodeFound;
+        const int32_t slot = graph.SlotFromIndex(index);
+        return slot > -1 ? linearNodes[slot] : nullptr;
     }
 }
@@ -2,18 +2,24 @@
 
 #pragma once
 
+#include "Arena.h"
+#include "GltfDocument.h"
+#include "SceneGraph.h"
+#include "VertexLayout.h"
+
 // Changing this value here also requires changing it in the vertex shader
 constexpr auto MAX_NUM_JOINTS = 128u;
+// Simplified levels of a primitive besides its full resolution range
+constexpr auto MAX_PRIMITIVE_LODS = 4u;
 
 namespace tinygltf {
     struct Image;
-    class Node;
-    class Model;
 }
 
 namespace Vk {
     struct VulkanDevice;
-    struct Node;
+    class GltfImageDecoder;
+    struct MeshletBounds;
 
     struct BoundingBox {
         glm::vec3 _min = { 0.0f, 0.0f, 0.0f };
@@ -60,7 +66,17 @@ namespace Vk {
             Load a texture from a glTF image (stored as vector of chars loaded via stb_image)
             Also generates the mip chain as glTF images are stored as jpg or png without any mips
         */
-        void FromgltfImage(tinygltf::Image& gltfimage, TextureSampler textureSampler, Vk::VulkanDevice* inDevice, VkQueue copyQueue);
+        void FromgltfImage(const tinygltf::Image& gltfimage, TextureSampler textureSampler, Vk::VulkanDevice* inDevice, VkQueue copyQueue);
+
+        /*
+            Load a texture from tightly packed RGBA8 pixels and generate its mip chain
+        */
+        void FromPixels(const unsigned char* buffer, VkDeviceSize bufferSize, uint32_t imageWidth, uint32_t imageHeight, TextureSampler textureSampler, Vk::VulkanDevice* inDevice, VkQueue copyQueue);
+
+        /*
+            Pixels of a glTF image in the layout FromPixels expects, RGB images are expanded into converted
+        */
+        static const unsigned char* GetPixels(const tinygltf::Image& gltfimage, std::vector<unsigned char>& converted, VkDeviceSize& bufferSize);
     };
 
     /*
@@ -100,6 +116,88 @@ namespace Vk {
         VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
     };
 
+    /*
+        Vertex streams uploaded by Model::UploadBuffers. The loader and the cooked files always work with Model::Vertex,
+        packed formats are converted right before the upload. VertexStreams holds the layouts of each format
+    */
+    enum class VertexFormat : uint32_t {
+        Float,              // Model::Vertex, 88 bytes in one stream
+        Packed,             // PackedVertex, 28 bytes, plus PackedSkin for the vertices of skinned meshes
+        Quantized,          // QuantizedVertex, 24 bytes, positions relative to the bounds of their primitive, plus PackedSkin
+    };
+
+    // Octahedral normal as snorm16, texture coordinates as half floats, tangent and its sign as snorm8
+    struct PackedVertex {
+        glm::vec3 position{};
+        int16_t normal[2]{};
+        uint32_t uv0 = 0;
+        uint32_t uv1 = 0;
+        int8_t tangent[4]{};
+    };
+
+    // PackedVertex with the position as unorm16 within a cube around the bounds of its primitive, see Primitive::positionScale
+    struct QuantizedVertex {
+        uint16_t position[4]{};
+        int16_t normal[2]{};
+        uint32_t uv0 = 0;
+        uint32_t uv1 = 0;
+        int8_t tangent[4]{};
+    };
+
+    // Second stream of packed formats, only the vertices of skinned meshes have one
+    struct PackedSkin {
+        uint8_t joints[4]{};
+        uint16_t weights[4]{};
+    };
+
+    /*
+        Streams of Model::splitStreams. Positions move into a buffer of their own, a glm::vec3 or QuantizedPosition per
+        vertex, and the remaining attributes keep their order and formats in the vertex buffer
+    */
+    struct FloatAttributes {
+        glm::vec3 normal{};
+        glm::vec2 uv0{};
+        glm::vec2 uv1{};
+        glm::vec4 joint0{};
+        glm::vec4 weight0{};
+        glm::vec4 tangent{};
+    };
+
+    struct PackedAttributes {
+        int16_t normal[2]{};
+        uint32_t uv0 = 0;
+        uint32_t uv1 = 0;
+        int8_t tangent[4]{};
+    };
+
+    struct QuantizedPosition {
+        uint16_t position[4]{};
+    };
+
+    /*
+        Simplified index range of a primitive over the same vertices, error is the largest distance to the full
+        resolution surface in mesh units
+    */
+    struct PrimitiveLod {
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        float error = 0.0f;
+    };
+
+    /*
+        Meshlet of a full resolution range as read by meshletcull.comp. The cone is an snorm8 axis and cutoff,
+        a cutoff of 1 never culls
+    */
+    struct Meshlet {
+        glm::vec3 center{ 0.0f };       // Bounding sphere in mesh units
+        float radius = 0.0f;
+        int8_t cone[4]{ 0, 0, 0, 127 };
+        uint32_t firstIndex = 0;        // In the index section of the primitive, like Primitive::firstIndex
+        uint16_t indexCount = 0;
+        uint16_t drawOffset = 0;        // Position among the meshlets of its draw
+        uint32_t draw = 0;              // Draw command of the primitive, see Model::SelectLods
+    };
+
     /*
         glTF primitive
     */
@@ -109,9 +207,27 @@ namespace Vk {
         uint32_t vertexCount;
         Material& material;
         bool hasIndices;
+        // First of the vertexCount vertices of the primitive, the range a non-indexed primitive draws
+        uint32_t firstVertex = 0;
 
         BoundingBox bb;
 
+        // Coarser with every level, see Model::SelectLods
+        std::array<PrimitiveLod, MAX_PRIMITIVE_LODS> lods{};
+        uint32_t lodCount = 0;
+
+        // Set by Model::UploadBuffers, indices of the primitive and its levels are relative to vertexOffset
+        int32_t vertexOffset = 0;
+        VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+
+        // Dequantization of VertexFormat::Quantized positions, offset + position * scale
+        glm::vec3 positionOffset{ 0.0f };
+        float positionScale = 1.0f;
+
+        // Meshlets of the full resolution range, zero unless Model::buildMeshlets, see Model::PackMeshlets
+        uint32_t firstMeshlet = 0;
+        uint32_t meshletCount = 0;
+
         Primitive(uint32_t firstIndex, uint32_t indexCount, uint32_t vertexCount, Material& material) : firstIndex(firstIndex), indexCount(indexCount), vertexCount(vertexCount), material(material) {
             hasIndices = indexCount > 0;
         };
@@ -124,16 +240,27 @@ namespace Vk {
     };
 
     /*
-        glTF mesh
+        glTF mesh, shared by every node that draws the same glTF mesh with the same skin
     */
     struct Mesh {
         Vk::VulkanDevice* device = nullptr;
 
-        std::vector<Primitive*> primitives;
+        // Consecutive primitives owned by the model
+        ArenaSpan<Primitive> primitives;
 
         BoundingBox bb;
         BoundingBox aabb;
 
+        int32_t skinIndex = -1;
+
+        // Range of Model::instanceSlots, all instances are drawn with one instanced draw per primitive
+        uint32_t firstInstance = 0;
+        uint32_t instanceCount = 0;
+        // Indirect draw command of the first primitive, see Model::SelectLods
+        uint32_t firstDraw = 0;
+        // Meshlet draw of the first primitive, the meshlets of each primitive follow the ones before it
+        uint32_t firstMeshletDraw = 0;
+
         struct UniformBuffer {
             VkBuffer buffer = VK_NULL_HANDLE;
             VkDeviceMemory memory = VK_NULL_HANDLE;
@@ -142,13 +269,13 @@ namespace Vk {
             void* mapped = nullptr;
         } uniformBuffer;
 
+        // The world matrix comes from the instance buffer, joint matrices already include the joint world matrix
         struct UniformBlock {
-            glm::mat4 matrix{ glm::identity<glm::mat4>() };
             glm::mat4 jointMatrix[MAX_NUM_JOINTS]{};
             float jointcount{ 0 };
         } uniformBlock;
 
-        Mesh(Vk::VulkanDevice* device, glm::mat4 matrix);
+        Mesh(Vk::VulkanDevice* device, int32_t skinIndex);
         ~Mesh();
 
         void SetBoundingBox(glm::vec3 min, glm::vec3 max) {
@@ -163,35 +290,38 @@ namespace Vk {
     */
     struct Skin {
         std::string name;
-        Node* skeletonRoot = nullptr;
+        int32_t skeletonRoot = -1;
         std::vector<glm::mat4> inverseBindMatrices;
-        std::vector<Node*> joints;
+        std::vector<uint32_t> joints;   // Slots in Model::graph
+    };
+
+    /*
+        EXT_mesh_gpu_instancing transform of one instance relative to its node. The rotation quaternion is stored
+        as 16 bit snorm, which keeps an instance at 32 bytes of the instance rate vertex stream
+    */
+    struct InstanceTransform {
+        glm::vec3 translation{ 0.0f };
+        glm::vec3 scale{ 1.0f };
+        int16_t rotation[4]{ 0, 0, 0, std::numeric_limits<int16_t>::max() };
+
+        InstanceTransform() = default;
+        InstanceTransform(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+        glm::mat4 GetMatrix() const;
     };
 
     /*
-        glTF node
+        glTF node, hierarchy and transform live in Model::graph at slot
     */
     struct Node {
-        Node* parent = nullptr;
-        uint32_t index = 0;
-        std::vector<Node*> children;
-        glm::mat4 matrix{ glm::identity<glm::mat4>() };
-        std::string name;
+        uint32_t slot = 0;
         Mesh* mesh = nullptr;
         Skin* skin = nullptr;
         int32_t skinIndex = -1;
-        glm::vec3 translation{};
-        glm::vec3 scale{ 1.0f };
-        glm::quat rotation{};
+        // Range of Model::nodeInstances, a node without EXT_mesh_gpu_instancing draws its mesh once
+        uint32_t firstInstance = 0;
+        uint32_t instanceCount = 0;
         BoundingBox bvh;
         BoundingBox aabb;
-
-        glm::mat4 LocalMatrix();
-        glm::mat4 GetMatrix();
-
-        void Update();
-
-        ~Node();
     };
 
     /*
@@ -200,7 +330,7 @@ namespace Vk {
     struct AnimationChannel {
         enum PathType { TRANSLATION, ROTATION, SCALE };
         PathType path;
-        Node* node = nullptr;
+        uint32_t node = 0;  // Slot in Model::graph
         uint32_t samplerIndex = 0;
     };
 
@@ -225,6 +355,18 @@ namespace Vk {
         float end = std::numeric_limits<float>::min();
     };
 
+    /*
+        Import steps of Model::LoadFromFile. Their results are cooked, so a cooked file is only used with the options it was made with
+    */
+    struct ModelImportOptions {
+        bool staticBatching = false;        // See Model::BatchStaticMeshes
+        bool optimizeMeshes = true;         // Vertex cache, overdraw and vertex fetch order of every triangle list
+        bool generateLods = true;           // Simplified index ranges of every unskinned triangle list
+        bool generateTangents = false;      // Tangents of normal mapped triangle lists without a TANGENT attribute
+
+        uint32_t GetFlags() const { return (staticBatching ? 1u : 0u) | (optimizeMeshes ? 2u : 0u) | (generateLods ? 4u : 0u) | (generateTangents ? 8u : 0u); }
+    };
+
     /*
         glTF model loading and rendering class
     */
@@ -238,6 +380,7 @@ namespace Vk {
             glm::vec2 uv1{};
             glm::vec4 joint0{};
             glm::vec4 weight0{};
+            glm::vec4 tangent{};            // xyz along +u, bitangent is cross(normal, xyz) * w, zero when the primitive has none
         };
 
         struct Vertices {
@@ -245,19 +388,70 @@ namespace Vk {
             VkDeviceMemory memory = VK_NULL_HANDLE;
         } vertices;
 
+        // 16 bit indices first, the 32 bit ones follow at wideOffset, see Primitive::indexType
         struct Indices {
             int count;
             VkBuffer buffer = VK_NULL_HANDLE;
             VkDeviceMemory memory = VK_NULL_HANDLE;
+            VkDeviceSize wideOffset = 0;
         } indices;
 
+        // PackedSkin stream of packed formats, the vertices of skinned meshes come first in vertices
+        struct SkinVertices {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+        } skinVertices;
+
+        // Position stream of splitStreams, vertices then holds the other attributes
+        struct Positions {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+        } positions;
+
+        // Chosen before loading, the scene creates its pipelines for one format
+        VertexFormat vertexFormat = VertexFormat::Float;
+        bool splitStreams = false;          // Positions apart from the other attributes, passes that only need depth fetch less
+
+        // Meshlets of unskinned primitives in draw order, a storage buffer for meshlet culling
+        struct Meshlets {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            uint32_t count = 0;
+        } meshlets;
+        bool buildMeshlets = false;         // Chosen before loading like vertexFormat
+
+        // World matrix of every mesh instance, an instance rate vertex stream that meshlet culling reads as well
+        struct Instances {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            glm::mat4* mapped = nullptr;
+        } instances;
+
+        // InstanceTransform of every mesh instance, a device local instance rate vertex stream next to instances
+        struct InstanceTransforms {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+        } instanceTransforms;
+
         glm::mat4 aabb{ glm::identity<glm::mat4>() };
 
-        std::vector<Node*> nodes;
-        std::vector<Node*> linearNodes;
+        SceneGraph graph;
+        std::vector<Node*> linearNodes;     // Indexed by graph slot
+        std::vector<Mesh*> meshes;          // In order of first use
+        std::vector<uint32_t> instanceSlots;    // Graph slot of every mesh instance, grouped by mesh
+        std::vector<InstanceTransform> nodeInstances;   // EXT_mesh_gpu_instancing transforms, in ranges of Node
+        std::vector<InstanceTransform> instanceLocals;  // Transform of every mesh instance relative to its node, as uploaded
+        uint32_t drawCount = 0;             // Primitives of all meshes, one indirect draw command each
+        bool gpuTransforms = false;         // Matrices are resolved on the GPU, animations leave the mesh uniform buffers alone
 
         std::vector<Skin*> skins;
 
+        // Nodes, meshes, primitives and skins live in these pools and are released together by Destroy
+        ObjectPool<Node> nodePool;
+        ObjectPool<Mesh> meshPool;
+        ObjectPool<Primitive> primitivePool;
+        ObjectPool<Skin> skinPool;
+
         std::vector<ModelTexture> textures;
         std::vector<TextureSampler> textureSamplers;
         std::vector<Material> materials;
@@ -269,26 +463,174 @@ namespace Vk {
             glm::vec3 max = glm::vec3(-FLT_MAX);
         } dimensions;
 
+        /*
+            Primitive whose vertices and indices are converted once the node tree is built
+        */
+        struct PrimitiveLoad {
+            const GltfDocument::Primitive* source = nullptr;
+            Primitive* primitive = nullptr;
+            uint32_t firstVertex = 0;
+            uint32_t firstIndex = 0;
+            uint32_t vertexCount = 0;
+            uint32_t indexCount = 0;
+        };
+
+        struct LoaderInfo {
+            std::vector<PrimitiveLoad> primitives;
+            std::vector<Mesh*> meshes;      // First Mesh of each glTF mesh, other skins share its primitives
+            std::unordered_map<uint64_t, Mesh*> sharedMeshes;   // By glTF mesh and skin index
+            uint32_t vertexCount = 0;
+            uint32_t indexCount = 0;
+        };
+
         void Destroy(VkDevice inDevice);
-        void LoadNode(Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale);
-        void LoadSkins(tinygltf::Model& gltfModel);
-        void LoadTextures(tinygltf::Model& gltfModel, Vk::VulkanDevice* inDevice, VkQueue transferQueue);
+        void LoadNode(int32_t parent, const GltfDocument::Node& node, uint32_t nodeIndex, const GltfDocument& document, LoaderInfo& loaderInfo, float globalscale);
+        void LoadPrimitives(const GltfDocument& document, const LoaderInfo& loaderInfo, const ModelImportOptions& options, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer);
+        void LoadSkins(const GltfDocument& document);
+        bool LoadTextures(const GltfDocument& document, const std::string& baseDir, GltfImageDecoder& imageDecoder, Vk::VulkanDevice* inDevice, VkQueue transferQueue, std::string& error);
         VkSamplerAddressMode GetVkWrapMode(int32_t wrapMode);
         VkFilter GetVkFilterMode(int32_t filterMode);
-        void LoadTextureSamplers(tinygltf::Model& gltfModel);
-        void LoadMaterials(tinygltf::Model& gltfModel);
-        void LoadAnimations(tinygltf::Model& gltfModel);
-        void LoadFromFile(const std::string& filename, Vk::VulkanDevice* inDevice, VkQueue transferQueue, float scale = 1.0f);
-        void DrawNode(Node* node, VkCommandBuffer commandBuffer);
+        void LoadTextureSamplers(const GltfDocument& document);
+        void LoadMaterials(const GltfDocument& document);
+        void LoadAnimations(const GltfDocument& document);
+        TextureSampler GetTextureSampler(int32_t samplerIndex) const;
+        void LoadFromFile(const std::string& filename, Vk::VulkanDevice* inDevice, VkQueue transferQueue, float scale = 1.0f, const std::string& cookedFilename = {}, const ModelImportOptions& options = {});
+        // Converts the vertices to vertexFormat and uploads them with the indices, which packed formats reorder along with
+        // the firstVertex of primitives without indices. Split streams upload the positions to their own buffer
+        void UploadBuffers(const Vertex* vertexData, size_t vertexCount, const uint32_t* indexData, size_t indexCount, VkQueue transferQueue);
+        /*
+            Moves the index ranges of every drawn primitive and its levels next to each other, relative to the smallest
+            vertex they reference. Primitives that span at most 65536 vertices get 16 bit indices. Returns the contents of
+            the index buffer and sets indices.wideOffset, index data no primitive draws is dropped
+        */
+        std::vector<uint8_t> PackIndexRanges(const uint32_t* indexData, size_t indexCount);
+        // Cuts the full resolution range of every unskinned primitive into meshlets and sets its firstMeshlet and meshletCount
+        std::vector<MeshletBounds> BuildMeshlets(const Vertex* vertexData, size_t vertexCount, const uint32_t* indexData, size_t indexCount);
+        // Meshlets in draw order, at the index ranges PackIndexRanges moved their primitives to
+        std::vector<Meshlet> PackMeshlets(const std::vector<MeshletBounds>& bounds);
+        // Binds the index buffer section of indexType
+        void BindIndices(VkCommandBuffer commandBuffer, VkIndexType indexType) const;
+        /*
+            Pre-applies the world matrices of static nodes to copies of their vertices and merges the copies per material
+            into one primitive each, drawn by a new root node with an identity transform. Primitives without indices are merged
+            as triangle lists of their vertices. The bounding box of each merged primitive is kept for culling. Vertex and index
+            data of sources no other node draws is dropped
+        */
+        void BatchStaticMeshes(uint32_t batchSourceIndex, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer);
+        // Groups the nodes by mesh into instanceSlots, a node adds one instance per EXT_mesh_gpu_instancing transform.
+        // Creates the instance buffer and uploads the instance transforms
+        void BuildInstances(VkQueue transferQueue);
+        void LoadNodeInstances(const GltfDocument& document, const GltfDocument::MeshGpuInstancing& instancing, Node& node);
+
+        /*
+            Cooked model files hold the final vertex and index data, RGBA8 images and flattened node, mesh, material,
+            skin and animation tables. They are memory mapped on load and only accepted while the source files are unchanged
+        */
+        bool LoadFromCookedFile(const std::string& cookedFilename, Vk::VulkanDevice* inDevice, VkQueue transferQueue, const ModelImportOptions& options = {});
+        void SaveCookedFile(const std::string& cookedFilename, const std::string& filename, const GltfDocument& document, const GltfImageDecoder& imageDecoder, const std::vector<Vertex>& vertexBuffer, const std::vector<uint32_t>& indexBuffer, uint32_t importFlags);
+        // Rebinds the index buffer whenever a primitive needs the other index type than boundIndexType
+        void DrawMesh(const Mesh& mesh, VkCommandBuffer commandBuffer, VkIndexType& boundIndexType);
         void Draw(VkCommandBuffer commandBuffer);
-        void CalculateBoundingBox(Node* node, Node* parent);
+        /*
+            Writes one indexed draw per primitive of every mesh, in mesh order starting at Mesh::firstDraw, drawing the
+            coarsest level whose error stays below maxPixelError on screen. The closest instance of a mesh decides,
+            from the nearest point of the bounding sphere of the mesh. view includes the model matrix of the scene,
+            pixelsPerUnit is the height of one unit at distance one in pixels. Reads the cached CPU world matrices and
+            never resolves dirty nodes, with gpuTransforms animated nodes are measured at the pose of the last CPU update
+        */
+        void SelectLods(const glm::mat4& view, float pixelsPerUnit, float maxPixelError, VkDrawIndexedIndirectCommand* commands) const;
         void GetSceneDimensions();
+        // Refreshes the dirty transforms of the graph, writes the world matrices of moved instances to the instance buffer
+        // and the joint matrices of moved skins to the uniform buffer of their meshes
+        void UpdateMeshes();
+        void UpdateMesh(Mesh& mesh);
         void UpdateAnimation(uint32_t index, float time);
 
         /*
             Helper functions
         */
-        Node* FindNode(Node* parent, uint32_t index);
+        Node* FindNode(std::string_view name);
         Node* NodeFromIndex(uint32_t index);
     };
+
+    /*
+        Vertex layouts of the formats. Interleaved is the vertex buffer of a model, with split streams Position and
+        Attributes take its place. Formats with a skin stream keep joints and weights in Skin instead
+    */
+    using PositionLayout = VertexLayout<glm::vec3,
+        VertexAttribute<VertexSemantic::Position, 0, VK_FORMAT_R32G32B32_SFLOAT, 0>>;
+
+    template<VertexFormat Format>
+    struct VertexStreams;
+
+    template<>
+    struct VertexStreams<VertexFormat::Float> {
+        using Interleaved = VertexLayout<Model::Vertex,
+            VertexAttribute<VertexSemantic::Position, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Model::Vertex, pos)>,
+            VertexAttribute<VertexSemantic::Normal, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Model::Vertex, normal)>,
+            VertexAttribute<VertexSemantic::UV0, 2, VK_FORMAT_R32G32_SFLOAT, offsetof(Model::Vertex, uv0)>,
+            VertexAttribute<VertexSemantic::UV1, 3, VK_FORMAT_R32G32_SFLOAT, offsetof(Model::Vertex, uv1)>,
+            VertexAttribute<VertexSemantic::Joints, 4, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Model::Vertex, joint0)>,
+            VertexAttribute<VertexSemantic::Weights, 5, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Model::Vertex, weight0)>,
+            VertexAttribute<VertexSemantic::Tangent, 13, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Model::Vertex, tangent)>>;
+        using Position = PositionLayout;
+        using Attributes = VertexLayout<FloatAttributes,
+            VertexAttribute<VertexSemantic::Normal, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(FloatAttributes, normal)>,
+            VertexAttribute<VertexSemantic::UV0, 2, VK_FORMAT_R32G32_SFLOAT, offsetof(FloatAttributes, uv0)>,
+            VertexAttribute<VertexSemantic::UV1, 3, VK_FORMAT_R32G32_SFLOAT, offsetof(FloatAttributes, uv1)>,
+            VertexAttribute<VertexSemantic::Joints, 4, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(FloatAttributes, joint0)>,
+            VertexAttribute<VertexSemantic::Weights, 5, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(FloatAttributes, weight0)>,
+            VertexAttribute<VertexSemantic::Tangent, 13, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(FloatAttributes, tangent)>>;
+        static constexpr bool skinStream = false;
+    };
+
+    template<>
+    struct VertexStreams<VertexFormat::Packed> {
+        using Interleaved = VertexLayout<PackedVertex,
+            VertexAttribute<VertexSemantic::Position, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(PackedVertex, position)>,
+            VertexAttribute<VertexSemantic::Normal, 1, VK_FORMAT_R16G16_SNORM, offsetof(PackedVertex, normal)>,
+            VertexAttribute<VertexSemantic::UV0, 2, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedVertex, uv0)>,
+            VertexAttribute<VertexSemantic::UV1, 3, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedVertex, uv1)>,
+            VertexAttribute<VertexSemantic::Tangent, 13, VK_FORMAT_R8G8B8A8_SNORM, offsetof(PackedVertex, tangent)>>;
+        using Position = PositionLayout;
+        using Attributes = VertexLayout<PackedAttributes,
+            VertexAttribute<VertexSemantic::Normal, 1, VK_FORMAT_R16G16_SNORM, offsetof(PackedAttributes, normal)>,
+            VertexAttribute<VertexSemantic::UV0, 2, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedAttributes, uv0)>,
+            VertexAttribute<VertexSemantic::UV1, 3, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedAttributes, uv1)>,
+            VertexAttribute<VertexSemantic::Tangent, 13, VK_FORMAT_R8G8B8A8_SNORM, offsetof(PackedAttributes, tangent)>>;
+        using Skin = VertexLayout<PackedSkin,
+            VertexAttribute<VertexSemantic::Joints, 4, VK_FORMAT_R8G8B8A8_UINT, offsetof(PackedSkin, joints)>,
+            VertexAttribute<VertexSemantic::Weights, 5, VK_FORMAT_R16G16B16A16_UNORM, offsetof(PackedSkin, weights)>>;
+        static constexpr bool skinStream = true;
+    };
+
+    template<>
+    struct VertexStreams<VertexFormat::Quantized> {
+        using Interleaved = VertexLayout<QuantizedVertex,
+            VertexAttribute<VertexSemantic::Position, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(QuantizedVertex, position)>,
+            VertexAttribute<VertexSemantic::Normal, 1, VK_FORMAT_R16G16_SNORM, offsetof(QuantizedVertex, normal)>,
+            VertexAttribute<VertexSemantic::UV0, 2, VK_FORMAT_R16G16_SFLOAT, offsetof(QuantizedVertex, uv0)>,
+            VertexAttribute<VertexSemantic::UV1, 3, VK_FORMAT_R16G16_SFLOAT, offsetof(QuantizedVertex, uv1)>,
+            VertexAttribute<VertexSemantic::Tangent, 13, VK_FORMAT_R8G8B8A8_SNORM, offsetof(QuantizedVertex, tangent)>>;
+        using Position = VertexLayout<QuantizedPosition,
+            VertexAttribute<VertexSemantic::Position, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(QuantizedPosition, position)>>;
+        using Attributes = VertexStreams<VertexFormat::Packed>::Attributes;
+        using Skin = VertexStreams<VertexFormat::Packed>::Skin;
+        static constexpr bool skinStream = true;
+    };
+
+    // Vertex input state of the scene pipelines for the streams of a model
+    struct VertexInputDescription {
+        // Binding 0 is the vertex buffer, with split streams binding 4 holds the positions
+        std::vector<VkVertexInputBindingDescription> bindings;
+        std::vector<VkVertexInputAttributeDescription> attributes;
+        // Binding 3, only declared by the pipelines of skinned meshes
+        std::vector<VkVertexInputBindingDescription> skinBindings;
+        std::vector<VkVertexInputAttributeDescription> skinAttributes;
+        // For passes that only need positions
+        VkVertexInputBindingDescription positionBinding{};
+        VkVertexInputAttributeDescription positionAttribute{};
+    };
+
+    VertexInputDescription DescribeVertexInput(VertexFormat format, bool splitStreams);
 }
@@ -0,0 +1,813 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+#include "VulkanModel.h"
+
+#pragma warning(disable : 4100)
+#include <tinygltf/tiny_gltf.h>
+#pragma warning(default : 4100)
+
+#include "Base64.h"
+#include "GltfImages.h"
+#include "VkUtils.h"
+#include "VulkanDevice.h"
+#include "MappedFile.h"
+
+namespace Vk {
+    namespace {
+        constexpr uint32_t COOKED_MAGIC = 0x4D43464E; // "NFCM"
+        constexpr uint32_t COOKED_VERSION = 9;
+        constexpr uint64_t COOKED_ALIGNMENT = 16;
+
+        enum CookedSection : uint32_t {
+            SECTION_STRINGS,
+            SECTION_DEPENDENCIES,
+            SECTION_EXTENSIONS,
+            SECTION_VERTICES,
+            SECTION_INDICES,
+            SECTION_IMAGES,
+            SECTION_IMAGE_DATA,
+            SECTION_SAMPLERS,
+            SECTION_TEXTURES,
+            SECTION_MATERIALS,
+            SECTION_NODES,
+            SECTION_NODE_INSTANCES,
+            SECTION_MESHES,
+            SECTION_PRIMITIVES,
+            SECTION_SKINS,
+            SECTION_SKIN_JOINTS,
+            SECTION_MATRICES,
+            SECTION_ANIMATIONS,
+            SECTION_ANIMATION_SAMPLERS,
+            SECTION_ANIMATION_CHANNELS,
+            SECTION_FLOATS,
+            SECTION_VEC4S,
+            SECTION_COUNT
+        };
+
+        struct CookedRange {
+            uint64_t offset = 0;
+            uint64_t size = 0;
+        };
+
+        struct CookedHeader {
+            uint32_t magic = COOKED_MAGIC;
+            uint32_t version = COOKED_VERSION;
+            uint32_t vertexStride = sizeof(Model::Vertex);
+            uint32_t sectionCount = SECTION_COUNT;
+            uint32_t importFlags = 0;           // ModelImportOptions::GetFlags
+            uint64_t sourceHash = 0;
+            CookedRange sections[SECTION_COUNT]{};
+        };
+
+        struct CookedString {
+            uint32_t offset = 0;
+            uint32_t length = 0;
+        };
+
+        struct CookedImage {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            uint64_t dataOffset = 0;
+            uint64_t dataSize = 0;
+        };
+
+        struct CookedTexture {
+            TextureSampler sampler{};
+            uint32_t image = 0;
+        };
+
+        struct CookedMaterial {
+            int32_t alphaMode = Material::ALPHAMODE_OPAQUE;
+            float alphaCutoff = 1.0f;
+            float metallicFactor = 1.0f;
+            float roughnessFactor = 1.0f;
+            glm::vec4 baseColorFactor{};
+            glm::vec4 emissiveFactor{};
+            glm::vec4 diffuseFactor{};
+            glm::vec3 specularFactor{};
+            int32_t baseColorTexture = -1;
+            int32_t metallicRoughnessTexture = -1;
+            int32_t normalTexture = -1;
+            int32_t occlusionTexture = -1;
+            int32_t emissiveTexture = -1;
+            int32_t specularGlossinessTexture = -1;
+            int32_t diffuseTexture = -1;
+            Material::TexCoordSets texCoordSets{};
+            uint8_t metallicRoughnessWorkflow = 1;
+            uint8_t specularGlossinessWorkflow = 0;
+        };
+
+        struct CookedNode {
+            CookedString name{};
+            uint32_t index = 0;
+            int32_t parent = -1;
+            int32_t skinIndex = -1;
+            int32_t mesh = -1;
+            glm::mat4 matrix{};
+            glm::vec3 translation{};
+            glm::vec3 scale{};
+            glm::quat rotation{};
+            uint32_t firstInstance = 0;
+            uint32_t instanceCount = 0;
+        };
+
+        struct CookedMesh {
+            int32_t skinIndex = -1;
+            glm::vec3 bbMin{};
+            glm::vec3 bbMax{};
+            uint32_t bbValid = 0;
+            uint32_t firstPrimitive = 0;
+            uint32_t primitiveCount = 0;
+        };
+
+        struct CookedPrimitive {
+            uint32_t firstIndex = 0;
+            uint32_t indexCount = 0;
+            uint32_t vertexCount = 0;
+            uint32_t firstVertex = 0;
+            uint32_t material = 0;
+            glm::vec3 bbMin{};
+            glm::vec3 bbMax{};
+            uint32_t bbValid = 0;
+            uint32_t lodCount = 0;
+            PrimitiveLod lods[MAX_PRIMITIVE_LODS]{};
+        };
+
+        struct CookedSkin {
+            CookedString name{};
+            int32_t skeletonRoot = -1;
+            uint32_t firstJoint = 0;
+            uint32_t jointCount = 0;
+            uint32_t firstMatrix = 0;
+            uint32_t matrixCount = 0;
+        };
+
+        struct CookedAnimation {
+            CookedString name{};
+            float start = 0.0f;
+            float end = 0.0f;
+            uint32_t firstSampler = 0;
+            uint32_t samplerCount = 0;
+            uint32_t firstChannel = 0;
+            uint32_t channelCount = 0;
+        };
+
+        struct CookedAnimationSampler {
+            int32_t interpolation = AnimationSampler::LINEAR;
+            uint32_t firstInput = 0;
+            uint32_t inputCount = 0;
+            uint32_t firstOutput = 0;
+            uint32_t outputCount = 0;
+        };
+
+        struct CookedAnimationChannel {
+            int32_t path = AnimationChannel::TRANSLATION;
+            uint32_t node = 0;
+            uint32_t samplerIndex = 0;
+        };
+
+        template<typename T>
+        struct CookedArray {
+            const T* data = nullptr;
+            size_t count = 0;
+
+            const T* begin() const { return data; }
+            const T* end() const { return data + count; }
+            const T& operator[](size_t i) const { return data[i]; }
+            bool Contains(uint64_t first, uint64_t size) const { return first <= count && size <= count - first; }
+        };
+
+        uint64_t HashBytes(const uint8_t* data, size_t size, uint64_t hash) {
+            // FNV-1a over 64 bit words, only used to notice changed source files
+            constexpr uint64_t prime = 0x100000001b3ull;
+            size_t i = 0;
+            for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+                uint64_t word;
+                memcpy(&word, data + i, sizeof(uint64_t));
+                hash = (hash ^ word) * prime;
+            }
+            for (; i < size; ++i) {
+                hash = (hash ^ data[i]) * prime;
+            }
+            return (hash ^ size) * prime;
+        }
+
+        bool HashSourceFiles(const std::filesystem::path& directory, const std::vector<std::string>& dependencies, uint64_t& hash) {
+            hash = 0xcbf29ce484222325ull;
+            for (const auto& dependency : dependencies) {
+                MappedFile file;
+                if (false == file.Open((directory / dependency).string())) {
+                    return false;
+                }
+                hash = HashBytes(file.Data(), file.Size(), hash);
+            }
+            return true;
+        }
+
+        class CookedWriter {
+        public:
+            template<typename T>
+            uint32_t Append(CookedSection section, const T* data, size_t count) {
+                static_assert(std::is_trivially_copyable<T>::value, "cooked records are copied as raw bytes");
+                auto& bytes = _sections[section];
+                const auto first = static_cast<uint32_t>(bytes.size() / sizeof(T));
+                const auto* src = reinterpret_cast<const uint8_t*>(data);
+                bytes.insert(bytes.end(), src, src + count * sizeof(T));
+                return first;
+            }
+
+            template<typename T>
+            uint32_t Append(CookedSection section, const T& value) {
+                return Append(section, &value, 1);
+            }
+
+            // Index the next record appended to section will get
+            template<typename T>
+            uint32_t Next(CookedSection section) const {
+                return static_cast<uint32_t>(_sections[section].size() / sizeof(T));
+            }
+
+            CookedString AddString(std::string_view value) {
+                CookedString result{};
+                result.offset = static_cast<uint32_t>(_sections[SECTION_STRINGS].size());
+                result.length = static_cast<uint32_t>(value.size());
+                Append(SECTION_STRINGS, value.data(), value.size());
+                return result;
+            }
+
+            bool Write(const std::string& filename, uint32_t importFlags, uint64_t sourceHash) const {
+                CookedHeader header{};
+                header.importFlags = importFlags;
+                header.sourceHash = sourceHash;
+
+                uint64_t offset = Align(sizeof(CookedHeader));
+                for (uint32_t i = 0; i < SECTION_COUNT; ++i) {
+                    header.sections[i].offset = offset;
+                    header.sections[i].size = _sections[i].size();
+                    offset = Align(offset + _sections[i].size());
+                }
+
+                // Write next to the target first so an interrupted cook never leaves a truncated file behind
+                const std::string tempFilename = filename + ".tmp";
+                {
+                    std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+                    if (false == file.is_open()) {
+                        return false;
+                    }
+
+                    const char padding[COOKED_ALIGNMENT]{};
+                    file.write(reinterpret_cast<const char*>(&header), sizeof(CookedHeader));
+                    file.write(padding, header.sections[0].offset - sizeof(CookedHeader));
+                    for (uint32_t i = 0; i < SECTION_COUNT; ++i) {
+                        const auto& bytes = _sections[i];
+                        file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+                        file.write(padding, Align(bytes.size()) - bytes.size());
+                    }
+                    if (false == file.good()) {
+                        return false;
+                    }
+                }
+
+                std::error_code error;
+                std::filesystem::rename(tempFilename, filename, error);
+                return false == static_cast<bool>(error);
+            }
+
+        private:
+            static uint64_t Align(uint64_t value) {
+                return (value + COOKED_ALIGNMENT - 1) & ~(COOKED_ALIGNMENT - 1);
+            }
+
+            std::array<std::vector<uint8_t>, SECTION_COUNT> _sections;
+        };
+
+        class CookedReader {
+        public:
+            bool Open(const std::string& filename) {
+                if (false == _file.Open(filename) || _file.Size() < sizeof(CookedHeader)) {
+                    return false;
+                }
+
+                _header = reinterpret_cast<const CookedHeader*>(_file.Data());
+                if (COOKED_MAGIC != _header->magic || COOKED_VERSION != _header->version ||
+                    sizeof(Model::Vertex) != _header->vertexStride || SECTION_COUNT != _header->sectionCount) {
+                    return false;
+                }
+
+                for (const auto& section : _header->sections) {
+                    if (section.offset > _file.Size() || section.size > _file.Size() - section.offset || 0 != section.offset % COOKED_ALIGNMENT) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            uint32_t ImportFlags() const { return _header->importFlags; }
+            uint64_t SourceHash() const { return _header->sourceHash; }
+
+            template<typename T>
+            bool Get(CookedSection section, CookedArray<T>& result) const {
+                const auto& range = _header->sections[section];
+                if (0 != range.size % sizeof(T)) {
+                    return false;
+                }
+                result.data = reinterpret_cast<const T*>(_file.Data() + range.offset);
+                result.count = static_cast<size_t>(range.size / sizeof(T));
+                return true;
+            }
+
+            bool GetString(const CookedString& value, std::string& result) const {
+                std::string_view view;
+                if (false == GetString(value, view)) {
+                    return false;
+                }
+                result.assign(view);
+                return true;
+            }
+
+            // View into the mapped file
+            bool GetString(const CookedString& value, std::string_view& result) const {
+                const auto& range = _header->sections[SECTION_STRINGS];
+                if (value.offset > range.size || value.length > range.size - value.offset) {
+                    return false;
+                }
+                result = std::string_view(reinterpret_cast<const char*>(_file.Data() + range.offset + value.offset), value.length);
+                return true;
+            }
+
+        private:
+            MappedFile          _file;
+            const CookedHeader* _header = nullptr;
+        };
+
+        int32_t TextureIndex(const std::vector<ModelTexture>& textures, const ModelTexture* texture) {
+            return texture ? static_cast<int32_t>(texture - textures.data()) : -1;
+        }
+    }
+
+    void Model::SaveCookedFile(const std::string& cookedFilename, const std::string& filename, const GltfDocument& document, const GltfImageDecoder& imageDecoder, const std::vector<Vertex>& vertexBuffer, const std::vector<uint32_t>& indexBuffer, uint32_t importFlags) {
+        CookedWriter writer;
+
+        // Source files, relative to the directory of the glTF file
+        const std::filesystem::path sourcePath(filename);
+        std::vector<std::string> dependencies{ sourcePath.filename().string() };
+        DataUri dataUri;
+        for (const auto& buffer : document.buffers) {
+            if (false == buffer.uri.empty() && false == ParseDataUri(buffer.uri, dataUri)) {
+                dependencies.emplace_back(buffer.uri);
+            }
+        }
+        for (const auto& image : document.images) {
+            if (false == image.uri.empty() && false == ParseDataUri(image.uri, dataUri)) {
+                dependencies.emplace_back(image.uri);
+            }
+        }
+
+        uint64_t sourceHash = 0;
+        if (false == HashSourceFiles(sourcePath.parent_path(), dependencies, sourceHash)) {
+            std::cerr << "Could not hash the sources of " << filename << ", skipping cooked file" << std::endl;
+            return;
+        }
+        for (const auto& dependency : dependencies) {
+            writer.Append(SECTION_DEPENDENCIES, writer.AddString(dependency));
+        }
+        for (const auto& extension : extensions) {
+            writer.Append(SECTION_EXTENSIONS, writer.AddString(extension));
+        }
+
+        writer.Append(SECTION_VERTICES, vertexBuffer.data(), vertexBuffer.size());
+        writer.Append(SECTION_INDICES, indexBuffer.data(), indexBuffer.size());
+
+        // Images are stored the way they are uploaded, so loading skips the decode
+        std::vector<int32_t> cookedImages(document.images.size(), -1);
+        uint64_t imageDataOffset = 0;
+        for (const auto& tex : document.textures) {
+            CookedTexture texture{};
+            texture.sampler = GetTextureSampler(tex.sampler);
+
+            if (-1 == cookedImages[tex.source]) {
+                const tinygltf::Image& gltfimage = imageDecoder.GetImage(tex.source);
+                std::vector<unsigned char> converted;
+                VkDeviceSize bufferSize = 0;
+                const unsigned char* pixels = ModelTexture::GetPixels(gltfimage, converted, bufferSize);
+
+                CookedImage image{};
+                image.width = static_cast<uint32_t>(gltfimage.width);
+                image.height = static_cast<uint32_t>(gltfimage.height);
+                image.dataOffset = imageDataOffset;
+                image.dataSize = bufferSize;
+                writer.Append(SECTION_IMAGE_DATA, pixels, static_cast<size_t>(bufferSize));
+                imageDataOffset += bufferSize;
+
+                cookedImages[tex.source] = static_cast<int32_t>(writer.Append(SECTION_IMAGES, image));
+            }
+            texture.image = static_cast<uint32_t>(cookedImages[tex.source]);
+            writer.Append(SECTION_TEXTURES, texture);
+        }
+
+        writer.Append(SECTION_SAMPLERS, textureSamplers.data(), textureSamplers.size());
+
+        for (const auto& material : materials) {
+            CookedMaterial cooked{};
+            cooked.alphaMode = material.alphaMode;
+            cooked.alphaCutoff = material.alphaCutoff;
+            cooked.metallicFactor = material.metallicFactor;
+            cooked.roughnessFactor = material.roughnessFactor;
+            cooked.baseColorFactor = material.baseColorFactor;
+            cooked.emissiveFactor = material.emissiveFactor;
+            cooked.diffuseFactor = material.extension.diffuseFactor;
+            cooked.specularFactor = material.extension.specularFactor;
+            cooked.baseColorTexture = TextureIndex(textures, material.baseColorTexture);
+            cooked.metallicRoughnessTexture = TextureIndex(textures, material.metallicRoughnessTexture);
+            cooked.normalTexture = TextureIndex(textures, material.normalTexture);
+            cooked.occlusionTexture = TextureIndex(textures, material.occlusionTexture);
+            cooked.emissiveTexture = TextureIndex(textures, material.emissiveTexture);
+            cooked.specularGlossinessTexture = TextureIndex(textures, material.extension.specularGlossinessTexture);
+            cooked.diffuseTexture = TextureIndex(textures, material.extension.diffuseTexture);
+            cooked.texCoordSets = material.texCoordSets;
+            cooked.metallicRoughnessWorkflow = material.pbrWorkflows.metallicRoughness ? 1 : 0;
+            cooked.specularGlossinessWorkflow = material.pbrWorkflows.specularGlossiness ? 1 : 0;
+            writer.Append(SECTION_MATERIALS, cooked);
+        }
+
+        // Meshes are written once and referenced by every node that draws them
+        std::unordered_map<const Mesh*, int32_t> meshIndices;
+        for (const Mesh* mesh : meshes) {
+            CookedMesh cooked{};
+            cooked.skinIndex = mesh->skinIndex;
+            cooked.bbMin = mesh->bb._min;
+            cooked.bbMax = mesh->bb._max;
+            cooked.bbValid = mesh->bb.valid ? 1 : 0;
+            cooked.firstPrimitive = writer.Next<CookedPrimitive>(SECTION_PRIMITIVES);
+            cooked.primitiveCount = static_cast<uint32_t>(mesh->primitives.size());
+
+            for (const Primitive& primitive : mesh->primitives) {
+                CookedPrimitive cookedPrimitive{};
+                cookedPrimitive.firstIndex = primitive.firstIndex;
+                cookedPrimitive.indexCount = primitive.indexCount;
+                cookedPrimitive.vertexCount = primitive.vertexCount;
+                cookedPrimitive.firstVertex = primitive.firstVertex;
+                cookedPrimitive.material = static_cast<uint32_t>(&primitive.material - materials.data());
+                cookedPrimitive.bbMin = primitive.bb._min;
+                cookedPrimitive.bbMax = primitive.bb._max;
+                cookedPrimitive.bbValid = primitive.bb.valid ? 1 : 0;
+                cookedPrimitive.lodCount = primitive.lodCount;
+                std::copy_n(primitive.lods.begin(), primitive.lodCount, cookedPrimitive.lods);
+                writer.Append(SECTION_PRIMITIVES, cookedPrimitive);
+            }
+
+            meshIndices[mesh] = static_cast<int32_t>(meshIndices.size());
+            writer.Append(SECTION_MESHES, cooked);
+        }
+
+        // Nodes keep their graph slots, parents always come before their children
+        for (const Node* node : linearNodes) {
+            const uint32_t slot = node->slot;
+            CookedNode cooked{};
+            cooked.name = writer.AddString(graph.Name(slot));
+            cooked.index = graph.sourceIndices[slot];
+            cooked.parent = graph.parents[slot];
+            cooked.skinIndex = node->skinIndex;
+            cooked.matrix = graph.matrices[slot];
+            cooked.translation = graph.translations[slot];
+            cooked.scale = graph.scales[slot];
+            cooked.rotation = graph.rotations[slot];
+
+            if (node->mesh) {
+                cooked.mesh = meshIndices[node->mesh];
+            }
+            if (node->instanceCount > 0) {
+                cooked.firstInstance = writer.Append(SECTION_NODE_INSTANCES, nodeInstances.data() + node->firstInstance, node->instanceCount);
+                cooked.instanceCount = node->instanceCount;
+            }
+
+            writer.Append(SECTION_NODES, cooked);
+        }
+
+        for (const Skin* skin : skins) {
+            CookedSkin cooked{};
+            cooked.name = writer.AddString(skin->name);
+            cooked.skeletonRoot = skin->skeletonRoot;
+            cooked.jointCount = static_cast<uint32_t>(skin->joints.size());
+            cooked.firstJoint = writer.Next<uint32_t>(SECTION_SKIN_JOINTS);
+            writer.Append(SECTION_SKIN_JOINTS, skin->joints.data(), skin->joints.size());
+            cooked.matrixCount = static_cast<uint32_t>(skin->inverseBindMatrices.size());
+            cooked.firstMatrix = writer.Append(SECTION_MATRICES, skin->inverseBindMatrices.data(), skin->inverseBindMatrices.size());
+            writer.Append(SECTION_SKINS, cooked);
+        }
+
+        for (const auto& animation : animations) {
+            CookedAnimation cooked{};
+            cooked.name = writer.AddString(animation.name);
+            cooked.start = animation.start;
+            cooked.end = animation.end;
+            cooked.samplerCount = static_cast<uint32_t>(animation.samplers.size());
+            cooked.channelCount = static_cast<uint32_t>(animation.channels.size());
+
+            cooked.firstSampler = writer.Next<CookedAnimationSampler>(SECTION_ANIMATION_SAMPLERS);
+            for (const auto& sampler : animation.samplers) {
+                CookedAnimationSampler cookedSampler{};
+                cookedSampler.interpolation = sampler.interpolation;
+                cookedSampler.inputCount = static_cast<uint32_t>(sampler.inputs.size());
+                cookedSampler.firstInput = writer.Append(SECTION_FLOATS, sampler.inputs.data(), sampler.inputs.size());
+                cookedSampler.outputCount = static_cast<uint32_t>(sampler.outputsVec4.size());
+                cookedSampler.firstOutput = writer.Append(SECTION_VEC4S, sampler.outputsVec4.data(), sampler.outputsVec4.size());
+                writer.Append(SECTION_ANIMATION_SAMPLERS, cookedSampler);
+            }
+
+            cooked.firstChannel = writer.Next<CookedAnimationChannel>(SECTION_ANIMATION_CHANNELS);
+            for (const auto& channel : animation.channels) {
+                CookedAnimationChannel cookedChannel{};
+                cookedChannel.path = channel.path;
+                cookedChannel.node = channel.node;
+                cookedChannel.samplerIndex = channel.samplerIndex;
+                writer.Append(SECTION_ANIMATION_CHANNELS, cookedChannel);
+            }
+
+            writer.Append(SECTION_ANIMATIONS, cooked);
+        }
+
+        if (false == writer.Write(cookedFilename, importFlags, sourceHash)) {
+            std::cerr << "Could not write cooked file " << cookedFilename << std::endl;
+        }
+    }
+
+    bool Model::LoadFromCookedFile(const std::string& cookedFilename, Vk::VulkanDevice* inDevice, VkQueue transferQueue, const ModelImportOptions& options) {
+        // Files cooked with other import steps are rebuilt like stale ones
+        CookedReader reader;
+        if (false == reader.Open(cookedFilename) || options.GetFlags() != reader.ImportFlags()) {
+            return false;
+        }
+
+        CookedArray<CookedString> dependencyNames, extensionNames;
+        CookedArray<Vertex> vertexData;
+        CookedArray<uint32_t> indexData, skinJoints;
+        CookedArray<CookedImage> cookedImages;
+        CookedArray<uint8_t> imageData;
+        CookedArray<TextureSampler> cookedSamplers;
+        CookedArray<CookedTexture> cookedTextures;
+        CookedArray<CookedMaterial> cookedMaterials;
+        CookedArray<CookedNode> cookedNodes;
+        CookedArray<InstanceTransform> cookedNodeInstances;
+        CookedArray<CookedMesh> cookedMeshes;
+        CookedArray<CookedPrimitive> cookedPrimitives;
+        CookedArray<CookedSkin> cookedSkins;
+        CookedArray<glm::mat4> matrices;
+        CookedArray<CookedAnimation> cookedAnimations;
+        CookedArray<CookedAnimationSampler> cookedAnimationSamplers;
+        CookedArray<CookedAnimationChannel> cookedAnimationChannels;
+        CookedArray<float> floats;
+        CookedArray<glm::vec4> vec4s;
+        const bool sectionsValid =
+            reader.Get(SECTION_DEPENDENCIES, dependencyNames) && reader.Get(SECTION_EXTENSIONS, extensionNames) &&
+            reader.Get(SECTION_VERTICES, vertexData) && reader.Get(SECTION_INDICES, indexData) &&
+            reader.Get(SECTION_IMAGES, cookedImages) && reader.Get(SECTION_IMAGE_DATA, imageData) &&
+            reader.Get(SECTION_SAMPLERS, cookedSamplers) && reader.Get(SECTION_TEXTURES, cookedTextures) &&
+            reader.Get(SECTION_MATERIALS, cookedMaterials) && reader.Get(SECTION_NODES, cookedNodes) &&
+            reader.Get(SECTION_NODE_INSTANCES, cookedNodeInstances) &&
+            reader.Get(SECTION_MESHES, cookedMeshes) && reader.Get(SECTION_PRIMITIVES, cookedPrimitives) &&
+            reader.Get(SECTION_SKINS, cookedSkins) && reader.Get(SECTION_SKIN_JOINTS, skinJoints) &&
+            reader.Get(SECTION_MATRICES, matrices) && reader.Get(SECTION_ANIMATIONS, cookedAnimations) &&
+            reader.Get(SECTION_ANIMATION_SAMPLERS, cookedAnimationSamplers) && reader.Get(SECTION_ANIMATION_CHANNELS, cookedAnimationChannels) &&
+            reader.Get(SECTION_FLOATS, floats) && reader.Get(SECTION_VEC4S, vec4s);
+        if (false == sectionsValid || 0 == vertexData.count || 0 == cookedMaterials.count) {
+            return false;
+        }
+
+        // Only accept the cooked file while every source file still hashes the same
+        std::vector<std::string> dependencies(dependencyNames.count);
+        for (size_t i = 0; i < dependencyNames.count; ++i) {
+            if (false == reader.GetString(dependencyNames[i], dependencies[i])) {
+                return false;
+            }
+        }
+        uint64_t sourceHash = 0;
+        if (false == HashSourceFiles(std::filesystem::path(cookedFilename).parent_path(), dependencies, sourceHash) || sourceHash != reader.SourceHash()) {
+            return false;
+        }
+
+        // Validate every cross reference before any object is created
+        for (const auto& image : cookedImages) {
+            if (false == imageData.Contains(image.dataOffset, image.dataSize) || static_cast<uint64_t>(image.width) * image.height * 4 > image.dataSize) {
+                return false;
+            }
+        }
+        for (const auto& texture : cookedTextures) {
+            if (texture.image >= cookedImages.count) {
+                return false;
+            }
+        }
+        for (const auto& material : cookedMaterials) {
+            for (int32_t texture : { material.baseColorTexture, material.metallicRoughnessTexture, material.normalTexture, material.occlusionTexture,
+                                     material.emissiveTexture, material.specularGlossinessTexture, material.diffuseTexture }) {
+                if (texture >= static_cast<int32_t>(cookedTextures.count)) {
+                    return false;
+                }
+            }
+        }
+        for (size_t i = 0; i < cookedNodes.count; ++i) {
+            const auto& node = cookedNodes[i];
+            if (node.parent >= static_cast<int32_t>(cookedNodes.count) || node.parent >= static_cast<int32_t>(i) ||
+                node.mesh >= static_cast<int32_t>(cookedMeshes.count) || node.skinIndex >= static_cast<int32_t>(cookedSkins.count) ||
+                false == cookedNodeInstances.Contains(node.firstInstance, node.instanceCount)) {
+                return false;
+            }
+        }
+        for (const auto& mesh : cookedMeshes) {
+            if (false == cookedPrimitives.Contains(mesh.firstPrimitive, mesh.primitiveCount) || mesh.skinIndex >= static_cast<int32_t>(cookedSkins.count)) {
+                return false;
+            }
+        }
+        for (const auto& primitive : cookedPrimitives) {
+            if (primitive.material >= cookedMaterials.count || false == indexData.Contains(primitive.firstIndex, primitive.indexCount)) {
+                return false;
+            }
+            if (0 == primitive.indexCount && false == vertexData.Contains(primitive.firstVertex, primitive.vertexCount)) {
+                return false;
+            }
+            if (primitive.lodCount > MAX_PRIMITIVE_LODS) {
+                return false;
+            }
+            for (uint32_t level = 0; level < primitive.lodCount; ++level) {
+                if (false == indexData.Contains(primitive.lods[level].firstIndex, primitive.lods[level].indexCount)) {
+                    return false;
+                }
+            }
+        }
+        for (const auto& skin : cookedSkins) {
+            if (skin.skeletonRoot >= static_cast<int32_t>(cookedNodes.count) ||
+                false == skinJoints.Contains(skin.firstJoint, skin.jointCount) || false == matrices.Contains(skin.firstMatrix, skin.matrixCount)) {
+                return false;
+            }
+            for (uint32_t j = 0; j < skin.jointCount; ++j) {
+                if (skinJoints[skin.firstJoint + j] >= cookedNodes.count) {
+                    return false;
+                }
+            }
+        }
+        for (const auto& animation : cookedAnimations) {
+            if (false == cookedAnimationSamplers.Contains(animation.firstSampler, animation.samplerCount) ||
+                false == cookedAnimationChannels.Contains(animation.firstChannel, animation.channelCount)) {
+                return false;
+            }
+            for (uint32_t c = 0; c < animation.channelCount; ++c) {
+                const auto& channel = cookedAnimationChannels[animation.firstChannel + c];
+                if (channel.node >= cookedNodes.count || channel.samplerIndex >= animation.samplerCount) {
+                    return false;
+                }
+            }
+        }
+        for (const auto& sampler : cookedAnimationSamplers) {
+            if (false == floats.Contains(sampler.firstInput, sampler.inputCount) || false == vec4s.Contains(sampler.firstOutput, sampler.outputCount)) {
+                return false;
+            }
+        }
+
+        this->device = inDevice;
+
+        for (const auto& extension : extensionNames) {
+            extensions.emplace_back();
+            reader.GetString(extension, extensions.back());
+        }
+
+        textureSamplers.assign(cookedSamplers.begin(), cookedSamplers.end());
+
+        // Materials point into this vector, so it must not grow afterwards
+        textures.resize(cookedTextures.count);
+        for (size_t i = 0; i < cookedTextures.count; ++i) {
+            const auto& texture = cookedTextures[i];
+            const auto& image = cookedImages[texture.image];
+            textures[i].FromPixels(imageData.data + image.dataOffset, image.dataSize, image.width, image.height, texture.sampler, inDevice, transferQueue);
+        }
+
+        const auto textureFromIndex = [this](int32_t index) -> ModelTexture* {
+            return index > -1 ? &textures[index] : nullptr;
+        };
+        materials.reserve(cookedMaterials.count);
+        for (const auto& cooked : cookedMaterials) {
+            Material material{};
+            material.alphaMode = static_cast<Material::AlphaMode>(cooked.alphaMode);
+            material.alphaCutoff = cooked.alphaCutoff;
+            material.metallicFactor = cooked.metallicFactor;
+            material.roughnessFactor = cooked.roughnessFactor;
+            material.baseColorFactor = cooked.baseColorFactor;
+            material.emissiveFactor = cooked.emissiveFactor;
+            material.baseColorTexture = textureFromIndex(cooked.baseColorTexture);
+            material.metallicRoughnessTexture = textureFromIndex(cooked.metallicRoughnessTexture);
+            material.normalTexture = textureFromIndex(cooked.normalTexture);
+            material.occlusionTexture = textureFromIndex(cooked.occlusionTexture);
+            material.emissiveTexture = textureFromIndex(cooked.emissiveTexture);
+            material.texCoordSets = cooked.texCoordSets;
+            material.extension.specularGlossinessTexture = textureFromIndex(cooked.specularGlossinessTexture);
+            material.extension.diffuseTexture = textureFromIndex(cooked.diffuseTexture);
+            material.extension.diffuseFactor = cooked.diffuseFactor;
+            material.extension.specularFactor = cooked.specularFactor;
+            material.pbrWorkflows.metallicRoughness = 0 != cooked.metallicRoughnessWorkflow;
+            material.pbrWorkflows.specularGlossiness = 0 != cooked.specularGlossinessWorkflow;
+            materials.push_back(material);
+        }
+
+        // Nodes are stored in slot order, so adding them one after another restores the graph
+        graph.Reserve(cookedNodes.count);
+        nodePool.Reserve(cookedNodes.count);
+        meshPool.Reserve(cookedMeshes.count);
+        primitivePool.Reserve(cookedPrimitives.count);
+        skinPool.Reserve(cookedSkins.count);
+        linearNodes.reserve(cookedNodes.count);
+
+        std::vector<Mesh*> cookedMeshPointers;
+        cookedMeshPointers.reserve(cookedMeshes.count);
+        for (const auto& cookedMesh : cookedMeshes) {
+            Mesh* newMesh = meshPool.New(device, cookedMesh.skinIndex);
+            newMesh->bb = BoundingBox(cookedMesh.bbMin, cookedMesh.bbMax);
+            newMesh->bb.valid = 0 != cookedMesh.bbValid;
+            primitivePool.Reserve(cookedMesh.primitiveCount);
+            for (uint32_t p = 0; p < cookedMesh.primitiveCount; ++p) {
+                const auto& cookedPrimitive = cookedPrimitives[cookedMesh.firstPrimitive + p];
+                Primitive* newPrimitive = primitivePool.New(cookedPrimitive.firstIndex, cookedPrimitive.indexCount, cookedPrimitive.vertexCount, materials[cookedPrimitive.material]);
+                newPrimitive->firstVertex = cookedPrimitive.firstVertex;
+                newPrimitive->bb = BoundingBox(cookedPrimitive.bbMin, cookedPrimitive.bbMax);
+                newPrimitive->bb.valid = 0 != cookedPrimitive.bbValid;
+                newPrimitive->lodCount = cookedPrimitive.lodCount;
+                std::copy_n(cookedPrimitive.lods, cookedPrimitive.lodCount, newPrimitive->lods.begin());
+                newMesh->primitives.data = newMesh->primitives.empty() ? newPrimitive : newMesh->primitives.data;
+                ++newMesh->primitives.count;
+            }
+            cookedMeshPointers.push_back(newMesh);
+        }
+
+        for (size_t i = 0; i < cookedNodes.count; ++i) {
+            const auto& cooked = cookedNodes[i];
+            std::string_view name;
+            reader.GetString(cooked.name, name);
+            const uint32_t slot = graph.Add(cooked.parent, cooked.index, name);
+            graph.SetMatrix(slot, cooked.matrix);
+            graph.SetTranslation(slot, cooked.translation);
+            graph.SetScale(slot, cooked.scale);
+            graph.SetRotation(slot, cooked.rotation);
+
+            Node* newNode = nodePool.New();
+            newNode->slot = slot;
+            newNode->skinIndex = cooked.skinIndex;
+            newNode->firstInstance = cooked.firstInstance;
+            newNode->instanceCount = cooked.instanceCount;
+            linearNodes.push_back(newNode);
+
+            if (cooked.mesh > -1) {
+                newNode->mesh = cookedMeshPointers[cooked.mesh];
+            }
+        }
+
+        for (const auto& cooked : cookedAnimations) {
+            Animation animation{};
+            reader.GetString(cooked.name, animation.name);
+            animation.start = cooked.start;
+            animation.end = cooked.end;
+            for (uint32_t s = 0; s < cooked.samplerCount; ++s) {
+                const auto& cookedSampler = cookedAnimationSamplers[cooked.firstSampler + s];
+                AnimationSampler sampler{};
+                sampler.interpolation = static_cast<AnimationSampler::InterpolationType>(cookedSampler.interpolation);
+                sampler.inputs.assign(floats.begin() + cookedSampler.firstInput, floats.begin() + cookedSampler.firstInput + cookedSampler.inputCount);
+                sampler.outputsVec4.assign(vec4s.begin() + cookedSampler.firstOutput, vec4s.begin() + cookedSampler.firstOutput + cookedSampler.outputCount);
+                animation.samplers.push_back(sampler);
+            }
+            for (uint32_t c = 0; c < cooked.channelCount; ++c) {
+                const auto& cookedChannel = cookedAnimationChannels[cooked.firstChannel + c];
+                AnimationChannel channel{};
+                channel.path = static_cast<AnimationChannel::PathType>(cookedChannel.path);
+                channel.node = cookedChannel.node;
+                channel.samplerIndex = cookedChannel.samplerIndex;
+                animation.channels.push_back(channel);
+            }
+            animations.push_back(animation);
+        }
+
+        for (const auto& cooked : cookedSkins) {
+            Skin* newSkin = skinPool.New();
+            reader.GetString(cooked.name, newSkin->name);
+            newSkin->skeletonRoot = cooked.skeletonRoot;
+            newSkin->joints.assign(skinJoints.begin() + cooked.firstJoint, skinJoints.begin() + cooked.firstJoint + cooked.jointCount);
+            newSkin->inverseBindMatrices.assign(matrices.begin() + cooked.firstMatrix, matrices.begin() + cooked.firstMatrix + cooked.matrixCount);
+            skins.push_back(newSkin);
+        }
+
+        // Assign skins
+        for (auto node : linearNodes) {
+            if (node->skinIndex > -1) {
+                node->skin = skins[node->skinIndex];
+            }
+        }
+        nodeInstances.assign(cookedNodeInstances.begin(), cookedNodeInstances.end());
+        BuildInstances(transferQueue);
+        // Initial pose
+        UpdateMeshes();
+
+        // The staging upload of the float format reads straight from the mapped file
+        indices.count = static_cast<uint32_t>(indexData.count);
+        UploadBuffers(vertexData.data, vertexData.count, indexData.data, indexData.count, transferQueue);
+
+        GetSceneDimensions();
+        return true;
+    }
+}
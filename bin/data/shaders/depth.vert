@@ -0,0 +1,60 @@
+#version 450
+
+// Depth pre-pass of meshes without skin, computes gl_Position exactly like pbr.vert and pbr_packed.vert.
+// Positions of the packed formats are dequantized with the push constants, which are identity otherwise
+
+layout (location = 0) in vec3 inPos;
+// World matrix of the instance, takes locations 6 to 9
+layout (location = 6) in mat4 inModel;
+
+// Transform of the instance relative to its node, identity unless the node uses EXT_mesh_gpu_instancing
+layout (location = 10) in vec3 inInstanceTranslation;
+layout (location = 11) in vec4 inInstanceRotation;
+layout (location = 12) in vec3 inInstanceScale;
+
+layout (set = 0, binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec3 camPos;
+} ubo;
+
+// Follows the material block of pbr_khr.frag
+layout (push_constant) uniform Primitive {
+	layout (offset = 104) int firstJoint;
+	float positionScale;
+	vec3 positionOffset;
+} primitive;
+
+out gl_PerVertex
+{
+	invariant vec4 gl_Position;
+};
+
+mat4 instanceMatrix()
+{
+	vec4 q = inInstanceRotation;
+
+	mat3 r = mat3(
+		1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.w * q.z), 2.0 * (q.x * q.z - q.w * q.y),
+		2.0 * (q.x * q.y - q.w * q.z), 1.0 - 2.0 * (q.x * q.x + q.z * q.z), 2.0 * (q.y * q.z + q.w * q.x),
+		2.0 * (q.x * q.z + q.w * q.y), 2.0 * (q.y * q.z - q.w * q.x), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+
+	return mat4(
+		vec4(r[0] * inInstanceScale.x, 0.0),
+		vec4(r[1] * inInstanceScale.y, 0.0),
+		vec4(r[2] * inInstanceScale.z, 0.0),
+		vec4(inInstanceTranslation, 1.0));
+}
+
+void main() 
+{
+	mat4 instance = instanceMatrix();
+	vec3 pos = primitive.positionOffset + inPos * primitive.positionScale;
+	mat4 matrix = inModel * instance;
+	vec4 locPos = ubo.model * matrix * vec4(pos, 1.0);
+	locPos.y = -locPos.y;
+	vec3 worldPos = locPos.xyz / locPos.w;
+	gl_Position =  ubo.projection * ubo.view * vec4(worldPos, 1.0);
+}
@@ -0,0 +1,65 @@
+#version 450
+
+// depth.vert reading node matrices resolved by nodetransforms.comp, matches pbr_nodes.vert and pbr_nodes_packed.vert
+
+layout (location = 0) in vec3 inPos;
+
+// Transform of the instance relative to its node, identity unless the node uses EXT_mesh_gpu_instancing
+layout (location = 10) in vec3 inInstanceTranslation;
+layout (location = 11) in vec4 inInstanceRotation;
+layout (location = 12) in vec3 inInstanceScale;
+
+layout (set = 0, binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec3 camPos;
+} ubo;
+
+layout (std430, set = 2, binding = 0) readonly buffer WorldMatrices {
+	mat4 worldMatrices[];
+};
+
+layout (std430, set = 2, binding = 2) readonly buffer InstanceSlots {
+	uint instanceSlots[];
+};
+
+// Follows the material block of pbr_khr.frag
+layout (push_constant) uniform Primitive {
+	layout (offset = 104) int firstJoint;
+	float positionScale;
+	vec3 positionOffset;
+} primitive;
+
+out gl_PerVertex
+{
+	invariant vec4 gl_Position;
+};
+
+mat4 instanceMatrix()
+{
+	vec4 q = inInstanceRotation;
+
+	mat3 r = mat3(
+		1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.w * q.z), 2.0 * (q.x * q.z - q.w * q.y),
+		2.0 * (q.x * q.y - q.w * q.z), 1.0 - 2.0 * (q.x * q.x + q.z * q.z), 2.0 * (q.y * q.z + q.w * q.x),
+		2.0 * (q.x * q.z + q.w * q.y), 2.0 * (q.y * q.z - q.w * q.x), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+
+	return mat4(
+		vec4(r[0] * inInstanceScale.x, 0.0),
+		vec4(r[1] * inInstanceScale.y, 0.0),
+		vec4(r[2] * inInstanceScale.z, 0.0),
+		vec4(inInstanceTranslation, 1.0));
+}
+
+void main() 
+{
+	mat4 instance = instanceMatrix();
+	vec3 pos = primitive.positionOffset + inPos * primitive.positionScale;
+	mat4 matrix = worldMatrices[instanceSlots[gl_InstanceIndex]] * instance;
+	vec4 locPos = ubo.model * matrix * vec4(pos, 1.0);
+	locPos.y = -locPos.y;
+	vec3 worldPos = locPos.xyz / locPos.w;
+	gl_Position =  ubo.projection * ubo.view * vec4(worldPos, 1.0);
+}
@@ -0,0 +1,100 @@
+#version 450
+
+// pbr.vert reading node and joint matrices resolved by nodetransforms.comp
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inUV0;
+layout (location = 3) in vec2 inUV1;
+layout (location = 4) in vec4 inJoint0;
+layout (location = 5) in vec4 inWeight0;
+
+// Transform of the instance relative to its node, identity unless the node uses EXT_mesh_gpu_instancing
+layout (location = 10) in vec3 inInstanceTranslation;
+layout (location = 11) in vec4 inInstanceRotation;
+layout (location = 12) in vec3 inInstanceScale;
+
+// Direction of +u and the sign of the bitangent, zero unless the normal map of the primitive needs it
+layout (location = 13) in vec4 inTangent;
+
+layout (set = 0, binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec3 camPos;
+} ubo;
+
+layout (std430, set = 2, binding = 0) readonly buffer WorldMatrices {
+	mat4 worldMatrices[];
+};
+
+layout (std430, set = 2, binding = 1) readonly buffer JointMatrices {
+	mat4 jointMatrices[];
+};
+
+layout (std430, set = 2, binding = 2) readonly buffer InstanceSlots {
+	uint instanceSlots[];
+};
+
+// Follows the material block of pbr_khr.frag
+layout (push_constant) uniform Node {
+	layout (offset = 104) int firstJoint;
+} node;
+
+layout (location = 0) out vec3 outWorldPos;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) out vec2 outUV0;
+layout (location = 3) out vec2 outUV1;
+layout (location = 4) out vec4 outTangent;
+
+// Matches the depth pre-pass of depth.vert exactly
+out gl_PerVertex
+{
+	invariant vec4 gl_Position;
+};
+
+mat4 instanceMatrix()
+{
+	vec4 q = inInstanceRotation;
+
+	mat3 r = mat3(
+		1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.w * q.z), 2.0 * (q.x * q.z - q.w * q.y),
+		2.0 * (q.x * q.y - q.w * q.z), 1.0 - 2.0 * (q.x * q.x + q.z * q.z), 2.0 * (q.y * q.z + q.w * q.x),
+		2.0 * (q.x * q.z + q.w * q.y), 2.0 * (q.y * q.z - q.w * q.x), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+
+	return mat4(
+		vec4(r[0] * inInstanceScale.x, 0.0),
+		vec4(r[1] * inInstanceScale.y, 0.0),
+		vec4(r[2] * inInstanceScale.z, 0.0),
+		vec4(inInstanceTranslation, 1.0));
+}
+
+void main() 
+{
+	mat4 instance = instanceMatrix();
+	vec4 locPos;
+	if (node.firstJoint >= 0) {
+		// Mesh is skinned, joint matrices already include the joint world matrix
+		int first = node.firstJoint;
+		mat4 skinMat = 
+			inWeight0.x * jointMatrices[first + int(inJoint0.x)] +
+			inWeight0.y * jointMatrices[first + int(inJoint0.y)] +
+			inWeight0.z * jointMatrices[first + int(inJoint0.z)] +
+			inWeight0.w * jointMatrices[first + int(inJoint0.w)];
+
+		locPos = ubo.model * instance * skinMat * vec4(inPos, 1.0);
+		outNormal = normalize(transpose(inverse(mat3(ubo.model * instance * skinMat))) * inNormal);
+		outTangent = vec4(mat3(ubo.model * instance * skinMat) * inTangent.xyz, inTangent.w * sign(determinant(mat3(ubo.model * instance * skinMat))));
+	} else {
+		mat4 matrix = worldMatrices[instanceSlots[gl_InstanceIndex]] * instance;
+		locPos = ubo.model * matrix * vec4(inPos, 1.0);
+		outNormal = normalize(transpose(inverse(mat3(ubo.model * matrix))) * inNormal);
+		outTangent = vec4(mat3(ubo.model * matrix) * inTangent.xyz, inTangent.w * sign(determinant(mat3(ubo.model * matrix))));
+	}
+	locPos.y = -locPos.y;
+	outWorldPos = locPos.xyz / locPos.w;
+	outUV0 = inUV0;
+	outUV1 = inUV1;
+	gl_Position =  ubo.projection * ubo.view * vec4(outWorldPos, 1.0);
+}
@@ -0,0 +1,87 @@
+#version 450
+
+// pbr.vert reading Vk::PackedVertex or Vk::QuantizedVertex, vertices of meshes without skin
+
+// Positions are relative to the quantization cube of the primitive, the normal is octahedral encoded
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec2 inNormal;
+layout (location = 2) in vec2 inUV0;
+layout (location = 3) in vec2 inUV1;
+// World matrix of the instance, takes locations 6 to 9
+layout (location = 6) in mat4 inModel;
+
+// Transform of the instance relative to its node, identity unless the node uses EXT_mesh_gpu_instancing
+layout (location = 10) in vec3 inInstanceTranslation;
+layout (location = 11) in vec4 inInstanceRotation;
+layout (location = 12) in vec3 inInstanceScale;
+
+// Direction of +u and the sign of the bitangent, zero unless the normal map of the primitive needs it
+layout (location = 13) in vec4 inTangent;
+
+layout (set = 0, binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec3 camPos;
+} ubo;
+
+
+// Follows the material block of pbr_khr.frag
+layout (push_constant) uniform Primitive {
+	layout (offset = 104) int firstJoint;
+	float positionScale;
+	vec3 positionOffset;
+} primitive;
+
+layout (location = 0) out vec3 outWorldPos;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) out vec2 outUV0;
+layout (location = 3) out vec2 outUV1;
+layout (location = 4) out vec4 outTangent;
+
+// Matches the depth pre-pass of depth.vert exactly
+out gl_PerVertex
+{
+	invariant vec4 gl_Position;
+};
+
+mat4 instanceMatrix()
+{
+	vec4 q = inInstanceRotation;
+
+	mat3 r = mat3(
+		1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.w * q.z), 2.0 * (q.x * q.z - q.w * q.y),
+		2.0 * (q.x * q.y - q.w * q.z), 1.0 - 2.0 * (q.x * q.x + q.z * q.z), 2.0 * (q.y * q.z + q.w * q.x),
+		2.0 * (q.x * q.z + q.w * q.y), 2.0 * (q.y * q.z - q.w * q.x), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+
+	return mat4(
+		vec4(r[0] * inInstanceScale.x, 0.0),
+		vec4(r[1] * inInstanceScale.y, 0.0),
+		vec4(r[2] * inInstanceScale.z, 0.0),
+		vec4(inInstanceTranslation, 1.0));
+}
+
+// Inverse of the octahedral mapping of Vk::EncodeOctahedral
+vec3 decodeNormal(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+void main() 
+{
+	mat4 instance = instanceMatrix();
+	vec3 pos = primitive.positionOffset + inPos * primitive.positionScale;
+	mat4 matrix = inModel * instance;
+	vec4 locPos = ubo.model * matrix * vec4(pos, 1.0);
+	outNormal = normalize(transpose(inverse(mat3(ubo.model * matrix))) * decodeNormal(inNormal));
+	outTangent = vec4(mat3(ubo.model * matrix) * inTangent.xyz, inTangent.w * sign(determinant(mat3(ubo.model * matrix))));
+	locPos.y = -locPos.y;
+	outWorldPos = locPos.xyz / locPos.w;
+	outUV0 = inUV0;
+	outUV1 = inUV1;
+	gl_Position =  ubo.projection * ubo.view * vec4(outWorldPos, 1.0);
+}
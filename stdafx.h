@@ -13,17 +13,33 @@
 #include <cstdlib>
 #include <cstdio>
 #include <corecrt_math_defines.h>
+#include <intrin.h>
+#include <immintrin.h>
 
 #include <array>
 #include <vector>
+#include <deque>
+#include <memory>
 #include <iostream>
 #include <sstream>
 #include <fstream>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <chrono>
 #include <filesystem>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <functional>
+#include <queue>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <numeric>
+#include <charconv>
 using namespace std::literals::string_literals;
 
 #pragma warning(disable : 4127)
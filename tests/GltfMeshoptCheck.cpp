@@ -0,0 +1,132 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+#include "GltfMeshoptCheck.h"
+
+#include "GltfBuffers.h"
+#include "GltfDocument.h"
+#include "GltfMeshopt.h"
+#include "MappedFile.h"
+
+namespace Vk {
+    namespace {
+        /*
+            Encoded streams and expected output of meshoptimizer's decoder tests. The vertex codec has no reference
+            stream here, it is covered by the fallback comparison of files written by gltfpack -cf.
+        */
+        const uint8_t triangleStreamV0[] = {
+            0xe0, 0xf0, 0x10, 0xfe, 0xff, 0xf0, 0x0c, 0xff, 0x02, 0x02, 0x02, 0x00, 0x76, 0x87, 0x56, 0x67,
+            0x78, 0xa9, 0x86, 0x65, 0x89, 0x68, 0x98, 0x01, 0x69, 0x00, 0x00,
+        };
+        const uint32_t triangleIndicesV0[] = { 0, 1, 2, 2, 1, 3, 4, 6, 5, 7, 8, 9 };
+
+        // Restarts at vertex 0 and codes free indices as last - 1 and last + 1
+        const uint8_t triangleStreamV1[] = {
+            0xe1, 0xf0, 0x10, 0xfe, 0x1f, 0x3d, 0x00, 0x0a, 0x00, 0x76, 0x87, 0x56, 0x67, 0x78, 0xa9, 0x86,
+            0x65, 0x89, 0x68, 0x98, 0x01, 0x69, 0x00, 0x00,
+        };
+        const uint32_t triangleIndicesV1[] = { 0, 1, 2, 2, 1, 3, 0, 1, 2, 2, 1, 5, 2, 1, 4 };
+
+        const uint8_t sequenceStreamV1[] = { 0xd1, 0x00, 0x04, 0xcd, 0x01, 0x04, 0x07, 0x98, 0x1f, 0x00, 0x00, 0x00, 0x00 };
+        const uint32_t sequenceIndicesV1[] = { 0, 1, 51, 2, 49, 1000 };
+
+        const uint8_t octahedral8[] = { 0, 1, 127, 0, 0, 187, 127, 1, 255, 1, 127, 0, 14, 130, 127, 1 };
+        const uint8_t octahedral8Decoded[] = { 0, 1, 127, 0, 0, 159, 82, 1, 255, 1, 127, 0, 1, 130, 241, 1 };
+
+        const uint16_t octahedral12[] = { 0, 1, 2047, 0, 0, 1870, 2047, 1, 2017, 1, 2047, 0, 14, 1300, 2047, 1 };
+        const uint16_t octahedral12Decoded[] = { 0, 16, 32767, 0, 0, 32621, 3088, 1, 32764, 16, 471, 0, 307, 28541, 16093, 1 };
+
+        const uint16_t quaternion12[] = { 0, 1, 0, 0x7fc, 0, 1870, 0, 0x7fd, 2017, 1, 0, 0x7fe, 14, 1300, 0, 0x7ff };
+        const uint16_t quaternion12Decoded[] = { 32767, 0, 11, 0, 0, 25013, 0, 21166, 11, 0, 23504, 22830, 158, 14715, 0, 29277 };
+
+        const uint32_t exponential[] = { 0, 0xff000003, 0x02fffff7, 0xfe7fffff };
+        const uint32_t exponentialDecoded[] = { 0, 0x3fc00000, 0xc2100000, 0x49fffffe };
+
+        bool Report(const std::string& name, bool passed) {
+            std::cout << (passed ? "passed: " : "FAILED: ") << name << std::endl;
+            return passed;
+        }
+
+        // Decodes into both index sizes
+        template<size_t Count>
+        bool CheckIndices(const std::string& name, bool triangles, const uint8_t* src, size_t srcSize, const uint32_t (&expected)[Count]) {
+            bool passed = true;
+            for (const size_t indexSize : { size_t(2), size_t(4) }) {
+                std::vector<uint8_t> decoded(Count * indexSize);
+                bool valid = triangles ? DecodeTriangleStream(decoded.data(), Count, indexSize, src, srcSize)
+                                       : DecodeIndexSequence(decoded.data(), Count, indexSize, src, srcSize);
+                for (size_t i = 0; valid && i < Count; ++i) {
+                    uint32_t index = 0;
+                    if (2 == indexSize) {
+                        uint16_t shortIndex = 0;
+                        memcpy(&shortIndex, decoded.data() + i * 2, sizeof(shortIndex));
+                        index = shortIndex;
+                    }
+                    else {
+                        memcpy(&index, decoded.data() + i * 4, sizeof(index));
+                    }
+                    valid = expected[i] == index;
+                }
+                passed = Report(name + ", " + std::to_string(indexSize * 8) + " bit", valid) && passed;
+            }
+            return passed;
+        }
+
+        template<typename T, size_t Count>
+        bool CheckFilter(const std::string& name, void (*filter)(uint8_t*, size_t, size_t), size_t stride, const T (&input)[Count], const T (&expected)[Count]) {
+            T decoded[Count];
+            memcpy(decoded, input, sizeof(decoded));
+            filter(reinterpret_cast<uint8_t*>(decoded), sizeof(decoded) / stride, stride);
+            return Report(name, 0 == memcmp(decoded, expected, sizeof(decoded)));
+        }
+
+        bool CheckFile(const std::string& filename) {
+            MappedFile file;
+            GltfDocument document;
+            std::string error;
+
+            const bool binary = std::filesystem::path(filename).extension() == ".glb";
+            bool loaded = false;
+            if (false == file.Open(filename)) {
+                error = "could not map the file";
+            }
+            else if (binary) {
+                loaded = document.ParseBinary(file.Data(), file.Size(), error);
+            }
+            else {
+                loaded = document.Parse(reinterpret_cast<const char*>(file.Data()), file.Size(), error);
+            }
+
+            const int32_t sceneIndex = document.defaultScene > -1 ? document.defaultScene : 0;
+            if (loaded) {
+                loaded = LoadSceneBuffers(document, sceneIndex, std::filesystem::path(filename).parent_path().string(), error);
+            }
+
+            size_t verifiedCount = 0;
+            if (loaded) {
+                loaded = VerifyMeshoptFallbacks(document, verifiedCount, error);
+            }
+            if (loaded && 0 == verifiedCount) {
+                loaded = false;
+                error = "no compressed buffer view with uncompressed fallback data";
+            }
+            return Report(filename + (loaded ? ", " + std::to_string(verifiedCount) + " buffer views match their fallback" : ", " + error), loaded);
+        }
+    }
+
+    bool RunMeshoptConformanceCheck(const std::vector<std::string>& filenames) {
+        bool passed = true;
+        passed = CheckIndices("triangle stream v0", true, triangleStreamV0, sizeof(triangleStreamV0), triangleIndicesV0) && passed;
+        passed = CheckIndices("triangle stream v1", true, triangleStreamV1, sizeof(triangleStreamV1), triangleIndicesV1) && passed;
+        passed = CheckIndices("index sequence v1", false, sequenceStreamV1, sizeof(sequenceStreamV1), sequenceIndicesV1) && passed;
+        passed = CheckFilter("octahedral filter, 8 bit", DecodeOctahedralFilter, 4, octahedral8, octahedral8Decoded) && passed;
+        passed = CheckFilter("octahedral filter, 16 bit", DecodeOctahedralFilter, 8, octahedral12, octahedral12Decoded) && passed;
+        passed = CheckFilter("quaternion filter", DecodeQuaternionFilter, 8, quaternion12, quaternion12Decoded) && passed;
+        passed = CheckFilter("exponential filter", DecodeExponentialFilter, 16, exponential, exponentialDecoded) && passed;
+
+        for (const std::string& filename : filenames) {
+            passed = CheckFile(filename) && passed;
+        }
+        return passed;
+    }
+}
@@ -0,0 +1,12 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#pragma once
+
+namespace Vk {
+    /*
+        Decodes the reference streams of meshoptimizer's own decoder tests and compares them to their expected output,
+        then loads every file of filenames and compares its compressed buffer views to their uncompressed fallback,
+        see VerifyMeshoptFallbacks. Prints one line per check and returns false when any of them fails.
+    */
+    bool RunMeshoptConformanceCheck(const std::vector<std::string>& filenames);
+}
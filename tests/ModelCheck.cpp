@@ -0,0 +1,319 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+#include "ModelCheck.h"
+
+#include "VkInstance.h"
+#include "VkUtils.h"
+#include "VulkanDevice.h"
+#include "VulkanModel.h"
+
+namespace Vk {
+    namespace {
+        bool Report(const std::string& name, bool passed) {
+            std::cout << (passed ? "passed: " : "FAILED: ") << name << std::endl;
+            return passed;
+        }
+
+        // Device of the first physical device without a surface, the checks only load models and copy buffers
+        struct TestDevice {
+            Instance instance;
+            VulkanDevice* device = nullptr;
+            VkQueue queue = VK_NULL_HANDLE;
+
+            bool Create() {
+                if (false == instance.Initialize(false)) {
+                    return false;
+                }
+                uint32_t count = 0;
+                vkEnumeratePhysicalDevices(instance.Get(), &count, nullptr);
+                if (0 == count) {
+                    return false;
+                }
+                std::vector<VkPhysicalDevice> physicalDevices(count);
+                vkEnumeratePhysicalDevices(instance.Get(), &count, physicalDevices.data());
+                device = new VulkanDevice(physicalDevices[0]);
+                if (VK_SUCCESS != device->CreateLogicalDevice({}, {}, VK_QUEUE_GRAPHICS_BIT)) {
+                    return false;
+                }
+                vkGetDeviceQueue(device->logicalDevice, device->queueFamilyIndices.graphics, 0, &queue);
+                return true;
+            }
+
+            ~TestDevice() {
+                delete device;
+                instance.Release();
+            }
+        };
+
+        // Copies size bytes at offset of a device local buffer to the host
+        std::vector<uint8_t> ReadBuffer(TestDevice& test, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) {
+            VulkanDevice& device = *test.device;
+            VkBuffer staging = VK_NULL_HANDLE;
+            VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+            CheckResult(device.CreateBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, size, &staging, &stagingMemory));
+
+            VkCommandBuffer copyCmd = device.CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+            VkBufferCopy copyRegion = {};
+            copyRegion.srcOffset = offset;
+            copyRegion.size = size;
+            vkCmdCopyBuffer(copyCmd, buffer, staging, 1, &copyRegion);
+            device.FlushCommandBuffer(copyCmd, test.queue, true);
+
+            std::vector<uint8_t> result(static_cast<size_t>(size));
+            void* mapped = nullptr;
+            CheckResult(vkMapMemory(device.logicalDevice, stagingMemory, 0, size, 0, &mapped));
+            memcpy(result.data(), mapped, result.size());
+            vkUnmapMemory(device.logicalDevice, stagingMemory);
+            vkDestroyBuffer(device.logicalDevice, staging, nullptr);
+            vkFreeMemory(device.logicalDevice, stagingMemory, nullptr);
+            return result;
+        }
+
+        // Writes name.gltf and the name.bin it refers to into the temporary directory, returns the path of the .gltf
+        std::string WriteGltf(const std::string& name, const std::string& json, const std::vector<uint8_t>& bin) {
+            const std::filesystem::path directory = std::filesystem::temp_directory_path();
+            std::ofstream(directory / (name + ".bin"), std::ios::binary).write(reinterpret_cast<const char*>(bin.data()), bin.size());
+            std::ofstream(directory / (name + ".gltf"), std::ios::binary) << json;
+            return (directory / (name + ".gltf")).string();
+        }
+
+        template<typename T>
+        void Append(std::vector<uint8_t>& bin, std::initializer_list<T> values) {
+            for (const T value : values) {
+                const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+                bin.insert(bin.end(), bytes, bytes + sizeof(T));
+            }
+        }
+
+        // Vertices of the batch in the order its indices draw them, resolved through the 16 or 32 bit section of the primitive
+        std::vector<glm::vec3> DrawnPositions(TestDevice& test, const Model& model, const Primitive& primitive) {
+            const VkDeviceSize indexSize = VK_INDEX_TYPE_UINT16 == primitive.indexType ? 2 : 4;
+            const VkDeviceSize sectionOffset = VK_INDEX_TYPE_UINT16 == primitive.indexType ? 0 : model.indices.wideOffset;
+            const std::vector<uint8_t> indexBytes = ReadBuffer(test, model.indices.buffer, sectionOffset + primitive.firstIndex * indexSize, primitive.indexCount * indexSize);
+
+            std::vector<uint32_t> vertexIndices(primitive.indexCount);
+            uint32_t vertexEnd = 0;
+            for (uint32_t i = 0; i < primitive.indexCount; ++i) {
+                uint32_t index = 0;
+                memcpy(&index, indexBytes.data() + i * indexSize, static_cast<size_t>(indexSize));
+                vertexIndices[i] = index + primitive.vertexOffset;
+                vertexEnd = std::max(vertexEnd, vertexIndices[i] + 1);
+            }
+            const std::vector<uint8_t> vertexBytes = ReadBuffer(test, model.vertices.buffer, 0, vertexEnd * sizeof(Model::Vertex));
+
+            std::vector<glm::vec3> positions;
+            for (const uint32_t vertex : vertexIndices) {
+                Model::Vertex drawn;
+                memcpy(&drawn, vertexBytes.data() + vertex * sizeof(Model::Vertex), sizeof(drawn));
+                positions.push_back(drawn.pos);
+            }
+            return positions;
+        }
+
+        /*
+            One static node draws an indexed and a non-indexed triangle, an animated node draws a non-indexed triangle
+            whose vertices come after them. The batch has to draw both triangles of the static node moved by its translation,
+            and the animated triangle has to keep its vertices at its new firstVertex
+        */
+        bool CheckStaticBatching(TestDevice& test) {
+            const glm::vec3 indexed[] = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } };
+            const glm::vec3 listed[] = { { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 1.0f } };
+            const glm::vec3 animated[] = { { 5.0f, 5.0f, 5.0f }, { 6.0f, 5.0f, 5.0f }, { 5.0f, 6.0f, 5.0f } };
+            const glm::vec3 translation(10.0f, 0.0f, 0.0f);
+
+            std::vector<uint8_t> bin;
+            for (const auto* triangle : { indexed, listed, animated }) {
+                for (uint32_t v = 0; v < 3; ++v) {
+                    Append<float>(bin, { triangle[v].x, triangle[v].y, triangle[v].z });
+                }
+            }
+            Append<uint16_t>(bin, { 0, 1, 2, 0 });
+            Append<float>(bin, { 0.0f, 0.0f, 0.0f, 0.0f });
+
+            const std::string json = R"({
+                "asset": { "version": "2.0" },
+                "scene": 0,
+                "scenes": [ { "nodes": [ 0, 1 ] } ],
+                "nodes": [ { "mesh": 0, "translation": [ 10, 0, 0 ] }, { "mesh": 1 } ],
+                "meshes": [
+                    { "primitives": [ { "attributes": { "POSITION": 0 }, "indices": 3 }, { "attributes": { "POSITION": 1 } } ] },
+                    { "primitives": [ { "attributes": { "POSITION": 2 } } ] }
+                ],
+                "animations": [ {
+                    "channels": [ { "sampler": 0, "target": { "node": 1, "path": "translation" } } ],
+                    "samplers": [ { "input": 4, "output": 5 } ]
+                } ],
+                "accessors": [
+                    { "bufferView": 0, "byteOffset": 0, "componentType": 5126, "count": 3, "type": "VEC3", "min": [ 0, 0, 0 ], "max": [ 1, 1, 0 ] },
+                    { "bufferView": 0, "byteOffset": 36, "componentType": 5126, "count": 3, "type": "VEC3", "min": [ 0, 0, 1 ], "max": [ 1, 1, 1 ] },
+                    { "bufferView": 0, "byteOffset": 72, "componentType": 5126, "count": 3, "type": "VEC3", "min": [ 5, 5, 5 ], "max": [ 6, 6, 5 ] },
+                    { "bufferView": 1, "componentType": 5123, "count": 3, "type": "SCALAR" },
+                    { "bufferView": 2, "componentType": 5126, "count": 1, "type": "SCALAR", "min": [ 0 ], "max": [ 0 ] },
+                    { "bufferView": 2, "byteOffset": 4, "componentType": 5126, "count": 1, "type": "VEC3" }
+                ],
+                "bufferViews": [
+                    { "buffer": 0, "byteOffset": 0, "byteLength": 108 },
+                    { "buffer": 0, "byteOffset": 108, "byteLength": 6 },
+                    { "buffer": 0, "byteOffset": 116, "byteLength": 16 }
+                ],
+                "buffers": [ { "uri": "NewFrameworkStaticBatching.bin", "byteLength": 132 } ]
+            })";
+            const std::string filename = WriteGltf("NewFrameworkStaticBatching", json, bin);
+
+            ModelImportOptions options;
+            options.staticBatching = true;
+            options.optimizeMeshes = false;
+            options.generateLods = false;
+            Model model;
+            model.LoadFromFile(filename, test.device, test.queue, 1.0f, {}, options);
+
+            bool passed = Report("static batching, static node gives its mesh to the batch", model.linearNodes.size() == 3 && nullptr == model.linearNodes[0]->mesh);
+            const Node* animatedNode = passed ? model.linearNodes[1] : nullptr;
+            const Node* batchNode = passed ? model.linearNodes[2] : nullptr;
+            passed = Report("static batching, one batch of both primitives", nullptr != batchNode && nullptr != batchNode->mesh &&
+                1 == batchNode->mesh->primitives.size() && 6 == batchNode->mesh->primitives[0].indexCount) && passed;
+            if (false == passed) {
+                model.Destroy(test.device->logicalDevice);
+                return false;
+            }
+
+            std::vector<glm::vec3> expected;
+            for (const auto* triangle : { indexed, listed }) {
+                for (uint32_t v = 0; v < 3; ++v) {
+                    expected.push_back(triangle[v] + translation);
+                }
+            }
+            passed = Report("static batching, batch draws the indexed and the non-indexed triangle", expected == DrawnPositions(test, model, batchNode->mesh->primitives[0])) && passed;
+
+            // The vertices of the static node are dropped, the triangle of the animated node moves to the front
+            const Primitive& kept = animatedNode->mesh->primitives[0];
+            bool keptMatches = 0 == kept.indexCount && 0 == kept.firstVertex && 3 == kept.vertexCount;
+            if (keptMatches) {
+                const std::vector<uint8_t> vertexBytes = ReadBuffer(test, model.vertices.buffer, 0, 3 * sizeof(Model::Vertex));
+                for (uint32_t v = 0; v < 3; ++v) {
+                    Model::Vertex vertex;
+                    memcpy(&vertex, vertexBytes.data() + v * sizeof(Model::Vertex), sizeof(vertex));
+                    keptMatches = keptMatches && animated[v] == vertex.pos;
+                }
+            }
+            passed = Report("static batching, non-indexed primitive of an animated node keeps its vertices", keptMatches) && passed;
+
+            model.Destroy(test.device->logicalDevice);
+            return passed;
+        }
+
+        /*
+            A static and a skinned node each draw a non-indexed triangle with positions outside [0, 1]. Quantized vertices
+            have to decode to the source positions within the cube of their primitive, the skinned vertices move to the
+            front and need entries in the skin stream
+        */
+        bool CheckQuantizedWithoutIndices(TestDevice& test) {
+            const glm::vec3 still[] = { { -3.0f, 2.0f, 7.0f }, { 10.0f, -4.0f, 2.0f }, { 0.5f, 20.0f, -8.0f } };
+            const glm::vec3 skinned[] = { { -2.0f, -2.0f, -2.0f }, { 3.0f, -2.0f, -2.0f }, { -2.0f, 4.0f, -2.0f } };
+
+            std::vector<uint8_t> bin;
+            for (const auto* triangle : { still, skinned }) {
+                for (uint32_t v = 0; v < 3; ++v) {
+                    Append<float>(bin, { triangle[v].x, triangle[v].y, triangle[v].z });
+                }
+            }
+            for (uint32_t v = 0; v < 3; ++v) {
+                Append<uint8_t>(bin, { 0, 0, 0, 0 });
+            }
+            for (uint32_t v = 0; v < 3; ++v) {
+                Append<float>(bin, { 1.0f, 0.0f, 0.0f, 0.0f });
+            }
+            const glm::mat4 inverseBind(1.0f);
+            for (uint32_t column = 0; column < 4; ++column) {
+                Append<float>(bin, { inverseBind[column].x, inverseBind[column].y, inverseBind[column].z, inverseBind[column].w });
+            }
+
+            const std::string json = R"({
+                "asset": { "version": "2.0" },
+                "scene": 0,
+                "scenes": [ { "nodes": [ 0, 1, 2 ] } ],
+                "nodes": [ { "mesh": 0 }, { "mesh": 1, "skin": 0 }, { "name": "joint" } ],
+                "skins": [ { "joints": [ 2 ], "inverseBindMatrices": 4 } ],
+                "meshes": [
+                    { "primitives": [ { "attributes": { "POSITION": 0 } } ] },
+                    { "primitives": [ { "attributes": { "POSITION": 1, "JOINTS_0": 2, "WEIGHTS_0": 3 } } ] }
+                ],
+                "accessors": [
+                    { "bufferView": 0, "byteOffset": 0, "componentType": 5126, "count": 3, "type": "VEC3", "min": [ -3, -4, -8 ], "max": [ 10, 20, 7 ] },
+                    { "bufferView": 0, "byteOffset": 36, "componentType": 5126, "count": 3, "type": "VEC3", "min": [ -2, -2, -2 ], "max": [ 3, 4, -2 ] },
+                    { "bufferView": 1, "componentType": 5121, "count": 3, "type": "VEC4" },
+                    { "bufferView": 2, "componentType": 5126, "count": 3, "type": "VEC4" },
+                    { "bufferView": 3, "componentType": 5126, "count": 1, "type": "MAT4" }
+                ],
+                "bufferViews": [
+                    { "buffer": 0, "byteOffset": 0, "byteLength": 72 },
+                    { "buffer": 0, "byteOffset": 72, "byteLength": 12 },
+                    { "buffer": 0, "byteOffset": 84, "byteLength": 48 },
+                    { "buffer": 0, "byteOffset": 132, "byteLength": 64 }
+                ],
+                "buffers": [ { "uri": "NewFrameworkQuantized.bin", "byteLength": 196 } ]
+            })";
+            const std::string filename = WriteGltf("NewFrameworkQuantized", json, bin);
+
+            Model model;
+            model.vertexFormat = VertexFormat::Quantized;
+            model.LoadFromFile(filename, test.device, test.queue);
+
+            bool passed = Report("quantized, both non-indexed triangles loaded", model.linearNodes.size() == 3 &&
+                nullptr != model.linearNodes[0]->mesh && nullptr != model.linearNodes[1]->mesh && VK_NULL_HANDLE != model.vertices.buffer);
+            if (false == passed) {
+                model.Destroy(test.device->logicalDevice);
+                return false;
+            }
+
+            const std::vector<uint8_t> vertexBytes = ReadBuffer(test, model.vertices.buffer, 0, 6 * sizeof(QuantizedVertex));
+            const auto decodes = [&vertexBytes](const Primitive& primitive, const glm::vec3* expected) {
+                if (0 != primitive.indexCount || 3 != primitive.vertexCount || primitive.firstVertex > 3) {
+                    return false;
+                }
+                // Within one step of the 16 bit grid
+                const float tolerance = primitive.positionScale / 65535.0f;
+                for (uint32_t v = 0; v < 3; ++v) {
+                    QuantizedVertex vertex;
+                    memcpy(&vertex, vertexBytes.data() + (primitive.firstVertex + v) * sizeof(QuantizedVertex), sizeof(vertex));
+                    const glm::vec3 unorm = glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]) / 65535.0f;
+                    const glm::vec3 decoded = primitive.positionOffset + unorm * primitive.positionScale;
+                    if (glm::any(glm::greaterThan(glm::abs(decoded - expected[v]), glm::vec3(tolerance)))) {
+                        return false;
+                    }
+                }
+                return true;
+            };
+            const Primitive& stillPrimitive = model.linearNodes[0]->mesh->primitives[0];
+            const Primitive& skinnedPrimitive = model.linearNodes[1]->mesh->primitives[0];
+            passed = Report("quantized, non-indexed positions outside [0, 1] decode to their source", decodes(stillPrimitive, still)) && passed;
+            passed = Report("quantized, skinned non-indexed positions decode to their source", decodes(skinnedPrimitive, skinned)) && passed;
+
+            // Skinned vertices come first, so the skin stream holds exactly the skinned triangle
+            bool skinMatches = 0 == skinnedPrimitive.firstVertex && VK_NULL_HANDLE != model.skinVertices.buffer;
+            if (skinMatches) {
+                const std::vector<uint8_t> skinBytes = ReadBuffer(test, model.skinVertices.buffer, 0, 3 * sizeof(PackedSkin));
+                for (uint32_t v = 0; v < 3; ++v) {
+                    PackedSkin skin;
+                    memcpy(&skin, skinBytes.data() + v * sizeof(PackedSkin), sizeof(skin));
+                    skinMatches = skinMatches && 0 == skin.joints[0] && UINT16_MAX == skin.weights[0] && 0 == skin.weights[1];
+                }
+            }
+            passed = Report("quantized, skinned non-indexed vertices have skin stream entries", skinMatches) && passed;
+
+            model.Destroy(test.device->logicalDevice);
+            return passed;
+        }
+    }
+
+    bool RunModelCheck() {
+        TestDevice test;
+        if (false == Report("device without a window", test.Create())) {
+            return false;
+        }
+        bool passed = CheckStaticBatching(test);
+        passed = CheckQuantizedWithoutIndices(test) && passed;
+        return passed;
+    }
+}
@@ -0,0 +1,13 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#pragma once
+
+namespace Vk {
+    /*
+        Loads small glTF files written to the temporary directory on a device without a window and reads the uploaded
+        vertex and index buffers back. Covers static batching of indexed and non-indexed primitives, and quantized
+        positions and skin streams of non-indexed primitives.
+        Prints one line per check and returns false when any of them fails or no device could be created.
+    */
+    bool RunModelCheck();
+}
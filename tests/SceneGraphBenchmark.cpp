@@ -0,0 +1,188 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+#include "SceneGraphBenchmark.h"
+
+#include "SceneGraph.h"
+#include "ThreadPool.h"
+
+namespace Vk {
+    namespace {
+        // The node of the former Model, every world matrix is rebuilt from the local matrices of all parents
+        struct ReferenceNode {
+            glm::vec3                           translation{ 0.0f };
+            glm::quat                           rotation{ 1.0f, 0.0f, 0.0f, 0.0f };
+            glm::vec3                           scale{ 1.0f };
+            glm::mat4                           matrix{ 1.0f };
+            glm::mat4                           world{ 1.0f };
+            ReferenceNode*                      parent = nullptr;
+            std::vector<ReferenceNode*>         children;
+
+            glm::mat4 LocalMatrix() const {
+                return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
+            }
+
+            glm::mat4 GetMatrix() const {
+                glm::mat4 m = LocalMatrix();
+                for (const ReferenceNode* p = parent; nullptr != p; p = p->parent) {
+                    m = p->LocalMatrix() * m;
+                }
+                return m;
+            }
+
+            void Update() {
+                world = GetMatrix();
+                for (ReferenceNode* child : children) {
+                    child->Update();
+                }
+            }
+        };
+
+        // xorshift32, the hierarchy is the same on every run
+        struct Random {
+            uint32_t                            state = 0x9e3779b9u;
+
+            uint32_t Next() {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                return state;
+            }
+            float Unit() { return static_cast<float>(Next() >> 8) / static_cast<float>(1u << 24); }
+        };
+
+        glm::quat FrameRotation(uint32_t slot, uint32_t frame) {
+            const glm::vec3 axis = glm::normalize(glm::vec3(1.0f + static_cast<float>(slot % 3), static_cast<float>(slot % 5), 1.0f));
+            return glm::angleAxis(0.01f * static_cast<float>(frame + 1) + 0.001f * static_cast<float>(slot % 97), axis);
+        }
+
+        template<typename Func>
+        double MillisecondsPerFrame(uint32_t frameCount, Func&& frame) {
+            // The first frame starts the thread pool and warms the caches and is not counted
+            frame(0);
+            double total = 0.0;
+            for (uint32_t i = 1; i <= frameCount; ++i) {
+                total += frame(i);
+            }
+            return total / static_cast<double>(frameCount);
+        }
+    }
+
+    bool RunSceneGraphBenchmark(uint32_t nodeCount, uint32_t maxDepth, uint32_t frameCount) {
+        using Clock = std::chrono::steady_clock;
+        const auto milliseconds = [](Clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        };
+
+        // Random tree, parents come before their children and no node is deeper than maxDepth
+        Random random;
+        std::vector<int32_t> parents(nodeCount, -1);
+        std::vector<uint32_t> depths(nodeCount, 0);
+        std::vector<std::vector<uint32_t>> children(nodeCount);
+        std::vector<uint32_t> roots;
+        for (uint32_t node = 0; node < nodeCount; ++node) {
+            if (0 == node || 0 == random.Next() % 1000) {
+                roots.push_back(node);
+                continue;
+            }
+            uint32_t parent = random.Next() % node;
+            while (depths[parent] + 1 >= maxDepth) {
+                parent = random.Next() % node;
+            }
+            parents[node] = static_cast<int32_t>(parent);
+            depths[node] = depths[parent] + 1;
+            children[parent].push_back(node);
+        }
+
+        // Depth first slots, the order SceneGraph hands them out in when a model is loaded
+        std::vector<uint32_t> order;
+        order.reserve(nodeCount);
+        std::vector<uint32_t> stack(roots.rbegin(), roots.rend());
+        while (false == stack.empty()) {
+            const uint32_t node = stack.back();
+            stack.pop_back();
+            order.push_back(node);
+            stack.insert(stack.end(), children[node].rbegin(), children[node].rend());
+        }
+        std::vector<int32_t> slots(nodeCount, -1);
+        for (uint32_t slot = 0; slot < nodeCount; ++slot) {
+            slots[order[slot]] = static_cast<int32_t>(slot);
+        }
+
+        SceneGraph graph;
+        std::vector<ReferenceNode> reference(nodeCount);
+        graph.Reserve(nodeCount);
+        for (uint32_t slot = 0; slot < nodeCount; ++slot) {
+            const uint32_t node = order[slot];
+            const int32_t parent = parents[node] > -1 ? slots[parents[node]] : -1;
+            graph.Add(parent, node, "");
+
+            ReferenceNode& referenceNode = reference[slot];
+            referenceNode.translation = glm::vec3(random.Unit(), random.Unit(), random.Unit()) * 2.0f - 1.0f;
+            referenceNode.scale = glm::vec3(0.9f + 0.2f * random.Unit());
+            // Some nodes carry a glTF matrix on top of their TRS
+            if (0 == slot % 16) {
+                referenceNode.matrix = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, 1.0f + 0.1f * random.Unit(), 1.0f));
+                graph.SetMatrix(slot, referenceNode.matrix);
+            }
+            graph.SetTranslation(slot, referenceNode.translation);
+            graph.SetScale(slot, referenceNode.scale);
+            if (parent > -1) {
+                referenceNode.parent = &reference[parent];
+                reference[parent].children.push_back(&referenceNode);
+            }
+        }
+        graph.UpdateWorldMatrices();
+
+        const double recursion = MillisecondsPerFrame(frameCount, [&](uint32_t frame) {
+            for (uint32_t slot = 0; slot < nodeCount; ++slot) {
+                reference[slot].rotation = FrameRotation(slot, frame);
+            }
+            const auto start = Clock::now();
+            for (const uint32_t root : roots) {
+                reference[slots[root]].Update();
+            }
+            return milliseconds(start);
+        });
+
+        const auto updateGraph = [&](uint32_t frame) {
+            for (uint32_t slot = 0; slot < nodeCount; ++slot) {
+                graph.SetRotation(slot, FrameRotation(slot, frame));
+            }
+            const auto start = Clock::now();
+            graph.UpdateWorldMatrices();
+            return milliseconds(start);
+        };
+        // Every run ends on the last frame, so the graph has to match the recursion after each of them
+        const auto maxDifference = [&]() {
+            float maxError = 0.0f;
+            for (uint32_t slot = 0; slot < nodeCount; ++slot) {
+                for (glm::length_t column = 0; column < 4; ++column) {
+                    for (glm::length_t row = 0; row < 4; ++row) {
+                        const float expected = reference[slot].world[column][row];
+                        const float error = std::abs(graph.worldMatrices[slot][column][row] - expected) / std::max(1.0f, std::abs(expected));
+                        maxError = std::max(maxError, error);
+                    }
+                }
+            }
+            return maxError;
+        };
+
+        graph.batchMinNodes = UINT32_MAX;
+        const double subtreeWalk = MillisecondsPerFrame(frameCount, updateGraph);
+        const float subtreeWalkError = maxDifference();
+        graph.batchMinNodes = 0;
+        const double batched = MillisecondsPerFrame(frameCount, updateGraph);
+        const float batchedError = maxDifference();
+
+        std::cout << "Scene graph benchmark, " << nodeCount << " nodes, depth up to " << maxDepth << ", " << roots.size() << " roots, "
+            << ThreadPool::Get().ThreadCount() + 1 << " threads, every rotation changed each frame" << std::endl;
+        std::cout << "Node::Update recursion: " << recursion << " ms per frame" << std::endl;
+        std::cout << "Subtree walk: " << subtreeWalk << " ms per frame, largest relative difference " << subtreeWalkError << std::endl;
+        std::cout << "Batched kernels: " << batched << " ms per frame, largest relative difference " << batchedError << std::endl;
+
+        // The graph multiplies in another order than the recursion, which leaves a few ulps of rounding
+        constexpr float tolerance = 1e-4f;
+        return subtreeWalkError <= tolerance && batchedError <= tolerance;
+    }
+}
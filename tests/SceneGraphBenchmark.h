@@ -0,0 +1,14 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#pragma once
+
+namespace Vk {
+    /*
+        Times the world matrix update of a generated hierarchy in which every rotation changes each frame. The
+        reference is the Node::Update recursion the scene graph replaced, which rebuilds every world matrix by
+        walking up the parents, against the subtree walk and the batched SIMD kernels of SceneGraph. Prints the
+        milliseconds per frame of each and the largest relative difference of the graph to the reference, and returns
+        false when that difference is more than rounding.
+    */
+    bool RunSceneGraphBenchmark(uint32_t nodeCount = 50000, uint32_t maxDepth = 13, uint32_t frameCount = 20);
+}
@@ -0,0 +1,41 @@
+// Copyright 2018-2019 TAP, Inc. All Rights Reserved.
+
+#include "stdafx.h"
+
+#include "GltfMeshoptCheck.h"
+#include "ModelCheck.h"
+#include "SceneGraphBenchmark.h"
+
+namespace {
+    int32_t PrintUsage() {
+        std::cerr << "Usage: NewFrameworkTests --check-meshopt [file.gltf|file.glb ...]" << std::endl;
+        std::cerr << "       NewFrameworkTests --check-model" << std::endl;
+        std::cerr << "       NewFrameworkTests --bench" << std::endl;
+        return 2;
+    }
+}
+
+// Console checks that stay out of the renderer, the exit code is 0 when every check passed
+int main(int argc, char* argv[]) {
+    const std::vector<std::string> arguments(argv + 1, argv + argc);
+    if (arguments.empty()) {
+        return PrintUsage();
+    }
+
+    // --check-meshopt [files] compares the meshopt decoders to reference streams and the fallback data of the files
+    if ("--check-meshopt" == arguments[0]) {
+        return Vk::RunMeshoptConformanceCheck({ arguments.begin() + 1, arguments.end() }) ? 0 : 1;
+    }
+
+    // --check-model loads generated glTF files on a device without a window and reads their buffers back
+    if ("--check-model" == arguments[0] && 1 == arguments.size()) {
+        return Vk::RunModelCheck() ? 0 : 1;
+    }
+
+    // --bench times the scene graph update and fails when its world matrices differ from the reference
+    if ("--bench" == arguments[0] && 1 == arguments.size()) {
+        return Vk::RunSceneGraphBenchmark() ? 0 : 1;
+    }
+
+    return PrintUsage();
+}